@@ -1,16 +1,42 @@
 #include "Epub.h"
 
+#include <FileHandleCache.h>
 #include <FsHelpers.h>
 #include <HardwareSerial.h>
 #include <JpegToBmpConverter.h>
 #include <SDCardManager.h>
 #include <ZipFile.h>
 
+#include "Epub/BookFingerprintStore.h"
+#include "Epub/CacheManifest.h"
 #include "Epub/parsers/ContainerParser.h"
 #include "Epub/parsers/ContentOpfParser.h"
 #include "Epub/parsers/TocNavParser.h"
 #include "Epub/parsers/TocNcxParser.h"
 
+Epub::Epub(std::string filepath, const std::string& cacheDir) : filepath(std::move(filepath)) {
+  // Caches used to be keyed by the filepath, so moving or renaming a book threw its cache away
+  const std::string legacyCachePath =
+      cacheDir + "/epub_" + std::to_string(std::hash<std::string>{}(this->filepath));
+
+  BookFingerprint fingerprint;
+  if (!BOOK_FINGERPRINTS.get(this->filepath, &fingerprint)) {
+    cachePath = legacyCachePath;
+    return;
+  }
+
+  // create a cache key based on the book's content
+  cachePath = cacheDir + "/epub_" + fingerprint.cacheKey();
+  if (!SdMan.exists(cachePath.c_str()) && SdMan.exists(legacyCachePath.c_str())) {
+    FILE_CACHE.invalidateDir(legacyCachePath);
+    FsFile legacyDir = SdMan.open(legacyCachePath.c_str());
+    if (legacyDir && legacyDir.rename(cachePath.c_str())) {
+      Serial.printf("[%lu] [EBP] Migrated cache %s to %s\n", millis(), legacyCachePath.c_str(), cachePath.c_str());
+    }
+    legacyDir.close();
+  }
+}
+
 bool Epub::findContentOpfFile(std::string* contentOpfFile) const {
   const auto containerPath = "META-INF/container.xml";
   size_t containerSize;
@@ -99,49 +125,42 @@ bool Epub::parseTocNcxFile() const {
 
   Serial.printf("[%lu] [EBP] Parsing toc ncx file: %s\n", millis(), tocNcxItem.c_str());
 
-  const auto tmpNcxPath = getCachePath() + "/toc.ncx";
-  FsFile tempNcxFile;
-  if (!SdMan.openFileForWrite("EBP", tmpNcxPath, tempNcxFile)) {
-    return false;
-  }
-  readItemContentsToStream(tocNcxItem, tempNcxFile, 1024);
-  tempNcxFile.close();
-  if (!SdMan.openFileForRead("EBP", tmpNcxPath, tempNcxFile)) {
+  ZipFile::EntryReader ncxReader;
+  if (!openItemContents(tocNcxItem, ncxReader)) {
+    Serial.printf("[%lu] [EBP] Could not open toc ncx file\n", millis());
     return false;
   }
-  const auto ncxSize = tempNcxFile.size();
 
-  TocNcxParser ncxParser(contentBasePath, ncxSize, bookMetadataCache.get());
+  TocNcxParser ncxParser(contentBasePath, ncxReader.size(), bookMetadataCache.get());
 
   if (!ncxParser.setup()) {
     Serial.printf("[%lu] [EBP] Could not setup toc ncx parser\n", millis());
-    tempNcxFile.close();
     return false;
   }
 
   const auto ncxBuffer = static_cast<uint8_t*>(malloc(1024));
   if (!ncxBuffer) {
     Serial.printf("[%lu] [EBP] Could not allocate memory for toc ncx parser\n", millis());
-    tempNcxFile.close();
     return false;
   }
 
-  while (tempNcxFile.available()) {
-    const auto readSize = tempNcxFile.read(ncxBuffer, 1024);
-    if (readSize == 0) break;
+  while (ncxReader.available() > 0) {
+    const int readSize = ncxReader.read(ncxBuffer, 1024);
+    if (readSize <= 0) {
+      Serial.printf("[%lu] [EBP] Could not read toc ncx data\n", millis());
+      free(ncxBuffer);
+      return false;
+    }
     const auto processedSize = ncxParser.write(ncxBuffer, readSize);
 
-    if (processedSize != readSize) {
+    if (processedSize != static_cast<size_t>(readSize)) {
       Serial.printf("[%lu] [EBP] Could not process all toc ncx data\n", millis());
       free(ncxBuffer);
-      tempNcxFile.close();
       return false;
     }
   }
 
   free(ncxBuffer);
-  tempNcxFile.close();
-  SdMan.remove(tmpNcxPath.c_str());
 
   Serial.printf("[%lu] [EBP] Parsed TOC items\n", millis());
   return true;
@@ -156,22 +175,16 @@ bool Epub::parseTocNavFile() const {
 
   Serial.printf("[%lu] [EBP] Parsing toc nav file: %s\n", millis(), tocNavItem.c_str());
 
-  const auto tmpNavPath = getCachePath() + "/toc.nav";
-  FsFile tempNavFile;
-  if (!SdMan.openFileForWrite("EBP", tmpNavPath, tempNavFile)) {
-    return false;
-  }
-  readItemContentsToStream(tocNavItem, tempNavFile, 1024);
-  tempNavFile.close();
-  if (!SdMan.openFileForRead("EBP", tmpNavPath, tempNavFile)) {
+  ZipFile::EntryReader navReader;
+  if (!openItemContents(tocNavItem, navReader)) {
+    Serial.printf("[%lu] [EBP] Could not open toc nav file\n", millis());
     return false;
   }
-  const auto navSize = tempNavFile.size();
 
   // Note: We can't use `contentBasePath` here as the nav file may be in a different folder to the content.opf
   // and the HTMLX nav file will have hrefs relative to itself
   const std::string navContentBasePath = tocNavItem.substr(0, tocNavItem.find_last_of('/') + 1);
-  TocNavParser navParser(navContentBasePath, navSize, bookMetadataCache.get());
+  TocNavParser navParser(navContentBasePath, navReader.size(), bookMetadataCache.get());
 
   if (!navParser.setup()) {
     Serial.printf("[%lu] [EBP] Could not setup toc nav parser\n", millis());
@@ -184,21 +197,23 @@ bool Epub::parseTocNavFile() const {
     return false;
   }
 
-  while (tempNavFile.available()) {
-    const auto readSize = tempNavFile.read(navBuffer, 1024);
+  while (navReader.available() > 0) {
+    const int readSize = navReader.read(navBuffer, 1024);
+    if (readSize <= 0) {
+      Serial.printf("[%lu] [EBP] Could not read toc nav data\n", millis());
+      free(navBuffer);
+      return false;
+    }
     const auto processedSize = navParser.write(navBuffer, readSize);
 
-    if (processedSize != readSize) {
+    if (processedSize != static_cast<size_t>(readSize)) {
       Serial.printf("[%lu] [EBP] Could not process all toc nav data\n", millis());
       free(navBuffer);
-      tempNavFile.close();
       return false;
     }
   }
 
   free(navBuffer);
-  tempNavFile.close();
-  SdMan.remove(tmpNavPath.c_str());
 
   Serial.printf("[%lu] [EBP] Parsed TOC nav items\n", millis());
   return true;
@@ -208,11 +223,21 @@ bool Epub::parseTocNavFile() const {
 bool Epub::load(const bool buildIfMissing) {
   Serial.printf("[%lu] [EBP] Loading ePub: %s\n", millis(), filepath.c_str());
 
+  // Drop (or migrate) only the cache stages whose format changed since they were written
+  const bool cacheExisted = SdMan.exists(cachePath.c_str());
+  if (cacheExisted) {
+    CacheManifest(*this).reconcile();
+  }
+
   // Initialize spine/TOC cache
   bookMetadataCache.reset(new BookMetadataCache(cachePath));
 
   // Try to load existing cache first
   if (bookMetadataCache->load()) {
+    // Caches built before the central directory index existed won't have one yet
+    if (!SdMan.exists(getZipIndexPath().c_str())) {
+      ZipFile(filepath, getZipIndexPath()).buildIndex();
+    }
     Serial.printf("[%lu] [EBP] Loaded ePub: %s\n", millis(), filepath.c_str());
     return true;
   }
@@ -225,9 +250,23 @@ bool Epub::load(const bool buildIfMissing) {
   // Cache doesn't exist or is invalid, build it
   Serial.printf("[%lu] [EBP] Cache not found, building spine/TOC cache\n", millis());
   setupCacheDir();
+  if (!cacheExisted) {
+    // Records the stage versions the new cache is written with
+    CacheManifest(*this).reconcile();
+  }
 
   const uint32_t indexingStart = millis();
 
+  // Index the zip central directory first so every lookup below is a binary search rather than a scan. An index that
+  // survived the manifest check is kept, the zip index still rejects itself if the file changed.
+  if (!SdMan.exists(getZipIndexPath().c_str())) {
+    const uint32_t zipIndexStart = millis();
+    if (!ZipFile(filepath, getZipIndexPath()).buildIndex()) {
+      Serial.printf("[%lu] [EBP] Could not build zip index, falling back to central directory scans\n", millis());
+    }
+    Serial.printf("[%lu] [EBP] Zip index built in %lu ms\n", millis(), millis() - zipIndexStart);
+  }
+
   // Begin building cache - stream entries to disk immediately
   if (!bookMetadataCache->beginWrite()) {
     Serial.printf("[%lu] [EBP] Could not begin writing cache\n", millis());
@@ -291,7 +330,7 @@ bool Epub::load(const bool buildIfMissing) {
 
   // Build final book.bin
   const uint32_t buildStart = millis();
-  if (!bookMetadataCache->buildBookBin(filepath, bookMetadata)) {
+  if (!bookMetadataCache->buildBookBin(filepath, getZipIndexPath(), bookMetadata)) {
     Serial.printf("[%lu] [EBP] Could not update mappings and sizes\n", millis());
     return false;
   }
@@ -319,7 +358,13 @@ bool Epub::clearCache() const {
     return true;
   }
 
-  if (!SdMan.removeDir(cachePath.c_str())) {
+  if (sectionPack) {
+    sectionPack->reset();
+  }
+  if (pageMap) {
+    pageMap->reset();
+  }
+  if (!FILE_CACHE.removeDir(cachePath.c_str())) {
     Serial.printf("[%lu] [EPB] Failed to clear cache\n", millis());
     return false;
   }
@@ -338,6 +383,33 @@ void Epub::setupCacheDir() const {
 
 const std::string& Epub::getCachePath() const { return cachePath; }
 
+std::string Epub::getZipIndexPath() const { return cachePath + "/zip.idx"; }
+
+std::string Epub::getSectionPackPath() const { return cachePath + "/sections.pack"; }
+
+SectionPack& Epub::getSectionPack() const {
+  if (!sectionPack) {
+    sectionPack.reset(new SectionPack(getSectionPackPath()));
+    if (!SdMan.exists(sectionPack->getPath().c_str())) {
+      // Sections used to be one file each, drop those rather than keeping two caches of the same layout around
+      const auto legacySectionsDir = cachePath + "/sections";
+      if (SdMan.exists(legacySectionsDir.c_str())) {
+        FILE_CACHE.removeDir(legacySectionsDir.c_str());
+      }
+    } else if (sectionPack->shouldCompact()) {
+      sectionPack->compact();
+    }
+  }
+  return *sectionPack;
+}
+
+BookPageMap& Epub::getBookPageMap() const {
+  if (!pageMap) {
+    pageMap.reset(new BookPageMap(cachePath + "/pages.bin"));
+  }
+  return *pageMap;
+}
+
 const std::string& Epub::getPath() const { return filepath; }
 
 const std::string& Epub::getTitle() const {
@@ -392,28 +464,18 @@ bool Epub::generateCoverBmp(bool cropped) const {
   if (coverImageHref.substr(coverImageHref.length() - 4) == ".jpg" ||
       coverImageHref.substr(coverImageHref.length() - 5) == ".jpeg") {
     Serial.printf("[%lu] [EBP] Generating BMP from JPG cover image (%s mode)\n", millis(), cropped ? "cropped" : "fit");
-    const auto coverJpgTempPath = getCachePath() + "/.cover.jpg";
-
-    FsFile coverJpg;
-    if (!SdMan.openFileForWrite("EBP", coverJpgTempPath, coverJpg)) {
-      return false;
-    }
-    readItemContentsToStream(coverImageHref, coverJpg, 1024);
-    coverJpg.close();
-
-    if (!SdMan.openFileForRead("EBP", coverJpgTempPath, coverJpg)) {
+    ZipFile::EntryReader coverJpg;
+    if (!openItemContents(coverImageHref, coverJpg)) {
       return false;
     }
 
     FsFile coverBmp;
     if (!SdMan.openFileForWrite("EBP", getCoverBmpPath(cropped), coverBmp)) {
-      coverJpg.close();
       return false;
     }
     const bool success = JpegToBmpConverter::jpegFileToBmpStream(coverJpg, coverBmp, cropped);
     coverJpg.close();
     coverBmp.close();
-    SdMan.remove(coverJpgTempPath.c_str());
 
     if (!success) {
       Serial.printf("[%lu] [EBP] Failed to generate BMP from JPG cover image\n", millis());
@@ -450,22 +512,13 @@ bool Epub::generateThumbBmp() const {
   if (coverImageHref.substr(coverImageHref.length() - 4) == ".jpg" ||
       coverImageHref.substr(coverImageHref.length() - 5) == ".jpeg") {
     Serial.printf("[%lu] [EBP] Generating thumb BMP from JPG cover image\n", millis());
-    const auto coverJpgTempPath = getCachePath() + "/.cover.jpg";
-
-    FsFile coverJpg;
-    if (!SdMan.openFileForWrite("EBP", coverJpgTempPath, coverJpg)) {
-      return false;
-    }
-    readItemContentsToStream(coverImageHref, coverJpg, 1024);
-    coverJpg.close();
-
-    if (!SdMan.openFileForRead("EBP", coverJpgTempPath, coverJpg)) {
+    ZipFile::EntryReader coverJpg;
+    if (!openItemContents(coverImageHref, coverJpg)) {
       return false;
     }
 
     FsFile thumbBmp;
     if (!SdMan.openFileForWrite("EBP", getThumbBmpPath(), thumbBmp)) {
-      coverJpg.close();
       return false;
     }
     // Use smaller target size for Continue Reading card (half of screen: 240x400)
@@ -476,7 +529,6 @@ bool Epub::generateThumbBmp() const {
                                                                              THUMB_TARGET_HEIGHT);
     coverJpg.close();
     thumbBmp.close();
-    SdMan.remove(coverJpgTempPath.c_str());
 
     if (!success) {
       Serial.printf("[%lu] [EBP] Failed to generate thumb BMP from JPG cover image\n", millis());
@@ -500,7 +552,7 @@ uint8_t* Epub::readItemContentsToBytes(const std::string& itemHref, size_t* size
 
   const std::string path = FsHelpers::normalisePath(itemHref);
 
-  const auto content = ZipFile(filepath).readFileToMemory(path.c_str(), size, trailingNullByte);
+  const auto content = ZipFile(filepath, getZipIndexPath()).readFileToMemory(path.c_str(), size, trailingNullByte);
   if (!content) {
     Serial.printf("[%lu] [EBP] Failed to read item %s\n", millis(), path.c_str());
     return nullptr;
@@ -516,12 +568,22 @@ bool Epub::readItemContentsToStream(const std::string& itemHref, Print& out, con
   }
 
   const std::string path = FsHelpers::normalisePath(itemHref);
-  return ZipFile(filepath).readFileToStream(path.c_str(), out, chunkSize);
+  return ZipFile(filepath, getZipIndexPath()).readFileToStream(path.c_str(), out, chunkSize);
+}
+
+bool Epub::openItemContents(const std::string& itemHref, ZipFile::EntryReader& reader, const size_t chunkSize) const {
+  if (itemHref.empty()) {
+    Serial.printf("[%lu] [EBP] Failed to open item, empty href\n", millis());
+    return false;
+  }
+
+  const std::string path = FsHelpers::normalisePath(itemHref);
+  return ZipFile(filepath, getZipIndexPath()).openEntry(path.c_str(), reader, chunkSize);
 }
 
 bool Epub::getItemSize(const std::string& itemHref, size_t* size) const {
   const std::string path = FsHelpers::normalisePath(itemHref);
-  return ZipFile(filepath).getInflatedFileSize(path.c_str(), size);
+  return ZipFile(filepath, getZipIndexPath()).getInflatedFileSize(path.c_str(), size);
 }
 
 int Epub::getSpineItemsCount() const {
@@ -531,7 +593,26 @@ int Epub::getSpineItemsCount() const {
   return bookMetadataCache->getSpineCount();
 }
 
-size_t Epub::getCumulativeSpineItemSize(const int spineIndex) const { return getSpineItem(spineIndex).cumulativeSize; }
+size_t Epub::getCumulativeSpineItemSize(const int spineIndex) const {
+  if (!bookMetadataCache || !bookMetadataCache->isLoaded() || bookMetadataCache->getSpineCount() == 0) {
+    Serial.printf("[%lu] [EBP] getCumulativeSpineItemSize called but cache not loaded\n", millis());
+    return 0;
+  }
+
+  if (spineIndex < 0 || spineIndex >= bookMetadataCache->getSpineCount()) {
+    Serial.printf("[%lu] [EBP] getCumulativeSpineItemSize index:%d is out of range\n", millis(), spineIndex);
+    return bookMetadataCache->getSpineCumulativeSize(0);
+  }
+
+  return bookMetadataCache->getSpineCumulativeSize(spineIndex);
+}
+
+int Epub::getSpineIndexForBookOffset(const size_t offset) const {
+  if (!bookMetadataCache || !bookMetadataCache->isLoaded()) {
+    return 0;
+  }
+  return bookMetadataCache->findSpineIndexForOffset(static_cast<uint32_t>(offset));
+}
 
 BookMetadataCache::SpineEntry Epub::getSpineItem(const int spineIndex) const {
   if (!bookMetadataCache || !bookMetadataCache->isLoaded()) {
@@ -569,6 +650,17 @@ int Epub::getTocItemsCount() const {
   return bookMetadataCache->getTocCount();
 }
 
+int Epub::readTocTitles(
+    const int first, const int count,
+    const std::function<bool(int index, const char* title, uint8_t level, int16_t spineIndex)>& visitor) const {
+  if (!bookMetadataCache || !bookMetadataCache->isLoaded()) {
+    Serial.printf("[%lu] [EBP] readTocTitles called but cache not loaded\n", millis());
+    return 0;
+  }
+
+  return bookMetadataCache->readTocTitles(first, count, visitor);
+}
+
 // work out the section index for a toc index
 int Epub::getSpineIndexForTocIndex(const int tocIndex) const {
   if (!bookMetadataCache || !bookMetadataCache->isLoaded()) {
@@ -590,7 +682,19 @@ int Epub::getSpineIndexForTocIndex(const int tocIndex) const {
   return spineIndex;
 }
 
-int Epub::getTocIndexForSpineIndex(const int spineIndex) const { return getSpineItem(spineIndex).tocIndex; }
+int Epub::getTocIndexForSpineIndex(const int spineIndex) const {
+  if (!bookMetadataCache || !bookMetadataCache->isLoaded() || bookMetadataCache->getSpineCount() == 0) {
+    Serial.printf("[%lu] [EBP] getTocIndexForSpineIndex called but cache not loaded\n", millis());
+    return -1;
+  }
+
+  if (spineIndex < 0 || spineIndex >= bookMetadataCache->getSpineCount()) {
+    Serial.printf("[%lu] [EBP] getTocIndexForSpineIndex index:%d is out of range\n", millis(), spineIndex);
+    return bookMetadataCache->getSpineTocIndex(0);
+  }
+
+  return bookMetadataCache->getSpineTocIndex(spineIndex);
+}
 
 size_t Epub::getBookSize() const {
   if (!bookMetadataCache || !bookMetadataCache->isLoaded() || bookMetadataCache->getSpineCount() == 0) {
@@ -629,7 +733,17 @@ int Epub::getSpineIndexForTextReference() const {
 }
 
 // Calculate progress in book (returns 0.0-1.0)
-float Epub::calculateProgress(const int currentSpineIndex, const float currentSpineRead) const {
+float Epub::calculateProgress(const int currentSpineIndex, const float currentSpineRead,
+                              const uint64_t layoutKey) const {
+  auto& pages = getBookPageMap();
+  // Page counts of another font, viewport or spacing would put the position somewhere else
+  if (layoutKey != 0 && pages.isAvailable() && pages.getLayoutKey() == layoutKey &&
+      pages.getSpineCount() == getSpineItemsCount() && pages.getBookPageCount() > 0) {
+    const float bookPage = static_cast<float>(pages.getFirstPage(currentSpineIndex)) +
+                           currentSpineRead * static_cast<float>(pages.getSpinePageCount(currentSpineIndex));
+    return bookPage / static_cast<float>(pages.getBookPageCount());
+  }
+
   const size_t bookSize = getBookSize();
   if (bookSize == 0) {
     return 0.0f;
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <Print.h>
+#include <ZipFile.h>
 
 #include <memory>
 #include <string>
@@ -8,8 +9,8 @@
 #include <vector>
 
 #include "Epub/BookMetadataCache.h"
-
-class ZipFile;
+#include "Epub/BookPageMap.h"
+#include "Epub/SectionPack.h"
 
 class Epub {
   // the ncx file (EPUB 2)
@@ -20,10 +21,14 @@ class Epub {
   std::string filepath;
   // the base path for items in the EPUB file
   std::string contentBasePath;
-  // Uniq cache key based on filepath
+  // Uniq cache key based on the book's content fingerprint (falls back to the filepath if it can't be read)
   std::string cachePath;
   // Spine and TOC cache
   std::unique_ptr<BookMetadataCache> bookMetadataCache;
+  // Laid out sections, opened on first use
+  mutable std::unique_ptr<SectionPack> sectionPack;
+  // Exact book page numbers, loaded on first use
+  mutable std::unique_ptr<BookPageMap> pageMap;
 
   bool findContentOpfFile(std::string* contentOpfFile) const;
   bool parseContentOpf(BookMetadataCache::BookMetadata& bookMetadata);
@@ -31,16 +36,17 @@ class Epub {
   bool parseTocNavFile() const;
 
  public:
-  explicit Epub(std::string filepath, const std::string& cacheDir) : filepath(std::move(filepath)) {
-    // create a cache key based on the filepath
-    cachePath = cacheDir + "/epub_" + std::to_string(std::hash<std::string>{}(this->filepath));
-  }
+  explicit Epub(std::string filepath, const std::string& cacheDir);
   ~Epub() = default;
   std::string& getBasePath() { return contentBasePath; }
   bool load(bool buildIfMissing = true);
   bool clearCache() const;
   void setupCacheDir() const;
   const std::string& getCachePath() const;
+  std::string getZipIndexPath() const;
+  std::string getSectionPackPath() const;
+  SectionPack& getSectionPack() const;
+  BookPageMap& getBookPageMap() const;
   const std::string& getPath() const;
   const std::string& getTitle() const;
   const std::string& getAuthor() const;
@@ -52,16 +58,25 @@ class Epub {
   uint8_t* readItemContentsToBytes(const std::string& itemHref, size_t* size = nullptr,
                                    bool trailingNullByte = false) const;
   bool readItemContentsToStream(const std::string& itemHref, Print& out, size_t chunkSize) const;
+  bool openItemContents(const std::string& itemHref, ZipFile::EntryReader& reader, size_t chunkSize = 1024) const;
   bool getItemSize(const std::string& itemHref, size_t* size) const;
   BookMetadataCache::SpineEntry getSpineItem(int spineIndex) const;
   BookMetadataCache::TocEntry getTocItem(int tocIndex) const;
   int getSpineItemsCount() const;
   int getTocItemsCount() const;
+  // Allocation free sequential walk over TOC titles, see BookMetadataCache::readTocTitles
+  int readTocTitles(int first, int count,
+                    const std::function<bool(int index, const char* title, uint8_t level, int16_t spineIndex)>& visitor)
+      const;
   int getSpineIndexForTocIndex(int tocIndex) const;
   int getTocIndexForSpineIndex(int spineIndex) const;
   size_t getCumulativeSpineItemSize(int spineIndex) const;
+  // Spine item containing a byte offset into the whole book (as measured by getBookSize)
+  int getSpineIndexForBookOffset(size_t offset) const;
   int getSpineIndexForTextReference() const;
 
   size_t getBookSize() const;
-  float calculateProgress(int currentSpineIndex, float currentSpineRead) const;
+  // Uses exact page numbers when the book page map was counted in layoutKey (the layout being read in), byte sizes of
+  // the spine items otherwise. Callers that don't know the current layout leave it 0 and get the byte estimate.
+  float calculateProgress(int currentSpineIndex, float currentSpineRead, uint64_t layoutKey = 0) const;
 };
@@ -0,0 +1,170 @@
+#include "BookFingerprintStore.h"
+
+#include <BufferedFsReader.h>
+#include <BufferedFsWriter.h>
+#include <FileHandleCache.h>
+#include <HardwareSerial.h>
+#include <MD5Builder.h>
+#include <SDCardManager.h>
+#include <Serialization.h>
+
+#include <algorithm>
+
+// Initialize the static instance
+BookFingerprintStore BookFingerprintStore::instance;
+
+namespace {
+constexpr uint8_t FINGERPRINTS_FILE_VERSION = 2;
+constexpr char FINGERPRINTS_FILE[] = "/.crosspoint/fingerprints.bin";
+
+// KOReader partial MD5: CHUNK_SIZE bytes at 0 and at CHUNK_SIZE << (2 * i) for i = 0..10
+constexpr size_t CHUNK_SIZE = 1024;
+constexpr int CHUNK_COUNT = 12;
+
+size_t getChunkOffset(const int i) { return i == 0 ? 0 : CHUNK_SIZE << (2 * (i - 1)); }
+}  // namespace
+
+bool BookFingerprintStore::calculate(const std::string& path, BookFingerprint* fingerprint) {
+  FsFile file;
+  if (!FILE_CACHE.openFileForRead("BFP", path, file)) {
+    Serial.printf("[%lu] [BFP] Failed to open file: %s\n", millis(), path.c_str());
+    return false;
+  }
+
+  const unsigned long start = millis();
+  const size_t fileSize = file.fileSize();
+
+  MD5Builder md5;
+  md5.begin();
+
+  uint8_t buffer[CHUNK_SIZE];
+  for (int i = 0; i < CHUNK_COUNT; i++) {
+    const size_t offset = getChunkOffset(i);
+    if (offset >= fileSize) {
+      break;
+    }
+    if (!file.seekSet(offset)) {
+      Serial.printf("[%lu] [BFP] Failed to seek to offset %zu\n", millis(), offset);
+      continue;
+    }
+    const int bytesRead = file.read(buffer, std::min(CHUNK_SIZE, fileSize - offset));
+    if (bytesRead > 0) {
+      md5.add(buffer, bytesRead);
+    }
+  }
+  file.close();
+
+  md5.calculate();
+  fingerprint->fileSize = static_cast<uint32_t>(fileSize);
+  fingerprint->partialMd5 = md5.toString().c_str();
+
+  Serial.printf("[%lu] [BFP] Fingerprinted %s: %s in %lu ms\n", millis(), path.c_str(),
+                fingerprint->cacheKey().c_str(), millis() - start);
+  return true;
+}
+
+bool BookFingerprintStore::get(const std::string& path, BookFingerprint* fingerprint) {
+  loadFromFile();
+
+  const auto it =
+      std::find_if(entries.begin(), entries.end(), [&path](const Entry& entry) { return entry.path == path; });
+
+  // Cheap sanity check that this is still the same file, the handle is reused by whoever opens the book next. A book
+  // copied over with the same size still gets a new modify date/time.
+  FsFile file;
+  uint16_t modifyDate = 0;
+  uint16_t modifyTime = 0;
+  if (FILE_CACHE.openFileForRead("BFP", path, file)) {
+    file.getModifyDateTime(&modifyDate, &modifyTime);
+  }
+  if (it != entries.end()) {
+    if (file && file.fileSize() == it->fingerprint.fileSize && modifyDate == it->modifyDate &&
+        modifyTime == it->modifyTime) {
+      *fingerprint = it->fingerprint;
+      return true;
+    }
+    entries.erase(it);
+  }
+  file.close();
+
+  if (!calculate(path, fingerprint)) {
+    return false;
+  }
+
+  if (entries.size() >= MAX_ENTRIES) {
+    entries.erase(entries.begin());
+  }
+  entries.push_back({path, *fingerprint, modifyDate, modifyTime});
+  saveToFile();
+  return true;
+}
+
+void BookFingerprintStore::forget(const std::string& path) {
+  loadFromFile();
+
+  const auto it =
+      std::find_if(entries.begin(), entries.end(), [&path](const Entry& entry) { return entry.path == path; });
+  if (it != entries.end()) {
+    entries.erase(it);
+    saveToFile();
+  }
+}
+
+void BookFingerprintStore::loadFromFile() {
+  if (loaded) {
+    return;
+  }
+  loaded = true;
+
+  FsFile file;
+  if (!SdMan.openFileForRead("BFP", FINGERPRINTS_FILE, file)) {
+    return;
+  }
+
+  BufferedFsReader reader(file);
+  uint8_t version;
+  serialization::readPod(reader, version);
+  if (version != FINGERPRINTS_FILE_VERSION) {
+    Serial.printf("[%lu] [BFP] Unknown file version: %u\n", millis(), version);
+    file.close();
+    return;
+  }
+
+  uint16_t count;
+  serialization::readPod(reader, count);
+  entries.resize(std::min(static_cast<size_t>(count), MAX_ENTRIES));
+  for (auto& entry : entries) {
+    serialization::readString(reader, entry.path);
+    serialization::readPod(reader, entry.fingerprint.fileSize);
+    serialization::readString(reader, entry.fingerprint.partialMd5);
+    serialization::readPod(reader, entry.modifyDate);
+    serialization::readPod(reader, entry.modifyTime);
+  }
+  file.close();
+
+  Serial.printf("[%lu] [BFP] Loaded %u book fingerprints\n", millis(), static_cast<unsigned>(entries.size()));
+}
+
+bool BookFingerprintStore::saveToFile() const {
+  // Make sure the directory exists
+  SdMan.mkdir("/.crosspoint");
+
+  FsFile file;
+  if (!SdMan.openFileForWrite("BFP", FINGERPRINTS_FILE, file)) {
+    return false;
+  }
+
+  BufferedFsWriter writer(file);
+  serialization::writePod(writer, FINGERPRINTS_FILE_VERSION);
+  serialization::writePod(writer, static_cast<uint16_t>(entries.size()));
+  for (const auto& entry : entries) {
+    serialization::writeString(writer, entry.path);
+    serialization::writePod(writer, entry.fingerprint.fileSize);
+    serialization::writeString(writer, entry.fingerprint.partialMd5);
+    serialization::writePod(writer, entry.modifyDate);
+    serialization::writePod(writer, entry.modifyTime);
+  }
+  const bool flushed = writer.flush();
+  file.close();
+  return flushed;
+}
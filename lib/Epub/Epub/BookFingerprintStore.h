@@ -0,0 +1,62 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * Content fingerprint of a book file: its size plus KOReader's partial MD5 (1KB samples at offsets 0, 1K, 4K, 16K,
+ * ... up to 1GB). It identifies the same book wherever it is on the card, so it keys the book's cache directory and
+ * doubles as the KOReader document ID.
+ */
+struct BookFingerprint {
+  uint32_t fileSize = 0;
+  std::string partialMd5;  // 32 lowercase hex characters
+
+  // Name used for the book's cache directory, e.g. "<md5>_<size>"
+  std::string cacheKey() const { return partialMd5 + "_" + std::to_string(fileSize); }
+};
+
+/**
+ * Singleton remembering the fingerprint of every book opened, persisted in /sd/.crosspoint/fingerprints.bin, so the
+ * sampled reads are done once per book and path. A remembered fingerprint is trusted as long as the file size and
+ * modify date/time still match; anything replacing a book in place (uploads) should still forget() the path, as the
+ * date/time may not be set or have changed.
+ */
+class BookFingerprintStore {
+  struct Entry {
+    std::string path;
+    BookFingerprint fingerprint;
+    // FAT modify date/time of the file when it was fingerprinted
+    uint16_t modifyDate = 0;
+    uint16_t modifyTime = 0;
+  };
+
+  static BookFingerprintStore instance;
+  std::vector<Entry> entries;  // oldest first
+  bool loaded = false;
+
+  BookFingerprintStore() = default;
+
+  void loadFromFile();
+  bool saveToFile() const;
+
+ public:
+  // Oldest paths are forgotten beyond this many
+  static constexpr size_t MAX_ENTRIES = 256;
+
+  BookFingerprintStore(const BookFingerprintStore&) = delete;
+  BookFingerprintStore& operator=(const BookFingerprintStore&) = delete;
+
+  static BookFingerprintStore& getInstance() { return instance; }
+
+  // Fingerprint of the file at path, computed and remembered on first use. Fails if the file can't be read.
+  bool get(const std::string& path, BookFingerprint* fingerprint);
+  // Drops what is remembered for path, e.g. after the file was deleted or overwritten
+  void forget(const std::string& path);
+
+  // Samples the file and hashes it, without consulting or updating the store
+  static bool calculate(const std::string& path, BookFingerprint* fingerprint);
+};
+
+// Helper macro to access the fingerprint store
+#define BOOK_FINGERPRINTS BookFingerprintStore::getInstance()
@@ -1,5 +1,6 @@
 #include "BookMetadataCache.h"
 
+#include <BufferedFsReader.h>
 #include <HardwareSerial.h>
 #include <Serialization.h>
 #include <ZipFile.h>
@@ -9,7 +10,6 @@
 #include "FsHelpers.h"
 
 namespace {
-constexpr uint8_t BOOK_CACHE_VERSION = 5;
 constexpr char bookBinFile[] = "/book.bin";
 constexpr char tmpSpineBinFile[] = "/spine.bin.tmp";
 constexpr char tmpTocBinFile[] = "/toc.bin.tmp";
@@ -29,12 +29,18 @@ bool BookMetadataCache::beginContentOpfPass() {
   Serial.printf("[%lu] [BMC] Beginning content opf pass\n", millis());
 
   // Open spine file for writing
-  return SdMan.openFileForWrite("BMC", cachePath + tmpSpineBinFile, spineFile);
+  if (!SdMan.openFileForWrite("BMC", cachePath + tmpSpineBinFile, spineFile)) {
+    return false;
+  }
+  spineWriter.reset(new BufferedFsWriter(spineFile));
+  return true;
 }
 
 bool BookMetadataCache::endContentOpfPass() {
+  const bool flushed = !spineWriter || spineWriter->flush();
+  spineWriter.reset();
   spineFile.close();
-  return true;
+  return flushed;
 }
 
 bool BookMetadataCache::beginTocPass() {
@@ -47,6 +53,7 @@ bool BookMetadataCache::beginTocPass() {
     spineFile.close();
     return false;
   }
+  tocWriter.reset(new BufferedFsWriter(tocFile));
 
   if (spineCount >= LARGE_SPINE_THRESHOLD) {
     spineHrefIndex.clear();
@@ -75,6 +82,8 @@ bool BookMetadataCache::beginTocPass() {
 }
 
 bool BookMetadataCache::endTocPass() {
+  const bool flushed = !tocWriter || tocWriter->flush();
+  tocWriter.reset();
   tocFile.close();
   spineFile.close();
 
@@ -82,7 +91,7 @@ bool BookMetadataCache::endTocPass() {
   spineHrefIndex.shrink_to_fit();
   useSpineHrefIndex = false;
 
-  return true;
+  return flushed;
 }
 
 bool BookMetadataCache::endWrite() {
@@ -96,7 +105,8 @@ bool BookMetadataCache::endWrite() {
   return true;
 }
 
-bool BookMetadataCache::buildBookBin(const std::string& epubPath, const BookMetadata& metadata) {
+bool BookMetadataCache::buildBookBin(const std::string& epubPath, const std::string& zipIndexPath,
+                                     const BookMetadata& metadata) {
   // Open all three files, writing to meta, reading from spine and toc
   if (!SdMan.openFileForWrite("BMC", cachePath + bookBinFile, bookFile)) {
     return false;
@@ -113,32 +123,41 @@ bool BookMetadataCache::buildBookBin(const std::string& epubPath, const BookMeta
     return false;
   }
 
-  constexpr uint32_t headerASize =
-      sizeof(BOOK_CACHE_VERSION) + /* LUT Offset */ sizeof(uint32_t) + sizeof(spineCount) + sizeof(tocCount);
+  constexpr uint32_t headerASize = sizeof(BOOK_CACHE_VERSION) + /* LUT Offset */ sizeof(uint32_t) +
+                                   sizeof(spineCount) + sizeof(tocCount) + /* Spine table offset */ sizeof(uint32_t);
   const uint32_t metadataSize = metadata.title.size() + metadata.author.size() + metadata.language.size() +
                                 metadata.coverItemHref.size() + metadata.textReferenceHref.size() +
                                 sizeof(uint32_t) * 5;
   const uint32_t lutSize = sizeof(uint32_t) * spineCount + sizeof(uint32_t) * tocCount;
   const uint32_t lutOffset = headerASize + metadataSize;
+  // The compact spine table (cumulative size u32 + toc index i16 per item) goes last, after the toc entries
+  const uint32_t spineTableOffset = lutOffset + lutSize + static_cast<uint32_t>(spineFile.size() + tocFile.size());
+  const uint32_t spineTableSize = (sizeof(uint32_t) + sizeof(int16_t)) * spineCount;
+
+  // book.bin is written field by field, collect it into whole-block SD writes. Its size is known exactly (the spine
+  // and toc entries are copied over unchanged in size), so reserve it contiguously.
+  BufferedFsWriter bookWriter(bookFile);
+  bookWriter.preAllocate(spineTableOffset + spineTableSize);
 
   // Header A
-  serialization::writePod(bookFile, BOOK_CACHE_VERSION);
-  serialization::writePod(bookFile, lutOffset);
-  serialization::writePod(bookFile, spineCount);
-  serialization::writePod(bookFile, tocCount);
+  serialization::writePod(bookWriter, BOOK_CACHE_VERSION);
+  serialization::writePod(bookWriter, lutOffset);
+  serialization::writePod(bookWriter, spineCount);
+  serialization::writePod(bookWriter, tocCount);
+  serialization::writePod(bookWriter, spineTableOffset);
   // Metadata
-  serialization::writeString(bookFile, metadata.title);
-  serialization::writeString(bookFile, metadata.author);
-  serialization::writeString(bookFile, metadata.language);
-  serialization::writeString(bookFile, metadata.coverItemHref);
-  serialization::writeString(bookFile, metadata.textReferenceHref);
+  serialization::writeString(bookWriter, metadata.title);
+  serialization::writeString(bookWriter, metadata.author);
+  serialization::writeString(bookWriter, metadata.language);
+  serialization::writeString(bookWriter, metadata.coverItemHref);
+  serialization::writeString(bookWriter, metadata.textReferenceHref);
 
   // Loop through spine entries, writing LUT positions
   spineFile.seek(0);
   for (int i = 0; i < spineCount; i++) {
     uint32_t pos = spineFile.position();
     auto spineEntry = readSpineEntry(spineFile);
-    serialization::writePod(bookFile, pos + lutOffset + lutSize);
+    serialization::writePod(bookWriter, pos + lutOffset + lutSize);
   }
 
   // Loop through toc entries, writing LUT positions
@@ -146,7 +165,7 @@ bool BookMetadataCache::buildBookBin(const std::string& epubPath, const BookMeta
   for (int i = 0; i < tocCount; i++) {
     uint32_t pos = tocFile.position();
     auto tocEntry = readTocEntry(tocFile);
-    serialization::writePod(bookFile, pos + lutOffset + lutSize + static_cast<uint32_t>(spineFile.position()));
+    serialization::writePod(bookWriter, pos + lutOffset + lutSize + static_cast<uint32_t>(spineFile.position()));
   }
 
   // LUTs complete
@@ -164,7 +183,7 @@ bool BookMetadataCache::buildBookBin(const std::string& epubPath, const BookMeta
     }
   }
 
-  ZipFile zip(epubPath);
+  ZipFile zip(epubPath, zipIndexPath);
   // Pre-open zip file to speed up size calculations
   if (!zip.open()) {
     Serial.printf("[%lu] [BMC] Could not open EPUB zip for size calculations\n", millis());
@@ -173,11 +192,10 @@ bool BookMetadataCache::buildBookBin(const std::string& epubPath, const BookMeta
     tocFile.close();
     return false;
   }
-  // NOTE: We intentionally skip calling loadAllFileStatSlims() here.
-  // For large EPUBs (2000+ chapters), pre-loading all ZIP central directory entries
-  // into memory causes OOM crashes on ESP32-C3's limited ~380KB RAM.
-  // Instead, for large books we use a one-pass batch lookup that scans the ZIP
-  // central directory once and matches against spine targets using hash comparison.
+  // NOTE: We intentionally never load all ZIP central directory entries into memory here.
+  // For large EPUBs (2000+ chapters), that causes OOM crashes on ESP32-C3's limited ~380KB RAM.
+  // Instead, for large books we use a one-pass batch lookup that walks the sorted on-SD zip index (or scans the
+  // ZIP central directory once if there is no index) and matches against spine targets using hash comparison.
   // This is O(n*log(m)) instead of O(n*m) while avoiding memory exhaustion.
   // See: https://github.com/crosspoint-reader/crosspoint-reader/issues/134
 
@@ -216,6 +234,8 @@ bool BookMetadataCache::buildBookBin(const std::string& epubPath, const BookMeta
     useBatchSizes = true;
   }
 
+  spineCumulativeSizes.assign(spineCount, 0);
+  spineTocIndexes.assign(spineCount, -1);
   uint32_t cumSize = 0;
   spineFile.seek(0);
   int lastSpineTocIndex = -1;
@@ -252,9 +272,11 @@ bool BookMetadataCache::buildBookBin(const std::string& epubPath, const BookMeta
 
     cumSize += itemSize;
     spineEntry.cumulativeSize = cumSize;
+    spineCumulativeSizes[i] = cumSize;
+    spineTocIndexes[i] = spineEntry.tocIndex;
 
     // Write out spine data to book.bin
-    writeSpineEntry(bookFile, spineEntry);
+    writeSpineEntry(bookWriter, spineEntry);
   }
   // Close opened zip file
   zip.close();
@@ -263,13 +285,29 @@ bool BookMetadataCache::buildBookBin(const std::string& epubPath, const BookMeta
   tocFile.seek(0);
   for (int i = 0; i < tocCount; i++) {
     auto tocEntry = readTocEntry(tocFile);
-    writeTocEntry(bookFile, tocEntry);
+    writeTocEntry(bookWriter, tocEntry);
+  }
+
+  // Compact spine table
+  for (int i = 0; i < spineCount; i++) {
+    serialization::writePod(bookWriter, spineCumulativeSizes[i]);
+    serialization::writePod(bookWriter, spineTocIndexes[i]);
   }
+  spineCumulativeSizes.clear();
+  spineCumulativeSizes.shrink_to_fit();
+  spineTocIndexes.clear();
+  spineTocIndexes.shrink_to_fit();
 
+  const bool flushed = bookWriter.finish();
   bookFile.close();
   spineFile.close();
   tocFile.close();
 
+  if (!flushed) {
+    Serial.printf("[%lu] [BMC] Failed to write book.bin\n", millis());
+    return false;
+  }
+
   Serial.printf("[%lu] [BMC] Successfully built book.bin\n", millis());
   return true;
 }
@@ -284,40 +322,40 @@ bool BookMetadataCache::cleanupTmpFiles() const {
   return true;
 }
 
-uint32_t BookMetadataCache::writeSpineEntry(FsFile& file, const SpineEntry& entry) const {
-  const uint32_t pos = file.position();
-  serialization::writeString(file, entry.href);
-  serialization::writePod(file, entry.cumulativeSize);
-  serialization::writePod(file, entry.tocIndex);
+uint32_t BookMetadataCache::writeSpineEntry(BufferedFsWriter& writer, const SpineEntry& entry) const {
+  const uint32_t pos = writer.position();
+  serialization::writeString(writer, entry.href);
+  serialization::writePod(writer, entry.cumulativeSize);
+  serialization::writePod(writer, entry.tocIndex);
   return pos;
 }
 
-uint32_t BookMetadataCache::writeTocEntry(FsFile& file, const TocEntry& entry) const {
-  const uint32_t pos = file.position();
-  serialization::writeString(file, entry.title);
-  serialization::writeString(file, entry.href);
-  serialization::writeString(file, entry.anchor);
-  serialization::writePod(file, entry.level);
-  serialization::writePod(file, entry.spineIndex);
+uint32_t BookMetadataCache::writeTocEntry(BufferedFsWriter& writer, const TocEntry& entry) const {
+  const uint32_t pos = writer.position();
+  serialization::writeString(writer, entry.title);
+  serialization::writeString(writer, entry.href);
+  serialization::writeString(writer, entry.anchor);
+  serialization::writePod(writer, entry.level);
+  serialization::writePod(writer, entry.spineIndex);
   return pos;
 }
 
 // Note: for the LUT to be accurate, this **MUST** be called for all spine items before `addTocEntry` is ever called
 // this is because in this function we're marking positions of the items
 void BookMetadataCache::createSpineEntry(const std::string& href) {
-  if (!buildMode || !spineFile) {
+  if (!buildMode || !spineFile || !spineWriter) {
     Serial.printf("[%lu] [BMC] createSpineEntry called but not in build mode\n", millis());
     return;
   }
 
   const SpineEntry entry(href, 0, -1);
-  writeSpineEntry(spineFile, entry);
+  writeSpineEntry(*spineWriter, entry);
   spineCount++;
 }
 
 void BookMetadataCache::createTocEntry(const std::string& title, const std::string& href, const std::string& anchor,
                                        const uint8_t level) {
-  if (!buildMode || !tocFile || !spineFile) {
+  if (!buildMode || !tocFile || !tocWriter || !spineFile) {
     Serial.printf("[%lu] [BMC] createTocEntry called but not in build mode\n", millis());
     return;
   }
@@ -357,7 +395,7 @@ void BookMetadataCache::createTocEntry(const std::string& title, const std::stri
   }
 
   const TocEntry entry(title, href, anchor, level, spineIndex);
-  writeTocEntry(tocFile, entry);
+  writeTocEntry(*tocWriter, entry);
   tocCount++;
 }
 
@@ -379,6 +417,8 @@ bool BookMetadataCache::load() {
   serialization::readPod(bookFile, lutOffset);
   serialization::readPod(bookFile, spineCount);
   serialization::readPod(bookFile, tocCount);
+  uint32_t spineTableOffset;
+  serialization::readPod(bookFile, spineTableOffset);
 
   serialization::readString(bookFile, coreMetadata.title);
   serialization::readString(bookFile, coreMetadata.author);
@@ -386,6 +426,22 @@ bool BookMetadataCache::load() {
   serialization::readString(bookFile, coreMetadata.coverItemHref);
   serialization::readString(bookFile, coreMetadata.textReferenceHref);
 
+  {
+    BufferedFsReader reader(bookFile);
+    if (spineTableOffset + (sizeof(uint32_t) + sizeof(int16_t)) * spineCount > reader.size()) {
+      Serial.printf("[%lu] [BMC] Spine table out of bounds\n", millis());
+      bookFile.close();
+      return false;
+    }
+    spineCumulativeSizes.resize(spineCount);
+    spineTocIndexes.resize(spineCount);
+    reader.seek(spineTableOffset);
+    for (int i = 0; i < spineCount; i++) {
+      serialization::readPod(reader, spineCumulativeSizes[i]);
+      serialization::readPod(reader, spineTocIndexes[i]);
+    }
+  }
+
   loaded = true;
   Serial.printf("[%lu] [BMC] Loaded cache data: %d spine, %d TOC entries\n", millis(), spineCount, tocCount);
   return true;
@@ -410,6 +466,17 @@ BookMetadataCache::SpineEntry BookMetadataCache::getSpineEntry(const int index)
   return readSpineEntry(bookFile);
 }
 
+int BookMetadataCache::findSpineIndexForOffset(const uint32_t offset) const {
+  if (spineCumulativeSizes.empty()) {
+    return 0;
+  }
+  const auto it = std::lower_bound(spineCumulativeSizes.begin(), spineCumulativeSizes.end(), offset);
+  if (it == spineCumulativeSizes.end()) {
+    return static_cast<int>(spineCumulativeSizes.size()) - 1;
+  }
+  return static_cast<int>(it - spineCumulativeSizes.begin());
+}
+
 BookMetadataCache::TocEntry BookMetadataCache::getTocEntry(const int index) {
   if (!loaded) {
     Serial.printf("[%lu] [BMC] getTocEntry called but cache not loaded\n", millis());
@@ -429,6 +496,50 @@ BookMetadataCache::TocEntry BookMetadataCache::getTocEntry(const int index) {
   return readTocEntry(bookFile);
 }
 
+int BookMetadataCache::readTocTitles(
+    const int first, const int count,
+    const std::function<bool(int index, const char* title, uint8_t level, int16_t spineIndex)>& visitor) {
+  if (!loaded || first < 0 || first >= static_cast<int>(tocCount) || count <= 0) {
+    return 0;
+  }
+  const int last = std::min(first + count, static_cast<int>(tocCount));
+
+  // TOC entries are stored back to back, so only the first one needs a LUT lookup
+  BufferedFsReader reader(bookFile);
+  reader.seek(lutOffset + sizeof(uint32_t) * spineCount + sizeof(uint32_t) * first);
+  uint32_t tocEntryPos;
+  serialization::readPod(reader, tocEntryPos);
+  reader.seek(tocEntryPos);
+
+  char title[MAX_TOC_TITLE_BYTES + 1];
+  int visited = 0;
+  for (int i = first; i < last; i++) {
+    uint32_t len;
+    serialization::readPod(reader, len);
+    const uint32_t kept = std::min(len, static_cast<uint32_t>(MAX_TOC_TITLE_BYTES));
+    if (reader.read(title, kept) != static_cast<int>(kept)) {
+      break;
+    }
+    title[kept] = '\0';
+    reader.seekCur(static_cast<int32_t>(len - kept));
+    // Skip href and anchor
+    for (int s = 0; s < 2; s++) {
+      serialization::readPod(reader, len);
+      reader.seekCur(static_cast<int32_t>(len));
+    }
+    uint8_t level;
+    int16_t spineIndex;
+    serialization::readPod(reader, level);
+    serialization::readPod(reader, spineIndex);
+
+    if (!visitor(i, title, level, spineIndex)) {
+      break;
+    }
+    visited++;
+  }
+  return visited;
+}
+
 BookMetadataCache::SpineEntry BookMetadataCache::readSpineEntry(FsFile& file) const {
   SpineEntry entry;
   serialization::readString(file, entry.href);
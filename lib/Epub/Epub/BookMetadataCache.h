@@ -1,13 +1,19 @@
 #pragma once
 
+#include <BufferedFsWriter.h>
 #include <SDCardManager.h>
 
 #include <algorithm>
+#include <functional>
+#include <memory>
 #include <string>
 #include <vector>
 
 class BookMetadataCache {
  public:
+  // Bump when book.bin changes (metadata, spine or TOC), older files are rebuilt from the OPF
+  static constexpr uint8_t BOOK_CACHE_VERSION = 6;
+
   struct BookMetadata {
     std::string title;
     std::string author;
@@ -50,10 +56,18 @@ class BookMetadataCache {
   bool loaded;
   bool buildMode;
 
+  // Resident copy of each spine item's cumulative size and TOC index (6 bytes per item), so progress mapping and the
+  // status bar never go to the SD card. Hrefs are still read lazily through getSpineEntry.
+  std::vector<uint32_t> spineCumulativeSizes;
+  std::vector<int16_t> spineTocIndexes;
+
   FsFile bookFile;
   // Temp file handles during build
   FsFile spineFile;
   FsFile tocFile;
+  // Write buffers over the temp files while they are being written
+  std::unique_ptr<BufferedFsWriter> spineWriter;
+  std::unique_ptr<BufferedFsWriter> tocWriter;
 
   // Index for fast href→spineIndex lookup (used only for large EPUBs)
   struct SpineHrefIndexEntry {
@@ -76,8 +90,8 @@ class BookMetadataCache {
     return hash;
   }
 
-  uint32_t writeSpineEntry(FsFile& file, const SpineEntry& entry) const;
-  uint32_t writeTocEntry(FsFile& file, const TocEntry& entry) const;
+  uint32_t writeSpineEntry(BufferedFsWriter& writer, const SpineEntry& entry) const;
+  uint32_t writeTocEntry(BufferedFsWriter& writer, const TocEntry& entry) const;
   SpineEntry readSpineEntry(FsFile& file) const;
   TocEntry readTocEntry(FsFile& file) const;
 
@@ -100,13 +114,26 @@ class BookMetadataCache {
   bool cleanupTmpFiles() const;
 
   // Post-processing to update mappings and sizes
-  bool buildBookBin(const std::string& epubPath, const BookMetadata& metadata);
+  bool buildBookBin(const std::string& epubPath, const std::string& zipIndexPath, const BookMetadata& metadata);
 
   // Reading phase (read mode)
   bool load();
   SpineEntry getSpineEntry(int index);
   TocEntry getTocEntry(int index);
+  // Resident spine table lookups, index must be in range
+  uint32_t getSpineCumulativeSize(const int index) const { return spineCumulativeSizes[index]; }
+  int16_t getSpineTocIndex(const int index) const { return spineTocIndexes[index]; }
+  // First spine item whose cumulative size reaches offset (binary search), the last one if offset is past the end
+  int findSpineIndexForOffset(uint32_t offset) const;
   int getSpineCount() const { return spineCount; }
   int getTocCount() const { return tocCount; }
   bool isLoaded() const { return loaded; }
+
+  // Longest title prefix handed to readTocTitles visitors, the rest of a longer title is skipped
+  static constexpr size_t MAX_TOC_TITLE_BYTES = 255;
+  // Visits TOC entries [first, first + count) with one sequential (block buffered) read, without allocating. title is
+  // only valid during the call. The visitor returns false to stop early. Returns the number of entries visited.
+  int readTocTitles(
+      int first, int count,
+      const std::function<bool(int index, const char* title, uint8_t level, int16_t spineIndex)>& visitor);
 };
@@ -0,0 +1,111 @@
+#include "BookPageMap.h"
+
+#include <FileHandleCache.h>
+#include <HardwareSerial.h>
+#include <SDCardManager.h>
+#include <Serialization.h>
+
+#include <algorithm>
+
+namespace {
+constexpr uint8_t PAGE_MAP_VERSION = 1;
+}  // namespace
+
+bool BookPageMap::isAvailable() {
+  if (loaded) {
+    return !cumulativePages.empty();
+  }
+  loaded = true;
+  cumulativePages.clear();
+
+  FsFile file;
+  if (!SdMan.exists(path.c_str()) || !FILE_CACHE.openFileForRead("BPM", path, file)) {
+    return false;
+  }
+
+  uint8_t version;
+  uint16_t count;
+  serialization::readPod(file, version);
+  serialization::readPod(file, layoutKey);
+  serialization::readPod(file, count);
+  if (version != PAGE_MAP_VERSION || file.available() < static_cast<int>(count * sizeof(uint16_t))) {
+    Serial.printf("[%lu] [BPM] Ignoring unreadable page map (version %u)\n", millis(), version);
+    file.close();
+    return false;
+  }
+
+  cumulativePages.reserve(count);
+  uint32_t total = 0;
+  for (uint16_t i = 0; i < count; i++) {
+    uint16_t pages;
+    serialization::readPod(file, pages);
+    total += pages;
+    cumulativePages.push_back(total);
+  }
+  file.close();
+  return !cumulativePages.empty();
+}
+
+bool BookPageMap::save(const uint64_t key, const std::vector<uint16_t>& spinePageCounts) {
+  FsFile file;
+  if (!FILE_CACHE.openFileForWrite("BPM", path, file)) {
+    return false;
+  }
+
+  serialization::writePod(file, PAGE_MAP_VERSION);
+  serialization::writePod(file, key);
+  serialization::writePod(file, static_cast<uint16_t>(spinePageCounts.size()));
+  // Small enough (two bytes per spine item) to go out in one write
+  const size_t dataSize = spinePageCounts.size() * sizeof(uint16_t);
+  const bool ok = file.write(spinePageCounts.data(), dataSize) == dataSize;
+  file.close();
+  if (!ok) {
+    FILE_CACHE.remove(path.c_str());
+    return false;
+  }
+
+  layoutKey = key;
+  cumulativePages.clear();
+  cumulativePages.reserve(spinePageCounts.size());
+  uint32_t total = 0;
+  for (const uint16_t pages : spinePageCounts) {
+    total += pages;
+    cumulativePages.push_back(total);
+  }
+  loaded = true;
+  Serial.printf("[%lu] [BPM] Published %lu book pages over %u spine items\n", millis(),
+                static_cast<unsigned long>(total), static_cast<unsigned>(spinePageCounts.size()));
+  return true;
+}
+
+uint32_t BookPageMap::getFirstPage(const int spineIndex) const {
+  if (spineIndex <= 0 || cumulativePages.empty()) {
+    return 0;
+  }
+  if (spineIndex > getSpineCount()) {
+    return getBookPageCount();
+  }
+  return cumulativePages[spineIndex - 1];
+}
+
+uint32_t BookPageMap::getSpinePageCount(const int spineIndex) const {
+  if (spineIndex < 0 || spineIndex >= getSpineCount()) {
+    return 0;
+  }
+  return cumulativePages[spineIndex] - getFirstPage(spineIndex);
+}
+
+int BookPageMap::findSpineForPage(const uint32_t page) const {
+  if (cumulativePages.empty()) {
+    return 0;
+  }
+  // Items ending at or before page lie wholly in front of it
+  const auto it = std::upper_bound(cumulativePages.begin(), cumulativePages.end(), page);
+  return std::min(static_cast<int>(it - cumulativePages.begin()), getSpineCount() - 1);
+}
+
+void BookPageMap::reset() {
+  cumulativePages.clear();
+  layoutKey = 0;
+  loaded = false;
+}
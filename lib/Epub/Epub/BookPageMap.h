@@ -0,0 +1,37 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * Exact page numbers across the whole book: the page count of every spine item under one layout, published by the
+ * reader's background indexer once each item has been laid out. Running totals are kept in memory so book page
+ * lookups are O(1).
+ *
+ * layoutKey identifies the layout (font, spacing, viewport, ...) the counts were taken under. Page numbers are only
+ * exact for that layout, proportions (e.g. a progress percentage) are still far closer than byte-size estimates.
+ */
+class BookPageMap {
+  std::string path;
+  uint64_t layoutKey = 0;
+  // Pages up to and including each spine item
+  std::vector<uint32_t> cumulativePages;
+  bool loaded = false;
+
+ public:
+  explicit BookPageMap(std::string path) : path(std::move(path)) {}
+
+  // Loads the stored map on first use, false if there is none
+  bool isAvailable();
+  bool save(uint64_t layoutKey, const std::vector<uint16_t>& spinePageCounts);
+  uint64_t getLayoutKey() const { return layoutKey; }
+  int getSpineCount() const { return static_cast<int>(cumulativePages.size()); }
+  uint32_t getBookPageCount() const { return cumulativePages.empty() ? 0 : cumulativePages.back(); }
+  // Book page (0 based) the spine item starts at
+  uint32_t getFirstPage(int spineIndex) const;
+  uint32_t getSpinePageCount(int spineIndex) const;
+  // Spine item showing a book page (the last one starting at or before it, so empty items are skipped), O(log n)
+  int findSpineForPage(uint32_t page) const;
+  // Forgets the in-memory map, e.g. after the cache directory was removed
+  void reset();
+};
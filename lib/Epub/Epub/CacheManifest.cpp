@@ -0,0 +1,215 @@
+#include "CacheManifest.h"
+
+#include <FileHandleCache.h>
+#include <HardwareSerial.h>
+#include <JpegToBmpConverter.h>
+#include <SDCardManager.h>
+#include <Serialization.h>
+
+#include <vector>
+
+#include "BookMetadataCache.h"
+#include "Epub.h"
+#include "Page.h"
+#include "Section.h"
+#include "parsers/ChapterHtmlSlimParser.h"
+
+namespace {
+constexpr uint8_t MANIFEST_VERSION = 1;
+constexpr uint8_t STAGE_COUNT = static_cast<uint8_t>(CacheStage::COUNT);
+
+constexpr uint8_t stageBit(const CacheStage stage) { return 1 << static_cast<uint8_t>(stage); }
+
+// Stages built from the output of another one go with it: pages and token streams refer to converted images by path,
+// and sections and token streams are keyed by spine index
+constexpr uint8_t DEPENDENT_STAGES[STAGE_COUNT] = {
+    0,                                                              // ZIP_INDEX
+    stageBit(CacheStage::TOKENS) | stageBit(CacheStage::SECTIONS),  // BOOK
+    stageBit(CacheStage::TOKENS) | stageBit(CacheStage::SECTIONS),  // IMAGES
+    0,                                                              // TOKENS
+    0,                                                              // SECTIONS
+};
+
+struct MigrationEntry {
+  CacheStage stage;
+  uint8_t fromVersion;
+  CacheManifest::Migration migrate;
+};
+
+std::vector<MigrationEntry>& migrations() {
+  static std::vector<MigrationEntry> registry;
+  return registry;
+}
+
+CacheManifest::Migration findMigration(const CacheStage stage, const uint8_t fromVersion) {
+  for (const auto& entry : migrations()) {
+    if (entry.stage == stage && entry.fromVersion == fromVersion) {
+      return entry.migrate;
+    }
+  }
+  return nullptr;
+}
+}  // namespace
+
+void CacheManifest::registerMigration(const CacheStage stage, const uint8_t fromVersion, const Migration migration) {
+  migrations().push_back({stage, fromVersion, migration});
+}
+
+uint8_t CacheManifest::currentVersion(const CacheStage stage) {
+  switch (stage) {
+    case CacheStage::ZIP_INDEX:
+      return ZipFile::INDEX_VERSION;
+    case CacheStage::BOOK:
+      return BookMetadataCache::BOOK_CACHE_VERSION;
+    case CacheStage::IMAGES:
+      return JpegToBmpConverter::OUTPUT_VERSION;
+    case CacheStage::TOKENS:
+      return ChapterHtmlSlimParser::TOKEN_FILE_VERSION;
+    case CacheStage::SECTIONS:
+      return Section::SECTION_FILE_VERSION;
+    default:
+      return 0;
+  }
+}
+
+const char* CacheManifest::stageName(const CacheStage stage) {
+  switch (stage) {
+    case CacheStage::ZIP_INDEX:
+      return "zip index";
+    case CacheStage::BOOK:
+      return "book";
+    case CacheStage::IMAGES:
+      return "images";
+    case CacheStage::TOKENS:
+      return "tokens";
+    case CacheStage::SECTIONS:
+      return "sections";
+    default:
+      return "?";
+  }
+}
+
+CacheManifest::CacheManifest(const Epub& epub) : epub(epub), path(epub.getCachePath() + "/manifest.bin") {}
+
+void CacheManifest::reconcile() {
+  uint8_t current[STAGE_COUNT];
+  for (uint8_t i = 0; i < STAGE_COUNT; i++) {
+    current[i] = currentVersion(static_cast<CacheStage>(i));
+  }
+
+  FsFile file;
+  if (!SdMan.exists(path.c_str()) || !SdMan.openFileForRead("CMF", path, file)) {
+    write(current);
+    return;
+  }
+
+  // Stages added to the manifest later than the cache was written are taken as current, like a missing manifest
+  uint8_t recorded[STAGE_COUNT];
+  memcpy(recorded, current, sizeof(recorded));
+  // readPod leaves these alone on a short read, an empty or truncated manifest must not compare against garbage
+  uint8_t manifestVersion = 0;
+  uint8_t count = 0;
+  serialization::readPod(file, manifestVersion);
+  serialization::readPod(file, count);
+  if (manifestVersion == MANIFEST_VERSION) {
+    for (uint8_t i = 0; i < count; i++) {
+      // Entries cut off by a truncated write are skipped
+      uint8_t stage = STAGE_COUNT;
+      uint8_t version = 0;
+      serialization::readPod(file, stage);
+      serialization::readPod(file, version);
+      if (stage < STAGE_COUNT) {
+        recorded[stage] = version;
+      }
+    }
+  }
+  file.close();
+
+  // Written back whenever it doesn't say current already: migrated stages must not be migrated again on the next load
+  if (manifestVersion == MANIFEST_VERSION && count >= STAGE_COUNT && memcmp(recorded, current, sizeof(recorded)) == 0) {
+    return;
+  }
+
+  uint8_t stale = 0;
+  for (uint8_t i = 0; i < STAGE_COUNT; i++) {
+    const auto stage = static_cast<CacheStage>(i);
+    while (recorded[i] != current[i]) {
+      // Only ever upgrade, a cache written by newer firmware is dropped rather than guessed at
+      const Migration migrate = recorded[i] < current[i] ? findMigration(stage, recorded[i]) : nullptr;
+      if (!migrate || !migrate(epub)) {
+        stale |= stageBit(stage) | DEPENDENT_STAGES[i];
+        break;
+      }
+      Serial.printf("[%lu] [CMF] Migrated %s from version %u to %u\n", millis(), stageName(stage), recorded[i],
+                    recorded[i] + 1);
+      recorded[i]++;
+    }
+  }
+
+  for (uint8_t i = 0; i < STAGE_COUNT; i++) {
+    if (stale & stageBit(static_cast<CacheStage>(i))) {
+      Serial.printf("[%lu] [CMF] Dropping %s cache (version %u, now %u)\n", millis(),
+                    stageName(static_cast<CacheStage>(i)), recorded[i], current[i]);
+      removeStage(static_cast<CacheStage>(i));
+    }
+  }
+  write(current);
+}
+
+void CacheManifest::removeStage(const CacheStage stage) const {
+  const auto& cachePath = epub.getCachePath();
+  auto removeFile = [](const std::string& filePath) {
+    if (SdMan.exists(filePath.c_str())) {
+      FILE_CACHE.remove(filePath.c_str());
+    }
+  };
+  auto removeDir = [](const std::string& dirPath) {
+    if (SdMan.exists(dirPath.c_str())) {
+      FILE_CACHE.removeDir(dirPath.c_str());
+    }
+  };
+
+  switch (stage) {
+    case CacheStage::ZIP_INDEX:
+      removeFile(epub.getZipIndexPath());
+      break;
+    case CacheStage::BOOK:
+      removeFile(cachePath + "/book.bin");
+      break;
+    case CacheStage::IMAGES:
+      removeDir(cachePath + "/images");
+      removeFile(epub.getCoverBmpPath(false));
+      removeFile(epub.getCoverBmpPath(true));
+      removeFile(epub.getThumbBmpPath());
+      break;
+    case CacheStage::TOKENS:
+      removeDir(cachePath + "/tokens");
+      break;
+    case CacheStage::SECTIONS:
+      // Page counts and interrupted builds are part of the layout. The pack file goes first: opening a pack that is
+      // still there may compact it, which is wasted work on a file about to be deleted
+      removeFile(epub.getSectionPackPath());
+      epub.getSectionPack().reset();
+      removeFile(cachePath + "/pages.bin");
+      epub.getBookPageMap().reset();
+      removeDir(cachePath + "/build");
+      break;
+    default:
+      break;
+  }
+}
+
+bool CacheManifest::write(const uint8_t* versions) const {
+  FsFile file;
+  if (!SdMan.openFileForWrite("CMF", path, file)) {
+    return false;
+  }
+  serialization::writePod(file, MANIFEST_VERSION);
+  serialization::writePod(file, STAGE_COUNT);
+  for (uint8_t i = 0; i < STAGE_COUNT; i++) {
+    serialization::writePod(file, i);
+    serialization::writePod(file, versions[i]);
+  }
+  file.close();
+  return true;
+}
@@ -0,0 +1,40 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+class Epub;
+
+// Independently versioned parts of a book's cache. The TOC is stored in book.bin and so belongs to BOOK.
+enum class CacheStage : uint8_t { ZIP_INDEX, BOOK, IMAGES, TOKENS, SECTIONS, COUNT };
+
+/**
+ * Records the format version of each cache stage in <cache>/manifest.bin, so a firmware update that changes one
+ * format only drops that stage (and the stages built from it) instead of every cached file of every book.
+ *
+ * When a recorded version is behind, the registered migrations are run one version step at a time. A stage without a
+ * migration for its version is removed and gets rebuilt on demand, like a cache that never existed.
+ */
+class CacheManifest {
+ public:
+  // Upgrades the stage's files under epub's cache directory from one version to the next in place. Returning false
+  // leaves the stage to be removed.
+  using Migration = bool (*)(const Epub& epub);
+
+  // Migrations run on every book whose stage is at fromVersion. Register them before books are loaded (i.e. in setup).
+  static void registerMigration(CacheStage stage, uint8_t fromVersion, Migration migration);
+  static uint8_t currentVersion(CacheStage stage);
+
+  explicit CacheManifest(const Epub& epub);
+
+  // Brings the book's cache in line with the current stage versions. Caches written before the manifest existed are
+  // taken as current, their files still carry the per-file version checks.
+  void reconcile();
+
+ private:
+  const Epub& epub;
+  std::string path;
+
+  static const char* stageName(CacheStage stage);
+  void removeStage(CacheStage stage) const;
+  bool write(const uint8_t* versions) const;
+};
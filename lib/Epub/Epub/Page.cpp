@@ -1,116 +1,180 @@
 #include "Page.h"
 
 #include <Bitmap.h>
+#include <FileHandleCache.h>
 #include <GfxRenderer.h>
 #include <HardwareSerial.h>
 #include <SDCardManager.h>
 #include <Serialization.h>
 
-void PageLine::render(GfxRenderer& renderer, const int fontId, const int xOffset, const int yOffset) {
-  block->render(renderer, fontId, xPos + xOffset, yPos + yOffset);
-}
+#include <cstring>
+#include <new>
 
-bool PageLine::serialize(FsFile& file) {
-  serialization::writePod(file, xPos);
-  serialization::writePod(file, yPos);
+namespace {
+// Far beyond any real page (a full screen of text is a few KB), guards the allocation against a corrupt length
+constexpr uint32_t MAX_PAGE_RECORD_SIZE = 64 * 1024;
 
-  // serialize TextBlock pointed to by PageLine
-  return block->serialize(file);
+template <typename T>
+T* carve(uint8_t*& cursor, const size_t count) {
+  auto* items = reinterpret_cast<T*>(cursor);
+  cursor += sizeof(T) * count;
+  return items;
 }
+}  // namespace
 
-std::unique_ptr<PageLine> PageLine::deserialize(FsFile& file) {
-  int16_t xPos;
-  int16_t yPos;
-  serialization::readPod(file, xPos);
-  serialization::readPod(file, yPos);
-
-  auto tb = TextBlock::deserialize(file);
-  return std::unique_ptr<PageLine>(new PageLine(std::move(tb), xPos, yPos));
+bool Page::serialize(BufferedFsWriter& file, const std::vector<uint8_t>& record) {
+  const auto size = static_cast<uint32_t>(record.size());
+  serialization::writePod(file, size);
+  return file.write(record.data(), size) == size;
 }
 
-void PageImage::render(GfxRenderer& renderer, const int fontId, const int xOffset, const int yOffset) {
-  (void)fontId;
-  FsFile file;
-  if (!SdMan.openFileForRead("PGE", bmpPath, file)) {
-    return;
+bool Page::readRecord(BufferedFsReader& file, std::vector<uint8_t>& record) {
+  uint32_t size;
+  serialization::readPod(file, size);
+  if (size > MAX_PAGE_RECORD_SIZE) {
+    Serial.printf("[%lu] [PGE] Deserialization failed: page record of %u bytes\n", millis(), size);
+    return false;
   }
-
-  Bitmap bitmap(file);
-  if (bitmap.parseHeaders() != BmpReaderError::Ok) {
-    file.close();
-    return;
+  record.resize(size);
+  if (file.read(record.data(), size) != static_cast<int>(size)) {
+    Serial.printf("[%lu] [PGE] Deserialization failed: short read of page record\n", millis());
+    return false;
   }
-
-  const int drawWidth = width > 0 ? width : bitmap.getWidth();
-  const int drawHeight = height > 0 ? height : bitmap.getHeight();
-  renderer.drawBitmap(bitmap, xPos + xOffset, yPos + yOffset, drawWidth, drawHeight);
-  file.close();
-}
-
-bool PageImage::serialize(FsFile& file) {
-  serialization::writePod(file, xPos);
-  serialization::writePod(file, yPos);
-  serialization::writePod(file, width);
-  serialization::writePod(file, height);
-  serialization::writeString(file, bmpPath);
   return true;
 }
 
-std::unique_ptr<PageImage> PageImage::deserialize(FsFile& file) {
-  int16_t xPos;
-  int16_t yPos;
-  uint16_t width;
-  uint16_t height;
-  std::string bmpPath;
-  serialization::readPod(file, xPos);
-  serialization::readPod(file, yPos);
-  serialization::readPod(file, width);
-  serialization::readPod(file, height);
-  serialization::readString(file, bmpPath);
-  return std::unique_ptr<PageImage>(new PageImage(std::move(bmpPath), width, height, xPos, yPos));
+std::unique_ptr<Page> Page::deserialize(BufferedFsReader& file) {
+  uint32_t size;
+  serialization::readPod(file, size);
+  // Decoded straight from the read buffer when the record fits it (any normal page), so the page is the only
+  // allocation. Otherwise it goes through a copy.
+  if (const uint8_t* data = size <= MAX_PAGE_RECORD_SIZE ? file.view(size) : nullptr) {
+    return decode(data, size);
+  }
+  file.seekCur(-static_cast<int32_t>(sizeof(size)));
+  std::vector<uint8_t> record;
+  if (!readRecord(file, record)) {
+    return nullptr;
+  }
+  return decode(record.data(), record.size());
 }
 
-void Page::render(GfxRenderer& renderer, const int fontId, const int xOffset, const int yOffset) const {
-  for (auto& element : elements) {
-    element->render(renderer, fontId, xOffset, yOffset);
+std::unique_ptr<Page> Page::decode(const uint8_t* record, const size_t size) {
+  // First pass sizes the arena and validates the record, the second fills it
+  size_t elementCount = 0;
+  size_t wordCount = 0;
+  size_t runCount = 0;
+  size_t textSize = 0;
+  PageCodec::Element element;
+  PageCodec::Word word;
+  {
+    PageCodec::Decoder decoder(record, size);
+    while (decoder.nextElement(element)) {
+      elementCount++;
+      if (element.tag == PageCodec::IMAGE) {
+        textSize += element.pathLength + 1;
+        continue;
+      }
+      uint8_t runStyle = 0;
+      for (uint16_t i = 0; i < element.wordCount && decoder.nextWord(word); i++) {
+        if (i == 0 || word.style != runStyle) {
+          runStyle = word.style;
+          runCount++;
+        }
+        textSize += word.length + 1;
+      }
+      wordCount += element.wordCount;
+    }
+    // Text offsets are 16 bit, a page record is far smaller than that anyway
+    if (!decoder.ok() || textSize > UINT16_MAX) {
+      Serial.printf("[%lu] [PGE] Deserialization failed: corrupt page record\n", millis());
+      return nullptr;
+    }
   }
-}
 
-bool Page::serialize(FsFile& file) const {
-  const uint16_t count = elements.size();
-  serialization::writePod(file, count);
+  const size_t arenaSize = sizeof(Element) * elementCount + sizeof(uint16_t) * wordCount * 2 +
+                           sizeof(StyleRun) * runCount + textSize;
+  std::unique_ptr<Page> page(new (ArenaSize{arenaSize}) Page());
+  page->arenaSize = arenaSize;
+  page->elementCount = static_cast<uint16_t>(elementCount);
+  // Largest alignment first, the page object itself is aligned for all of them
+  auto* cursor = reinterpret_cast<uint8_t*>(page.get() + 1);
+  page->elements = carve<Element>(cursor, elementCount);
+  page->runs = carve<StyleRun>(cursor, runCount);
+  page->wordOffsets = carve<uint16_t>(cursor, wordCount);
+  page->wordXpos = carve<uint16_t>(cursor, wordCount);
+  page->text = carve<char>(cursor, textSize);
+
+  PageCodec::Decoder decoder(record, size);
+  uint16_t elementIndex = 0;
+  uint16_t wordIndex = 0;
+  uint16_t runIndex = 0;
+  uint16_t textOffset = 0;
+  const auto appendText = [&page, &textOffset](const char* data, const size_t length) {
+    memcpy(page->text + textOffset, data, length);
+    page->text[textOffset + length] = '\0';
+    textOffset += length + 1;
+  };
+  while (decoder.nextElement(element)) {
+    Element& out = page->elements[elementIndex++];
+    out.tag = element.tag;
+    out.xPos = element.x;
+    out.yPos = element.y;
+    if (element.tag == PageCodec::IMAGE) {
+      out.image = {textOffset, element.width, element.height};
+      appendText(element.path, element.pathLength);
+      continue;
+    }
 
-  for (const auto& el : elements) {
-    serialization::writePod(file, static_cast<uint8_t>(el->getTag()));
-    if (!el->serialize(file)) {
-      return false;
+    out.line = {wordIndex, element.wordCount, runIndex, 0};
+    for (uint16_t i = 0; i < element.wordCount && decoder.nextWord(word); i++) {
+      if (i == 0 || word.style != page->runs[runIndex - 1].style) {
+        page->runs[runIndex++] = {0, static_cast<EpdFontFamily::Style>(word.style)};
+        out.line.runCount++;
+      }
+      page->runs[runIndex - 1].length++;
+      page->wordOffsets[wordIndex] = textOffset;
+      page->wordXpos[wordIndex] = word.x;
+      wordIndex++;
+      appendText(word.text, word.length);
     }
   }
-
-  return true;
+  return page;
 }
 
-std::unique_ptr<Page> Page::deserialize(FsFile& file) {
-  auto page = std::unique_ptr<Page>(new Page());
+void Page::render(GfxRenderer& renderer, const int fontId, const int xOffset, const int yOffset) const {
+  for (uint16_t e = 0; e < elementCount; e++) {
+    const Element& element = elements[e];
+    if (element.tag == PageCodec::IMAGE) {
+      renderImage(renderer, element, xOffset, yOffset);
+      continue;
+    }
 
-  uint16_t count;
-  serialization::readPod(file, count);
+    const int x = element.xPos + xOffset;
+    const int y = element.yPos + yOffset;
+    uint16_t word = element.line.firstWord;
+    for (uint16_t r = element.line.firstRun; r < element.line.firstRun + element.line.runCount; r++) {
+      for (uint16_t i = 0; i < runs[r].length; i++, word++) {
+        renderer.drawText(fontId, wordXpos[word] + x, y, text + wordOffsets[word], true, runs[r].style);
+      }
+    }
+  }
+}
 
-  for (uint16_t i = 0; i < count; i++) {
-    uint8_t tag;
-    serialization::readPod(file, tag);
+void Page::renderImage(GfxRenderer& renderer, const Element& element, const int xOffset, const int yOffset) const {
+  FsFile file;
+  if (!FILE_CACHE.openFileForRead("PGE", text + element.image.pathOffset, file)) {
+    return;
+  }
 
-    if (tag == TAG_PageLine) {
-      auto pl = PageLine::deserialize(file);
-      page->elements.push_back(std::move(pl));
-    } else if (tag == TAG_PageImage) {
-      auto img = PageImage::deserialize(file);
-      page->elements.push_back(std::move(img));
-    } else {
-      Serial.printf("[%lu] [PGE] Deserialization failed: Unknown tag %u\n", millis(), tag);
-      return nullptr;
-    }
+  Bitmap bitmap(file);
+  if (bitmap.parseHeaders() != BmpReaderError::Ok) {
+    file.close();
+    return;
   }
 
-  return page;
+  const int drawWidth = element.image.width > 0 ? element.image.width : bitmap.getWidth();
+  const int drawHeight = element.image.height > 0 ? element.image.height : bitmap.getHeight();
+  renderer.drawBitmap(bitmap, element.xPos + xOffset, element.yPos + yOffset, drawWidth, drawHeight);
+  file.close();
 }
@@ -1,61 +1,80 @@
 #pragma once
-#include <SdFat.h>
+#include <BufferedFsReader.h>
+#include <BufferedFsWriter.h>
+#include <EpdFontFamily.h>
 
-#include <string>
-#include <utility>
+#include <cstddef>
+#include <memory>
 #include <vector>
 
-#include "blocks/TextBlock.h"
+#include "PageCodec.h"
 
-enum PageElementTag : uint8_t {
-  TAG_PageLine = 1,
-  TAG_PageImage = 2,
-};
+class GfxRenderer;
 
-// represents something that has been added to a page
-class PageElement {
+/**
+ * A laid out page as loaded from the section file. Pages are built as PageCodec records (see PageCodec::Encoder) and
+ * only ever decoded into this flat form to be rendered.
+ *
+ * The page object and everything it holds share one allocation: the element array (lines and images, told apart by
+ * tag), the word offsets and x positions of all lines, their style runs and the NUL terminated word text. Loading a
+ * page is one malloc and dropping it one free, however many words it holds.
+ */
+class Page {
  public:
-  int16_t xPos;
-  int16_t yPos;
-  explicit PageElement(const int16_t xPos, const int16_t yPos) : xPos(xPos), yPos(yPos) {}
-  virtual ~PageElement() = default;
-  virtual PageElementTag getTag() const = 0;
-  virtual void render(GfxRenderer& renderer, int fontId, int xOffset, int yOffset) = 0;
-  virtual bool serialize(FsFile& file) = 0;
-};
+  // Writes a page record built by a PageCodec::Encoder, length prefixed
+  static bool serialize(BufferedFsWriter& file, const std::vector<uint8_t>& record);
+  // Reads a record written by serialize with one read, for decode or for adding to an encoder
+  static bool readRecord(BufferedFsReader& file, std::vector<uint8_t>& record);
+  static std::unique_ptr<Page> deserialize(BufferedFsReader& file);
+  static std::unique_ptr<Page> decode(const uint8_t* record, size_t size);
 
-// a line from a block element
-class PageLine final : public PageElement {
-  std::shared_ptr<TextBlock> block;
+  void render(GfxRenderer& renderer, int fontId, int xOffset, int yOffset) const;
+  // Bytes held by the page, header included
+  size_t getMemoryUsage() const { return sizeof(Page) + arenaSize; }
 
- public:
-  PageLine(std::shared_ptr<TextBlock> block, const int16_t xPos, const int16_t yPos)
-      : PageElement(xPos, yPos), block(std::move(block)) {}
-  PageElementTag getTag() const override { return TAG_PageLine; }
-  void render(GfxRenderer& renderer, int fontId, int xOffset, int yOffset) override;
-  bool serialize(FsFile& file) override;
-  static std::unique_ptr<PageLine> deserialize(FsFile& file);
-};
+  static void operator delete(void* ptr) { ::operator delete(ptr); }
 
-class PageImage final : public PageElement {
-  std::string bmpPath;
-  uint16_t width;
-  uint16_t height;
+ private:
+  struct LineData {
+    uint16_t firstWord;
+    uint16_t wordCount;
+    uint16_t firstRun;
+    uint16_t runCount;
+  };
+  struct ImageData {
+    uint16_t pathOffset;
+    uint16_t width;
+    uint16_t height;
+  };
+  struct Element {
+    PageCodec::ElementTag tag;
+    int16_t xPos;
+    int16_t yPos;
+    union {
+      LineData line;
+      ImageData image;
+    };
+  };
+  struct StyleRun {
+    uint16_t length;
+    EpdFontFamily::Style style;
+  };
 
- public:
-  PageImage(std::string bmpPath, const uint16_t width, const uint16_t height, const int16_t xPos, const int16_t yPos)
-      : PageElement(xPos, yPos), bmpPath(std::move(bmpPath)), width(width), height(height) {}
-  PageElementTag getTag() const override { return TAG_PageImage; }
-  void render(GfxRenderer& renderer, int fontId, int xOffset, int yOffset) override;
-  bool serialize(FsFile& file) override;
-  static std::unique_ptr<PageImage> deserialize(FsFile& file);
-};
+  // The arena follows the page object in the same allocation
+  struct ArenaSize {
+    size_t bytes;
+  };
+  static void* operator new(size_t size, ArenaSize arena) { return ::operator new(size + arena.bytes); }
+  static void operator delete(void* ptr, ArenaSize) { ::operator delete(ptr); }
 
-class Page {
- public:
-  // the list of block index and line numbers on this page
-  std::vector<std::shared_ptr<PageElement>> elements;
-  void render(GfxRenderer& renderer, int fontId, int xOffset, int yOffset) const;
-  bool serialize(FsFile& file) const;
-  static std::unique_ptr<Page> deserialize(FsFile& file);
+  size_t arenaSize = 0;
+  uint16_t elementCount = 0;
+  Element* elements = nullptr;
+  uint16_t* wordOffsets = nullptr;
+  uint16_t* wordXpos = nullptr;
+  StyleRun* runs = nullptr;
+  char* text = nullptr;
+
+  Page() = default;
+  void renderImage(GfxRenderer& renderer, const Element& element, int xOffset, int yOffset) const;
 };
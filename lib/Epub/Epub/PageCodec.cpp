@@ -0,0 +1,270 @@
+#include "PageCodec.h"
+
+namespace PageCodec {
+
+namespace {
+void writeVarint(std::vector<uint8_t>& out, uint32_t value) {
+  while (value >= 0x80) {
+    out.push_back(static_cast<uint8_t>(value) | 0x80);
+    value >>= 7;
+  }
+  out.push_back(static_cast<uint8_t>(value));
+}
+
+// Zigzag maps small negative numbers to small varints too (0, -1, 1, -2 -> 0, 1, 2, 3)
+void writeSigned(std::vector<uint8_t>& out, const int32_t value) {
+  writeVarint(out, (static_cast<uint32_t>(value) << 1) ^ static_cast<uint32_t>(value >> 31));
+}
+}  // namespace
+
+void Encoder::beginLine(const int16_t x, const int16_t y, const uint8_t blockStyle) {
+  lineX = x;
+  lineY = y;
+  lineBlockStyle = blockStyle;
+  lineWordBytes.clear();
+  lineRunBytes.clear();
+  lineWordCount = 0;
+  lineRunCount = 0;
+  lineRunLength = 0;
+  lastWordX = 0;
+}
+
+void Encoder::addWord(const char* wordText, const size_t length, const uint16_t x, const uint8_t style) {
+  if (lineRunLength > 0 && style != lineRunStyle) {
+    closeStyleRun();
+  }
+  lineRunStyle = style;
+  lineRunLength++;
+
+  text.append(wordText, length);
+  writeVarint(lineWordBytes, static_cast<uint32_t>(length));
+  // Words of a line run left to right, so the delta is the previous word's advance and fits one or two bytes. It wraps
+  // around 16 bits, an x to the left of the previous word still round trips, just in three bytes.
+  writeVarint(lineWordBytes, static_cast<uint16_t>(x - lastWordX));
+  lastWordX = x;
+  lineWordCount++;
+}
+
+void Encoder::closeStyleRun() {
+  lineRunBytes.push_back(lineRunStyle);
+  writeVarint(lineRunBytes, lineRunLength);
+  lineRunCount++;
+  lineRunLength = 0;
+}
+
+void Encoder::endLine() {
+  if (lineRunLength > 0) {
+    closeStyleRun();
+  }
+  elementBytes.push_back(LINE);
+  writeSigned(elementBytes, lineX);
+  writeSigned(elementBytes, lineY);
+  elementBytes.push_back(lineBlockStyle);
+  writeVarint(elementBytes, lineWordCount);
+  writeVarint(elementBytes, lineRunCount);
+  elementBytes.insert(elementBytes.end(), lineRunBytes.begin(), lineRunBytes.end());
+  elementBytes.insert(elementBytes.end(), lineWordBytes.begin(), lineWordBytes.end());
+  elementCount++;
+}
+
+void Encoder::addImage(const int16_t x, const int16_t y, const uint16_t width, const uint16_t height,
+                       const std::string& path) {
+  elementBytes.push_back(IMAGE);
+  writeSigned(elementBytes, x);
+  writeSigned(elementBytes, y);
+  writeVarint(elementBytes, width);
+  writeVarint(elementBytes, height);
+  writeVarint(elementBytes, static_cast<uint32_t>(path.size()));
+  elementBytes.insert(elementBytes.end(), path.begin(), path.end());
+  elementCount++;
+}
+
+const std::vector<uint8_t>& Encoder::finish() {
+  record.clear();
+  record.reserve(text.size() + elementBytes.size() + 8);
+  writeVarint(record, elementCount);
+  writeVarint(record, static_cast<uint32_t>(text.size()));
+  record.insert(record.end(), text.begin(), text.end());
+  record.insert(record.end(), elementBytes.begin(), elementBytes.end());
+  return record;
+}
+
+void Encoder::reset() {
+  text.clear();
+  elementBytes.clear();
+  elementCount = 0;
+}
+
+bool Encoder::append(const uint8_t* data, const size_t size) {
+  Decoder decoder(data, size);
+  Element element;
+  Word word;
+  while (decoder.nextElement(element)) {
+    if (element.tag == IMAGE) {
+      addImage(element.x, element.y, element.width, element.height, std::string(element.path, element.pathLength));
+      continue;
+    }
+    beginLine(element.x, element.y, element.blockStyle);
+    for (uint16_t i = 0; i < element.wordCount && decoder.nextWord(word); i++) {
+      addWord(word.text, word.length, word.x, word.style);
+    }
+    endLine();
+  }
+  return decoder.ok();
+}
+
+Decoder::Decoder(const uint8_t* data, const size_t size) : pos(data), end(data + size) {
+  uint32_t count;
+  uint32_t textSize;
+  if (!readVarint(pos, count) || !readVarint(pos, textSize) || count > UINT16_MAX ||
+      textSize > static_cast<size_t>(end - pos)) {
+    failed = true;
+    return;
+  }
+  elementCount = static_cast<uint16_t>(count);
+  text = reinterpret_cast<const char*>(pos);
+  textEnd = text + textSize;
+  pos += textSize;
+}
+
+bool Decoder::readVarint(const uint8_t*& cursor, uint32_t& value) {
+  // Nearly every field is a single byte
+  if (cursor < end && *cursor < 0x80) {
+    value = *cursor++;
+    return true;
+  }
+  value = 0;
+  for (int shift = 0; shift < 35; shift += 7) {
+    if (cursor >= end) {
+      failed = true;
+      return false;
+    }
+    const uint8_t byte = *cursor++;
+    value |= static_cast<uint32_t>(byte & 0x7F) << shift;
+    if (!(byte & 0x80)) {
+      return true;
+    }
+  }
+  failed = true;
+  return false;
+}
+
+bool Decoder::readSigned(const uint8_t*& cursor, int32_t& value) {
+  uint32_t raw;
+  if (!readVarint(cursor, raw)) {
+    return false;
+  }
+  value = static_cast<int32_t>(raw >> 1) ^ -static_cast<int32_t>(raw & 1);
+  return true;
+}
+
+bool Decoder::readByte(const uint8_t*& cursor, uint8_t& value) {
+  if (cursor >= end) {
+    failed = true;
+    return false;
+  }
+  value = *cursor++;
+  return true;
+}
+
+bool Decoder::nextElement(Element& element) {
+  // Words of the previous line left unread are skipped
+  Word skipped;
+  while (wordsLeft > 0) {
+    if (!nextWord(skipped)) {
+      return false;
+    }
+  }
+  if (failed || elementsRead >= elementCount) {
+    return false;
+  }
+
+  uint8_t tag;
+  int32_t x;
+  int32_t y;
+  if (!readByte(pos, tag) || !readSigned(pos, x) || !readSigned(pos, y)) {
+    return false;
+  }
+  element = {};
+  element.tag = static_cast<ElementTag>(tag);
+  element.x = static_cast<int16_t>(x);
+  element.y = static_cast<int16_t>(y);
+
+  if (tag == LINE) {
+    uint32_t wordCount;
+    uint32_t runCount;
+    if (!readByte(pos, element.blockStyle) || !readVarint(pos, wordCount) || !readVarint(pos, runCount) ||
+        wordCount > UINT16_MAX || runCount > wordCount) {
+      failed = true;
+      return false;
+    }
+    // Step over the style runs to the words, nextWord reads both side by side
+    runPos = pos;
+    for (uint32_t i = 0; i < runCount; i++) {
+      uint8_t style;
+      uint32_t length;
+      if (!readByte(pos, style) || !readVarint(pos, length)) {
+        return false;
+      }
+    }
+    element.wordCount = static_cast<uint16_t>(wordCount);
+    wordsLeft = element.wordCount;
+    runsLeft = static_cast<uint16_t>(runCount);
+    runLeft = 0;
+    lastWordX = 0;
+  } else if (tag == IMAGE) {
+    uint32_t width;
+    uint32_t height;
+    uint32_t pathLength;
+    if (!readVarint(pos, width) || !readVarint(pos, height) || !readVarint(pos, pathLength) ||
+        pathLength > static_cast<size_t>(end - pos)) {
+      failed = true;
+      return false;
+    }
+    element.width = static_cast<uint16_t>(width);
+    element.height = static_cast<uint16_t>(height);
+    element.path = reinterpret_cast<const char*>(pos);
+    element.pathLength = pathLength;
+    pos += pathLength;
+  } else {
+    failed = true;
+    return false;
+  }
+
+  elementsRead++;
+  return true;
+}
+
+bool Decoder::nextWord(Word& word) {
+  if (failed || wordsLeft == 0) {
+    return false;
+  }
+  if (runLeft == 0) {
+    uint32_t length;
+    if (runsLeft == 0 || !readByte(runPos, runStyle) || !readVarint(runPos, length) || length == 0 ||
+        length > UINT16_MAX) {
+      failed = true;
+      return false;
+    }
+    runLeft = static_cast<uint16_t>(length);
+    runsLeft--;
+  }
+
+  uint32_t length;
+  uint32_t xDelta;
+  if (!readVarint(pos, length) || !readVarint(pos, xDelta) || length > static_cast<size_t>(textEnd - text)) {
+    failed = true;
+    return false;
+  }
+  word.text = text;
+  word.length = length;
+  word.x = static_cast<uint16_t>(lastWordX + xDelta);
+  word.style = runStyle;
+  text += length;
+  lastWordX = word.x;
+  runLeft--;
+  wordsLeft--;
+  return true;
+}
+
+}  // namespace PageCodec
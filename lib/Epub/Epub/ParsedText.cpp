@@ -1,11 +1,11 @@
 #include "ParsedText.h"
 
 #include <GfxRenderer.h>
+#include <HardwareSerial.h>
 
 #include <algorithm>
 #include <cmath>
 #include <functional>
-#include <iterator>
 #include <limits>
 #include <vector>
 
@@ -21,6 +21,15 @@ constexpr size_t SOFT_HYPHEN_BYTES = 2;
 
 bool containsSoftHyphen(const std::string& word) { return word.find(SOFT_HYPHEN_UTF8) != std::string::npos; }
 
+bool containsSoftHyphen(const char* word, const size_t length) {
+  for (size_t i = 0; i + 1 < length; i++) {
+    if (word[i] == SOFT_HYPHEN_UTF8[0] && word[i + 1] == SOFT_HYPHEN_UTF8[1]) {
+      return true;
+    }
+  }
+  return false;
+}
+
 // Removes every soft hyphen in-place so rendered glyphs match measured widths.
 void stripSoftHyphensInPlace(std::string& word) {
   size_t pos = 0;
@@ -52,15 +61,54 @@ uint16_t measureWordWidth(const GfxRenderer& renderer, const int fontId, const s
 void ParsedText::addWord(std::string word, const EpdFontFamily::Style fontStyle) {
   if (word.empty()) return;
 
-  words.push_back(std::move(word));
-  wordStyles.push_back(fontStyle);
+  // Offsets are 16 bit, keep room for the word's NUL and the paragraph indent
+  const size_t room = UINT16_MAX - std::min(text.size() + 4, static_cast<size_t>(UINT16_MAX));
+  if (word.size() > room) {
+    Serial.printf("[%lu] [PTX] Word of %u bytes truncated to fit the text block\n", millis(),
+                  static_cast<unsigned>(word.size()));
+    word.resize(room);
+    if (word.empty()) return;
+  }
+
+  wordOffsets.push_back(static_cast<uint16_t>(text.size()));
+  wordLengths.push_back(static_cast<uint16_t>(word.size()));
+  wordFlags.push_back(fontStyle & STYLE_MASK);
+  text.append(word);
+  text.push_back('\0');
+}
+
+uint16_t ParsedText::measureWord(const GfxRenderer& renderer, const int fontId, const size_t index) const {
+  const char* word = text.data() + wordOffsets[index];
+  const size_t length = wordLengths[index];
+  // The prefix of a split word isn't terminated where it ends, and needs its hyphen measured too
+  const bool inPlace = word[length] == '\0' && !(wordFlags[index] & APPEND_HYPHEN);
+  if (inPlace && !containsSoftHyphen(word, length)) {
+    return renderer.getTextWidth(fontId, word, wordStyle(index));
+  }
+  return measureWordWidth(renderer, fontId, std::string(word, length), wordStyle(index),
+                          (wordFlags[index] & APPEND_HYPHEN) != 0);
+}
+
+// Extracted lines are always the first words, drop them together once the layout pass is done
+void ParsedText::dropWords(const size_t count) {
+  if (count == 0) {
+    return;
+  }
+  const uint16_t textStart = count < wordOffsets.size() ? wordOffsets[count] : static_cast<uint16_t>(text.size());
+  text.erase(0, textStart);
+  wordOffsets.erase(wordOffsets.begin(), wordOffsets.begin() + count);
+  wordLengths.erase(wordLengths.begin(), wordLengths.begin() + count);
+  wordFlags.erase(wordFlags.begin(), wordFlags.begin() + count);
+  for (auto& offset : wordOffsets) {
+    offset -= textStart;
+  }
 }
 
 // Consumes data to minimize memory usage
 void ParsedText::layoutAndExtractLines(const GfxRenderer& renderer, const int fontId, const uint16_t viewportWidth,
                                        const std::function<void(std::shared_ptr<TextBlock>)>& processLine,
                                        const bool includeLastLine) {
-  if (words.empty()) {
+  if (wordOffsets.empty()) {
     return;
   }
 
@@ -82,22 +130,16 @@ void ParsedText::layoutAndExtractLines(const GfxRenderer& renderer, const int fo
   for (size_t i = 0; i < lineCount; ++i) {
     extractLine(i, pageWidth, spaceWidth, wordWidths, lineBreakIndices, processLine);
   }
+  dropWords(lineCount > 0 ? lineBreakIndices[lineCount - 1] : 0);
 }
 
 std::vector<uint16_t> ParsedText::calculateWordWidths(const GfxRenderer& renderer, const int fontId) {
-  const size_t totalWordCount = words.size();
+  const size_t totalWordCount = wordOffsets.size();
 
   std::vector<uint16_t> wordWidths;
   wordWidths.reserve(totalWordCount);
-
-  auto wordsIt = words.begin();
-  auto wordStylesIt = wordStyles.begin();
-
-  while (wordsIt != words.end()) {
-    wordWidths.push_back(measureWordWidth(renderer, fontId, *wordsIt, *wordStylesIt));
-
-    std::advance(wordsIt, 1);
-    std::advance(wordStylesIt, 1);
+  for (size_t i = 0; i < totalWordCount; i++) {
+    wordWidths.push_back(measureWord(renderer, fontId, i));
   }
 
   return wordWidths;
@@ -105,7 +147,7 @@ std::vector<uint16_t> ParsedText::calculateWordWidths(const GfxRenderer& rendere
 
 std::vector<size_t> ParsedText::computeLineBreaks(const GfxRenderer& renderer, const int fontId, const int pageWidth,
                                                   const int spaceWidth, std::vector<uint16_t>& wordWidths) {
-  if (words.empty()) {
+  if (wordOffsets.empty()) {
     return {};
   }
 
@@ -118,7 +160,7 @@ std::vector<size_t> ParsedText::computeLineBreaks(const GfxRenderer& renderer, c
     }
   }
 
-  const size_t totalWordCount = words.size();
+  const size_t totalWordCount = wordOffsets.size();
 
   // DP table to store the minimum badness (cost) of lines starting at index i
   std::vector<int> dp(totalWordCount);
@@ -196,12 +238,19 @@ std::vector<size_t> ParsedText::computeLineBreaks(const GfxRenderer& renderer, c
 }
 
 void ParsedText::applyParagraphIndent() {
-  if (extraParagraphSpacing || words.empty()) {
+  if (extraParagraphSpacing || wordOffsets.empty()) {
     return;
   }
 
   if (style == TextBlock::JUSTIFIED || style == TextBlock::LEFT_ALIGN) {
-    words.front().insert(0, "\xe2\x80\x83");
+    // The first word starts the buffer, so only the offsets after it move
+    constexpr char EM_SPACE[] = "\xe2\x80\x83";
+    constexpr uint16_t EM_SPACE_BYTES = sizeof(EM_SPACE) - 1;
+    text.insert(0, EM_SPACE, EM_SPACE_BYTES);
+    wordLengths[0] += EM_SPACE_BYTES;
+    for (size_t i = 1; i < wordOffsets.size(); i++) {
+      wordOffsets[i] += EM_SPACE_BYTES;
+    }
   }
 }
 
@@ -261,18 +310,12 @@ bool ParsedText::hyphenateWordAtIndex(const size_t wordIndex, const int availabl
                                       const int fontId, std::vector<uint16_t>& wordWidths,
                                       const bool allowFallbackBreaks) {
   // Guard against invalid indices or zero available width before attempting to split.
-  if (availableWidth <= 0 || wordIndex >= words.size()) {
+  if (availableWidth <= 0 || wordIndex >= wordOffsets.size()) {
     return false;
   }
 
-  // Get iterators to target word and style.
-  auto wordIt = words.begin();
-  auto styleIt = wordStyles.begin();
-  std::advance(wordIt, wordIndex);
-  std::advance(styleIt, wordIndex);
-
-  const std::string& word = *wordIt;
-  const auto style = *styleIt;
+  const std::string word(text.data() + wordOffsets[wordIndex], wordLengths[wordIndex]);
+  const auto style = wordStyle(wordIndex);
 
   // Collect candidate breakpoints (byte offsets and hyphen requirements).
   auto breakInfos = Hyphenator::breakOffsets(word, allowFallbackBreaks);
@@ -307,22 +350,18 @@ bool ParsedText::hyphenateWordAtIndex(const size_t wordIndex, const int availabl
     return false;
   }
 
-  // Split the word at the selected breakpoint and append a hyphen if required.
-  std::string remainder = word.substr(chosenOffset);
-  wordIt->resize(chosenOffset);
-  if (chosenNeedsHyphen) {
-    wordIt->push_back('-');
-  }
-
-  // Insert the remainder word (with matching style) directly after the prefix.
-  auto insertWordIt = std::next(wordIt);
-  auto insertStyleIt = std::next(styleIt);
-  words.insert(insertWordIt, remainder);
-  wordStyles.insert(insertStyleIt, style);
+  // Split the word at the selected breakpoint: the remainder is a new entry pointing into the same text, the prefix
+  // gets its hyphen when it is rendered. A hyphen still owed by the whole word moves to the remainder.
+  const uint8_t flags = wordFlags[wordIndex];
+  wordLengths[wordIndex] = static_cast<uint16_t>(chosenOffset);
+  wordFlags[wordIndex] = (flags & ~APPEND_HYPHEN) | (chosenNeedsHyphen ? APPEND_HYPHEN : 0);
+  wordOffsets.insert(wordOffsets.begin() + wordIndex + 1, static_cast<uint16_t>(wordOffsets[wordIndex] + chosenOffset));
+  wordLengths.insert(wordLengths.begin() + wordIndex + 1, static_cast<uint16_t>(word.size() - chosenOffset));
+  wordFlags.insert(wordFlags.begin() + wordIndex + 1, (flags & (STYLE_MASK | APPEND_HYPHEN)) | CONTINUATION);
 
   // Update cached widths to reflect the new prefix/remainder pairing.
   wordWidths[wordIndex] = static_cast<uint16_t>(chosenWidth);
-  const uint16_t remainderWidth = measureWordWidth(renderer, fontId, remainder, style);
+  const uint16_t remainderWidth = measureWord(renderer, fontId, wordIndex + 1);
   wordWidths.insert(wordWidths.begin() + wordIndex + 1, remainderWidth);
   return true;
 }
@@ -359,30 +398,52 @@ void ParsedText::extractLine(const size_t breakIndex, const int pageWidth, const
   }
 
   // Pre-calculate X positions for words
-  std::list<uint16_t> lineXPos;
+  std::vector<uint16_t> lineXPos;
+  lineXPos.reserve(lineWordCount);
   for (size_t i = lastBreakAt; i < lineBreak; i++) {
     const uint16_t currentWordWidth = wordWidths[i];
     lineXPos.push_back(xpos);
     xpos += currentWordWidth + spacing;
   }
 
-  // Iterators always start at the beginning as we are moving content with splice below
-  auto wordEndIt = words.begin();
-  auto wordStyleEndIt = wordStyles.begin();
-  std::advance(wordEndIt, lineWordCount);
-  std::advance(wordStyleEndIt, lineWordCount);
-
-  // *** CRITICAL STEP: CONSUME DATA USING SPLICE ***
-  std::list<std::string> lineWords;
-  lineWords.splice(lineWords.begin(), words, words.begin(), wordEndIt);
-  std::list<EpdFontFamily::Style> lineWordStyles;
-  lineWordStyles.splice(lineWordStyles.begin(), wordStyles, wordStyles.begin(), wordStyleEndIt);
-
-  for (auto& word : lineWords) {
-    if (containsSoftHyphen(word)) {
-      stripSoftHyphensInPlace(word);
+  // Copy the words out as rendered: soft hyphens dropped, hyphens of split words added, each NUL terminated
+  size_t lineTextSize = 0;
+  for (size_t i = lastBreakAt; i < lineBreak; i++) {
+    lineTextSize += wordLengths[i] + 2;
+  }
+  std::string lineText;
+  lineText.reserve(lineTextSize);
+  std::vector<uint16_t> lineWordOffsets;
+  std::vector<EpdFontFamily::Style> lineWordStyles;
+  lineWordOffsets.reserve(lineWordCount);
+  lineWordStyles.reserve(lineWordCount);
+  for (size_t i = lastBreakAt; i < lineBreak; i++) {
+    const char* word = text.data() + wordOffsets[i];
+    const size_t length = wordLengths[i];
+    lineWordOffsets.push_back(static_cast<uint16_t>(lineText.size()));
+    lineWordStyles.push_back(wordStyle(i));
+    for (size_t b = 0; b < length; b++) {
+      if (b + 1 < length && word[b] == SOFT_HYPHEN_UTF8[0] && word[b + 1] == SOFT_HYPHEN_UTF8[1]) {
+        b++;
+        continue;
+      }
+      lineText.push_back(word[b]);
+    }
+    if (wordFlags[i] & APPEND_HYPHEN) {
+      lineText.push_back('-');
+    }
+    lineText.push_back('\0');
+  }
+
+  // A line starting with the remainder of a split word starts in the source word before it
+  lineStartWordIndex =
+      extractedSourceWords - ((wordFlags[lastBreakAt] & CONTINUATION) && extractedSourceWords > 0 ? 1 : 0);
+  for (size_t i = lastBreakAt; i < lineBreak; i++) {
+    if (!(wordFlags[i] & CONTINUATION)) {
+      extractedSourceWords++;
     }
   }
 
-  processLine(std::make_shared<TextBlock>(std::move(lineWords), std::move(lineXPos), std::move(lineWordStyles), style));
-}
\ No newline at end of file
+  processLine(std::make_shared<TextBlock>(std::move(lineText), std::move(lineWordOffsets), std::move(lineXPos),
+                                          std::move(lineWordStyles), style));
+}
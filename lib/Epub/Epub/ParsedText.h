@@ -3,7 +3,6 @@
 #include <EpdFontFamily.h>
 
 #include <functional>
-#include <list>
 #include <memory>
 #include <string>
 #include <vector>
@@ -12,13 +11,36 @@
 
 class GfxRenderer;
 
+/**
+ * The words of a paragraph waiting for layout, kept in flat arrays: the UTF-8 text of all words in one buffer (each
+ * NUL terminated so most can be measured in place) plus per-word offset, length and flag arrays. Line breaking works on
+ * indices into them and hyphenation splits a word by adding an entry that points into the same text. Extracted lines
+ * are dropped from the front in one go once a layout pass is done.
+ */
 class ParsedText {
-  std::list<std::string> words;
-  std::list<EpdFontFamily::Style> wordStyles;
+  // Low bits of a word's flags hold its EpdFontFamily::Style
+  static constexpr uint8_t STYLE_MASK = 0x03;
+  // Remainder of a word split by hyphenation, so word indices keep counting source words
+  static constexpr uint8_t CONTINUATION = 0x04;
+  // Prefix of a split word that is rendered with a hyphen after it
+  static constexpr uint8_t APPEND_HYPHEN = 0x08;
+
+  std::string text;
+  std::vector<uint16_t> wordOffsets;
+  std::vector<uint16_t> wordLengths;
+  std::vector<uint8_t> wordFlags;
+  // Source words handed out in lines so far, and the index of the source word the last extracted line starts in
+  uint16_t extractedSourceWords = 0;
+  uint16_t lineStartWordIndex = 0;
   TextBlock::Style style;
   bool extraParagraphSpacing;
   bool hyphenationEnabled;
 
+  EpdFontFamily::Style wordStyle(const size_t index) const {
+    return static_cast<EpdFontFamily::Style>(wordFlags[index] & STYLE_MASK);
+  }
+  uint16_t measureWord(const GfxRenderer& renderer, int fontId, size_t index) const;
+  void dropWords(size_t count);
   void applyParagraphIndent();
   std::vector<size_t> computeLineBreaks(const GfxRenderer& renderer, int fontId, int pageWidth, int spaceWidth,
                                         std::vector<uint16_t>& wordWidths);
@@ -32,6 +54,10 @@ class ParsedText {
   std::vector<uint16_t> calculateWordWidths(const GfxRenderer& renderer, int fontId);
 
  public:
+  // Word offsets are 16 bit, so text is capped at 64KB (addWord truncates past it). A block holding this much should be
+  // laid out, half the cap leaves room for the words that follow until it is.
+  static constexpr size_t LAYOUT_TEXT_SIZE = 32 * 1024;
+
   explicit ParsedText(const TextBlock::Style style, const bool extraParagraphSpacing,
                       const bool hyphenationEnabled = false)
       : style(style), extraParagraphSpacing(extraParagraphSpacing), hyphenationEnabled(hyphenationEnabled) {}
@@ -40,8 +66,12 @@ class ParsedText {
   void addWord(std::string word, EpdFontFamily::Style fontStyle);
   void setStyle(const TextBlock::Style style) { this->style = style; }
   TextBlock::Style getStyle() const { return style; }
-  size_t size() const { return words.size(); }
-  bool isEmpty() const { return words.empty(); }
+  size_t size() const { return wordOffsets.size(); }
+  bool isEmpty() const { return wordOffsets.empty(); }
+  // Bytes of text buffered, see LAYOUT_TEXT_SIZE
+  size_t getTextSize() const { return text.size(); }
+  // Index (within this block, counting words as added) of the word the line last passed to processLine starts in
+  uint16_t getLineStartWordIndex() const { return lineStartWordIndex; }
   void layoutAndExtractLines(const GfxRenderer& renderer, int fontId, uint16_t viewportWidth,
                              const std::function<void(std::shared_ptr<TextBlock>)>& processLine,
                              bool includeLastLine = true);
@@ -1,27 +1,81 @@
 #include "Section.h"
 
+#include <FileHandleCache.h>
 #include <SDCardManager.h>
 #include <Serialization.h>
+#include <ZipFile.h>
+
+#include <algorithm>
+#include <cstdlib>
 
 #include "Page.h"
+#include "SectionPack.h"
 #include "hyphenation/Hyphenator.h"
 #include "parsers/ChapterHtmlSlimParser.h"
 
 namespace {
-constexpr uint8_t SECTION_FILE_VERSION = 11;
 constexpr uint32_t HEADER_SIZE = sizeof(uint8_t) + sizeof(int) + sizeof(float) + sizeof(bool) + sizeof(uint8_t) +
                                  sizeof(uint16_t) + sizeof(uint16_t) + sizeof(uint16_t) + sizeof(bool) +
                                  sizeof(uint32_t);
+// Page start table entry: source offset (u32) + word index (u16)
+constexpr uint32_t PAGE_START_ENTRY_SIZE = sizeof(uint32_t) + sizeof(uint16_t);
+// Anchor table entry: id hash (u64) + page (u16)
+constexpr uint32_t ANCHOR_ENTRY_SIZE = sizeof(uint64_t) + sizeof(uint16_t);
+// The token stream is written alongside the section, a small buffer is enough for its mostly short records
+constexpr size_t TOKEN_WRITE_BUFFER_SIZE = 1024;
+constexpr uint8_t BUILD_CHECKPOINT_VERSION = 1;
+// Pages built between checkpoints while parsing, each one costs a flush of the section and a small state file
+constexpr uint16_t BUILD_CHECKPOINT_PAGES = 8;
 }  // namespace
 
-uint32_t Section::onPageComplete(std::unique_ptr<Page> page) {
+bool Section::headerMatches(FsFile& file, const int fontId, const float lineCompression,
+                            const bool extraParagraphSpacing, const uint8_t paragraphAlignment,
+                            const uint16_t viewportWidth, const uint16_t viewportHeight,
+                            const bool hyphenationEnabled, uint8_t* version) {
+  serialization::readPod(file, *version);
+  if (*version != SECTION_FILE_VERSION) {
+    return false;
+  }
+
+  int fileFontId;
+  uint16_t fileViewportWidth, fileViewportHeight;
+  float fileLineCompression;
+  bool fileExtraParagraphSpacing;
+  uint8_t fileParagraphAlignment;
+  bool fileHyphenationEnabled;
+  serialization::readPod(file, fileFontId);
+  serialization::readPod(file, fileLineCompression);
+  serialization::readPod(file, fileExtraParagraphSpacing);
+  serialization::readPod(file, fileParagraphAlignment);
+  serialization::readPod(file, fileViewportWidth);
+  serialization::readPod(file, fileViewportHeight);
+  serialization::readPod(file, fileHyphenationEnabled);
+
+  return fontId == fileFontId && lineCompression == fileLineCompression &&
+         extraParagraphSpacing == fileExtraParagraphSpacing && paragraphAlignment == fileParagraphAlignment &&
+         viewportWidth == fileViewportWidth && viewportHeight == fileViewportHeight &&
+         hyphenationEnabled == fileHyphenationEnabled;
+}
+
+std::string Section::getTokenFilePath() const {
+  return epub->getCachePath() + "/tokens/" + std::to_string(spineIndex) + ".bin";
+}
+
+uint32_t Section::readPageStartTableOffset(BufferedFsReader& reader) const {
+  reader.seek(sectionOffset + HEADER_SIZE - sizeof(uint32_t));
+  uint32_t lutOffset;
+  serialization::readPod(reader, lutOffset);
+  return sectionOffset + lutOffset + sizeof(uint32_t) * pageCount;
+}
+
+uint32_t Section::onPageComplete(BufferedFsWriter& writer, const std::vector<uint8_t>& page) {
   if (!file) {
     Serial.printf("[%lu] [SCT] File not open for writing page %d\n", millis(), pageCount);
     return 0;
   }
 
-  const uint32_t position = file.position();
-  if (!page->serialize(file)) {
+  const uint32_t position = writer.position() - sectionOffset;
+  if (!Page::serialize(writer, page)) {
     Serial.printf("[%lu] [SCT] Failed to serialize page %d\n", millis(), pageCount);
     return 0;
   }
@@ -31,9 +85,10 @@ uint32_t Section::onPageComplete(std::unique_ptr<Page> page) {
   return position;
 }
 
-void Section::writeSectionFileHeader(const int fontId, const float lineCompression, const bool extraParagraphSpacing,
-                                     const uint8_t paragraphAlignment, const uint16_t viewportWidth,
-                                     const uint16_t viewportHeight, const bool hyphenationEnabled) {
+void Section::writeSectionFileHeader(BufferedFsWriter& writer, const int fontId, const float lineCompression,
+                                     const bool extraParagraphSpacing, const uint8_t paragraphAlignment,
+                                     const uint16_t viewportWidth, const uint16_t viewportHeight,
+                                     const bool hyphenationEnabled) {
   if (!file) {
     Serial.printf("[%lu] [SCT] File not open for writing header\n", millis());
     return;
@@ -43,65 +98,43 @@ void Section::writeSectionFileHeader(const int fontId, const float lineCompressi
                                    sizeof(viewportHeight) + sizeof(pageCount) + sizeof(hyphenationEnabled) +
                                    sizeof(uint32_t),
                 "Header size mismatch");
-  serialization::writePod(file, SECTION_FILE_VERSION);
-  serialization::writePod(file, fontId);
-  serialization::writePod(file, lineCompression);
-  serialization::writePod(file, extraParagraphSpacing);
-  serialization::writePod(file, paragraphAlignment);
-  serialization::writePod(file, viewportWidth);
-  serialization::writePod(file, viewportHeight);
-  serialization::writePod(file, hyphenationEnabled);
-  serialization::writePod(file, pageCount);  // Placeholder for page count (will be initially 0 when written)
-  serialization::writePod(file, static_cast<uint32_t>(0));  // Placeholder for LUT offset
+  serialization::writePod(writer, SECTION_FILE_VERSION);
+  serialization::writePod(writer, fontId);
+  serialization::writePod(writer, lineCompression);
+  serialization::writePod(writer, extraParagraphSpacing);
+  serialization::writePod(writer, paragraphAlignment);
+  serialization::writePod(writer, viewportWidth);
+  serialization::writePod(writer, viewportHeight);
+  serialization::writePod(writer, hyphenationEnabled);
+  serialization::writePod(writer, pageCount);  // Placeholder for page count (will be initially 0 when written)
+  serialization::writePod(writer, static_cast<uint32_t>(0));  // Placeholder for LUT offset
 }
 
 bool Section::loadSectionFile(const int fontId, const float lineCompression, const bool extraParagraphSpacing,
                               const uint8_t paragraphAlignment, const uint16_t viewportWidth,
                               const uint16_t viewportHeight, const bool hyphenationEnabled) {
-  // Prefer a per-viewport cache filename so portrait/landscape can coexist.
-  activeFilePath = getViewportFilePath(viewportWidth, viewportHeight);
-  if (!SdMan.openFileForRead("SCT", activeFilePath, file)) {
-    // Backwards compatibility: try legacy filename.
-    activeFilePath = getLegacyFilePath();
-    if (!SdMan.openFileForRead("SCT", activeFilePath, file)) {
-      return false;
-    }
+  packViewportWidth = viewportWidth;
+  packViewportHeight = viewportHeight;
+  auto& pack = epub->getSectionPack();
+  uint32_t sectionLength;
+  if (!pack.find(spineIndex, viewportWidth, viewportHeight, &sectionOffset, &sectionLength) ||
+      !pack.openForRead(file)) {
+    return false;
   }
+  file.seek(sectionOffset);
 
   // Match parameters
-  {
-    uint8_t version;
-    serialization::readPod(file, version);
+  uint8_t version;
+  if (!headerMatches(file, fontId, lineCompression, extraParagraphSpacing, paragraphAlignment, viewportWidth,
+                     viewportHeight, hyphenationEnabled, &version)) {
+    file.close();
     if (version != SECTION_FILE_VERSION) {
-      file.close();
       Serial.printf("[%lu] [SCT] Deserialization failed: Unknown version %u\n", millis(), version);
-      clearCache();
-      return false;
-    }
-
-    int fileFontId;
-    uint16_t fileViewportWidth, fileViewportHeight;
-    float fileLineCompression;
-    bool fileExtraParagraphSpacing;
-    uint8_t fileParagraphAlignment;
-    bool fileHyphenationEnabled;
-    serialization::readPod(file, fileFontId);
-    serialization::readPod(file, fileLineCompression);
-    serialization::readPod(file, fileExtraParagraphSpacing);
-    serialization::readPod(file, fileParagraphAlignment);
-    serialization::readPod(file, fileViewportWidth);
-    serialization::readPod(file, fileViewportHeight);
-    serialization::readPod(file, fileHyphenationEnabled);
-
-    if (fontId != fileFontId || lineCompression != fileLineCompression ||
-        extraParagraphSpacing != fileExtraParagraphSpacing || paragraphAlignment != fileParagraphAlignment ||
-        viewportWidth != fileViewportWidth || viewportHeight != fileViewportHeight ||
-        hyphenationEnabled != fileHyphenationEnabled) {
-      file.close();
+    } else {
       Serial.printf("[%lu] [SCT] Deserialization failed: Parameters do not match\n", millis());
-      clearCache();
-      return false;
     }
+    clearCache();
+    return false;
   }
 
   serialization::readPod(file, pageCount);
@@ -110,15 +143,8 @@ bool Section::loadSectionFile(const int fontId, const float lineCompression, con
   return true;
 }
 
-// Your updated class method (assuming you are using the 'SD' object, which is a wrapper for a specific filesystem)
 bool Section::clearCache() const {
-  const auto path = activeFilePath.empty() ? getLegacyFilePath() : activeFilePath;
-  if (!SdMan.exists(path.c_str())) {
-    Serial.printf("[%lu] [SCT] Cache does not exist, no action needed\n", millis());
-    return true;
-  }
-
-  if (!SdMan.remove(path.c_str())) {
+  if (!epub->getSectionPack().remove(spineIndex, packViewportWidth, packViewportHeight)) {
     Serial.printf("[%lu] [SCT] Failed to clear cache\n", millis());
     return false;
   }
@@ -131,83 +157,169 @@ bool Section::createSectionFile(const int fontId, const float lineCompression, c
                                 const uint8_t paragraphAlignment, const uint16_t viewportWidth,
                                 const uint16_t viewportHeight, const bool hyphenationEnabled,
                                 const std::function<void()>& progressSetupFn,
-                                const std::function<void(int)>& progressFn) {
+                                const std::function<void(int)>& progressFn,
+                                const std::function<bool()>& pageBuiltFn) {
   constexpr uint32_t MIN_SIZE_FOR_PROGRESS = 50 * 1024;  // 50KB
+  const auto sdOpsStart = SdOpCounter::snapshot();
   const auto localPath = epub->getSpineItem(spineIndex).href;
-  const auto tmpHtmlPath = epub->getCachePath() + "/.tmp_" + std::to_string(spineIndex) + ".html";
 
-  // Create cache directory if it doesn't exist
-  {
-    const auto sectionsDir = epub->getCachePath() + "/sections";
-    SdMan.mkdir(sectionsDir.c_str());
-  }
-
-  // Retry logic for SD card timing issues
-  bool success = false;
-  uint32_t fileSize = 0;
-  for (int attempt = 0; attempt < 3 && !success; attempt++) {
-    if (attempt > 0) {
-      Serial.printf("[%lu] [SCT] Retrying stream (attempt %d)...\n", millis(), attempt + 1);
-      delay(50);  // Brief delay before retry
-    }
-
-    // Remove any incomplete file from previous attempt before retrying
-    if (SdMan.exists(tmpHtmlPath.c_str())) {
-      SdMan.remove(tmpHtmlPath.c_str());
-    }
-
-    FsFile tmpHtml;
-    if (!SdMan.openFileForWrite("SCT", tmpHtmlPath, tmpHtml)) {
-      continue;
-    }
-    success = epub->readItemContentsToStream(localPath, tmpHtml, 1024);
-    fileSize = tmpHtml.size();
-    tmpHtml.close();
-
-    // If streaming failed, remove the incomplete file immediately
-    if (!success && SdMan.exists(tmpHtmlPath.c_str())) {
-      SdMan.remove(tmpHtmlPath.c_str());
-      Serial.printf("[%lu] [SCT] Removed incomplete temp file after failed attempt\n", millis());
-    }
-  }
-
-  if (!success) {
-    Serial.printf("[%lu] [SCT] Failed to stream item contents to temp file after retries\n", millis());
+  // The chapter is inflated straight into the parser, this is only needed to decide on the progress bar
+  size_t fileSize = 0;
+  if (!epub->getItemSize(localPath, &fileSize)) {
+    Serial.printf("[%lu] [SCT] Failed to find item contents for %s\n", millis(), localPath.c_str());
     return false;
   }
 
-  Serial.printf("[%lu] [SCT] Streamed temp HTML to %s (%d bytes)\n", millis(), tmpHtmlPath.c_str(), fileSize);
-
   // Only show progress bar for larger chapters where rendering overhead is worth it
   if (progressSetupFn && fileSize >= MIN_SIZE_FOR_PROGRESS) {
     progressSetupFn();
   }
 
-  activeFilePath = getViewportFilePath(viewportWidth, viewportHeight);
-  if (!SdMan.openFileForWrite("SCT", activeFilePath, file)) {
-    return false;
-  }
-  writeSectionFileHeader(fontId, lineCompression, extraParagraphSpacing, paragraphAlignment, viewportWidth,
-                         viewportHeight, hyphenationEnabled);
+  packViewportWidth = viewportWidth;
+  packViewportHeight = viewportHeight;
+  auto& pack = epub->getSectionPack();
+  // Page records and the tables after them are small writes, collect them into whole-block SD writes
+  std::unique_ptr<BufferedFsWriter> writer;
   std::vector<uint32_t> lut = {};
 
-    ChapterHtmlSlimParser visitor(
-      tmpHtmlPath, epub, localPath, renderer, fontId, lineCompression, extraParagraphSpacing, paragraphAlignment,
-      viewportWidth, viewportHeight, hyphenationEnabled,
-      [this, &lut](std::unique_ptr<Page> page) { lut.emplace_back(this->onPageComplete(std::move(page))); },
+  ChapterHtmlSlimParser visitor(
+      epub, localPath, renderer, fontId, lineCompression, extraParagraphSpacing, paragraphAlignment, viewportWidth,
+      viewportHeight, hyphenationEnabled,
+      [this, &writer, &lut, &pageBuiltFn, &visitor](const std::vector<uint8_t>& page) {
+        lut.emplace_back(this->onPageComplete(*writer, page));
+        if (!buildCancelled && pageBuiltFn && !pageBuiltFn()) {
+          buildCancelled = true;
+        }
+        if (buildCancelled) {
+          visitor.stop();
+        }
+      },
       progressFn);
+  buildLut = &lut;
+  buildPageStarts = &visitor.getPageStarts();
   Hyphenator::setPreferredLanguage(epub->getLanguage());
-  success = visitor.parseAndBuildPages();
 
-  SdMan.remove(tmpHtmlPath.c_str());
+  const auto tokenPath = getTokenFilePath();
+  FsFile tokenFile;
+  std::unique_ptr<BufferedFsWriter> tokenWriter;
+  bool success = false;
+  bool replayed = false;
+
+  // An interrupted build under the same settings continues from its last checkpoint instead of starting over
+  const auto resume = restoreBuildCheckpoint(visitor, lut, fontId, lineCompression, extraParagraphSpacing,
+                                             paragraphAlignment, viewportWidth, viewportHeight, hyphenationEnabled);
+  if (resume == BuildResume::FAILED) {
+    Serial.printf("[%lu] [SCT] Build checkpoint unusable, starting over\n", millis());
+    removeBuildCheckpoint();
+    pageCount = 0;
+    return createSectionFile(fontId, lineCompression, extraParagraphSpacing, paragraphAlignment, viewportWidth,
+                             viewportHeight, hyphenationEnabled, progressSetupFn, progressFn, pageBuiltFn);
+  }
+
+  if (resume == BuildResume::RESUMED) {
+    writer.reset(new BufferedFsWriter(file));
+    buildWriter = writer.get();
+    // Keep recording the token stream from where the checkpoint left it, if it was being recorded at all
+    const uint32_t tokenPosition = visitor.getCheckpointTokenPosition();
+    if (tokenPosition > 0 && SdMan.exists(tokenPath.c_str())) {
+      FILE_CACHE.invalidate(tokenPath);
+      tokenFile = SdMan.open(tokenPath.c_str(), O_RDWR);
+      if (tokenFile && tokenFile.size() >= tokenPosition && tokenFile.truncate(tokenPosition) &&
+          tokenFile.seek(tokenPosition)) {
+        tokenWriter.reset(new BufferedFsWriter(tokenFile, TOKEN_WRITE_BUFFER_SIZE));
+        visitor.recordTokens(tokenWriter.get());
+      } else {
+        tokenFile.close();
+      }
+    }
+    if (!tokenWriter && SdMan.exists(tokenPath.c_str())) {
+      FILE_CACHE.remove(tokenPath.c_str());
+    }
+    Serial.printf("[%lu] [SCT] Resuming build after %d pages\n", millis(), pageCount);
+  } else {
+    if (!pack.beginAppend(file, &sectionOffset)) {
+      return false;
+    }
+    writer.reset(new BufferedFsWriter(file));
+    buildWriter = writer.get();
+    writeSectionFileHeader(*writer, fontId, lineCompression, extraParagraphSpacing, paragraphAlignment, viewportWidth,
+                           viewportHeight, hyphenationEnabled);
+
+    // Re-paginating a chapter that was parsed before (under any layout settings) replays its token stream, skipping
+    // the inflate and XML work. Otherwise parse the XHTML and record the stream for next time.
+    if (SdMan.exists(tokenPath.c_str()) && FILE_CACHE.openFileForRead("SCT", tokenPath, tokenFile)) {
+      {
+        BufferedFsReader tokenReader(tokenFile);
+        success = visitor.replayTokens(tokenReader);
+      }
+      tokenFile.close();
+      if (!success && !buildCancelled) {
+        // Pages may already have been handed out, start over from the source
+        Serial.printf("[%lu] [SCT] Token stream unusable, parsing %s\n", millis(), localPath.c_str());
+        buildWriter = nullptr;
+        pack.abortAppend(file, sectionOffset);
+        FILE_CACHE.remove(tokenPath.c_str());
+        pageCount = 0;
+        return createSectionFile(fontId, lineCompression, extraParagraphSpacing, paragraphAlignment, viewportWidth,
+                                 viewportHeight, hyphenationEnabled, progressSetupFn, progressFn, pageBuiltFn);
+      }
+      replayed = true;
+    } else {
+      SdMan.mkdir((epub->getCachePath() + "/tokens").c_str());
+      if (FILE_CACHE.openFileForWrite("SCT", tokenPath, tokenFile)) {
+        tokenWriter.reset(new BufferedFsWriter(tokenFile, TOKEN_WRITE_BUFFER_SIZE));
+        visitor.recordTokens(tokenWriter.get());
+      }
+    }
+  }
+
+  if (!replayed) {
+    // Parsing is the slow path, so it leaves a checkpoint every few pages that an interrupted build (sleep, power
+    // loss) resumes from. Pages and tokens have to be on the card before the checkpoint that counts them.
+    SdMan.mkdir((epub->getCachePath() + "/build").c_str());
+    visitor.setCheckpointCallback(
+        [this, &visitor, &lut, &writer, &tokenWriter, &tokenFile] {
+          if (!writer->flush() || !file.sync() || (tokenWriter && (!tokenWriter->flush() || !tokenFile.sync()))) {
+            return;
+          }
+          writeBuildCheckpoint(visitor, lut, writer->position());
+        },
+        BUILD_CHECKPOINT_PAGES, getBuildCheckpointPath() + ".inf");
+    success = visitor.parseAndBuildPages();
+    if (buildCancelled) {
+      // Left for the next build of this section to resume, along with the flushed part of the token stream
+      if (tokenWriter) {
+        tokenWriter->flush();
+        tokenWriter.reset();
+        tokenFile.close();
+      }
+    } else {
+      if (tokenWriter) {
+        const bool recorded = success && tokenWriter->finish();
+        tokenWriter.reset();
+        tokenFile.close();
+        if (!recorded) {
+          FILE_CACHE.remove(tokenPath.c_str());
+        }
+      }
+      removeBuildCheckpoint();
+    }
+  }
+  buildWriter = nullptr;
+
+  if (buildCancelled) {
+    // The partial blob stays at the end of the pack for the checkpoint, the next append elsewhere drops it
+    Serial.printf("[%lu] [SCT] Build cancelled after %d pages\n", millis(), pageCount);
+    file.close();
+    return false;
+  }
   if (!success) {
     Serial.printf("[%lu] [SCT] Failed to parse XML and build pages\n", millis());
-    file.close();
-    SdMan.remove(activeFilePath.c_str());
+    pack.abortAppend(file, sectionOffset);
     return false;
   }
 
-  const uint32_t lutOffset = file.position();
+  const uint32_t lutOffset = writer->position() - sectionOffset;
   bool hasFailedLutRecords = false;
   // Write LUT
   for (const uint32_t& pos : lut) {
@@ -215,39 +327,365 @@ bool Section::createSectionFile(const int fontId, const float lineCompression, c
       hasFailedLutRecords = true;
       break;
     }
-    serialization::writePod(file, pos);
+    serialization::writePod(*writer, pos);
   }
 
   if (hasFailedLutRecords) {
     Serial.printf("[%lu] [SCT] Failed to write LUT due to invalid page positions\n", millis());
-    file.close();
-    SdMan.remove(activeFilePath.c_str());
+    pack.abortAppend(file, sectionOffset);
+    return false;
+  }
+
+  // Source position of each page right after the LUT, in page order (and so in source order)
+  const auto& starts = visitor.getPageStarts();
+  if (starts.size() != lut.size()) {
+    Serial.printf("[%lu] [SCT] Page start count %u does not match page count %u\n", millis(),
+                  static_cast<unsigned>(starts.size()), static_cast<unsigned>(lut.size()));
+    pack.abortAppend(file, sectionOffset);
     return false;
   }
+  for (const auto& start : starts) {
+    serialization::writePod(*writer, start.offset);
+    serialization::writePod(*writer, start.wordIndex);
+  }
+
+  // Anchor table after the page starts, sorted by hash for binary search. The first occurrence of an id wins.
+  auto& anchors = visitor.getAnchors();
+  std::stable_sort(anchors.begin(), anchors.end(),
+                   [](const ChapterHtmlSlimParser::Anchor& a, const ChapterHtmlSlimParser::Anchor& b) {
+                     return a.hash < b.hash;
+                   });
+  anchors.erase(std::unique(anchors.begin(), anchors.end(),
+                            [](const ChapterHtmlSlimParser::Anchor& a, const ChapterHtmlSlimParser::Anchor& b) {
+                              return a.hash == b.hash;
+                            }),
+                anchors.end());
+  const uint16_t anchorCount = static_cast<uint16_t>(std::min(anchors.size(), static_cast<size_t>(UINT16_MAX)));
+  serialization::writePod(*writer, anchorCount);
+  for (uint16_t i = 0; i < anchorCount; i++) {
+    serialization::writePod(*writer, anchors[i].hash);
+    serialization::writePod(*writer, anchors[i].page);
+  }
 
   // Go back and write LUT offset
-  file.seek(HEADER_SIZE - sizeof(uint32_t) - sizeof(pageCount));
-  serialization::writePod(file, pageCount);
-  serialization::writePod(file, lutOffset);
-  file.close();
+  writer->seek(sectionOffset + HEADER_SIZE - sizeof(uint32_t) - sizeof(pageCount));
+  serialization::writePod(*writer, pageCount);
+  serialization::writePod(*writer, lutOffset);
+  if (!writer->flush()) {
+    Serial.printf("[%lu] [SCT] Failed to write section file\n", millis());
+    pack.abortAppend(file, sectionOffset);
+    return false;
+  }
+  if (!pack.commitAppend(file, sectionOffset, spineIndex, viewportWidth, viewportHeight)) {
+    return false;
+  }
+  pageLut = std::move(lut);
+  pageStarts = starts;
+  Serial.printf("[%lu] [SCT] Built %d pages, %u anchors with %lu SD reads, %lu SD writes\n", millis(), pageCount,
+                anchorCount,
+                static_cast<unsigned long>(SdOpCounter::readsSince(sdOpsStart)),
+                static_cast<unsigned long>(SdOpCounter::writesSince(sdOpsStart)));
   return true;
 }
 
-std::unique_ptr<Page> Section::loadPageFromSectionFile() {
-  const auto path = activeFilePath.empty() ? getLegacyFilePath() : activeFilePath;
-  if (!SdMan.openFileForRead("SCT", path, file)) {
-    return nullptr;
+std::string Section::getBuildCheckpointPath() const {
+  return epub->getCachePath() + "/build/" + std::to_string(spineIndex) + ".bin";
+}
+
+void Section::writeBuildCheckpoint(ChapterHtmlSlimParser& visitor, const std::vector<uint32_t>& lut,
+                                   const uint32_t sectionEnd) {
+  const auto path = getBuildCheckpointPath();
+  const auto tmpPath = path + ".tmp";
+  FsFile stateFile;
+  if (!FILE_CACHE.openFileForWrite("SCT", tmpPath, stateFile)) {
+    return;
+  }
+
+  bool ok;
+  {
+    BufferedFsWriter stateWriter(stateFile, TOKEN_WRITE_BUFFER_SIZE);
+    serialization::writePod(stateWriter, BUILD_CHECKPOINT_VERSION);
+    serialization::writePod(stateWriter, sectionOffset);
+    serialization::writePod(stateWriter, sectionEnd);
+    serialization::writePod(stateWriter, static_cast<uint16_t>(lut.size()));
+    for (const uint32_t pos : lut) {
+      serialization::writePod(stateWriter, pos);
+    }
+    ok = visitor.writeCheckpoint(stateWriter) && stateWriter.flush() && stateFile.sync();
   }
 
-  file.seek(HEADER_SIZE - sizeof(uint32_t));
+  // Written aside and swapped in, so an interruption leaves the previous checkpoint or none, never a torn one
+  if (ok) {
+    if (SdMan.exists(path.c_str())) {
+      FILE_CACHE.remove(path.c_str());
+    }
+    ok = stateFile.rename(path.c_str());
+  }
+  stateFile.close();
+  if (!ok) {
+    FILE_CACHE.remove(tmpPath.c_str());
+    return;
+  }
+  Serial.printf("[%lu] [SCT] Build checkpoint after %d pages\n", millis(), pageCount);
+}
+
+Section::BuildResume Section::restoreBuildCheckpoint(ChapterHtmlSlimParser& visitor, std::vector<uint32_t>& lut,
+                                                     const int fontId, const float lineCompression,
+                                                     const bool extraParagraphSpacing,
+                                                     const uint8_t paragraphAlignment, const uint16_t viewportWidth,
+                                                     const uint16_t viewportHeight, const bool hyphenationEnabled) {
+  const auto path = getBuildCheckpointPath();
+  FsFile stateFile;
+  if (!SdMan.exists(path.c_str()) || !FILE_CACHE.openFileForRead("SCT", path, stateFile)) {
+    return BuildResume::NONE;
+  }
+
+  BufferedFsReader reader(stateFile);
+  uint8_t version;
+  uint32_t offset;
+  uint32_t sectionEnd;
+  uint16_t pages;
+  serialization::readPod(reader, version);
+  serialization::readPod(reader, offset);
+  serialization::readPod(reader, sectionEnd);
+  serialization::readPod(reader, pages);
+
+  // The partial blob must still be the tail of the pack and have been started for the same layout
+  bool usable = version == BUILD_CHECKPOINT_VERSION && epub->getSectionPack().resumeAppend(file, offset, sectionEnd);
+  if (usable) {
+    uint8_t headerVersion;
+    usable = file.seek(offset) &&
+             headerMatches(file, fontId, lineCompression, extraParagraphSpacing, paragraphAlignment, viewportWidth,
+                           viewportHeight, hyphenationEnabled, &headerVersion) &&
+             file.seek(sectionEnd);
+    if (!usable) {
+      file.close();
+    }
+  }
+  if (!usable) {
+    stateFile.close();
+    removeBuildCheckpoint();
+    return BuildResume::NONE;
+  }
+
+  sectionOffset = offset;
+  lut.resize(pages);
+  for (auto& pos : lut) {
+    serialization::readPod(reader, pos);
+  }
+  pageCount = pages;
+  const bool restored = visitor.readCheckpoint(reader);
+  stateFile.close();
+  if (!restored) {
+    file.close();
+    return BuildResume::FAILED;
+  }
+  return BuildResume::RESUMED;
+}
+
+void Section::removeBuildCheckpoint() const {
+  const auto path = getBuildCheckpointPath();
+  for (const auto& checkpointPath : {path, path + ".tmp", path + ".inf"}) {
+    if (SdMan.exists(checkpointPath.c_str())) {
+      FILE_CACHE.remove(checkpointPath.c_str());
+    }
+  }
+}
+
+bool Section::loadPageLut() {
+  if (!epub->getSectionPack().openForRead(file)) {
+    return false;
+  }
+
+  BufferedFsReader reader(file);
+  reader.seek(sectionOffset + HEADER_SIZE - sizeof(uint32_t));
   uint32_t lutOffset;
-  serialization::readPod(file, lutOffset);
-  file.seek(lutOffset + sizeof(uint32_t) * currentPage);
-  uint32_t pagePos;
-  serialization::readPod(file, pagePos);
-  file.seek(pagePos);
+  serialization::readPod(reader, lutOffset);
+  reader.seek(sectionOffset + lutOffset);
+  pageLut.resize(pageCount);
+  const int lutSize = static_cast<int>(sizeof(uint32_t) * pageCount);
+  bool ok = reader.read(pageLut.data(), lutSize) == lutSize;
+  // The page start table follows the LUT, so it comes with the same reads
+  pageStarts.resize(pageCount);
+  for (auto& start : pageStarts) {
+    ok = ok && reader.read(&start.offset, sizeof(start.offset)) == sizeof(start.offset) &&
+         reader.read(&start.wordIndex, sizeof(start.wordIndex)) == sizeof(start.wordIndex);
+  }
+  file.close();
+  if (!ok) {
+    Serial.printf("[%lu] [SCT] Failed to read page LUT\n", millis());
+    pageLut.clear();
+    pageStarts.clear();
+  }
+  return ok;
+}
+
+std::unique_ptr<Page> Section::loadPage(const int index) {
+  const auto sdOpsStart = SdOpCounter::snapshot();
+  if (buildWriter) {
+    // Mid-build the pack is open for appending and the LUT is still in memory. Read the page through the same handle
+    // and put it back where the writer continues.
+    if (index < 0 || index >= static_cast<int>(buildLut->size()) || !buildWriter->flush()) {
+      return nullptr;
+    }
+    std::unique_ptr<Page> page;
+    {
+      BufferedFsReader reader(file);
+      reader.seek(sectionOffset + (*buildLut)[index]);
+      page = Page::deserialize(reader);
+    }
+    if (!file.seek(buildWriter->position())) {
+      Serial.printf("[%lu] [SCT] Failed to restore append position after loading page %d\n", millis(), index);
+      buildCancelled = true;
+      return nullptr;
+    }
+    Serial.printf("[%lu] [SCT] Loaded page %d of section being built\n", millis(), index);
+    return page;
+  }
+
+  if (index < 0 || index >= pageCount || (pageLut.size() != pageCount && !loadPageLut()) ||
+      !epub->getSectionPack().openForRead(file)) {
+    return nullptr;
+  }
+
+  // The record is decoded straight out of the reader's block buffer, one SD read for a normal page
+  BufferedFsReader reader(file);
+  reader.seek(sectionOffset + pageLut[index]);
+  auto page = Page::deserialize(reader);
+  file.close();
+  Serial.printf("[%lu] [SCT] Loaded page %d with %lu SD reads\n", millis(), index,
+                static_cast<unsigned long>(SdOpCounter::readsSince(sdOpsStart)));
+  return page;
+}
+
+const Page* Section::keepPage(const int index, std::unique_ptr<Page> page) {
+  DecodedPage* slot = &pageRing[0];
+  for (auto& candidate : pageRing) {
+    if (!candidate.page) {
+      slot = &candidate;
+      break;
+    }
+    if (std::abs(candidate.index - currentPage) > std::abs(slot->index - currentPage)) {
+      slot = &candidate;
+    }
+  }
+  slot->index = index;
+  slot->page = std::move(page);
+  return slot->page.get();
+}
+
+const Page* Section::getPage(const int index) {
+  for (const auto& decoded : pageRing) {
+    if (decoded.page && decoded.index == index) {
+      Serial.printf("[%lu] [SCT] Page %d was prefetched\n", millis(), index);
+      return decoded.page.get();
+    }
+  }
+  auto page = loadPage(index);
+  return page ? keepPage(index, std::move(page)) : nullptr;
+}
 
-  auto page = Page::deserialize(file);
+bool Section::prefetchPage() {
+  for (const int index : {currentPage + 1, currentPage - 1}) {
+    if (index < 0 || index >= pageCount) {
+      continue;
+    }
+    const bool decoded = std::any_of(pageRing.begin(), pageRing.end(), [index](const DecodedPage& slot) {
+      return slot.page && slot.index == index;
+    });
+    if (decoded) {
+      continue;
+    }
+    auto page = loadPage(index);
+    if (!page) {
+      return false;
+    }
+    keepPage(index, std::move(page));
+    return true;
+  }
+  return false;
+}
+
+int Section::getPageForAnchor(const std::string& anchor) {
+  // The anchor table is only written once the build has finished
+  if (anchor.empty() || buildWriter || !epub->getSectionPack().openForRead(file)) {
+    return -1;
+  }
+
+  BufferedFsReader reader(file);
+  const uint32_t tableOffset = readPageStartTableOffset(reader) + PAGE_START_ENTRY_SIZE * pageCount;
+  reader.seek(tableOffset);
+  uint16_t anchorCount;
+  serialization::readPod(reader, anchorCount);
+
+  const uint64_t target = ZipFile::fnvHash64(anchor.c_str(), anchor.size());
+  int page = -1;
+  int low = 0;
+  int high = static_cast<int>(anchorCount) - 1;
+  while (low <= high) {
+    const int mid = (low + high) / 2;
+    reader.seek(tableOffset + sizeof(anchorCount) + ANCHOR_ENTRY_SIZE * mid);
+    uint64_t hash;
+    serialization::readPod(reader, hash);
+    if (hash == target) {
+      uint16_t anchorPage;
+      serialization::readPod(reader, anchorPage);
+      page = std::min(static_cast<int>(anchorPage), pageCount - 1);
+      break;
+    }
+    if (hash < target) {
+      low = mid + 1;
+    } else {
+      high = mid - 1;
+    }
+  }
   file.close();
+
+  Serial.printf("[%lu] [SCT] Anchor #%s -> page %d\n", millis(), anchor.c_str(), page);
+  return page;
+}
+
+bool Section::getSourcePosition(const int page, SourcePosition* position) {
+  if (buildWriter) {
+    if (page < 0 || page >= static_cast<int>(buildPageStarts->size())) {
+      return false;
+    }
+    *position = (*buildPageStarts)[page];
+    return true;
+  }
+  if (page < 0 || page >= pageCount || (pageStarts.size() != pageCount && !loadPageLut())) {
+    return false;
+  }
+  *position = pageStarts[page];
+  return true;
+}
+
+int Section::getPageForSourcePosition(const SourcePosition& position) {
+  if (!buildWriter && (pageCount == 0 || (pageStarts.size() != pageCount && !loadPageLut()))) {
+    return -1;
+  }
+
+  // Last page starting at or before position
+  const auto& starts = buildWriter ? *buildPageStarts : pageStarts;
+  const auto next = std::upper_bound(starts.begin(), starts.end(), position);
+  if (buildWriter && next == starts.end()) {
+    // Only settled once a later page starts past position, until then it may still be on a page not built yet
+    return -1;
+  }
+  if (next == starts.begin()) {
+    return 0;
+  }
+  auto pageStart = next - 1;
+  // An image and the text following it can share a position, prefer the earlier page
+  while (pageStart != starts.begin() && *(pageStart - 1) == *pageStart) {
+    --pageStart;
+  }
+  const int page = static_cast<int>(pageStart - starts.begin());
+  if (buildWriter) {
+    return page;
+  }
+
+  Serial.printf("[%lu] [SCT] Source position %lu:%u -> page %d\n", millis(),
+                static_cast<unsigned long>(position.offset), position.wordIndex, page);
   return page;
 }
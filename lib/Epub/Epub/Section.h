@@ -1,48 +1,115 @@
 #pragma once
+#include <array>
 #include <functional>
 #include <memory>
+#include <vector>
 
 #include "Epub.h"
+#include "Page.h"
+#include "SourcePosition.h"
 
-class Page;
+class BufferedFsReader;
+class BufferedFsWriter;
+class ChapterHtmlSlimParser;
 class GfxRenderer;
 
 class Section {
+ public:
+  // Bump when the section layout or page serialization changes, sections of other versions are laid out again
+  static constexpr uint8_t SECTION_FILE_VERSION = 14;
+
+ private:
+  enum class BuildResume : uint8_t { NONE, RESUMED, FAILED };
+  // Current page and its two neighbours
+  static constexpr size_t PAGE_RING_SIZE = 3;
+  struct DecodedPage {
+    int index = -1;
+    std::unique_ptr<Page> page;
+  };
+
   std::shared_ptr<Epub> epub;
   const int spineIndex;
   GfxRenderer& renderer;
-  mutable std::string activeFilePath;
   FsFile file;
+  // Where this section's blob lives in the book's section pack, LUT and page offsets are relative to it
+  uint32_t sectionOffset = 0;
+  // Viewport the section was loaded or built for, part of its pack key so portrait/landscape can coexist
+  uint16_t packViewportWidth = 0;
+  uint16_t packViewportHeight = 0;
+  // While createSectionFile runs: the writer appending to file and the pages laid out so far, which lets pages be
+  // loaded before the build has finished (see pageBuiltFn)
+  BufferedFsWriter* buildWriter = nullptr;
+  const std::vector<uint32_t>* buildLut = nullptr;
+  const std::vector<SourcePosition>* buildPageStarts = nullptr;
+  bool buildCancelled = false;
+  // Page offsets and page start positions of the finished section, read once on the first lookup and kept while the
+  // section is open
+  std::vector<uint32_t> pageLut;
+  std::vector<SourcePosition> pageStarts;
+  // Decoded pages around currentPage, so turning to an adjacent page needs no SD access
+  std::array<DecodedPage, PAGE_RING_SIZE> pageRing;
 
-  std::string getLegacyFilePath() const {
-    return epub->getCachePath() + "/sections/" + std::to_string(spineIndex) + ".bin";
-  }
+  bool loadPageLut();
+  std::unique_ptr<Page> loadPage(int index);
+  // Stores a decoded page in place of the one furthest from currentPage
+  const Page* keepPage(int index, std::unique_ptr<Page> page);
 
-  std::string getViewportFilePath(const uint16_t viewportWidth, const uint16_t viewportHeight) const {
-    return epub->getCachePath() + "/sections/" + std::to_string(spineIndex) + "_" + std::to_string(viewportWidth) +
-           "x" + std::to_string(viewportHeight) + ".bin";
-  }
+  void writeSectionFileHeader(BufferedFsWriter& writer, int fontId, float lineCompression, bool extraParagraphSpacing,
+                              uint8_t paragraphAlignment, uint16_t viewportWidth, uint16_t viewportHeight,
+                              bool hyphenationEnabled);
+  uint32_t onPageComplete(BufferedFsWriter& writer, const std::vector<uint8_t>& page);
+  // Absolute offset of the page start table (right after the LUT)
+  uint32_t readPageStartTableOffset(BufferedFsReader& reader) const;
+  // Layout-independent token stream of the chapter, shared by every viewport and settings combination
+  std::string getTokenFilePath() const;
+  // Reads the header at the file's position, true if it was written for these layout parameters
+  static bool headerMatches(FsFile& file, int fontId, float lineCompression, bool extraParagraphSpacing,
+                            uint8_t paragraphAlignment, uint16_t viewportWidth, uint16_t viewportHeight,
+                            bool hyphenationEnabled, uint8_t* version);
 
-  void writeSectionFileHeader(int fontId, float lineCompression, bool extraParagraphSpacing, uint8_t paragraphAlignment,
-                              uint16_t viewportWidth, uint16_t viewportHeight, bool hyphenationEnabled);
-  uint32_t onPageComplete(std::unique_ptr<Page> page);
+  // State of an unfinished build: where its blob is in the pack, the LUT so far and the parser state at the last
+  // checkpointed block, so the build can resume there after an interruption
+  std::string getBuildCheckpointPath() const;
+  void writeBuildCheckpoint(ChapterHtmlSlimParser& visitor, const std::vector<uint32_t>& lut, uint32_t sectionEnd);
+  // RESUMED leaves file open at the end of the restored pages. FAILED means visitor was partly restored and can't be
+  // used for a fresh build.
+  BuildResume restoreBuildCheckpoint(ChapterHtmlSlimParser& visitor, std::vector<uint32_t>& lut, int fontId,
+                                     float lineCompression, bool extraParagraphSpacing, uint8_t paragraphAlignment,
+                                     uint16_t viewportWidth, uint16_t viewportHeight, bool hyphenationEnabled);
+  void removeBuildCheckpoint() const;
 
  public:
   uint16_t pageCount = 0;
   int currentPage = 0;
 
   explicit Section(const std::shared_ptr<Epub>& epub, const int spineIndex, GfxRenderer& renderer)
-      : epub(epub),
-        spineIndex(spineIndex),
-        renderer(renderer),
-        activeFilePath(getLegacyFilePath()) {}
+      : epub(epub), spineIndex(spineIndex), renderer(renderer) {}
   ~Section() = default;
   bool loadSectionFile(int fontId, float lineCompression, bool extraParagraphSpacing, uint8_t paragraphAlignment,
                        uint16_t viewportWidth, uint16_t viewportHeight, bool hyphenationEnabled);
   bool clearCache() const;
+  // pageBuiltFn is called after each page is appended, with the build paused inside it: pages built so far can be
+  // loaded until it returns (e.g. by another task waiting on the same lock). Returning false abandons the build but
+  // keeps its checkpoint, so building the section again continues from there.
   bool createSectionFile(int fontId, float lineCompression, bool extraParagraphSpacing, uint8_t paragraphAlignment,
                          uint16_t viewportWidth, uint16_t viewportHeight, bool hyphenationEnabled,
                          const std::function<void()>& progressSetupFn = nullptr,
-                         const std::function<void(int)>& progressFn = nullptr);
-  std::unique_ptr<Page> loadPageFromSectionFile();
+                         const std::function<void(int)>& progressFn = nullptr,
+                         const std::function<bool()>& pageBuiltFn = nullptr);
+  // True while createSectionFile is running. pageCount is then the number of pages built so far, and the page and
+  // source position lookups only see those pages.
+  bool isBuilding() const { return buildWriter != nullptr; }
+  // Decoded page, from the ring when it was prefetched and from SD otherwise. nullptr if it can't be loaded. The page
+  // stays valid until the next getPage or prefetchPage call.
+  const Page* getPage(int index);
+  // Decodes the next or previous page of currentPage into the ring, one page per call. Returns false once both are
+  // there (or can't be loaded), meant to be called while the reader is idle.
+  bool prefetchPage();
+  // Page an element id (e.g. a TOC anchor) was laid out on, -1 if the section has no such id
+  int getPageForAnchor(const std::string& anchor);
+  // Source position of the first line or image on page
+  bool getSourcePosition(int page, SourcePosition* position);
+  // Page showing position under the current layout (the last page starting at or before it), -1 on failure or, while
+  // building, if that page may not have been built yet
+  int getPageForSourcePosition(const SourcePosition& position);
 };
@@ -0,0 +1,364 @@
+#include "SectionPack.h"
+
+#include <BufferedFsReader.h>
+#include <BufferedFsWriter.h>
+#include <FileHandleCache.h>
+#include <HardwareSerial.h>
+#include <SDCardManager.h>
+#include <Serialization.h>
+
+#include <algorithm>
+
+namespace {
+constexpr uint8_t PACK_VERSION = 1;
+// version (u8) + index offset (u32) + entry count (u16) + dead bytes (u32)
+constexpr uint32_t HEADER_SIZE = sizeof(uint8_t) + sizeof(uint32_t) + sizeof(uint16_t) + sizeof(uint32_t);
+// spine index, viewport width, viewport height (u16 each) + offset, length (u32 each)
+constexpr uint32_t ENTRY_SIZE = 3 * sizeof(uint16_t) + 2 * sizeof(uint32_t);
+// Don't bother compacting until there is at least this much to reclaim
+constexpr uint32_t COMPACT_MIN_DEAD_BYTES = 256 * 1024;
+constexpr size_t COPY_BUFFER_SIZE = 4096;
+}  // namespace
+
+bool SectionPack::load() {
+  if (loaded) {
+    return true;
+  }
+
+  entries.clear();
+  indexOffset = 0;
+  indexSize = 0;
+  deadBytes = 0;
+  loaded = true;
+
+  if (!SdMan.exists(path.c_str())) {
+    return true;
+  }
+
+  FsFile file;
+  if (!FILE_CACHE.openFileForRead("SPK", path, file)) {
+    return false;
+  }
+
+  BufferedFsReader reader(file);
+  uint8_t version;
+  uint16_t count = 0;
+  serialization::readPod(reader, version);
+  serialization::readPod(reader, indexOffset);
+  serialization::readPod(reader, count);
+  serialization::readPod(reader, deadBytes);
+
+  if (version != PACK_VERSION || indexOffset < HEADER_SIZE ||
+      indexOffset + static_cast<uint32_t>(count) * ENTRY_SIZE > reader.size()) {
+    Serial.printf("[%lu] [SPK] Discarding unusable section pack (version %u)\n", millis(), version);
+    file.close();
+    FILE_CACHE.remove(path.c_str());
+    indexOffset = 0;
+    deadBytes = 0;
+    return true;
+  }
+
+  reader.seek(indexOffset);
+  entries.resize(count);
+  for (auto& entry : entries) {
+    serialization::readPod(reader, entry.spineIndex);
+    serialization::readPod(reader, entry.viewportWidth);
+    serialization::readPod(reader, entry.viewportHeight);
+    serialization::readPod(reader, entry.offset);
+    serialization::readPod(reader, entry.length);
+  }
+  indexSize = count * ENTRY_SIZE;
+  file.close();
+
+  Serial.printf("[%lu] [SPK] Loaded section pack: %u sections, %lu dead bytes\n", millis(), count,
+                static_cast<unsigned long>(deadBytes));
+  return true;
+}
+
+std::vector<SectionPack::Entry>::iterator SectionPack::findEntry(const uint16_t spineIndex,
+                                                                 const uint16_t viewportWidth,
+                                                                 const uint16_t viewportHeight) {
+  const Entry key = {0, 0, spineIndex, viewportWidth, viewportHeight};
+  const auto it = std::lower_bound(entries.begin(), entries.end(), key, [](const Entry& a, const Entry& b) {
+    if (a.spineIndex != b.spineIndex) return a.spineIndex < b.spineIndex;
+    if (a.viewportWidth != b.viewportWidth) return a.viewportWidth < b.viewportWidth;
+    return a.viewportHeight < b.viewportHeight;
+  });
+  return it;
+}
+
+bool SectionPack::find(const uint16_t spineIndex, const uint16_t viewportWidth, const uint16_t viewportHeight,
+                       uint32_t* offset, uint32_t* length) {
+  if (!load()) {
+    return false;
+  }
+
+  const auto it = findEntry(spineIndex, viewportWidth, viewportHeight);
+  if (it == entries.end() || it->spineIndex != spineIndex || it->viewportWidth != viewportWidth ||
+      it->viewportHeight != viewportHeight) {
+    return false;
+  }
+
+  *offset = it->offset;
+  *length = it->length;
+  return true;
+}
+
+bool SectionPack::openForRead(FsFile& file) const { return FILE_CACHE.openFileForRead("SPK", path, file); }
+
+bool SectionPack::beginAppend(FsFile& file, uint32_t* offset) {
+  if (!load()) {
+    return false;
+  }
+
+  // Cached read handles would not see the pack grow
+  FILE_CACHE.invalidate(path);
+
+  if (!SdMan.exists(path.c_str())) {
+    if (!SdMan.openFileForWrite("SPK", path, file)) {
+      return false;
+    }
+    // Fresh pack: header pointing at an empty index right behind it
+    entries.clear();
+    indexOffset = HEADER_SIZE;
+    indexSize = 0;
+    deadBytes = 0;
+    serialization::writePod(file, PACK_VERSION);
+    serialization::writePod(file, indexOffset);
+    serialization::writePod(file, static_cast<uint16_t>(0));
+    serialization::writePod(file, deadBytes);
+  } else {
+    file = SdMan.open(path.c_str(), O_RDWR);
+    if (!file) {
+      Serial.printf("[%lu] [SPK] Could not open section pack for writing\n", millis());
+      return false;
+    }
+    // The index is always the last thing committed, anything behind it is from an append that never finished
+    const uint32_t indexEnd = indexOffset + indexSize;
+    if (file.size() > indexEnd) {
+      Serial.printf("[%lu] [SPK] Dropping %lu bytes of unfinished section\n", millis(),
+                    static_cast<unsigned long>(file.size() - indexEnd));
+      file.truncate(indexEnd);
+    }
+  }
+
+  *offset = file.size();
+  return file.seek(*offset);
+}
+
+bool SectionPack::resumeAppend(FsFile& file, const uint32_t offset, const uint32_t resumeAt) {
+  if (!load() || indexOffset + indexSize != offset || !SdMan.exists(path.c_str())) {
+    return false;
+  }
+
+  FILE_CACHE.invalidate(path);
+  file = SdMan.open(path.c_str(), O_RDWR);
+  if (!file) {
+    return false;
+  }
+  if (file.size() < resumeAt || !file.truncate(resumeAt) || !file.seek(resumeAt)) {
+    file.close();
+    return false;
+  }
+  return true;
+}
+
+bool SectionPack::writeIndexAndHeader(FsFile& file) {
+  const uint32_t newIndexOffset = file.size();
+  if (!file.seek(newIndexOffset)) {
+    return false;
+  }
+
+  {
+    BufferedFsWriter writer(file);
+    for (const auto& entry : entries) {
+      serialization::writePod(writer, entry.spineIndex);
+      serialization::writePod(writer, entry.viewportWidth);
+      serialization::writePod(writer, entry.viewportHeight);
+      serialization::writePod(writer, entry.offset);
+      serialization::writePod(writer, entry.length);
+    }
+    if (!writer.flush()) {
+      return false;
+    }
+  }
+
+  // Only now that the new index is complete does the header move over to it
+  deadBytes += indexSize;
+  indexOffset = newIndexOffset;
+  indexSize = entries.size() * ENTRY_SIZE;
+  file.seek(0);
+  serialization::writePod(file, PACK_VERSION);
+  serialization::writePod(file, indexOffset);
+  serialization::writePod(file, static_cast<uint16_t>(entries.size()));
+  serialization::writePod(file, deadBytes);
+  return file.sync();
+}
+
+bool SectionPack::commitAppend(FsFile& file, const uint32_t offset, const uint16_t spineIndex,
+                               const uint16_t viewportWidth, const uint16_t viewportHeight) {
+  const uint32_t length = file.size() - offset;
+
+  const auto it = findEntry(spineIndex, viewportWidth, viewportHeight);
+  if (it != entries.end() && it->spineIndex == spineIndex && it->viewportWidth == viewportWidth &&
+      it->viewportHeight == viewportHeight) {
+    deadBytes += it->length;
+    it->offset = offset;
+    it->length = length;
+  } else {
+    entries.insert(it, {offset, length, spineIndex, viewportWidth, viewportHeight});
+  }
+
+  const bool ok = writeIndexAndHeader(file);
+  file.close();
+  FILE_CACHE.invalidate(path);
+  if (!ok) {
+    Serial.printf("[%lu] [SPK] Failed to write section pack index\n", millis());
+    // The header may or may not have moved over, re-read whatever is on the card next time
+    reset();
+  }
+  return ok;
+}
+
+void SectionPack::abortAppend(FsFile& file, const uint32_t offset) {
+  // Nothing references the bytes past offset yet
+  file.truncate(offset);
+  file.close();
+  FILE_CACHE.invalidate(path);
+}
+
+bool SectionPack::remove(const uint16_t spineIndex, const uint16_t viewportWidth, const uint16_t viewportHeight) {
+  if (!load()) {
+    return false;
+  }
+
+  const auto it = findEntry(spineIndex, viewportWidth, viewportHeight);
+  if (it == entries.end() || it->spineIndex != spineIndex || it->viewportWidth != viewportWidth ||
+      it->viewportHeight != viewportHeight) {
+    return true;
+  }
+
+  FILE_CACHE.invalidate(path);
+  FsFile file = SdMan.open(path.c_str(), O_RDWR);
+  if (!file) {
+    return false;
+  }
+
+  // As in beginAppend, an unfinished section behind the index (an interrupted append or a cancelled build kept for
+  // resuming) goes first. Left there, the new index would land behind it and nothing would ever account for it.
+  const uint32_t indexEnd = indexOffset + indexSize;
+  if (file.size() > indexEnd) {
+    Serial.printf("[%lu] [SPK] Dropping %lu bytes of unfinished section\n", millis(),
+                  static_cast<unsigned long>(file.size() - indexEnd));
+    if (!file.truncate(indexEnd)) {
+      file.close();
+      return false;
+    }
+  }
+
+  deadBytes += it->length;
+  entries.erase(it);
+  const bool ok = writeIndexAndHeader(file);
+  file.close();
+  if (!ok) {
+    reset();
+  }
+  return ok;
+}
+
+bool SectionPack::shouldCompact() {
+  if (!load()) {
+    return false;
+  }
+
+  uint32_t liveBytes = 0;
+  for (const auto& entry : entries) {
+    liveBytes += entry.length;
+  }
+  return deadBytes >= COMPACT_MIN_DEAD_BYTES && deadBytes > liveBytes;
+}
+
+bool SectionPack::compact() {
+  if (!load() || !SdMan.exists(path.c_str())) {
+    return false;
+  }
+
+  const unsigned long start = millis();
+  const uint32_t reclaimed = deadBytes;
+  FILE_CACHE.invalidate(path);
+  FsFile file = SdMan.open(path.c_str(), O_RDWR);
+  if (!file) {
+    return false;
+  }
+
+  auto* buffer = static_cast<uint8_t*>(malloc(COPY_BUFFER_SIZE));
+  if (!buffer) {
+    Serial.printf("[%lu] [SPK] Could not allocate compaction buffer\n", millis());
+    file.close();
+    return false;
+  }
+
+  // Point the header at an empty index first: if compaction is interrupted the pack reads back empty rather than
+  // referencing data that has already moved
+  serialization::writePod(file, PACK_VERSION);
+  serialization::writePod(file, HEADER_SIZE);
+  serialization::writePod(file, static_cast<uint16_t>(0));
+  serialization::writePod(file, static_cast<uint32_t>(0));
+  file.sync();
+
+  // Slide the sections down in file order, the destination is always at or before the source
+  std::vector<Entry*> byOffset;
+  byOffset.reserve(entries.size());
+  for (auto& entry : entries) {
+    byOffset.push_back(&entry);
+  }
+  std::sort(byOffset.begin(), byOffset.end(), [](const Entry* a, const Entry* b) { return a->offset < b->offset; });
+
+  bool ok = true;
+  uint32_t cursor = HEADER_SIZE;
+  for (auto* entry : byOffset) {
+    if (entry->offset != cursor) {
+      for (uint32_t copied = 0; ok && copied < entry->length; copied += COPY_BUFFER_SIZE) {
+        const size_t chunk = std::min(static_cast<size_t>(entry->length - copied), COPY_BUFFER_SIZE);
+        ok = file.seek(entry->offset + copied) && file.read(buffer, chunk) == static_cast<int>(chunk) &&
+             file.seek(cursor + copied) && file.write(buffer, chunk) == chunk;
+      }
+      entry->offset = cursor;
+    }
+    if (!ok) {
+      break;
+    }
+    cursor += entry->length;
+  }
+  free(buffer);
+
+  if (!ok) {
+    Serial.printf("[%lu] [SPK] Compaction failed, dropping section pack\n", millis());
+    file.close();
+    FILE_CACHE.remove(path.c_str());
+    reset();
+    return false;
+  }
+
+  indexSize = 0;
+  deadBytes = 0;
+  ok = file.truncate(cursor) && writeIndexAndHeader(file);
+  file.close();
+  if (!ok) {
+    reset();
+    return false;
+  }
+
+  Serial.printf("[%lu] [SPK] Compacted section pack, reclaimed %lu bytes in %lu ms\n", millis(),
+                static_cast<unsigned long>(reclaimed), millis() - start);
+  return true;
+}
+
+void SectionPack::reset() {
+  entries.clear();
+  entries.shrink_to_fit();
+  indexOffset = 0;
+  indexSize = 0;
+  deadBytes = 0;
+  loaded = false;
+}
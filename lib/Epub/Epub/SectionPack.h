@@ -0,0 +1,67 @@
+#pragma once
+#include <SdFat.h>
+
+#include <string>
+#include <vector>
+
+/**
+ * All laid out sections of a book in one file, instead of one file per spine item and viewport.
+ *
+ * Layout: a fixed header, an append-only data region holding the section blobs, and the index (spine index and
+ * viewport -> offset/length) after the last blob. Appending a section writes the blob and a fresh copy of the index at
+ * the end of the file and only then points the header at it, so an interrupted build leaves the previous index intact.
+ * Replaced sections and superseded index copies become dead space until compact() is run.
+ *
+ * The index is small and kept in memory, so opening a section is a lookup plus one seek in the (cached) pack handle
+ * rather than a FAT path resolution.
+ */
+class SectionPack {
+  struct Entry {
+    uint32_t offset;
+    uint32_t length;
+    uint16_t spineIndex;
+    uint16_t viewportWidth;
+    uint16_t viewportHeight;
+  };
+
+  std::string path;
+  std::vector<Entry> entries;  // sorted by (spineIndex, viewportWidth, viewportHeight)
+  uint32_t indexOffset = 0;
+  // Size of the index copy indexOffset points at, it becomes dead space once the next copy is written
+  uint32_t indexSize = 0;
+  uint32_t deadBytes = 0;
+  bool loaded = false;
+
+  bool load();
+  std::vector<Entry>::iterator findEntry(uint16_t spineIndex, uint16_t viewportWidth, uint16_t viewportHeight);
+  // Writes the index at the end of the file, then points the header at it
+  bool writeIndexAndHeader(FsFile& file);
+
+ public:
+  explicit SectionPack(std::string path) : path(std::move(path)) {}
+
+  const std::string& getPath() const { return path; }
+  // Locates a section, offset is the absolute position of its blob in the pack
+  bool find(uint16_t spineIndex, uint16_t viewportWidth, uint16_t viewportHeight, uint32_t* offset, uint32_t* length);
+  bool openForRead(FsFile& file) const;
+
+  // Opens the pack for appending a section blob, positioning file at *offset (the current end of the pack).
+  // Must be followed by commitAppend or abortAppend. Bytes left past the index by an interrupted append are dropped.
+  bool beginAppend(FsFile& file, uint32_t* offset);
+  // Reopens an append interrupted after writing [offset, resumeAt), positioning file at resumeAt. Fails if the pack
+  // was written since (the blob is no longer the tail) or holds less than resumeAt bytes.
+  bool resumeAppend(FsFile& file, uint32_t offset, uint32_t resumeAt);
+  // Indexes everything written since beginAppend as the section for spineIndex/viewport, replacing any previous one
+  bool commitAppend(FsFile& file, uint32_t offset, uint16_t spineIndex, uint16_t viewportWidth,
+                    uint16_t viewportHeight);
+  void abortAppend(FsFile& file, uint32_t offset);
+  bool remove(uint16_t spineIndex, uint16_t viewportWidth, uint16_t viewportHeight);
+
+  // Worth compacting once dead space outweighs the live sections
+  bool shouldCompact();
+  // Slides the live sections down over dead space in place and truncates the file. Offsets returned by find()
+  // before compacting are invalid afterwards.
+  bool compact();
+  // Forgets the in-memory index, e.g. after the cache directory was removed
+  void reset();
+};
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <cstdint>
+
+// Layout-independent position in a spine item: the byte offset of the block (or image) element in the XHTML source
+// plus the index of a word within that block. Unlike page numbers it survives font, margin and orientation changes.
+struct SourcePosition {
+  uint32_t offset;
+  uint16_t wordIndex;
+
+  bool operator==(const SourcePosition& other) const {
+    return offset == other.offset && wordIndex == other.wordIndex;
+  }
+  bool operator<(const SourcePosition& other) const {
+    return offset < other.offset || (offset == other.offset && wordIndex < other.wordIndex);
+  }
+};
@@ -0,0 +1,67 @@
+#include "TocWindowCache.h"
+
+#include <GfxRenderer.h>
+#include <HardwareSerial.h>
+
+#include <algorithm>
+#include <cstring>
+
+#include "Epub.h"
+
+void TocWindowCache::ensure(const int first, int count) {
+  count = std::min(count, epub.getTocItemsCount() - first);
+  if (first < 0 || count <= 0 || contains(first, count)) {
+    return;
+  }
+  load(first, count);
+}
+
+bool TocWindowCache::get(const int tocIndex, Item* item) {
+  if (tocIndex < 0 || tocIndex >= epub.getTocItemsCount()) {
+    return false;
+  }
+  if (!contains(tocIndex, 1)) {
+    load(tocIndex, MAX_ITEMS);
+    if (!contains(tocIndex, 1)) {
+      return false;
+    }
+  }
+
+  const auto& slot = slots[tocIndex - windowStart];
+  item->title = pool + slot.titleOffset;
+  item->level = slot.level;
+  item->spineIndex = slot.spineIndex;
+  return true;
+}
+
+void TocWindowCache::setMaxWidth(const int width) {
+  if (width != maxWidth) {
+    maxWidth = width;
+    clear();
+  }
+}
+
+void TocWindowCache::load(const int first, const int count) {
+  windowStart = first;
+  windowCount = 0;
+  size_t poolUsed = 0;
+
+  const unsigned long start = millis();
+  epub.readTocTitles(first, std::min(count, MAX_ITEMS),
+                     [this, &poolUsed](int, const char* title, const uint8_t level, const int16_t spineIndex) {
+                       const int width = maxWidth - (level - 1) * indentPerLevel;
+                       const std::string truncated = renderer.truncatedText(fontId, title, width);
+                       if (poolUsed + truncated.size() + 1 > POOL_SIZE) {
+                         // Pool is full, the window ends here
+                         return false;
+                       }
+                       memcpy(pool + poolUsed, truncated.c_str(), truncated.size() + 1);
+                       slots[windowCount] = {static_cast<uint16_t>(poolUsed), level, spineIndex};
+                       poolUsed += truncated.size() + 1;
+                       windowCount++;
+                       return true;
+                     });
+
+  Serial.printf("[%lu] [TWC] Loaded TOC entries %d-%d (%u pool bytes) in %lu ms\n", millis(), first,
+                first + windowCount - 1, static_cast<unsigned>(poolUsed), millis() - start);
+}
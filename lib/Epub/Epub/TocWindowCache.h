@@ -0,0 +1,61 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+class Epub;
+class GfxRenderer;
+
+/**
+ * A window of consecutive TOC entries held in RAM for list and status bar rendering.
+ *
+ * Filling the window is one sequential read over book.bin (rather than two seeks and three string allocations per
+ * entry through Epub::getTocItem). Titles are truncated to the configured width as they are loaded and packed into a
+ * fixed size string pool, so drawing a row is a pointer lookup.
+ */
+class TocWindowCache {
+ public:
+  static constexpr int MAX_ITEMS = 32;
+  static constexpr size_t POOL_SIZE = 3072;
+
+  struct Item {
+    const char* title;
+    uint8_t level;
+    int16_t spineIndex;
+  };
+
+  // Titles are truncated to maxWidth - (level - 1) * indentPerLevel pixels in fontId
+  TocWindowCache(const Epub& epub, const GfxRenderer& renderer, int fontId, int maxWidth, int indentPerLevel = 0)
+      : epub(epub), renderer(renderer), fontId(fontId), maxWidth(maxWidth), indentPerLevel(indentPerLevel) {}
+
+  // Makes [first, first + count) resident, reloading the window from first if any of it is missing. Ranges larger
+  // than MAX_ITEMS (or than fits the pool) are only partially loaded.
+  void ensure(int first, int count);
+  // Looks up tocIndex, loading a window starting at it on a miss. The title stays valid until the window moves.
+  bool get(int tocIndex, Item* item);
+  // Changing the width drops the window, its titles were truncated for the old one
+  void setMaxWidth(int width);
+  void clear() { windowCount = 0; }
+
+ private:
+  struct Slot {
+    uint16_t titleOffset;
+    uint8_t level;
+    int16_t spineIndex;
+  };
+
+  const Epub& epub;
+  const GfxRenderer& renderer;
+  int fontId;
+  int maxWidth;
+  int indentPerLevel;
+
+  int windowStart = 0;
+  int windowCount = 0;
+  Slot slots[MAX_ITEMS] = {};
+  char pool[POOL_SIZE] = {};
+
+  bool contains(int first, int count) const {
+    return first >= windowStart && first + count <= windowStart + windowCount;
+  }
+  void load(int first, int count);
+};
@@ -1,14 +1,14 @@
 #pragma once
 #include <EpdFontFamily.h>
-#include <SdFat.h>
 
-#include <list>
 #include <memory>
 #include <string>
+#include <vector>
 
+#include "../PageCodec.h"
 #include "Block.h"
 
-// Represents a line of text on a page
+// Represents a line of text on a page. The words are stored back to back, each NUL terminated, in one buffer.
 class TextBlock final : public Block {
  public:
   enum Style : uint8_t {
@@ -19,23 +19,26 @@ class TextBlock final : public Block {
   };
 
  private:
-  std::list<std::string> words;
-  std::list<uint16_t> wordXpos;
-  std::list<EpdFontFamily::Style> wordStyles;
+  std::string text;
+  std::vector<uint16_t> wordOffsets;
+  std::vector<uint16_t> wordXpos;
+  std::vector<EpdFontFamily::Style> wordStyles;
   Style style;
 
  public:
-  explicit TextBlock(std::list<std::string> words, std::list<uint16_t> word_xpos,
-                     std::list<EpdFontFamily::Style> word_styles, const Style style)
-      : words(std::move(words)), wordXpos(std::move(word_xpos)), wordStyles(std::move(word_styles)), style(style) {}
+  explicit TextBlock(std::string text, std::vector<uint16_t> word_offsets, std::vector<uint16_t> word_xpos,
+                     std::vector<EpdFontFamily::Style> word_styles, const Style style)
+      : text(std::move(text)),
+        wordOffsets(std::move(word_offsets)),
+        wordXpos(std::move(word_xpos)),
+        wordStyles(std::move(word_styles)),
+        style(style) {}
   ~TextBlock() override = default;
   void setStyle(const Style style) { this->style = style; }
   Style getStyle() const { return style; }
-  bool isEmpty() override { return words.empty(); }
+  bool isEmpty() override { return wordOffsets.empty(); }
   void layout(GfxRenderer& renderer) override {};
-  // given a renderer works out where to break the words into lines
-  void render(const GfxRenderer& renderer, int fontId, int x, int y) const;
   BlockType getType() override { return TEXT_BLOCK; }
-  bool serialize(FsFile& file) const;
-  static std::unique_ptr<TextBlock> deserialize(FsFile& file);
+  // Adds the line to the page the encoder is building
+  bool encode(PageCodec::Encoder& encoder, int16_t x, int16_t y) const;
 };
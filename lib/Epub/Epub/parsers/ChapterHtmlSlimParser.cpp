@@ -1,14 +1,18 @@
 #include "ChapterHtmlSlimParser.h"
 
+#include <Arduino.h>
 #include <Bitmap.h>
 #include <Epub.h>
+#include <FileHandleCache.h>
 #include <FsHelpers.h>
 #include <GfxRenderer.h>
 #include <HardwareSerial.h>
 #include <JpegToBmpConverter.h>
 #include <SDCardManager.h>
+#include <Serialization.h>
 #include <expat.h>
 
+#include <algorithm>
 #include <cctype>
 
 #include "../Page.h"
@@ -19,6 +23,22 @@ constexpr int NUM_HEADER_TAGS = sizeof(HEADER_TAGS) / sizeof(HEADER_TAGS[0]);
 // Minimum file size (in bytes) to show progress bar - smaller chapters don't benefit from it
 constexpr size_t MIN_SIZE_FOR_PROGRESS = 50 * 1024;  // 50KB
 
+// Size of each expat feed (and of the compressed read chunk), sector aligned so each fill is a whole-block SD read
+constexpr size_t PARSE_BUFFER_SIZE = 4096;
+
+// Largest free heap block needed to stream a JPEG straight out of the zip: a second entry reader (32KB dictionary,
+// inflater, input buffer) next to the chapter's, with the decoder on top
+constexpr size_t STREAM_IMAGE_MIN_HEAP_BLOCK = 64 * 1024;
+
+// Token stream record types, each followed by its fields:
+//   BLOCK  style (u8), source offset (u32)          start a new text block
+//   FLUSH  source offset (u32)                      close the block and start a paragraph-aligned one
+//   WORD   font style (u8), length (u16), bytes     append a word to the current block
+//   IMAGE  source offset (u32), width (u16), height (u16), BMP path (string)
+//   ANCHOR id hash (u64)                            resolved to the page of the next line or image
+//   END                                             marks a complete stream
+enum TokenType : uint8_t { TOKEN_END = 0, TOKEN_BLOCK, TOKEN_FLUSH, TOKEN_WORD, TOKEN_IMAGE, TOKEN_ANCHOR };
+
 const char* BLOCK_TAGS[] = {"p", "li", "div", "br", "blockquote"};
 constexpr int NUM_BLOCK_TAGS = sizeof(BLOCK_TAGS) / sizeof(BLOCK_TAGS[0]);
 
@@ -73,28 +93,144 @@ void ChapterHtmlSlimParser::flushPartWordBuffer() {
   }
   // flush the buffer
   partWordBuffer[partWordBufferIndex] = '\0';
-  currentTextBlock->addWord(partWordBuffer, fontStyle);
+  addWordToBlock(partWordBuffer, fontStyle);
   partWordBufferIndex = 0;
 }
 
+void ChapterHtmlSlimParser::addWordToBlock(std::string word, const EpdFontFamily::Style fontStyle) {
+  if (tokenWriter) {
+    const uint16_t length = static_cast<uint16_t>(std::min(word.size(), static_cast<size_t>(UINT16_MAX)));
+    serialization::writePod(*tokenWriter, static_cast<uint8_t>(TOKEN_WORD));
+    serialization::writePod(*tokenWriter, static_cast<uint8_t>(fontStyle));
+    serialization::writePod(*tokenWriter, length);
+    tokenWriter->write(word.data(), length);
+  }
+
+  if (!currentTextBlock) {
+    currentTextBlock.reset(new ParsedText((TextBlock::Style)paragraphAlignment, extraParagraphSpacing,
+                                          hyphenationEnabled));
+  }
+  currentTextBlock->addWord(std::move(word), fontStyle);
+
+  // If we have > 750 words buffered up, perform the layout and consume out all but the last line
+  // There should be enough here to build out 1-2 full pages and doing this will free up a lot of
+  // memory.
+  // Spotted when reading Intermezzo, there are some really long text blocks in there.
+  // Very long words can fill the block's text buffer first, so it is also laid out at LAYOUT_TEXT_SIZE.
+  if (currentTextBlock->size() > 750 || currentTextBlock->getTextSize() > ParsedText::LAYOUT_TEXT_SIZE) {
+    Serial.printf("[%lu] [EHP] Text block too long, splitting into multiple pages\n", millis());
+    currentTextBlock->layoutAndExtractLines(
+        renderer, fontId, viewportWidth,
+        [this](const std::shared_ptr<TextBlock>& textBlock) { addLineToPage(textBlock); }, false);
+  }
+}
+
+void ChapterHtmlSlimParser::completePage() {
+  // A page without lines or images (can't normally happen) shares the previous page's position
+  if (!pageStartSet && !pageStarts.empty()) {
+    pageStart = pageStarts.back();
+  }
+  pageStarts.push_back(pageStart);
+  pageStartSet = false;
+  completePageFn(currentPage->finish());
+  currentPage.reset();
+  completedPages++;
+}
+
+void ChapterHtmlSlimParser::stop() {
+  stopRequested = true;
+  if (xmlParser) {
+    XML_StopParser(xmlParser, XML_FALSE);
+  }
+}
+
+uint32_t ChapterHtmlSlimParser::currentSourceOffset() const {
+  if (!xmlParser) {
+    return replaySourceOffset;
+  }
+  const int64_t offset = static_cast<int64_t>(XML_GetCurrentByteIndex(xmlParser)) + sourceOffsetShift;
+  return offset > 0 ? static_cast<uint32_t>(offset) : 0;
+}
+
+void ChapterHtmlSlimParser::notePageStart(const SourcePosition position) {
+  if (!pageStartSet) {
+    pageStart = position;
+    pageStartSet = true;
+  }
+}
+
+void ChapterHtmlSlimParser::addPendingAnchor(const char* tagName, const char* id) {
+  // A block element's id belongs to its own first line, so push out whatever text the previous block still holds
+  // before the anchor can be resolved against it
+  const bool startsBlock = matches(tagName, BLOCK_TAGS, NUM_BLOCK_TAGS) ||
+                           matches(tagName, HEADER_TAGS, NUM_HEADER_TAGS) || strcmp(tagName, "table") == 0;
+  if (startsBlock && currentTextBlock) {
+    if (partWordBufferIndex > 0) {
+      flushPartWordBuffer();
+    }
+    startNewTextBlock(currentBlockStyle);
+  }
+  queueAnchor(ZipFile::fnvHash64(id, strlen(id)));
+}
+
+void ChapterHtmlSlimParser::queueAnchor(const uint64_t hash) {
+  if (tokenWriter) {
+    serialization::writePod(*tokenWriter, static_cast<uint8_t>(TOKEN_ANCHOR));
+    serialization::writePod(*tokenWriter, hash);
+  }
+  pendingAnchors.push_back(hash);
+}
+
+void ChapterHtmlSlimParser::resolvePendingAnchors(const uint16_t page) {
+  for (const uint64_t hash : pendingAnchors) {
+    anchors.push_back({hash, page});
+  }
+  pendingAnchors.clear();
+}
+
 // start a new text block if needed
-void ChapterHtmlSlimParser::startNewTextBlock(const TextBlock::Style style) {
-  if (currentTextBlock) {
+void ChapterHtmlSlimParser::startNewTextBlock(const uint8_t blockStyle) {
+  const uint32_t sourceOffset = currentSourceOffset();
+  const uint32_t tokenPosition = tokenWriter ? tokenWriter->position() : 0;
+  if (tokenWriter) {
+    serialization::writePod(*tokenWriter, static_cast<uint8_t>(TOKEN_BLOCK));
+    serialization::writePod(*tokenWriter, blockStyle);
+    serialization::writePod(*tokenWriter, sourceOffset);
+  }
+
+  currentBlockStyle = blockStyle;
+  const auto style = static_cast<TextBlock::Style>(blockStyle == PARAGRAPH_STYLE ? paragraphAlignment : blockStyle);
+  if (currentTextBlock && currentTextBlock->isEmpty()) {
     // already have a text block running and it is empty - just reuse it
-    if (currentTextBlock->isEmpty()) {
-      currentTextBlock->setStyle(style);
-      return;
+    currentTextBlock->setStyle(style);
+  } else {
+    if (currentTextBlock) {
+      makePages();
     }
-
-    makePages();
+    currentTextBlock.reset(new ParsedText(style, extraParagraphSpacing, hyphenationEnabled));
+  }
+  blockSourceOffset = sourceOffset;
+
+  // Everything before this element's start tag is laid out and the new block is still empty, which makes this a
+  // point parsing can be resumed from. Only taken while parsing XHTML, replaying tokens is quick anyway.
+  if (checkpointFn && xmlParser && completedPages >= lastCheckpointPages + checkpointPageInterval) {
+    checkpointTokenPosition = tokenPosition;
+    lastCheckpointPages = completedPages;
+    checkpointFn();
   }
-  currentTextBlock.reset(new ParsedText(style, extraParagraphSpacing, hyphenationEnabled));
 }
 
 void ChapterHtmlSlimParser::flushCurrentTextBlock() {
+  if (tokenWriter) {
+    serialization::writePod(*tokenWriter, static_cast<uint8_t>(TOKEN_FLUSH));
+    serialization::writePod(*tokenWriter, currentSourceOffset());
+  }
+
+  currentBlockStyle = PARAGRAPH_STYLE;
   if (!currentTextBlock) {
     currentTextBlock.reset(new ParsedText((TextBlock::Style)paragraphAlignment, extraParagraphSpacing,
                                           hyphenationEnabled));
+    blockSourceOffset = currentSourceOffset();
     return;
   }
 
@@ -103,11 +239,21 @@ void ChapterHtmlSlimParser::flushCurrentTextBlock() {
   }
   currentTextBlock.reset(new ParsedText((TextBlock::Style)paragraphAlignment, extraParagraphSpacing,
                                         hyphenationEnabled));
+  blockSourceOffset = currentSourceOffset();
 }
 
 void ChapterHtmlSlimParser::addImageToPage(const std::string& bmpPath, uint16_t width, uint16_t height) {
+  const uint32_t sourceOffset = currentSourceOffset();
+  if (tokenWriter) {
+    serialization::writePod(*tokenWriter, static_cast<uint8_t>(TOKEN_IMAGE));
+    serialization::writePod(*tokenWriter, sourceOffset);
+    serialization::writePod(*tokenWriter, width);
+    serialization::writePod(*tokenWriter, height);
+    serialization::writeString(*tokenWriter, bmpPath);
+  }
+
   if (!currentPage) {
-    currentPage.reset(new Page());
+    currentPage.reset(new PageCodec::Encoder());
     currentPageNextY = 0;
   }
 
@@ -125,19 +271,20 @@ void ChapterHtmlSlimParser::addImageToPage(const std::string& bmpPath, uint16_t
   }
 
   if (currentPageNextY + drawHeight > viewportHeight && currentPageNextY > 0) {
-    completePageFn(std::move(currentPage));
-    currentPage.reset(new Page());
+    completePage();
+    currentPage.reset(new PageCodec::Encoder());
     currentPageNextY = 0;
   }
+  resolvePendingAnchors(completedPages);
+  notePageStart({sourceOffset, 0});
 
   int16_t xPos = 0;
   if (drawWidth < viewportWidth) {
     xPos = static_cast<int16_t>((viewportWidth - drawWidth) / 2);
   }
 
-  currentPage->elements.push_back(
-      std::make_shared<PageImage>(bmpPath, static_cast<uint16_t>(drawWidth), static_cast<uint16_t>(drawHeight), xPos,
-                                  currentPageNextY));
+  currentPage->addImage(xPos, currentPageNextY, static_cast<uint16_t>(drawWidth), static_cast<uint16_t>(drawHeight),
+                        bmpPath);
   currentPageNextY += drawHeight;
 
   if (extraParagraphSpacing) {
@@ -197,7 +344,7 @@ bool ChapterHtmlSlimParser::convertImageToBmp(const std::string& href, std::stri
 
   if (SdMan.exists(bmpPath.c_str())) {
     FsFile bmpFile;
-    if (!SdMan.openFileForRead("EIM", bmpPath, bmpFile)) {
+    if (!FILE_CACHE.openFileForRead("EIM", bmpPath, bmpFile)) {
       return false;
     }
     Bitmap bitmap(bmpFile);
@@ -212,48 +359,62 @@ bool ChapterHtmlSlimParser::convertImageToBmp(const std::string& href, std::stri
     return true;
   }
 
+  // Short of heap the JPEG is extracted to a temp file first, as before chapters were streamed: its inflater is then
+  // gone before the decoder starts
+  const bool streamImage = ESP.getMaxAllocHeap() >= STREAM_IMAGE_MIN_HEAP_BLOCK;
   const auto tmpJpgPath = cacheDir + "/img_" + key + ".jpg";
-  if (SdMan.exists(tmpJpgPath.c_str())) {
-    SdMan.remove(tmpJpgPath.c_str());
-  }
-
-  FsFile tmpJpg;
-  if (!SdMan.openFileForWrite("EIM", tmpJpgPath, tmpJpg)) {
-    return false;
+  ZipFile::EntryReader jpgEntry;
+  FsFile jpgFile;
+  if (streamImage) {
+    if (!epub->openItemContents(href, jpgEntry)) {
+      return false;
+    }
+  } else {
+    Serial.printf("[%lu] [EHP] Low on heap (%u byte block), extracting %s before converting it\n", millis(),
+                  static_cast<unsigned>(ESP.getMaxAllocHeap()), href.c_str());
+    if (!SdMan.openFileForWrite("EIM", tmpJpgPath, jpgFile)) {
+      return false;
+    }
+    const bool extracted = epub->readItemContentsToStream(href, jpgFile, 1024);
+    jpgFile.close();
+    if (!extracted || !SdMan.openFileForRead("EIM", tmpJpgPath, jpgFile)) {
+      SdMan.remove(tmpJpgPath.c_str());
+      return false;
+    }
   }
 
-  bool ok = epub->readItemContentsToStream(href, tmpJpg, 1024);
-  tmpJpg.close();
-  if (!ok) {
-    SdMan.remove(tmpJpgPath.c_str());
+  FsFile bmpFile;
+  if (!FILE_CACHE.openFileForWrite("EIM", bmpPath, bmpFile)) {
+    if (!streamImage) {
+      jpgFile.close();
+      SdMan.remove(tmpJpgPath.c_str());
+    }
     return false;
   }
 
-  FsFile jpgFile;
-  if (!SdMan.openFileForRead("EIM", tmpJpgPath, jpgFile)) {
-    SdMan.remove(tmpJpgPath.c_str());
-    return false;
+  bool ok;
+  {
+    // Rows go out in whole blocks to a contiguous file, so the BMP also reads back with multi-sector transfers
+    BufferedFsWriter bmpWriter(bmpFile);
+    ok = (streamImage
+              ? JpegToBmpConverter::jpegFileToBmpStreamWithSize(jpgEntry, bmpWriter, viewportWidth, viewportHeight)
+              : JpegToBmpConverter::jpegFileToBmpStreamWithSize(jpgFile, bmpWriter, viewportWidth, viewportHeight)) &&
+         bmpWriter.finish();
   }
-
-  FsFile bmpFile;
-  if (!SdMan.openFileForWrite("EIM", bmpPath, bmpFile)) {
+  jpgEntry.close();
+  bmpFile.close();
+  if (!streamImage) {
     jpgFile.close();
     SdMan.remove(tmpJpgPath.c_str());
-    return false;
   }
 
-  ok = JpegToBmpConverter::jpegFileToBmpStreamWithSize(jpgFile, bmpFile, viewportWidth, viewportHeight);
-  jpgFile.close();
-  bmpFile.close();
-  SdMan.remove(tmpJpgPath.c_str());
-
   if (!ok) {
-    SdMan.remove(bmpPath.c_str());
+    FILE_CACHE.remove(bmpPath.c_str());
     return false;
   }
 
   FsFile bmpRead;
-  if (!SdMan.openFileForRead("EIM", bmpPath, bmpRead)) {
+  if (!FILE_CACHE.openFileForRead("EIM", bmpPath, bmpRead)) {
     return false;
   }
   Bitmap bitmap(bmpRead);
@@ -292,12 +453,30 @@ bool ChapterHtmlSlimParser::handleImageTag(const std::string& src, const std::st
 void XMLCALL ChapterHtmlSlimParser::startElement(void* userData, const XML_Char* name, const XML_Char** atts) {
   auto* self = static_cast<ChapterHtmlSlimParser*>(userData);
 
+  if (self->checkpointFn) {
+    if (self->openElementNames.empty()) {
+      self->prologEnd = self->currentSourceOffset();
+    }
+    self->openElementNames += name;
+    self->openElementNames += ' ';
+  }
+
   // Middle of skip
   if (self->skipUntilDepth < self->depth) {
     self->depth += 1;
     return;
   }
 
+  // Element ids become anchors, resolved to a page once the next line or image is placed
+  if (atts != nullptr) {
+    for (int i = 0; atts[i]; i += 2) {
+      if (strcmp(atts[i], "id") == 0 && atts[i + 1][0] != '\0') {
+        self->addPendingAnchor(name, atts[i + 1]);
+        break;
+      }
+    }
+  }
+
   // Special handling for tables - show placeholder text instead of dropping silently
   if (strcmp(name, "table") == 0) {
     // Add placeholder text
@@ -332,14 +511,10 @@ void XMLCALL ChapterHtmlSlimParser::startElement(void* userData, const XML_Char*
     if (!handled) {
       const std::string altText = alt.empty() ? "[Image]" : "[Image: " + alt + "]";
       Serial.printf("[%lu] [EHP] Image fallback: %s\n", millis(), altText.c_str());
-      if (!self->currentTextBlock) {
-        self->currentTextBlock.reset(new ParsedText((TextBlock::Style)self->paragraphAlignment,
-                                                    self->extraParagraphSpacing, self->hyphenationEnabled));
-      }
       if (self->partWordBufferIndex > 0) {
         self->flushPartWordBuffer();
       }
-      self->currentTextBlock->addWord(altText, EpdFontFamily::ITALIC);
+      self->addWordToBlock(altText, EpdFontFamily::ITALIC);
       self->depth += 1;
       return;
     }
@@ -380,14 +555,14 @@ void XMLCALL ChapterHtmlSlimParser::startElement(void* userData, const XML_Char*
         // flush word preceding <br/> to currentTextBlock before calling startNewTextBlock
         self->flushPartWordBuffer();
       }
-      self->startNewTextBlock(self->currentTextBlock->getStyle());
+      self->startNewTextBlock(self->currentBlockStyle);
       self->depth += 1;
       return;
     }
 
-    self->startNewTextBlock(static_cast<TextBlock::Style>(self->paragraphAlignment));
+    self->startNewTextBlock(PARAGRAPH_STYLE);
     if (strcmp(name, "li") == 0) {
-      self->currentTextBlock->addWord("\xe2\x80\xa2", EpdFontFamily::REGULAR);
+      self->addWordToBlock("\xe2\x80\xa2", EpdFontFamily::REGULAR);
     }
 
     self->depth += 1;
@@ -449,22 +624,16 @@ void XMLCALL ChapterHtmlSlimParser::characterData(void* userData, const XML_Char
 
     self->partWordBuffer[self->partWordBufferIndex++] = s[i];
   }
-
-  // If we have > 750 words buffered up, perform the layout and consume out all but the last line
-  // There should be enough here to build out 1-2 full pages and doing this will free up a lot of
-  // memory.
-  // Spotted when reading Intermezzo, there are some really long text blocks in there.
-  if (self->currentTextBlock->size() > 750) {
-    Serial.printf("[%lu] [EHP] Text block too long, splitting into multiple pages\n", millis());
-    self->currentTextBlock->layoutAndExtractLines(
-        self->renderer, self->fontId, self->viewportWidth,
-        [self](const std::shared_ptr<TextBlock>& textBlock) { self->addLineToPage(textBlock); }, false);
-  }
 }
 
 void XMLCALL ChapterHtmlSlimParser::endElement(void* userData, const XML_Char* name) {
   auto* self = static_cast<ChapterHtmlSlimParser*>(userData);
 
+  if (self->checkpointFn && !self->openElementNames.empty()) {
+    const size_t previousEnd = self->openElementNames.rfind(' ', self->openElementNames.size() - 2);
+    self->openElementNames.resize(previousEnd == std::string::npos ? 0 : previousEnd + 1);
+  }
+
   if (self->partWordBufferIndex > 0) {
     // Only flush out part word buffer if we're closing a block tag or are at the top of the HTML file.
     // We don't want to flush out content when closing inline tags like <span>.
@@ -499,7 +668,9 @@ void XMLCALL ChapterHtmlSlimParser::endElement(void* userData, const XML_Char* n
 }
 
 bool ChapterHtmlSlimParser::parseAndBuildPages() {
-  startNewTextBlock((TextBlock::Style)this->paragraphAlignment);
+  if (!resuming) {
+    startNewTextBlock(PARAGRAPH_STYLE);
+  }
 
   const XML_Parser parser = XML_ParserCreate(nullptr);
   int done;
@@ -509,66 +680,80 @@ bool ChapterHtmlSlimParser::parseAndBuildPages() {
     return false;
   }
 
-  FsFile file;
-  if (!SdMan.openFileForRead("EHP", filepath, file)) {
+  ZipFile::EntryReader reader;
+  if (!epub->openItemContents(itemHref, reader, PARSE_BUFFER_SIZE)) {
+    Serial.printf("[%lu] [EHP] Could not open %s\n", millis(), itemHref.c_str());
     XML_ParserFree(parser);
     return false;
   }
 
-  // Get file size for progress calculation
-  const size_t totalSize = file.size();
-  size_t bytesRead = 0;
+  // Get inflated size for progress calculation
+  const size_t totalSize = reader.size();
   int lastProgress = -1;
 
+  if (checkpointFn) {
+    reader.enableCheckpoints(inflateCheckpointPath);
+  }
+  if (resuming && !feedResumePrefix(parser, reader)) {
+    Serial.printf("[%lu] [EHP] Could not resume %s at offset %lu\n", millis(), itemHref.c_str(),
+                  static_cast<unsigned long>(resumeOffset));
+    XML_ParserFree(parser);
+    return false;
+  }
+
+  xmlParser = parser;
   XML_SetUserData(parser, this);
   XML_SetElementHandler(parser, startElement, endElement);
   XML_SetCharacterDataHandler(parser, characterData);
 
   do {
-    void* const buf = XML_GetBuffer(parser, 1024);
+    void* const buf = XML_GetBuffer(parser, PARSE_BUFFER_SIZE);
     if (!buf) {
       Serial.printf("[%lu] [EHP] Couldn't allocate memory for buffer\n", millis());
       XML_StopParser(parser, XML_FALSE);                // Stop any pending processing
       XML_SetElementHandler(parser, nullptr, nullptr);  // Clear callbacks
       XML_SetCharacterDataHandler(parser, nullptr);
       XML_ParserFree(parser);
-      file.close();
+      xmlParser = nullptr;
       return false;
     }
 
-    const size_t len = file.read(buf, 1024);
+    const int len = reader.read(buf, PARSE_BUFFER_SIZE);
 
-    if (len == 0 && file.available() > 0) {
+    if (len < 0 || (len == 0 && reader.available() > 0)) {
       Serial.printf("[%lu] [EHP] File read error\n", millis());
       XML_StopParser(parser, XML_FALSE);                // Stop any pending processing
       XML_SetElementHandler(parser, nullptr, nullptr);  // Clear callbacks
       XML_SetCharacterDataHandler(parser, nullptr);
       XML_ParserFree(parser);
-      file.close();
+      xmlParser = nullptr;
       return false;
     }
 
     // Update progress (call every 10% change to avoid too frequent updates)
     // Only show progress for larger chapters where rendering overhead is worth it
-    bytesRead += len;
     if (progressFn && totalSize >= MIN_SIZE_FOR_PROGRESS) {
-      const int progress = static_cast<int>((bytesRead * 100) / totalSize);
+      const int progress = static_cast<int>((reader.position() * 100) / totalSize);
       if (lastProgress / 10 != progress / 10) {
         lastProgress = progress;
         progressFn(progress);
       }
     }
 
-    done = file.available() == 0;
+    done = reader.available() == 0;
 
-    if (XML_ParseBuffer(parser, static_cast<int>(len), done) == XML_STATUS_ERROR) {
-      Serial.printf("[%lu] [EHP] Parse error at line %lu:\n%s\n", millis(), XML_GetCurrentLineNumber(parser),
-                    XML_ErrorString(XML_GetErrorCode(parser)));
+    if (XML_ParseBuffer(parser, len, done) == XML_STATUS_ERROR) {
+      if (stopRequested) {
+        Serial.printf("[%lu] [EHP] Parsing of %s stopped\n", millis(), itemHref.c_str());
+      } else {
+        Serial.printf("[%lu] [EHP] Parse error at line %lu:\n%s\n", millis(), XML_GetCurrentLineNumber(parser),
+                      XML_ErrorString(XML_GetErrorCode(parser)));
+      }
       XML_StopParser(parser, XML_FALSE);                // Stop any pending processing
       XML_SetElementHandler(parser, nullptr, nullptr);  // Clear callbacks
       XML_SetCharacterDataHandler(parser, nullptr);
       XML_ParserFree(parser);
-      file.close();
+      xmlParser = nullptr;
       return false;
     }
   } while (!done);
@@ -577,29 +762,286 @@ bool ChapterHtmlSlimParser::parseAndBuildPages() {
   XML_SetElementHandler(parser, nullptr, nullptr);  // Clear callbacks
   XML_SetCharacterDataHandler(parser, nullptr);
   XML_ParserFree(parser);
-  file.close();
+  xmlParser = nullptr;
+  reader.close();
+
+  finishPages();
+
+  if (tokenWriter) {
+    // The version only goes in once the stream is complete, so an interrupted recording is never replayed
+    serialization::writePod(*tokenWriter, static_cast<uint8_t>(TOKEN_END));
+    tokenWriter->seek(tokenStart);
+    serialization::writePod(*tokenWriter, TOKEN_FILE_VERSION);
+    tokenWriter = nullptr;
+  }
+
+  return true;
+}
 
+void ChapterHtmlSlimParser::finishPages() {
   // Process last page if there is still text
   if (currentTextBlock) {
     makePages();
-    completePageFn(std::move(currentPage));
+    completePage();
     currentPage.reset();
     currentTextBlock.reset();
   }
 
+  // Ids after the last line (e.g. trailing empty elements) point at the last page
+  resolvePendingAnchors(completedPages > 0 ? completedPages - 1 : 0);
+}
+
+void ChapterHtmlSlimParser::recordTokens(BufferedFsWriter* writer) {
+  tokenWriter = writer;
+  if (resuming) {
+    // Continuing a stream that starts at the beginning of the token file, positioned at the checkpoint
+    tokenStart = 0;
+    return;
+  }
+  tokenStart = writer->position();
+  serialization::writePod(*tokenWriter, static_cast<uint8_t>(0));  // Placeholder for the version
+}
+
+void ChapterHtmlSlimParser::setCheckpointCallback(const std::function<void()>& checkpointFn,
+                                                  const uint16_t pageInterval,
+                                                  const std::string& inflateCheckpointPath) {
+  this->checkpointFn = checkpointFn;
+  checkpointPageInterval = pageInterval;
+  this->inflateCheckpointPath = inflateCheckpointPath;
+}
+
+bool ChapterHtmlSlimParser::writeCheckpoint(BufferedFsWriter& writer) const {
+  // The element whose start tag is being handled is parsed again on resume, so it is not part of the open stack
+  std::string openElements = openElementNames;
+  if (!openElements.empty()) {
+    const size_t previousEnd = openElements.rfind(' ', openElements.size() - 2);
+    openElements.resize(previousEnd == std::string::npos ? 0 : previousEnd + 1);
+  }
+
+  serialization::writePod(writer, currentSourceOffset());
+  serialization::writePod(writer, prologEnd);
+  serialization::writeString(writer, openElements);
+  serialization::writePod(writer, depth);
+  serialization::writePod(writer, skipUntilDepth);
+  serialization::writePod(writer, boldUntilDepth);
+  serialization::writePod(writer, italicUntilDepth);
+  serialization::writePod(writer, currentBlockStyle);
+  serialization::writeString(writer, std::string(partWordBuffer, partWordBufferIndex));
+  serialization::writePod(writer, checkpointTokenPosition);
+
+  serialization::writePod(writer, completedPages);
+  serialization::writePod(writer, currentPageNextY);
+  serialization::writePod(writer, pageStart.offset);
+  serialization::writePod(writer, pageStart.wordIndex);
+  serialization::writePod(writer, pageStartSet);
+  const bool hasPage = currentPage != nullptr;
+  serialization::writePod(writer, hasPage);
+  if (hasPage && !Page::serialize(writer, currentPage->finish())) {
+    return false;
+  }
+
+  serialization::writePod(writer, static_cast<uint32_t>(pageStarts.size()));
+  for (const auto& start : pageStarts) {
+    serialization::writePod(writer, start.offset);
+    serialization::writePod(writer, start.wordIndex);
+  }
+  serialization::writePod(writer, static_cast<uint32_t>(anchors.size()));
+  for (const auto& anchor : anchors) {
+    serialization::writePod(writer, anchor.hash);
+    serialization::writePod(writer, anchor.page);
+  }
+  serialization::writePod(writer, static_cast<uint32_t>(pendingAnchors.size()));
+  for (const uint64_t hash : pendingAnchors) {
+    serialization::writePod(writer, hash);
+  }
+  return !writer.hasError();
+}
+
+bool ChapterHtmlSlimParser::readCheckpoint(BufferedFsReader& reader) {
+  std::string partWord;
+  serialization::readPod(reader, resumeOffset);
+  serialization::readPod(reader, prologEnd);
+  serialization::readString(reader, openElementNames);
+  serialization::readPod(reader, depth);
+  serialization::readPod(reader, skipUntilDepth);
+  serialization::readPod(reader, boldUntilDepth);
+  serialization::readPod(reader, italicUntilDepth);
+  serialization::readPod(reader, currentBlockStyle);
+  serialization::readString(reader, partWord);
+  serialization::readPod(reader, checkpointTokenPosition);
+  if (partWord.size() > MAX_WORD_SIZE || prologEnd > resumeOffset) {
+    return false;
+  }
+  memcpy(partWordBuffer, partWord.data(), partWord.size());
+  partWordBufferIndex = static_cast<int>(partWord.size());
+
+  bool hasPage;
+  serialization::readPod(reader, completedPages);
+  serialization::readPod(reader, currentPageNextY);
+  serialization::readPod(reader, pageStart.offset);
+  serialization::readPod(reader, pageStart.wordIndex);
+  serialization::readPod(reader, pageStartSet);
+  serialization::readPod(reader, hasPage);
+  currentPage.reset();
+  if (hasPage) {
+    std::vector<uint8_t> record;
+    currentPage.reset(new PageCodec::Encoder());
+    if (!Page::readRecord(reader, record) || !currentPage->append(record.data(), record.size())) {
+      return false;
+    }
+  }
+
+  uint32_t count;
+  serialization::readPod(reader, count);
+  if (count != completedPages) {
+    return false;
+  }
+  pageStarts.resize(count);
+  for (auto& start : pageStarts) {
+    serialization::readPod(reader, start.offset);
+    serialization::readPod(reader, start.wordIndex);
+  }
+  serialization::readPod(reader, count);
+  anchors.resize(count);
+  for (auto& anchor : anchors) {
+    serialization::readPod(reader, anchor.hash);
+    serialization::readPod(reader, anchor.page);
+  }
+  serialization::readPod(reader, count);
+  pendingAnchors.resize(count);
+  for (auto& hash : pendingAnchors) {
+    serialization::readPod(reader, hash);
+  }
+  // The block started at the checkpoint was still empty, its start tag recreates it with the same style
+  const auto style = static_cast<TextBlock::Style>(
+      currentBlockStyle == PARAGRAPH_STYLE ? paragraphAlignment : currentBlockStyle);
+  currentTextBlock.reset(new ParsedText(style, extraParagraphSpacing, hyphenationEnabled));
+  blockSourceOffset = resumeOffset;
+  lastCheckpointPages = completedPages;
+  resuming = true;
   return true;
 }
 
+bool ChapterHtmlSlimParser::feedResumePrefix(XML_Parser parser, ZipFile::EntryReader& reader) {
+  // Expat can't be restored from a snapshot, so it is brought to the same nesting instead: the original prolog (for
+  // the doctype and its entities) followed by bare start tags for every element open at the checkpoint
+  std::string prefix(prologEnd, '\0');
+  for (size_t filled = 0; filled < prefix.size();) {
+    const int len = reader.read(&prefix[filled], prefix.size() - filled);
+    if (len <= 0) {
+      return false;
+    }
+    filled += len;
+  }
+  size_t nameStart = 0;
+  for (size_t i = 0; i < openElementNames.size(); i++) {
+    if (openElementNames[i] == ' ') {
+      prefix += '<';
+      prefix.append(openElementNames, nameStart, i - nameStart);
+      prefix += '>';
+      nameStart = i + 1;
+    }
+  }
+
+  if (XML_Parse(parser, prefix.data(), static_cast<int>(prefix.size()), XML_FALSE) == XML_STATUS_ERROR) {
+    return false;
+  }
+  sourceOffsetShift = static_cast<int64_t>(resumeOffset) - static_cast<int64_t>(prefix.size());
+  return reader.seek(resumeOffset);
+}
+
+bool ChapterHtmlSlimParser::replayTokens(BufferedFsReader& reader) {
+  uint8_t version = 0;
+  serialization::readPod(reader, version);
+  if (version != TOKEN_FILE_VERSION) {
+    Serial.printf("[%lu] [EHP] Token stream version %u not supported\n", millis(), version);
+    return false;
+  }
+
+  const uint32_t totalSize = reader.size();
+  int lastProgress = -1;
+  std::string text;
+  while (!stopRequested) {
+    uint8_t type;
+    if (reader.read(&type, sizeof(type)) != sizeof(type)) {
+      Serial.printf("[%lu] [EHP] Token stream truncated\n", millis());
+      return false;
+    }
+
+    switch (type) {
+      case TOKEN_END:
+        finishPages();
+        return true;
+      case TOKEN_BLOCK: {
+        uint8_t blockStyle;
+        serialization::readPod(reader, blockStyle);
+        serialization::readPod(reader, replaySourceOffset);
+        startNewTextBlock(blockStyle);
+        break;
+      }
+      case TOKEN_FLUSH:
+        serialization::readPod(reader, replaySourceOffset);
+        flushCurrentTextBlock();
+        break;
+      case TOKEN_WORD: {
+        uint8_t fontStyle;
+        uint16_t length;
+        serialization::readPod(reader, fontStyle);
+        serialization::readPod(reader, length);
+        text.resize(length);
+        if (reader.read(&text[0], length) != length) {
+          Serial.printf("[%lu] [EHP] Token stream truncated\n", millis());
+          return false;
+        }
+        addWordToBlock(text, static_cast<EpdFontFamily::Style>(fontStyle));
+        break;
+      }
+      case TOKEN_IMAGE: {
+        uint16_t width;
+        uint16_t height;
+        serialization::readPod(reader, replaySourceOffset);
+        serialization::readPod(reader, width);
+        serialization::readPod(reader, height);
+        serialization::readString(reader, text);
+        addImageToPage(text, width, height);
+        break;
+      }
+      case TOKEN_ANCHOR: {
+        uint64_t hash;
+        serialization::readPod(reader, hash);
+        queueAnchor(hash);
+        break;
+      }
+      default:
+        Serial.printf("[%lu] [EHP] Unknown token %u in token stream\n", millis(), type);
+        return false;
+    }
+
+    if (progressFn && totalSize >= MIN_SIZE_FOR_PROGRESS) {
+      const int progress = static_cast<int>((static_cast<uint64_t>(reader.position()) * 100) / totalSize);
+      if (lastProgress / 10 != progress / 10) {
+        lastProgress = progress;
+        progressFn(progress);
+      }
+    }
+  }
+
+  Serial.printf("[%lu] [EHP] Token replay of %s stopped\n", millis(), itemHref.c_str());
+  return false;
+}
+
 void ChapterHtmlSlimParser::addLineToPage(std::shared_ptr<TextBlock> line) {
   const int lineHeight = renderer.getLineHeight(fontId) * lineCompression;
 
   if (currentPageNextY + lineHeight > viewportHeight) {
-    completePageFn(std::move(currentPage));
-    currentPage.reset(new Page());
+    completePage();
+    currentPage.reset(new PageCodec::Encoder());
     currentPageNextY = 0;
   }
+  resolvePendingAnchors(completedPages);
+  notePageStart({blockSourceOffset, currentTextBlock ? currentTextBlock->getLineStartWordIndex() : uint16_t(0)});
 
-  currentPage->elements.push_back(std::make_shared<PageLine>(line, 0, currentPageNextY));
+  line->encode(*currentPage, 0, currentPageNextY);
   currentPageNextY += lineHeight;
 }
 
@@ -610,7 +1052,7 @@ void ChapterHtmlSlimParser::makePages() {
   }
 
   if (!currentPage) {
-    currentPage.reset(new Page());
+    currentPage.reset(new PageCodec::Encoder());
     currentPageNextY = 0;
   }
 
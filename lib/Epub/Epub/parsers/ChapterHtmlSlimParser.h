@@ -1,26 +1,48 @@
 #pragma once
 
+#include <ZipFile.h>
 #include <expat.h>
 
 #include <climits>
 #include <functional>
 #include <memory>
+#include <vector>
 
+#include "../PageCodec.h"
 #include "../ParsedText.h"
+#include "../SourcePosition.h"
 #include "../blocks/TextBlock.h"
 
-class Page;
+class BufferedFsReader;
+class BufferedFsWriter;
 class GfxRenderer;
 class Epub;
 
 #define MAX_WORD_SIZE 200
 
+/**
+ * Turns a spine item into pages. Parsing is split from layout by a layout-independent token stream (block starts,
+ * words with their style, images, anchors): the expat callbacks produce tokens, layout consumes them. The stream can be
+ * recorded while parsing and replayed later, so re-paginating a chapter after a font, spacing or viewport change only
+ * runs line breaking instead of inflating and parsing the XHTML again.
+ */
 class ChapterHtmlSlimParser {
-  const std::string& filepath;
+ public:
+  // Bump when the token stream changes, cached streams of other versions are rebuilt from the source
+  static constexpr uint8_t TOKEN_FILE_VERSION = 1;
+
+  // Element id (FNV-1a 64-bit hash) and the page its first line or image was placed on
+  struct Anchor {
+    uint64_t hash;
+    uint16_t page;
+  };
+
+ private:
   std::shared_ptr<Epub> epub;
   std::string itemHref;
   GfxRenderer& renderer;
-  std::function<void(std::unique_ptr<Page>)> completePageFn;
+  // Receives each finished page as a PageCodec record
+  std::function<void(const std::vector<uint8_t>& page)> completePageFn;
   std::function<void(int)> progressFn;  // Progress callback (0-100)
   int depth = 0;
   int skipUntilDepth = INT_MAX;
@@ -31,8 +53,45 @@ class ChapterHtmlSlimParser {
   char partWordBuffer[MAX_WORD_SIZE + 1] = {};
   int partWordBufferIndex = 0;
   std::unique_ptr<ParsedText> currentTextBlock = nullptr;
-  std::unique_ptr<Page> currentPage = nullptr;
+  std::unique_ptr<PageCodec::Encoder> currentPage = nullptr;
   int16_t currentPageNextY = 0;
+  // Pages handed to completePageFn so far, i.e. the index of currentPage
+  uint16_t completedPages = 0;
+  // Ids seen since the last line or image was placed
+  std::vector<uint64_t> pendingAnchors;
+  std::vector<Anchor> anchors;
+  XML_Parser xmlParser = nullptr;
+  // Source offset of the element currently feeding currentTextBlock
+  uint32_t blockSourceOffset = 0;
+  // Where the first line or image on currentPage came from, one entry per completed page
+  SourcePosition pageStart = {0, 0};
+  bool pageStartSet = false;
+  std::vector<SourcePosition> pageStarts;
+  // Block style token standing for the configured paragraph alignment, so recorded tokens don't bake in the setting
+  static constexpr uint8_t PARAGRAPH_STYLE = 0xFF;
+  uint8_t currentBlockStyle = PARAGRAPH_STYLE;
+  BufferedFsWriter* tokenWriter = nullptr;
+  uint32_t tokenStart = 0;
+  // Source offset carried by the token being replayed, stands in for the expat byte index
+  uint32_t replaySourceOffset = 0;
+  // Build checkpoints, see setCheckpointCallback
+  std::function<void()> checkpointFn;
+  uint16_t checkpointPageInterval = 0;
+  uint16_t lastCheckpointPages = 0;
+  std::string inflateCheckpointPath;
+  // Token stream position before the block start the last checkpoint was taken at
+  uint32_t checkpointTokenPosition = 0;
+  // Names of the elements open in the source, space separated, replayed as bare start tags when resuming
+  std::string openElementNames;
+  // Source offset of the root element, the prolog before it (XML declaration, doctype) is replayed verbatim
+  uint32_t prologEnd = 0;
+  // Set by readCheckpoint: parsing continues at resumeOffset behind a synthetic prefix instead of at the start
+  bool resuming = false;
+  // Set by stop(), parsing or replay ends at the next opportunity and reports failure
+  bool stopRequested = false;
+  uint32_t resumeOffset = 0;
+  // Difference between source offsets and expat byte indices once a resume prefix has been fed
+  int64_t sourceOffsetShift = 0;
   int fontId;
   float lineCompression;
   bool extraParagraphSpacing;
@@ -41,9 +100,19 @@ class ChapterHtmlSlimParser {
   uint16_t viewportHeight;
   bool hyphenationEnabled;
 
-  void startNewTextBlock(TextBlock::Style style);
+  void completePage();
+  void addPendingAnchor(const char* tagName, const char* id);
+  void queueAnchor(uint64_t hash);
+  void resolvePendingAnchors(uint16_t page);
+  uint32_t currentSourceOffset() const;
+  void notePageStart(SourcePosition position);
+  // Layout primitives, each one is a token: recorded when tokenWriter is set, and what replayTokens calls back
+  void startNewTextBlock(uint8_t blockStyle);
+  void addWordToBlock(std::string word, EpdFontFamily::Style fontStyle);
   void flushPartWordBuffer();
   void makePages();
+  void finishPages();
+  bool feedResumePrefix(XML_Parser parser, ZipFile::EntryReader& reader);
   void flushCurrentTextBlock();
   void addImageToPage(const std::string& bmpPath, uint16_t width, uint16_t height);
   std::string resolveImageHref(const std::string& src) const;
@@ -56,15 +125,14 @@ class ChapterHtmlSlimParser {
   static void XMLCALL endElement(void* userData, const XML_Char* name);
 
  public:
-  explicit ChapterHtmlSlimParser(const std::string& filepath, std::shared_ptr<Epub> epub, std::string itemHref,
-                                 GfxRenderer& renderer, const int fontId,
+  explicit ChapterHtmlSlimParser(std::shared_ptr<Epub> epub, std::string itemHref, GfxRenderer& renderer,
+                                 const int fontId,
                                  const float lineCompression, const bool extraParagraphSpacing,
                                  const uint8_t paragraphAlignment, const uint16_t viewportWidth,
                                  const uint16_t viewportHeight, const bool hyphenationEnabled,
-                                 const std::function<void(std::unique_ptr<Page>)>& completePageFn,
+                                 const std::function<void(const std::vector<uint8_t>& page)>& completePageFn,
                                  const std::function<void(int)>& progressFn = nullptr)
-      : filepath(filepath),
-        epub(std::move(epub)),
+      : epub(std::move(epub)),
         itemHref(std::move(itemHref)),
         renderer(renderer),
         fontId(fontId),
@@ -78,5 +146,28 @@ class ChapterHtmlSlimParser {
         progressFn(progressFn) {}
   ~ChapterHtmlSlimParser() = default;
   bool parseAndBuildPages();
+  // Records the token stream of the next parseAndBuildPages to writer, complete once it has returned true
+  void recordTokens(BufferedFsWriter* writer);
+  // Builds pages from a stream recorded by recordTokens instead of parsing the XHTML. Returns false (with some pages
+  // possibly already handed out) if the stream is stale or truncated.
+  bool replayTokens(BufferedFsReader& reader);
+  // While parsing, calls checkpointFn at a block start once at least pageInterval pages were completed since the last
+  // call. The callback persists its own state plus writeCheckpoint's. Inflate checkpoints go to inflateCheckpointPath
+  // so a resumed parse can seek into the source cheaply.
+  void setCheckpointCallback(const std::function<void()>& checkpointFn, uint16_t pageInterval,
+                             const std::string& inflateCheckpointPath);
+  // Parser and layout state at the block start checkpointFn was called at (only valid inside the callback)
+  bool writeCheckpoint(BufferedFsWriter& writer) const;
+  // Restores a state written by writeCheckpoint, the next parseAndBuildPages continues from that block
+  bool readCheckpoint(BufferedFsReader& reader);
+  // Token stream position of the checkpoint, recorded tokens past it are to be discarded when resuming
+  uint32_t getCheckpointTokenPosition() const { return checkpointTokenPosition; }
+  // Abandons parseAndBuildPages or replayTokens from inside a callback (e.g. completePageFn), which then return false
+  void stop();
+  // Anchors in document order, complete once parseAndBuildPages has returned
+  std::vector<Anchor>& getAnchors() { return anchors; }
+  // Source position of the first line or image of each page, already holding the page's entry when completePageFn
+  // is called for it. Complete once parseAndBuildPages has returned.
+  const std::vector<SourcePosition>& getPageStarts() const { return pageStarts; }
   void addLineToPage(std::shared_ptr<TextBlock> line);
 };
@@ -0,0 +1,119 @@
+#include "FileHandleCache.h"
+
+#include <HardwareSerial.h>
+#include <SDCardManager.h>
+
+// Initialize the static instance
+FileHandleCache FileHandleCache::instance;
+
+void FileHandleCache::lock() {
+  // Created on first use, the instance is constructed before the scheduler is running
+  if (!mutex) {
+    mutex = xSemaphoreCreateMutex();
+  }
+  xSemaphoreTake(mutex, portMAX_DELAY);
+}
+
+void FileHandleCache::unlock() { xSemaphoreGive(mutex); }
+
+void FileHandleCache::closeSlot(Slot& slot) {
+  slot.file.close();
+  slot.path.clear();
+  slot.lastUsed = 0;
+}
+
+bool FileHandleCache::openFileForRead(const char* moduleName, const std::string& path, FsFile& file) {
+  lock();
+
+  // Empty slots have lastUsed 0, so they are taken before the least recently used handle is evicted
+  Slot* victim = &slots[0];
+  for (auto& slot : slots) {
+    if (slot.file && slot.path == path) {
+      file.close();
+      file = slot.file;
+      slot.lastUsed = ++useCounter;
+      stats.hits++;
+      unlock();
+      return true;
+    }
+    if (slot.lastUsed < victim->lastUsed) {
+      victim = &slot;
+    }
+  }
+
+  stats.misses++;
+  if (victim->file) {
+    stats.evictions++;
+    closeSlot(*victim);
+  }
+
+  if (!SdMan.openFileForRead(moduleName, path, victim->file)) {
+    closeSlot(*victim);
+    unlock();
+    return false;
+  }
+  victim->path = path;
+  victim->lastUsed = ++useCounter;
+  file.close();
+  file = victim->file;
+  unlock();
+  return true;
+}
+
+bool FileHandleCache::openFileForWrite(const char* moduleName, const std::string& path, FsFile& file) {
+  invalidate(path);
+  return SdMan.openFileForWrite(moduleName, path, file);
+}
+
+bool FileHandleCache::remove(const char* path) {
+  invalidate(path);
+  return SdMan.remove(path);
+}
+
+bool FileHandleCache::removeDir(const char* path) {
+  invalidateDir(path);
+  return SdMan.removeDir(path);
+}
+
+void FileHandleCache::invalidate(const std::string& path) {
+  lock();
+  for (auto& slot : slots) {
+    if (slot.file && slot.path == path) {
+      closeSlot(slot);
+      stats.invalidations++;
+    }
+  }
+  unlock();
+}
+
+void FileHandleCache::invalidateDir(const std::string& dirPath) {
+  std::string prefix = dirPath;
+  if (prefix.empty() || prefix.back() != '/') {
+    prefix += '/';
+  }
+
+  lock();
+  for (auto& slot : slots) {
+    if (slot.file && (slot.path == dirPath || slot.path.compare(0, prefix.size(), prefix) == 0)) {
+      closeSlot(slot);
+      stats.invalidations++;
+    }
+  }
+  unlock();
+}
+
+void FileHandleCache::clear() {
+  lock();
+  for (auto& slot : slots) {
+    closeSlot(slot);
+  }
+  unlock();
+}
+
+void FileHandleCache::logStats() const {
+  const uint32_t lookups = stats.hits + stats.misses;
+  Serial.printf("[%lu] [FHC] %lu hits, %lu misses (%lu%% hit rate), %lu evictions, %lu invalidations\n", millis(),
+                static_cast<unsigned long>(stats.hits), static_cast<unsigned long>(stats.misses),
+                static_cast<unsigned long>(lookups > 0 ? stats.hits * 100 / lookups : 0),
+                static_cast<unsigned long>(stats.evictions), static_cast<unsigned long>(stats.invalidations));
+}
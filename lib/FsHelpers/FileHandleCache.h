@@ -0,0 +1,75 @@
+#pragma once
+#include <SdFat.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+
+#include <cstdint>
+#include <string>
+
+/**
+ * Singleton LRU cache of read-only SD file handles, keyed by path.
+ * Opening a file walks the FAT long-file-name entries of every directory on its path, which adds up for files opened
+ * over and over (section files on every page turn, the EPUB around most zip lookups, BMPs on each render pass).
+ * A hit hands out a copy of the cached handle instead: it has its own position, so callers can seek and close it as
+ * usual without affecting the cache or each other.
+ *
+ * The cache does not see writes made through SdMan. Anything that rewrites or removes a file that may have been read
+ * through the cache must go through openFileForWrite/remove/removeDir here, or call invalidate first.
+ */
+class FileHandleCache {
+ public:
+  // Kept below the number of files open at once while parsing a chapter
+  static constexpr uint8_t MAX_HANDLES = 4;
+
+  struct Stats {
+    uint32_t hits;
+    uint32_t misses;
+    uint32_t evictions;
+    uint32_t invalidations;
+  };
+
+ private:
+  static FileHandleCache instance;
+
+  struct Slot {
+    std::string path;
+    FsFile file;
+    uint32_t lastUsed = 0;
+  };
+
+  Slot slots[MAX_HANDLES];
+  uint32_t useCounter = 0;
+  Stats stats = {0, 0, 0, 0};
+  SemaphoreHandle_t mutex = nullptr;
+
+  FileHandleCache() = default;
+
+  void lock();
+  void unlock();
+  void closeSlot(Slot& slot);
+
+ public:
+  FileHandleCache(const FileHandleCache&) = delete;
+  FileHandleCache& operator=(const FileHandleCache&) = delete;
+
+  static FileHandleCache& getInstance() { return instance; }
+
+  // Same contract as SdMan.openFileForRead, served from the cache when the path is already open
+  bool openFileForRead(const char* moduleName, const std::string& path, FsFile& file);
+  // Invalidate the path, then open it for writing through SdMan
+  bool openFileForWrite(const char* moduleName, const std::string& path, FsFile& file);
+  bool remove(const char* path);
+  bool removeDir(const char* path);
+
+  // Drop the cached handle for a path
+  void invalidate(const std::string& path);
+  // Drop every cached handle at or below a directory
+  void invalidateDir(const std::string& dirPath);
+  void clear();
+
+  Stats getStats() const { return stats; }
+  void logStats() const;
+};
+
+// Helper macro to access the file handle cache
+#define FILE_CACHE FileHandleCache::getInstance()
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <BufferedFsReader.h>
 #include <SdFat.h>
 
 #include <cstdint>
@@ -32,7 +33,7 @@ class Bitmap {
  public:
   static const char* errorToString(BmpReaderError err);
 
-  explicit Bitmap(FsFile& file, bool dithering = false) : file(file), dithering(dithering) {}
+  explicit Bitmap(FsFile& file, bool dithering = false) : file(file), reader(file), dithering(dithering) {}
   ~Bitmap();
   BmpReaderError parseHeaders();
   BmpReaderError readNextRow(uint8_t* data, uint8_t* rowBuffer) const;
@@ -46,10 +47,12 @@ class Bitmap {
   uint16_t getBpp() const { return bpp; }
 
  private:
-  static uint16_t readLE16(FsFile& f);
-  static uint32_t readLE32(FsFile& f);
+  static uint16_t readLE16(BufferedFsReader& r);
+  static uint32_t readLE32(BufferedFsReader& r);
 
   FsFile& file;
+  // Rows are much smaller than an SD block, so they are served from a block buffer (mutable for const methods)
+  mutable BufferedFsReader reader;
   bool dithering = false;
   int width = 0;
   int height = 0;
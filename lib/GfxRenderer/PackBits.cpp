@@ -0,0 +1,70 @@
+#include "PackBits.h"
+
+#include <cstring>
+
+namespace {
+constexpr size_t MAX_RUN = 128;
+// A shorter repeat costs as much as a run as it does as literals, and cutting a literal short for it adds a byte
+constexpr size_t MIN_RUN = 3;
+
+bool runStartsAt(const uint8_t* data, const size_t size, const size_t pos) {
+  return pos + MIN_RUN <= size && data[pos] == data[pos + 1] && data[pos] == data[pos + 2];
+}
+}  // namespace
+
+size_t PackBits::encode(const uint8_t* data, const size_t size, uint8_t* out) {
+  size_t written = 0;
+  size_t pos = 0;
+  while (pos < size) {
+    size_t run = 1;
+    while (pos + run < size && run < MAX_RUN && data[pos + run] == data[pos]) {
+      run++;
+    }
+    if (run >= MIN_RUN) {
+      if (out) {
+        out[written] = static_cast<uint8_t>(1 - static_cast<int>(run));
+        out[written + 1] = data[pos];
+      }
+      written += 2;
+      pos += run;
+      continue;
+    }
+
+    size_t literal = 1;
+    while (pos + literal < size && literal < MAX_RUN && !runStartsAt(data, size, pos + literal)) {
+      literal++;
+    }
+    if (out) {
+      out[written] = static_cast<uint8_t>(literal - 1);
+      memcpy(out + written + 1, data + pos, literal);
+    }
+    written += 1 + literal;
+    pos += literal;
+  }
+  return written;
+}
+
+bool PackBits::decode(const uint8_t* data, const size_t size, uint8_t* out, const size_t outSize) {
+  size_t pos = 0;
+  size_t written = 0;
+  while (pos < size) {
+    const auto control = static_cast<int8_t>(data[pos++]);
+    if (control >= 0) {
+      const size_t literal = static_cast<size_t>(control) + 1;
+      if (pos + literal > size || written + literal > outSize) {
+        return false;
+      }
+      memcpy(out + written, data + pos, literal);
+      pos += literal;
+      written += literal;
+    } else if (control != -128) {
+      const size_t run = 1 - control;
+      if (pos >= size || written + run > outSize) {
+        return false;
+      }
+      memset(out + written, data[pos++], run);
+      written += run;
+    }
+  }
+  return written == outSize;
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * PackBits run-length coding, used to keep whole frame buffers around cheaply. A control byte n in 0..127 is followed
+ * by n + 1 literal bytes, n in -127..-1 (as int8) by one byte repeated 1 - n times. The blank margins and line gaps of
+ * a 1-bit text page turn into 2 bytes per 128, so a 48KB page packs to a fraction of its size.
+ */
+namespace PackBits {
+
+// Writes the packed form of data to out and returns its size. With out == nullptr only the size is computed, so the
+// output can be allocated exactly. At most size + (size + 127) / 128 bytes.
+size_t encode(const uint8_t* data, size_t size, uint8_t* out);
+// Unpacks into out, false unless the input fills exactly outSize bytes
+bool decode(const uint8_t* data, size_t size, uint8_t* out, size_t outSize);
+
+}  // namespace PackBits
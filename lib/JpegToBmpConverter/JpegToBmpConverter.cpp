@@ -1,5 +1,6 @@
 #include "JpegToBmpConverter.h"
 
+#include <BufferedFsWriter.h>
 #include <HardwareSerial.h>
 #include <SdFat.h>
 #include <picojpeg.h>
@@ -9,9 +10,10 @@
 
 #include "BitmapHelpers.h"
 
-// Context structure for picojpeg callback
+// Context structure for picojpeg callback, reads from either an SD file or a zip entry
 struct JpegReadContext {
-  FsFile& file;
+  FsFile* file;
+  ZipFile::EntryReader* entry;
   uint8_t buffer[512];
   size_t bufferPos;
   size_t bufferFilled;
@@ -171,13 +173,15 @@ unsigned char JpegToBmpConverter::jpegReadCallback(unsigned char* pBuf, const un
                                                    unsigned char* pBytes_actually_read, void* pCallback_data) {
   auto* context = static_cast<JpegReadContext*>(pCallback_data);
 
-  if (!context || !context->file) {
+  if (!context || (context->file ? !*context->file : !context->entry->isOpen())) {
     return PJPG_STREAM_READ_ERROR;
   }
 
   // Check if we need to refill our context buffer
   if (context->bufferPos >= context->bufferFilled) {
-    context->bufferFilled = context->file.read(context->buffer, sizeof(context->buffer));
+    const int dataRead = context->file ? context->file->read(context->buffer, sizeof(context->buffer))
+                                       : context->entry->read(context->buffer, sizeof(context->buffer));
+    context->bufferFilled = dataRead > 0 ? dataRead : 0;
     context->bufferPos = 0;
 
     if (context->bufferFilled == 0) {
@@ -199,14 +203,12 @@ unsigned char JpegToBmpConverter::jpegReadCallback(unsigned char* pBuf, const un
 }
 
 // Internal implementation with configurable target size and bit depth
-bool JpegToBmpConverter::jpegFileToBmpStreamInternal(FsFile& jpegFile, Print& bmpOut, int targetWidth, int targetHeight,
-                                                     bool oneBit, bool crop) {
+bool JpegToBmpConverter::jpegFileToBmpStreamInternal(JpegReadContext& context, Print& bmpOut, int targetWidth,
+                                                     int targetHeight, bool oneBit, bool crop,
+                                                     BufferedFsWriter* contiguousOut) {
   Serial.printf("[%lu] [JPG] Converting JPEG to %s BMP (target: %dx%d)\n", millis(), oneBit ? "1-bit" : "2-bit",
                 targetWidth, targetHeight);
 
-  // Setup context for picojpeg callback
-  JpegReadContext context = {.file = jpegFile, .bufferPos = 0, .bufferFilled = 0};
-
   // Initialize picojpeg decoder
   pjpeg_image_info_t imageInfo;
   const unsigned char status = pjpeg_decode_init(&imageInfo, jpegReadCallback, &context, 0);
@@ -279,6 +281,11 @@ bool JpegToBmpConverter::jpegFileToBmpStreamInternal(FsFile& jpegFile, Print& bm
     bytesPerRow = (outWidth * 2 + 31) / 32 * 4;
   }
 
+  // The header is still buffered, so the file is empty and can be reserved at its final size
+  if (contiguousOut) {
+    contiguousOut->preAllocate(contiguousOut->position() + static_cast<uint32_t>(bytesPerRow) * outHeight);
+  }
+
   // Allocate row buffer
   auto* rowBuffer = static_cast<uint8_t*>(malloc(bytesPerRow));
   if (!rowBuffer) {
@@ -555,17 +562,43 @@ bool JpegToBmpConverter::jpegFileToBmpStreamInternal(FsFile& jpegFile, Print& bm
 
 // Core function: Convert JPEG file to 2-bit BMP (uses default target size)
 bool JpegToBmpConverter::jpegFileToBmpStream(FsFile& jpegFile, Print& bmpOut, bool crop) {
-  return jpegFileToBmpStreamInternal(jpegFile, bmpOut, TARGET_MAX_WIDTH, TARGET_MAX_HEIGHT, false, crop);
+  JpegReadContext context = {.file = &jpegFile, .entry = nullptr, .bufferPos = 0, .bufferFilled = 0};
+  return jpegFileToBmpStreamInternal(context, bmpOut, TARGET_MAX_WIDTH, TARGET_MAX_HEIGHT, false, crop);
 }
 
 // Convert with custom target size (for thumbnails, 2-bit)
 bool JpegToBmpConverter::jpegFileToBmpStreamWithSize(FsFile& jpegFile, Print& bmpOut, int targetMaxWidth,
                                                      int targetMaxHeight) {
-  return jpegFileToBmpStreamInternal(jpegFile, bmpOut, targetMaxWidth, targetMaxHeight, false);
+  JpegReadContext context = {.file = &jpegFile, .entry = nullptr, .bufferPos = 0, .bufferFilled = 0};
+  return jpegFileToBmpStreamInternal(context, bmpOut, targetMaxWidth, targetMaxHeight, false);
 }
 
 // Convert to 1-bit BMP (black and white only, no grays) for fast home screen rendering
 bool JpegToBmpConverter::jpegFileTo1BitBmpStreamWithSize(FsFile& jpegFile, Print& bmpOut, int targetMaxWidth,
                                                          int targetMaxHeight) {
-  return jpegFileToBmpStreamInternal(jpegFile, bmpOut, targetMaxWidth, targetMaxHeight, true);
+  JpegReadContext context = {.file = &jpegFile, .entry = nullptr, .bufferPos = 0, .bufferFilled = 0};
+  return jpegFileToBmpStreamInternal(context, bmpOut, targetMaxWidth, targetMaxHeight, true);
+}
+
+bool JpegToBmpConverter::jpegFileToBmpStream(ZipFile::EntryReader& jpegEntry, Print& bmpOut, bool crop) {
+  JpegReadContext context = {.file = nullptr, .entry = &jpegEntry, .bufferPos = 0, .bufferFilled = 0};
+  return jpegFileToBmpStreamInternal(context, bmpOut, TARGET_MAX_WIDTH, TARGET_MAX_HEIGHT, false, crop);
+}
+
+bool JpegToBmpConverter::jpegFileToBmpStreamWithSize(ZipFile::EntryReader& jpegEntry, Print& bmpOut,
+                                                     int targetMaxWidth, int targetMaxHeight) {
+  JpegReadContext context = {.file = nullptr, .entry = &jpegEntry, .bufferPos = 0, .bufferFilled = 0};
+  return jpegFileToBmpStreamInternal(context, bmpOut, targetMaxWidth, targetMaxHeight, false);
+}
+
+bool JpegToBmpConverter::jpegFileToBmpStreamWithSize(ZipFile::EntryReader& jpegEntry, BufferedFsWriter& bmpOut,
+                                                     int targetMaxWidth, int targetMaxHeight) {
+  JpegReadContext context = {.file = nullptr, .entry = &jpegEntry, .bufferPos = 0, .bufferFilled = 0};
+  return jpegFileToBmpStreamInternal(context, bmpOut, targetMaxWidth, targetMaxHeight, false, true, &bmpOut);
+}
+
+bool JpegToBmpConverter::jpegFileTo1BitBmpStreamWithSize(ZipFile::EntryReader& jpegEntry, Print& bmpOut,
+                                                         int targetMaxWidth, int targetMaxHeight) {
+  JpegReadContext context = {.file = nullptr, .entry = &jpegEntry, .bufferPos = 0, .bufferFilled = 0};
+  return jpegFileToBmpStreamInternal(context, bmpOut, targetMaxWidth, targetMaxHeight, true);
 }
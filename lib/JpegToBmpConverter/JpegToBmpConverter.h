@@ -1,19 +1,35 @@
 #pragma once
 
+#include <ZipFile.h>
+
+class BufferedFsWriter;
 class FsFile;
 class Print;
-class ZipFile;
+struct JpegReadContext;
 
 class JpegToBmpConverter {
   static unsigned char jpegReadCallback(unsigned char* pBuf, unsigned char buf_size,
                                         unsigned char* pBytes_actually_read, void* pCallback_data);
-  static bool jpegFileToBmpStreamInternal(class FsFile& jpegFile, Print& bmpOut, int targetWidth, int targetHeight,
-                                          bool oneBit, bool crop = true);
+  static bool jpegFileToBmpStreamInternal(JpegReadContext& context, Print& bmpOut, int targetWidth, int targetHeight,
+                                          bool oneBit, bool crop = true, BufferedFsWriter* contiguousOut = nullptr);
 
  public:
+  // Bump when the BMP output changes (dithering, scaling, header), cached conversions of other versions are redone
+  static constexpr uint8_t OUTPUT_VERSION = 1;
+
   static bool jpegFileToBmpStream(FsFile& jpegFile, Print& bmpOut, bool crop = true);
   // Convert with custom target size (for thumbnails)
   static bool jpegFileToBmpStreamWithSize(FsFile& jpegFile, Print& bmpOut, int targetMaxWidth, int targetMaxHeight);
   // Convert to 1-bit BMP (black and white only, no grays) for fast home screen rendering
   static bool jpegFileTo1BitBmpStreamWithSize(FsFile& jpegFile, Print& bmpOut, int targetMaxWidth, int targetMaxHeight);
+
+  // Same conversions, pulling the JPEG straight out of a zip entry (no temp file needed)
+  static bool jpegFileToBmpStream(ZipFile::EntryReader& jpegEntry, Print& bmpOut, bool crop = true);
+  static bool jpegFileToBmpStreamWithSize(ZipFile::EntryReader& jpegEntry, Print& bmpOut, int targetMaxWidth,
+                                          int targetMaxHeight);
+  // Same, pre-allocating the BMP contiguously once its exact size is known from the header
+  static bool jpegFileToBmpStreamWithSize(ZipFile::EntryReader& jpegEntry, BufferedFsWriter& bmpOut,
+                                          int targetMaxWidth, int targetMaxHeight);
+  static bool jpegFileTo1BitBmpStreamWithSize(ZipFile::EntryReader& jpegEntry, Print& bmpOut, int targetMaxWidth,
+                                              int targetMaxHeight);
 };
@@ -1,8 +1,8 @@
 #include "KOReaderDocumentId.h"
 
+#include <Epub/BookFingerprintStore.h>
 #include <HardwareSerial.h>
 #include <MD5Builder.h>
-#include <SDCardManager.h>
 
 namespace {
 // Extract filename from path (everything after last '/')
@@ -31,66 +31,12 @@ std::string KOReaderDocumentId::calculateFromFilename(const std::string& filePat
   return result;
 }
 
-size_t KOReaderDocumentId::getOffset(int i) {
-  // Offset = 1024 << (2*i)
-  // For i = -1: KOReader uses a value of 0
-  // For i >= 0: 1024 << (2*i)
-  if (i < 0) {
-    return 0;
-  }
-  return CHUNK_SIZE << (2 * i);
-}
-
 std::string KOReaderDocumentId::calculate(const std::string& filePath) {
-  FsFile file;
-  if (!SdMan.openFileForRead("KODoc", filePath, file)) {
-    Serial.printf("[%lu] [KODoc] Failed to open file: %s\n", millis(), filePath.c_str());
+  BookFingerprint fingerprint;
+  if (!BOOK_FINGERPRINTS.get(filePath, &fingerprint)) {
     return "";
   }
 
-  const size_t fileSize = file.fileSize();
-  Serial.printf("[%lu] [KODoc] Calculating hash for file: %s (size: %zu)\n", millis(), filePath.c_str(), fileSize);
-
-  // Initialize MD5 builder
-  MD5Builder md5;
-  md5.begin();
-
-  // Buffer for reading chunks
-  uint8_t buffer[CHUNK_SIZE];
-  size_t totalBytesRead = 0;
-
-  // Read from each offset (i = -1 to 10)
-  for (int i = -1; i < OFFSET_COUNT - 1; i++) {
-    const size_t offset = getOffset(i);
-
-    // Skip if offset is beyond file size
-    if (offset >= fileSize) {
-      continue;
-    }
-
-    // Seek to offset
-    if (!file.seekSet(offset)) {
-      Serial.printf("[%lu] [KODoc] Failed to seek to offset %zu\n", millis(), offset);
-      continue;
-    }
-
-    // Read up to CHUNK_SIZE bytes
-    const size_t bytesToRead = std::min(CHUNK_SIZE, fileSize - offset);
-    const size_t bytesRead = file.read(buffer, bytesToRead);
-
-    if (bytesRead > 0) {
-      md5.add(buffer, bytesRead);
-      totalBytesRead += bytesRead;
-    }
-  }
-
-  file.close();
-
-  // Calculate final hash
-  md5.calculate();
-  std::string result = md5.toString().c_str();
-
-  Serial.printf("[%lu] [KODoc] Hash calculated: %s (from %zu bytes)\n", millis(), result.c_str(), totalBytesRead);
-
-  return result;
+  Serial.printf("[%lu] [KODoc] Hash for %s: %s\n", millis(), filePath.c_str(), fingerprint.partialMd5.c_str());
+  return fingerprint.partialMd5;
 }
@@ -1,8 +1,78 @@
 #include "ProgressMapper.h"
 
 #include <HardwareSerial.h>
+#include <expat.h>
 
 #include <cmath>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+namespace {
+constexpr size_t XPATH_PARSE_BUFFER_SIZE = 1024;
+
+// State for walking a spine item's element tree up to a source offset
+struct ElementPathWalker {
+  XML_Parser parser = nullptr;
+  uint32_t targetOffset = 0;
+  bool insideBody = false;
+  bool reached = false;
+  // "name[index]" of each open element below <body>
+  std::vector<std::string> path;
+  // Children seen so far by name, one list per open level from <body> down, for the 1-based sibling index
+  std::vector<std::vector<std::pair<std::string, int>>> siblingCounts;
+};
+
+void XMLCALL walkerStartElement(void* userData, const XML_Char* name, const XML_Char** atts) {
+  (void)atts;
+  auto* walker = static_cast<ElementPathWalker*>(userData);
+  // Elements starting after the target can't contain it, so what is open now is the path
+  if (XML_GetCurrentByteIndex(walker->parser) > walker->targetOffset) {
+    walker->reached = true;
+    XML_StopParser(walker->parser, XML_FALSE);
+    return;
+  }
+
+  if (!walker->insideBody) {
+    if (strcmp(name, "body") == 0) {
+      walker->insideBody = true;
+      walker->siblingCounts.emplace_back();
+    }
+    return;
+  }
+
+  auto& counts = walker->siblingCounts.back();
+  int index = 1;
+  bool found = false;
+  for (auto& count : counts) {
+    if (count.first == name) {
+      index = ++count.second;
+      found = true;
+      break;
+    }
+  }
+  if (!found) {
+    counts.emplace_back(name, 1);
+  }
+  walker->path.push_back(std::string(name) + "[" + std::to_string(index) + "]");
+  walker->siblingCounts.emplace_back();
+}
+
+void XMLCALL walkerEndElement(void* userData, const XML_Char* name) {
+  (void)name;
+  auto* walker = static_cast<ElementPathWalker*>(userData);
+  if (!walker->insideBody) {
+    return;
+  }
+  walker->siblingCounts.pop_back();
+  if (walker->path.empty()) {
+    // Closing </body>
+    walker->insideBody = false;
+    return;
+  }
+  walker->path.pop_back();
+}
+}  // namespace
 
 KOReaderPosition ProgressMapper::toKOReader(const std::shared_ptr<Epub>& epub, const CrossPointPosition& pos) {
   KOReaderPosition result;
@@ -17,7 +87,7 @@ KOReaderPosition ProgressMapper::toKOReader(const std::shared_ptr<Epub>& epub, c
   result.percentage = epub->calculateProgress(pos.spineIndex, intraSpineProgress);
 
   // Generate XPath with estimated paragraph position based on page
-  result.xpath = generateXPath(pos.spineIndex, pos.pageNumber, pos.totalPages);
+  result.xpath = generateXPath(epub, pos.spineIndex, pos.sourceOffset);
 
   // Get chapter info for logging
   const int tocIndex = epub->getTocIndexForSpineIndex(pos.spineIndex);
@@ -35,6 +105,7 @@ CrossPointPosition ProgressMapper::toCrossPoint(const std::shared_ptr<Epub>& epu
   result.spineIndex = 0;
   result.pageNumber = 0;
   result.totalPages = totalPagesInSpine;
+  result.sourceOffset = 0;
 
   const size_t bookSize = epub->getBookSize();
   if (bookSize == 0) {
@@ -52,13 +123,7 @@ CrossPointPosition ProgressMapper::toCrossPoint(const std::shared_ptr<Epub>& epu
     const size_t targetBytes = static_cast<size_t>(bookSize * koPos.percentage);
 
     // Find the spine item that contains this byte position
-    for (int i = 0; i < epub->getSpineItemsCount(); i++) {
-      const size_t cumulativeSize = epub->getCumulativeSpineItemSize(i);
-      if (cumulativeSize >= targetBytes) {
-        result.spineIndex = i;
-        break;
-      }
-    }
+    result.spineIndex = epub->getSpineIndexForBookOffset(targetBytes);
 
     // Estimate page number within the spine item using percentage (only when no XPath)
     if (totalPagesInSpine > 0 && result.spineIndex < epub->getSpineItemsCount()) {
@@ -82,11 +147,65 @@ CrossPointPosition ProgressMapper::toCrossPoint(const std::shared_ptr<Epub>& epu
   return result;
 }
 
-std::string ProgressMapper::generateXPath(int spineIndex, int pageNumber, int totalPages) {
+std::string ProgressMapper::generateXPath(const std::shared_ptr<Epub>& epub, int spineIndex, uint32_t sourceOffset) {
   // KOReader uses 1-based DocFragment indices
-  // Use a simple xpath pointing to the DocFragment - KOReader will use the percentage for fine positioning
-  // Avoid specifying paragraph numbers as they may not exist in the target document
-  return "/body/DocFragment[" + std::to_string(spineIndex + 1) + "]/body";
+  const std::string xpath = "/body/DocFragment[" + std::to_string(spineIndex + 1) + "]/body";
+  if (sourceOffset == 0) {
+    // Start of the item (or unknown), KOReader will use the percentage for fine positioning
+    return xpath;
+  }
+  return xpath + findElementPath(epub, spineIndex, sourceOffset);
+}
+
+std::string ProgressMapper::findElementPath(const std::shared_ptr<Epub>& epub, int spineIndex,
+                                            uint32_t sourceOffset) {
+  ZipFile::EntryReader reader;
+  if (!epub->openItemContents(epub->getSpineItem(spineIndex).href, reader, XPATH_PARSE_BUFFER_SIZE)) {
+    return "";
+  }
+
+  const XML_Parser parser = XML_ParserCreate(nullptr);
+  if (!parser) {
+    Serial.printf("[%lu] [ProgressMapper] Couldn't allocate memory for parser\n", millis());
+    return "";
+  }
+
+  ElementPathWalker walker;
+  walker.parser = parser;
+  walker.targetOffset = sourceOffset;
+  XML_SetUserData(parser, &walker);
+  XML_SetElementHandler(parser, walkerStartElement, walkerEndElement);
+
+  bool ok = true;
+  bool done = false;
+  while (!done && !walker.reached) {
+    void* const buf = XML_GetBuffer(parser, XPATH_PARSE_BUFFER_SIZE);
+    const int len = buf ? reader.read(buf, XPATH_PARSE_BUFFER_SIZE) : -1;
+    if (len < 0) {
+      ok = false;
+      break;
+    }
+    done = reader.available() == 0;
+    // Stopping at the target surfaces as an aborted parse
+    if (XML_ParseBuffer(parser, len, done) == XML_STATUS_ERROR && !walker.reached) {
+      ok = false;
+      break;
+    }
+  }
+  XML_ParserFree(parser);
+  reader.close();
+
+  if (!ok) {
+    Serial.printf("[%lu] [ProgressMapper] Could not walk spine %d to offset %lu\n", millis(), spineIndex,
+                  static_cast<unsigned long>(sourceOffset));
+    return "";
+  }
+
+  std::string elementPath;
+  for (const auto& element : walker.path) {
+    elementPath += "/" + element;
+  }
+  return elementPath;
 }
 
 int ProgressMapper::parseDocFragmentIndex(const std::string& xpath) {
@@ -11,6 +11,7 @@ struct CrossPointPosition {
   int spineIndex;  // Current spine item (chapter) index
   int pageNumber;  // Current page within the spine item
   int totalPages;  // Total pages in the current spine item
+  uint32_t sourceOffset;  // XHTML byte offset of the page's first block, 0 if unknown
 };
 
 /**
@@ -27,9 +28,9 @@ struct KOReaderPosition {
  * CrossPoint tracks position as (spineIndex, pageNumber).
  * KOReader uses XPath-like strings + percentage.
  *
- * Since CrossPoint discards HTML structure during parsing, we generate
- * synthetic XPath strings based on spine index, using percentage as the
- * primary sync mechanism.
+ * Sections record the source offset of each page's first block, so the XPath
+ * sent to KOReader points at the element the page starts in. Positions coming
+ * back from KOReader are still resolved by DocFragment and percentage.
  */
 class ProgressMapper {
  public:
@@ -59,10 +60,17 @@ class ProgressMapper {
  private:
   /**
    * Generate XPath for KOReader compatibility.
-   * Format: /body/DocFragment[spineIndex+1]/body/p[estimatedParagraph]
-   * Paragraph is estimated based on page position within the chapter.
+   * Format: /body/DocFragment[spineIndex+1]/body/div[1]/p[14]
+   * The element path is found by re-parsing the spine item up to sourceOffset,
+   * without it the XPath stops at the DocFragment's body.
    */
-  static std::string generateXPath(int spineIndex, int pageNumber, int totalPages);
+  static std::string generateXPath(const std::shared_ptr<Epub>& epub, int spineIndex, uint32_t sourceOffset);
+
+  /**
+   * Path of the elements below <body> that are open at sourceOffset in the
+   * spine item, e.g. "/div[1]/p[14]". Empty if it can't be determined.
+   */
+  static std::string findElementPath(const std::shared_ptr<Epub>& epub, int spineIndex, uint32_t sourceOffset);
 
   /**
    * Parse DocFragment index from XPath string.
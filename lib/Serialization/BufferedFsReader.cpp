@@ -0,0 +1,113 @@
+#include "BufferedFsReader.h"
+
+#include <HardwareSerial.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+#include "SdOpCounter.h"
+
+namespace {
+constexpr size_t SECTOR_SIZE = 512;
+}
+
+BufferedFsReader::BufferedFsReader(FsFile& file, const size_t blockSize)
+    : file(file), blockSize((blockSize + SECTOR_SIZE - 1) / SECTOR_SIZE * SECTOR_SIZE) {
+  buffer = static_cast<uint8_t*>(malloc(this->blockSize));
+  if (!buffer) {
+    Serial.printf("[%lu] [BFR] Failed to allocate %u byte read buffer, reading unbuffered\n", millis(),
+                  static_cast<unsigned>(this->blockSize));
+  }
+  pos = file.position();
+  fileSize = file.size();
+}
+
+BufferedFsReader::~BufferedFsReader() { free(buffer); }
+
+bool BufferedFsReader::fill(const uint32_t blockStart) {
+  bufferFilled = 0;
+  if (!file.seek(blockStart)) {
+    return false;
+  }
+  const size_t toRead = std::min(blockSize, static_cast<size_t>(fileSize - blockStart));
+  SdOpCounter::reads++;
+  const int dataRead = file.read(buffer, toRead);
+  if (dataRead < 0) {
+    return false;
+  }
+  bufferStart = blockStart;
+  bufferFilled = dataRead;
+  return true;
+}
+
+int BufferedFsReader::read(void* buf, const size_t len) {
+  auto out = static_cast<uint8_t*>(buf);
+  size_t remaining = std::min(len, static_cast<size_t>(available()));
+  size_t total = 0;
+
+  while (remaining > 0) {
+    // Serve whatever overlaps the buffered block
+    if (bufferFilled > 0 && pos >= bufferStart && pos < bufferStart + bufferFilled) {
+      const size_t offset = pos - bufferStart;
+      const size_t toCopy = std::min(remaining, bufferFilled - offset);
+      memcpy(out + total, buffer + offset, toCopy);
+      pos += toCopy;
+      total += toCopy;
+      remaining -= toCopy;
+      continue;
+    }
+
+    // Large reads and unbuffered fallback go straight to the card
+    if (!buffer || remaining >= blockSize) {
+      if (!file.seek(pos)) {
+        return total > 0 ? static_cast<int>(total) : -1;
+      }
+      SdOpCounter::reads++;
+      const int dataRead = file.read(out + total, remaining);
+      if (dataRead <= 0) {
+        return total > 0 ? static_cast<int>(total) : -1;
+      }
+      pos += dataRead;
+      total += dataRead;
+      remaining -= dataRead;
+      continue;
+    }
+
+    if (!fill(pos - pos % blockSize) || pos >= bufferStart + bufferFilled) {
+      return total > 0 ? static_cast<int>(total) : -1;
+    }
+  }
+
+  return static_cast<int>(total);
+}
+
+const uint8_t* BufferedFsReader::view(const size_t len) {
+  if (!buffer || len > blockSize || len > available()) {
+    return nullptr;
+  }
+  if (bufferFilled == 0 || pos < bufferStart || pos + len > bufferStart + bufferFilled) {
+    if (!fill(pos) || len > bufferFilled) {
+      return nullptr;
+    }
+  }
+  const uint8_t* data = buffer + (pos - bufferStart);
+  pos += len;
+  return data;
+}
+
+bool BufferedFsReader::seek(const uint32_t position) {
+  if (position > fileSize) {
+    return false;
+  }
+  // The block is kept, a later read refills only if the new position falls outside of it
+  pos = position;
+  return true;
+}
+
+bool BufferedFsReader::seekCur(const int32_t offset) {
+  if (offset < 0 && static_cast<uint32_t>(-offset) > pos) {
+    return false;
+  }
+  return seek(pos + offset);
+}
@@ -0,0 +1,49 @@
+#pragma once
+#include <SdFat.h>
+
+#include <cstddef>
+#include <cstdint>
+
+// Read-side block cache over an FsFile. Reads are served from a sector aligned block (4KB by default) that is
+// refilled with a single SD read, so many small reads (POD fields, bitmap rows, ZIP headers) cost one SD transaction
+// per block. Seeks within the buffered block are free; reads at least a block long bypass the buffer.
+//
+// The reader never owns the file and moves its position around; callers going back to the FsFile directly must
+// seek first. If the allocation of the block fails it degrades to direct FsFile reads.
+class BufferedFsReader {
+ public:
+  static constexpr size_t DEFAULT_BLOCK_SIZE = 4096;
+
+  explicit BufferedFsReader(FsFile& file, size_t blockSize = DEFAULT_BLOCK_SIZE);
+  ~BufferedFsReader();
+
+  BufferedFsReader(const BufferedFsReader&) = delete;
+  BufferedFsReader& operator=(const BufferedFsReader&) = delete;
+
+  // Returns the number of bytes read (short at end of file), -1 on error
+  int read(void* buf, size_t len);
+  // Points at the next len bytes inside the block buffer (refilled from the current position if they aren't all in it)
+  // and moves past them, so they can be parsed without a copy. Valid until the next call on the reader. Returns nullptr
+  // if len doesn't fit the block, the file is shorter or the reader is unbuffered; read() still works then.
+  const uint8_t* view(size_t len);
+  bool seek(uint32_t position);
+  bool seekCur(int32_t offset);
+  uint32_t position() const { return pos; }
+  uint32_t size() const { return fileSize; }
+  uint32_t available() const { return pos < fileSize ? fileSize - pos : 0; }
+  // Drops the buffered block, needed if the file was written through since it was filled
+  void invalidate() { bufferFilled = 0; }
+  FsFile& getFile() { return file; }
+
+ private:
+  bool fill(uint32_t blockStart);
+
+  FsFile& file;
+  uint8_t* buffer = nullptr;
+  size_t blockSize;
+  // File range [bufferStart, bufferStart + bufferFilled) is held in buffer
+  uint32_t bufferStart = 0;
+  size_t bufferFilled = 0;
+  uint32_t pos = 0;
+  uint32_t fileSize = 0;
+};
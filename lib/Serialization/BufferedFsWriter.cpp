@@ -0,0 +1,114 @@
+#include "BufferedFsWriter.h"
+
+#include <HardwareSerial.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+#include "SdOpCounter.h"
+
+BufferedFsWriter::BufferedFsWriter(FsFile& file, const size_t blockSize) : file(file), blockSize(blockSize) {
+  buffer = static_cast<uint8_t*>(malloc(blockSize));
+  if (!buffer) {
+    Serial.printf("[%lu] [BFW] Failed to allocate %u byte write buffer, writing unbuffered\n", millis(),
+                  static_cast<unsigned>(blockSize));
+  }
+  filePosition = file.position();
+  writtenEnd = filePosition;
+}
+
+BufferedFsWriter::~BufferedFsWriter() { free(buffer); }
+
+bool BufferedFsWriter::writeOut(const uint8_t* data, const size_t len) {
+  SdOpCounter::writes++;
+  const size_t written = file.write(data, len);
+  filePosition += written;
+  writtenEnd = std::max(writtenEnd, filePosition);
+  if (written != len) {
+    Serial.printf("[%lu] [BFW] Short write: %u of %u bytes\n", millis(), static_cast<unsigned>(written),
+                  static_cast<unsigned>(len));
+    writeError = true;
+    return false;
+  }
+  return true;
+}
+
+size_t BufferedFsWriter::write(const void* buf, const size_t len) {
+  auto data = static_cast<const uint8_t*>(buf);
+
+  if (!buffer) {
+    const uint32_t start = filePosition;
+    writeOut(data, len);
+    return filePosition - start;
+  }
+
+  size_t total = 0;
+  while (total < len) {
+    // Nothing buffered and at least a block to go: skip the copy and write straight from the caller
+    if (bufferFilled == 0 && len - total >= blockSize) {
+      const uint32_t start = filePosition;
+      const bool ok = writeOut(data + total, len - total);
+      total += filePosition - start;
+      if (!ok) {
+        break;
+      }
+      continue;
+    }
+
+    const size_t toCopy = std::min(len - total, blockSize - bufferFilled);
+    memcpy(buffer + bufferFilled, data + total, toCopy);
+    bufferFilled += toCopy;
+    total += toCopy;
+
+    if (bufferFilled == blockSize && !flush()) {
+      break;
+    }
+  }
+
+  return total;
+}
+
+bool BufferedFsWriter::flush() {
+  if (bufferFilled > 0) {
+    const size_t pending = bufferFilled;
+    bufferFilled = 0;
+    writeOut(buffer, pending);
+  }
+  return !writeError;
+}
+
+bool BufferedFsWriter::seek(const uint32_t position) {
+  if (!flush() || !file.seek(position)) {
+    return false;
+  }
+  filePosition = position;
+  return true;
+}
+
+bool BufferedFsWriter::preAllocate(const uint32_t expectedSize) {
+  // Bytes still in the buffer are fine, only the file itself has to be empty
+  if (expectedSize == 0 || filePosition != 0 || file.size() != 0) {
+    return false;
+  }
+  if (!file.preAllocate(expectedSize)) {
+    Serial.printf("[%lu] [BFW] Could not pre-allocate %lu contiguous bytes\n", millis(),
+                  static_cast<unsigned long>(expectedSize));
+    return false;
+  }
+  preAllocated = true;
+  return true;
+}
+
+bool BufferedFsWriter::finish() {
+  if (!flush()) {
+    return false;
+  }
+  if (preAllocated && file.size() > writtenEnd && !file.truncate(writtenEnd)) {
+    Serial.printf("[%lu] [BFW] Failed to trim pre-allocated file to %lu bytes\n", millis(),
+                  static_cast<unsigned long>(writtenEnd));
+    writeError = true;
+    return false;
+  }
+  return true;
+}
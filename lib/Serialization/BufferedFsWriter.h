@@ -0,0 +1,61 @@
+#pragma once
+#include <SdFat.h>
+
+#include <cstddef>
+#include <cstdint>
+
+// Write-combining buffer over an FsFile. Writes are collected in a RAM block (4KB by default) and handed to the card
+// one full block at a time, so serializing many small fields (words, positions, styles) costs one SD write per block
+// instead of one per field. position() includes the buffered bytes, so offsets taken while writing (page LUTs, book.bin
+// LUTs) match the final file.
+//
+// Buffered data only reaches the file on flush() or seek(), anything still buffered when the writer is destroyed is
+// dropped (so error paths can simply close and remove the file). Callers must flush before closing the file or
+// touching it directly. If the allocation of the block fails it degrades to direct FsFile writes.
+//
+// It is also a Print, so stream producers (e.g. the JPEG to BMP converter) can write through it.
+class BufferedFsWriter final : public Print {
+ public:
+  static constexpr size_t DEFAULT_BLOCK_SIZE = 4096;
+
+  explicit BufferedFsWriter(FsFile& file, size_t blockSize = DEFAULT_BLOCK_SIZE);
+  ~BufferedFsWriter();
+
+  BufferedFsWriter(const BufferedFsWriter&) = delete;
+  BufferedFsWriter& operator=(const BufferedFsWriter&) = delete;
+
+  // Returns the number of bytes accepted, short only if the card write failed
+  size_t write(const void* buf, size_t len);
+  size_t write(uint8_t b) override { return write(&b, 1); }
+  size_t write(const uint8_t* buf, size_t len) override { return write(static_cast<const void*>(buf), len); }
+  using Print::write;
+
+  // Reserves expectedSize bytes of contiguous clusters for the file, which must not have been written to yet.
+  // Contiguous files let SdFat move each sector aligned block with one multi-sector transfer, both here and when the
+  // file is read back. Over-estimates are trimmed by finish(); if the file outgrows the reservation it simply continues
+  // non-contiguously.
+  bool preAllocate(uint32_t expectedSize);
+  // Flushes and, if the file was pre-allocated, truncates it to the bytes actually written
+  bool finish();
+  // Writes out any buffered bytes, returns false if this or any earlier write failed
+  bool flush();
+  // Flushes and repositions the file, e.g. to patch a header placeholder
+  bool seek(uint32_t position);
+  uint32_t position() const { return filePosition + bufferFilled; }
+  bool hasError() const { return writeError; }
+  FsFile& getFile() { return file; }
+
+ private:
+  bool writeOut(const uint8_t* data, size_t len);
+
+  FsFile& file;
+  uint8_t* buffer = nullptr;
+  size_t blockSize;
+  size_t bufferFilled = 0;
+  // File position the buffered bytes will be written at
+  uint32_t filePosition = 0;
+  // Furthest byte written, the real file size when the file was pre-allocated past it
+  uint32_t writtenEnd = 0;
+  bool preAllocated = false;
+  bool writeError = false;
+};
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstdint>
+
+// Running count of SD read/write calls issued through the Serialization helpers, the buffered readers/writers and
+// the ZIP entry reader. Take a snapshot before an operation and log the difference to see how many SD transactions
+// it needed.
+struct SdOpCounter {
+  static inline uint32_t reads = 0;
+  static inline uint32_t writes = 0;
+
+  struct Snapshot {
+    uint32_t reads;
+    uint32_t writes;
+  };
+
+  static Snapshot snapshot() { return {reads, writes}; }
+  static uint32_t readsSince(const Snapshot& start) { return reads - start.reads; }
+  static uint32_t writesSince(const Snapshot& start) { return writes - start.writes; }
+};
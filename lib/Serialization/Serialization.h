@@ -3,6 +3,10 @@
 
 #include <iostream>
 
+#include "BufferedFsReader.h"
+#include "BufferedFsWriter.h"
+#include "SdOpCounter.h"
+
 namespace serialization {
 template <typename T>
 static void writePod(std::ostream& os, const T& value) {
@@ -11,9 +15,15 @@ static void writePod(std::ostream& os, const T& value) {
 
 template <typename T>
 static void writePod(FsFile& file, const T& value) {
+  SdOpCounter::writes++;
   file.write(reinterpret_cast<const uint8_t*>(&value), sizeof(T));
 }
 
+template <typename T>
+static void writePod(BufferedFsWriter& writer, const T& value) {
+  writer.write(&value, sizeof(T));
+}
+
 template <typename T>
 static void readPod(std::istream& is, T& value) {
   is.read(reinterpret_cast<char*>(&value), sizeof(T));
@@ -21,9 +31,15 @@ static void readPod(std::istream& is, T& value) {
 
 template <typename T>
 static void readPod(FsFile& file, T& value) {
+  SdOpCounter::reads++;
   file.read(reinterpret_cast<uint8_t*>(&value), sizeof(T));
 }
 
+template <typename T>
+static void readPod(BufferedFsReader& reader, T& value) {
+  reader.read(&value, sizeof(T));
+}
+
 static void writeString(std::ostream& os, const std::string& s) {
   const uint32_t len = s.size();
   writePod(os, len);
@@ -33,9 +49,16 @@ static void writeString(std::ostream& os, const std::string& s) {
 static void writeString(FsFile& file, const std::string& s) {
   const uint32_t len = s.size();
   writePod(file, len);
+  SdOpCounter::writes++;
   file.write(reinterpret_cast<const uint8_t*>(s.data()), len);
 }
 
+static void writeString(BufferedFsWriter& writer, const std::string& s) {
+  const uint32_t len = s.size();
+  writePod(writer, len);
+  writer.write(s.data(), len);
+}
+
 static void readString(std::istream& is, std::string& s) {
   uint32_t len;
   readPod(is, len);
@@ -47,6 +70,14 @@ static void readString(FsFile& file, std::string& s) {
   uint32_t len;
   readPod(file, len);
   s.resize(len);
+  SdOpCounter::reads++;
   file.read(&s[0], len);
 }
+
+static void readString(BufferedFsReader& reader, std::string& s) {
+  uint32_t len;
+  readPod(reader, len);
+  s.resize(len);
+  reader.read(&s[0], len);
+}
 }  // namespace serialization
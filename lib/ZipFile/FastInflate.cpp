@@ -0,0 +1,650 @@
+#include "FastInflate.h"
+
+#include <cstring>
+
+namespace {
+// Table entry layout: bits 0-4 code length (total bits for a literal pair), bits 5-7 kind, bits 8-11 extra bits
+// (length/distance), subtable bits or first code length (literal pair), bits 16-31 value.
+constexpr uint32_t KIND_SHIFT = 5;
+constexpr uint32_t AUX_SHIFT = 8;
+constexpr uint32_t VALUE_SHIFT = 16;
+
+constexpr uint32_t KIND_LITERAL = 0;
+constexpr uint32_t KIND_LITERAL_PAIR = 1;
+constexpr uint32_t KIND_LENGTH = 2;
+constexpr uint32_t KIND_END_OF_BLOCK = 3;
+constexpr uint32_t KIND_SUBTABLE = 4;
+constexpr uint32_t KIND_DISTANCE = 5;
+constexpr uint32_t KIND_INVALID = 7;
+
+constexpr uint32_t INVALID_ENTRY = KIND_INVALID << KIND_SHIFT;
+
+constexpr uint16_t LENGTH_BASES[29] = {3,  4,  5,  6,  7,  8,  9,  10, 11,  13,  15,  17,  19,  23, 27,
+                                      31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+constexpr uint8_t LENGTH_EXTRA_BITS[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2,
+                                           2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+constexpr uint16_t DIST_BASES[30] = {1,    2,    3,    4,    5,    7,    9,    13,    17,    25,
+                                    33,   49,   65,   97,   129,  193,  257,  385,   513,   769,
+                                    1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+constexpr uint8_t DIST_EXTRA_BITS[30] = {0, 0, 0, 0, 1, 1, 2, 2,  3,  3,  4,  4,  5,  5,  6,
+                                         6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+constexpr uint8_t PRECODE_ORDER[19] = {16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+
+constexpr uint32_t makeEntry(const uint32_t len, const uint32_t kind, const uint32_t aux, const uint32_t value) {
+  return len | (kind << KIND_SHIFT) | (aux << AUX_SHIFT) | (value << VALUE_SHIFT);
+}
+
+inline uint32_t entryLength(const uint32_t entry) { return entry & 31; }
+inline uint32_t entryKind(const uint32_t entry) { return (entry >> KIND_SHIFT) & 7; }
+inline uint32_t entryAux(const uint32_t entry) { return (entry >> AUX_SHIFT) & 15; }
+inline uint32_t entryValue(const uint32_t entry) { return entry >> VALUE_SHIFT; }
+
+inline uint32_t reverseBits(uint32_t code, const unsigned len) {
+  uint32_t reversed = 0;
+  for (unsigned i = 0; i < len; i++) {
+    reversed = (reversed << 1) | (code & 1);
+    code >>= 1;
+  }
+  return reversed;
+}
+
+// Looks up the entry for the next code, following a subtable link if needed
+inline uint32_t lookup(const uint32_t* table, const unsigned rootBits, const uint32_t bits) {
+  uint32_t entry = table[bits & ((1u << rootBits) - 1)];
+  if (entryKind(entry) == KIND_SUBTABLE) {
+    entry = table[entryValue(entry) + ((bits >> rootBits) & ((1u << entryAux(entry)) - 1))];
+  }
+  return entry;
+}
+
+// Copies an n byte back reference to out + pos, wrapping the source around the window when windowMask describes a
+// circular window
+inline void copyMatch(uint8_t* out, const size_t pos, const size_t distance, const size_t n, const size_t windowMask) {
+  uint8_t* dst = out + pos;
+  const size_t src = (pos - distance) & windowMask;
+  if (n > 0 && src + n - 1 > windowMask) {
+    for (size_t i = 0; i < n; i++) {
+      dst[i] = out[(src + i) & windowMask];
+    }
+    return;
+  }
+
+  const uint8_t* s = out + src;
+  if (distance >= 8 && n >= 8) {
+    // Each word is loaded before it is stored, and with distance >= 8 it never overlaps bytes written by itself. The
+    // last word is realigned to end at n, rewriting a few already copied bytes instead of looping over a tail.
+    uint64_t word;
+    for (size_t i = 0; i + 8 < n; i += 8) {
+      memcpy(&word, s + i, sizeof(word));
+      memcpy(dst + i, &word, sizeof(word));
+    }
+    memcpy(&word, s + n - 8, sizeof(word));
+    memcpy(dst + n - 8, &word, sizeof(word));
+  } else if (distance >= 4 && n >= 4 && n <= 8) {
+    uint32_t word;
+    memcpy(&word, s, sizeof(word));
+    memcpy(dst, &word, sizeof(word));
+    memcpy(&word, s + n - 4, sizeof(word));
+    memcpy(dst + n - 4, &word, sizeof(word));
+  } else if (distance == 1) {
+    memset(dst, *s, n);
+  } else {
+    for (size_t i = 0; i < n; i++) {
+      dst[i] = s[i];
+    }
+  }
+}
+
+// Input and output headroom that lets the decode loop skip per-symbol bounds checks: three word refills and the
+// longest match plus a literal pair
+constexpr ptrdiff_t FAST_INPUT_MARGIN = 16;
+constexpr ptrdiff_t FAST_OUTPUT_MARGIN = 258 + 2;
+}  // namespace
+
+void FastInflate::init() {
+  bitBuffer = 0;
+  bitCount = 0;
+  totalOut = 0;
+  storedRemaining = 0;
+  numLitlen = 0;
+  numDist = 0;
+  numPrecode = 0;
+  lensRead = 0;
+  matchLength = 0;
+  matchDistance = 0;
+  distExtra = 0;
+  state = BLOCK_HEADER;
+  finalBlock = false;
+}
+
+bool FastInflate::buildTable(uint32_t* table, const size_t enough, const unsigned rootBits, const uint8_t* codeLens,
+                             const unsigned numSyms, const TableKind kind) {
+  uint16_t count[16] = {};
+  for (unsigned sym = 0; sym < numSyms; sym++) {
+    count[codeLens[sym]]++;
+  }
+  count[0] = 0;
+
+  // Over-subscribed codes are corrupt; incomplete ones are allowed and leave invalid entries behind
+  int left = 1;
+  for (unsigned len = 1; len <= 15; len++) {
+    left <<= 1;
+    left -= count[len];
+    if (left < 0) {
+      return false;
+    }
+  }
+
+  uint16_t offsets[16];
+  offsets[1] = 0;
+  for (unsigned len = 1; len < 15; len++) {
+    offsets[len + 1] = offsets[len] + count[len];
+  }
+  uint16_t sorted[288 + 32];
+  for (unsigned sym = 0; sym < numSyms; sym++) {
+    if (codeLens[sym] != 0) {
+      sorted[offsets[codeLens[sym]]++] = sym;
+    }
+  }
+  const unsigned numCodes = offsets[15];
+
+  const size_t rootSize = size_t{1} << rootBits;
+  for (size_t i = 0; i < rootSize; i++) {
+    table[i] = INVALID_ENTRY;
+  }
+
+  size_t nextSubtable = rootSize;
+  size_t subtableStart = 0;
+  unsigned subtableBits = 0;
+  uint32_t currentPrefix = UINT32_MAX;
+  uint32_t code = 0;
+  unsigned prevLen = 0;
+
+  for (unsigned i = 0; i < numCodes; i++) {
+    const unsigned sym = sorted[i];
+    const unsigned len = codeLens[sym];
+    code <<= len - prevLen;
+    prevLen = len;
+    const uint32_t reversed = reverseBits(code++, len);
+
+    uint32_t entry;
+    switch (kind) {
+      case TableKind::PRECODE:
+        entry = makeEntry(len, KIND_LITERAL, 0, sym);
+        break;
+      case TableKind::LITLEN:
+        if (sym < 256) {
+          entry = makeEntry(len, KIND_LITERAL, 0, sym);
+        } else if (sym == 256) {
+          entry = makeEntry(len, KIND_END_OF_BLOCK, 0, 0);
+        } else if (sym < 286) {
+          entry = makeEntry(len, KIND_LENGTH, LENGTH_EXTRA_BITS[sym - 257], LENGTH_BASES[sym - 257]);
+        } else {
+          entry = INVALID_ENTRY | len;
+        }
+        break;
+      case TableKind::DIST:
+      default:
+        entry = sym < 30 ? makeEntry(len, KIND_DISTANCE, DIST_EXTRA_BITS[sym], DIST_BASES[sym]) : (INVALID_ENTRY | len);
+        break;
+    }
+
+    if (len <= rootBits) {
+      for (size_t index = reversed; index < rootSize; index += size_t{1} << len) {
+        table[index] = entry;
+      }
+    } else {
+      // Codes sharing a root prefix are contiguous in canonical order, so each prefix gets one subtable sized to
+      // cover the remaining codes under it
+      const uint32_t prefix = reversed & (rootSize - 1);
+      if (prefix != currentPrefix) {
+        subtableBits = len - rootBits;
+        int remaining = 1 << subtableBits;
+        while (subtableBits + rootBits < 15) {
+          remaining -= count[subtableBits + rootBits];
+          if (remaining <= 0) {
+            break;
+          }
+          subtableBits++;
+          remaining <<= 1;
+        }
+        subtableStart = nextSubtable;
+        nextSubtable += size_t{1} << subtableBits;
+        if (nextSubtable > enough) {
+          return false;
+        }
+        for (size_t index = subtableStart; index < nextSubtable; index++) {
+          table[index] = INVALID_ENTRY;
+        }
+        table[prefix] = makeEntry(rootBits, KIND_SUBTABLE, subtableBits, subtableStart);
+        currentPrefix = prefix;
+      }
+      for (size_t index = reversed >> rootBits; index < (size_t{1} << subtableBits);
+           index += size_t{1} << (len - rootBits)) {
+        table[subtableStart + index] = entry;
+      }
+    }
+    count[len]--;
+  }
+
+  if (kind == TableKind::LITLEN) {
+    // Merge literal pairs whose combined code length fits in the root table. Walking downwards means the second
+    // lookup (index >> len1 <= index) still sees the single literal entry.
+    for (size_t index = rootSize; index-- > 0;) {
+      const uint32_t first = table[index];
+      if (entryKind(first) != KIND_LITERAL || entryLength(first) >= rootBits) {
+        continue;
+      }
+      const uint32_t firstLen = entryLength(first);
+      const uint32_t second = table[index >> firstLen];
+      if (entryKind(second) != KIND_LITERAL || firstLen + entryLength(second) > rootBits) {
+        continue;
+      }
+      table[index] = makeEntry(firstLen + entryLength(second), KIND_LITERAL_PAIR, firstLen,
+                               entryValue(first) | (entryValue(second) << 8));
+    }
+  }
+  return true;
+}
+
+bool FastInflate::buildFixedTables() {
+  unsigned sym = 0;
+  for (; sym < 144; sym++) lens[sym] = 8;
+  for (; sym < 256; sym++) lens[sym] = 9;
+  for (; sym < 280; sym++) lens[sym] = 7;
+  for (; sym < 288; sym++) lens[sym] = 8;
+  for (; sym < 288 + 32; sym++) lens[sym] = 5;
+  return buildTable(litlenTable, LITLEN_ENOUGH, LITLEN_TABLE_BITS, lens, 288, TableKind::LITLEN) &&
+         buildTable(distTable, DIST_ENOUGH, DIST_TABLE_BITS, lens + 288, 32, TableKind::DIST);
+}
+
+bool FastInflate::decodeFast(const uint8_t*& inRef, const uint8_t* inEnd, uint8_t* out, const uint8_t* outStart,
+                             uint8_t*& outRef, const uint8_t* outEnd, const size_t windowMask, uint32_t& bitbufRef,
+                             uint32_t& bitcountRef) const {
+  // Work on local copies so the compiler can keep them in registers across the byte stores
+  const uint8_t* inNext = inRef;
+  uint8_t* outNext = outRef;
+  uint32_t bitbuf = bitbufRef;
+  uint32_t bitcount = bitcountRef;
+  const uint32_t outBase = totalOut - static_cast<uint32_t>(outStart - out);
+  const uint32_t* const litlen = litlenTable;
+  const uint32_t* const dist = distTable;
+  bool ok = true;
+
+#define FAST_REFILL()                        \
+  if (bitcount < 24) {                       \
+    uint32_t word;                           \
+    memcpy(&word, inNext, sizeof(word));     \
+    bitbuf |= word << bitcount;              \
+    inNext += (31 - bitcount) >> 3;          \
+    bitcount |= 24;                          \
+  }
+#define FAST_CONSUME(n) \
+  bitbuf >>= (n);       \
+  bitcount -= (n)
+
+  while (inEnd - inNext >= FAST_INPUT_MARGIN && outEnd - outNext >= FAST_OUTPUT_MARGIN) {
+    FAST_REFILL();
+    uint32_t entry = litlen[bitbuf & ((1u << LITLEN_TABLE_BITS) - 1)];
+    uint32_t kind = entryKind(entry);
+    if (kind == KIND_LITERAL_PAIR) {
+      outNext[0] = entryValue(entry) & 0xFF;
+      outNext[1] = entryValue(entry) >> 8;
+      outNext += 2;
+      FAST_CONSUME(entryLength(entry));
+      continue;
+    }
+    if (kind == KIND_SUBTABLE) {
+      entry = litlen[entryValue(entry) + ((bitbuf >> LITLEN_TABLE_BITS) & ((1u << entryAux(entry)) - 1))];
+      kind = entryKind(entry);
+    }
+    if (kind == KIND_LITERAL) {
+      *outNext++ = entryValue(entry);
+      FAST_CONSUME(entryLength(entry));
+      continue;
+    }
+    if (kind != KIND_LENGTH) {
+      // End of block and invalid codes take the checked path
+      break;
+    }
+
+    const uint32_t len = entryLength(entry);
+    const uint32_t length = entryValue(entry) + ((bitbuf >> len) & ((1u << entryAux(entry)) - 1));
+    FAST_CONSUME(len + entryAux(entry));
+    FAST_REFILL();
+    const uint32_t distEntry = lookup(dist, DIST_TABLE_BITS, bitbuf);
+    if (entryKind(distEntry) != KIND_DISTANCE) {
+      // The buffer holds at least 24 real bits here, so this is a corrupt stream rather than a short one
+      ok = false;
+      break;
+    }
+    FAST_CONSUME(entryLength(distEntry));
+    FAST_REFILL();
+    const uint32_t extra = entryAux(distEntry);
+    const uint32_t distance = entryValue(distEntry) + (bitbuf & ((1u << extra) - 1));
+    FAST_CONSUME(extra);
+    if (distance > outBase + static_cast<uint32_t>(outNext - out)) {
+      ok = false;
+      break;
+    }
+
+    copyMatch(out, outNext - out, distance, length, windowMask);
+    outNext += length;
+  }
+
+#undef FAST_REFILL
+#undef FAST_CONSUME
+
+  inRef = inNext;
+  outRef = outNext;
+  bitbufRef = bitbuf;
+  bitcountRef = bitcount;
+  return ok;
+}
+
+FastInflate::Status FastInflate::inflate(const uint8_t* in, size_t* inBytes, uint8_t* out, const size_t outPos,
+                                         size_t* outBytes, const size_t windowMask, const bool hasMoreInput) {
+  const uint8_t* inNext = in;
+  const uint8_t* const inEnd = in + *inBytes;
+  uint8_t* const outStart = out + outPos;
+  uint8_t* outNext = outStart;
+  uint8_t* const outEnd = outStart + *outBytes;
+  uint32_t bitbuf = bitBuffer;
+  uint32_t bitcount = bitCount;
+  Status status = FAILED;
+
+  // Tops the bit buffer up to at least 24 bits with a single unaligned load. Needs bitcount < 24 and four input
+  // bytes; bits loaded above bitcount belong to the next unconsumed byte and are ORed in again unchanged later.
+  const auto refillWord = [&]() {
+    uint32_t word;
+    memcpy(&word, inNext, sizeof(word));
+    bitbuf |= word << bitcount;
+    inNext += (31 - bitcount) >> 3;
+    bitcount |= 24;
+  };
+  const auto refill = [&]() {
+    if (bitcount >= 24) {
+      return;
+    }
+    if (inEnd - inNext >= 4) {
+      refillWord();
+      return;
+    }
+    while (bitcount <= 24 && inNext < inEnd) {
+      bitbuf |= static_cast<uint32_t>(*inNext++) << bitcount;
+      bitcount += 8;
+    }
+  };
+  // Only valid for n <= 24, or n == 32 on a byte aligned buffer
+  const auto ensure = [&](const uint32_t n) {
+    if (bitcount >= n) {
+      return true;
+    }
+    refill();
+    while (bitcount < n && bitcount <= 24 && inNext < inEnd) {
+      bitbuf |= static_cast<uint32_t>(*inNext++) << bitcount;
+      bitcount += 8;
+    }
+    return bitcount >= n;
+  };
+  const auto consume = [&](const uint32_t n) {
+    bitbuf >>= n;
+    bitcount -= n;
+  };
+
+  if (state == STREAM_DONE) {
+    status = DONE;
+    goto finish;
+  }
+  if (state == STREAM_FAILED) {
+    goto fail;
+  }
+
+  for (;;) {
+    switch (state) {
+      case BLOCK_HEADER: {
+        if (!ensure(3)) goto needInput;
+        finalBlock = bitbuf & 1;
+        const uint32_t type = (bitbuf >> 1) & 3;
+        consume(3);
+        if (type == 0) {
+          state = STORED_HEADER;
+        } else if (type == 1) {
+          if (!buildFixedTables()) goto fail;
+          state = LITLEN;
+        } else if (type == 2) {
+          state = DYNAMIC_COUNTS;
+        } else {
+          goto fail;
+        }
+        break;
+      }
+
+      case STORED_HEADER: {
+        consume(bitcount & 7);
+        if (!ensure(32)) goto needInput;
+        const uint32_t len = bitbuf & 0xFFFF;
+        const uint32_t nlen = (bitbuf >> 16) & 0xFFFF;
+        if (len != (~nlen & 0xFFFF)) goto fail;
+        consume(16);
+        consume(16);
+        storedRemaining = len;
+        state = STORED_COPY;
+        break;
+      }
+
+      case STORED_COPY: {
+        while (storedRemaining > 0 && bitcount >= 8) {
+          if (outNext == outEnd) goto outputFull;
+          *outNext++ = bitbuf & 0xFF;
+          consume(8);
+          storedRemaining--;
+        }
+        if (storedRemaining > 0) {
+          // Bit buffer is drained; anything left in it is a preview of bytes copied directly below
+          bitbuf = 0;
+          bitcount = 0;
+          size_t n = storedRemaining;
+          if (n > static_cast<size_t>(outEnd - outNext)) n = outEnd - outNext;
+          if (n > static_cast<size_t>(inEnd - inNext)) n = inEnd - inNext;
+          memcpy(outNext, inNext, n);
+          outNext += n;
+          inNext += n;
+          storedRemaining -= n;
+          if (storedRemaining > 0) {
+            if (outNext == outEnd) goto outputFull;
+            goto needInput;
+          }
+        }
+        state = finalBlock ? STREAM_DONE : BLOCK_HEADER;
+        break;
+      }
+
+      case DYNAMIC_COUNTS: {
+        if (!ensure(14)) goto needInput;
+        numLitlen = 257 + (bitbuf & 31);
+        numDist = 1 + ((bitbuf >> 5) & 31);
+        numPrecode = 4 + ((bitbuf >> 10) & 15);
+        consume(14);
+        if (numLitlen > 286 || numDist > 30) goto fail;
+        memset(precodeLens, 0, sizeof(precodeLens));
+        lensRead = 0;
+        state = DYNAMIC_PRECODE;
+        break;
+      }
+
+      case DYNAMIC_PRECODE: {
+        while (lensRead < numPrecode) {
+          if (!ensure(3)) goto needInput;
+          precodeLens[PRECODE_ORDER[lensRead++]] = bitbuf & 7;
+          consume(3);
+        }
+        if (!buildTable(precodeTable, PRECODE_ENOUGH, PRECODE_TABLE_BITS, precodeLens, 19, TableKind::PRECODE)) {
+          goto fail;
+        }
+        lensRead = 0;
+        state = DYNAMIC_LENS;
+        break;
+      }
+
+      case DYNAMIC_LENS: {
+        const unsigned total = numLitlen + numDist;
+        while (lensRead < total) {
+          refill();
+          const uint32_t entry = precodeTable[bitbuf & ((1u << PRECODE_TABLE_BITS) - 1)];
+          if (entryKind(entry) == KIND_INVALID) goto invalidCode;
+          const uint32_t len = entryLength(entry);
+          const uint32_t sym = entryValue(entry);
+          const uint32_t extra = sym == 16 ? 2 : sym == 17 ? 3 : sym == 18 ? 7 : 0;
+          if (!ensure(len + extra)) goto needInput;
+          const uint32_t extraValue = (bitbuf >> len) & ((1u << extra) - 1);
+          consume(len + extra);
+
+          if (sym < 16) {
+            lens[lensRead++] = sym;
+            continue;
+          }
+          uint8_t value = 0;
+          unsigned repeat;
+          if (sym == 16) {
+            if (lensRead == 0) goto fail;
+            value = lens[lensRead - 1];
+            repeat = 3 + extraValue;
+          } else if (sym == 17) {
+            repeat = 3 + extraValue;
+          } else {
+            repeat = 11 + extraValue;
+          }
+          if (lensRead + repeat > total) goto fail;
+          memset(lens + lensRead, value, repeat);
+          lensRead += repeat;
+        }
+        if (lens[256] == 0) goto fail;
+        if (!buildTable(litlenTable, LITLEN_ENOUGH, LITLEN_TABLE_BITS, lens, numLitlen, TableKind::LITLEN) ||
+            !buildTable(distTable, DIST_ENOUGH, DIST_TABLE_BITS, lens + numLitlen, numDist, TableKind::DIST)) {
+          goto fail;
+        }
+        state = LITLEN;
+        break;
+      }
+
+      case LITLEN: {
+        for (;;) {
+          if (inEnd - inNext >= FAST_INPUT_MARGIN && outEnd - outNext >= FAST_OUTPUT_MARGIN) {
+            if (!decodeFast(inNext, inEnd, out, outStart, outNext, outEnd, windowMask, bitbuf, bitcount)) goto fail;
+          }
+
+          refill();
+          const uint32_t entry = lookup(litlenTable, LITLEN_TABLE_BITS, bitbuf);
+          const uint32_t len = entryLength(entry);
+          const uint32_t kind = entryKind(entry);
+
+          if (kind == KIND_LITERAL_PAIR) {
+            // A pair never needs more bits than the root table, which a refill with input available always covers
+            if (bitcount < len) goto needInput;
+            if (outEnd - outNext >= 2) {
+              outNext[0] = entryValue(entry) & 0xFF;
+              outNext[1] = entryValue(entry) >> 8;
+              outNext += 2;
+              consume(len);
+              continue;
+            }
+            if (outNext == outEnd) goto outputFull;
+            *outNext++ = entryValue(entry) & 0xFF;
+            consume(entryAux(entry));
+            continue;
+          }
+          if (kind == KIND_LITERAL) {
+            if (bitcount < len) goto needInput;
+            if (outNext == outEnd) goto outputFull;
+            *outNext++ = entryValue(entry);
+            consume(len);
+            continue;
+          }
+          if (kind == KIND_LENGTH) {
+            const uint32_t extra = entryAux(entry);
+            if (!ensure(len + extra)) goto needInput;
+            matchLength = entryValue(entry) + ((bitbuf >> len) & ((1u << extra) - 1));
+            consume(len + extra);
+            state = DIST;
+            break;
+          }
+          if (kind == KIND_END_OF_BLOCK) {
+            if (bitcount < len) goto needInput;
+            consume(len);
+            state = finalBlock ? STREAM_DONE : BLOCK_HEADER;
+            break;
+          }
+          goto invalidCode;
+        }
+        break;
+      }
+
+      case DIST: {
+        refill();
+        const uint32_t entry = lookup(distTable, DIST_TABLE_BITS, bitbuf);
+        if (entryKind(entry) != KIND_DISTANCE) goto invalidCode;
+        if (bitcount < entryLength(entry)) goto needInput;
+        consume(entryLength(entry));
+        matchDistance = entryValue(entry);
+        distExtra = entryAux(entry);
+        state = DIST_EXTRA;
+      }
+        [[fallthrough]];
+
+      case DIST_EXTRA: {
+        if (!ensure(distExtra)) goto needInput;
+        const uint32_t distance = matchDistance + (bitbuf & ((1u << distExtra) - 1));
+        consume(distExtra);
+        if (distance > totalOut + static_cast<uint32_t>(outNext - outStart)) goto fail;
+        matchDistance = distance;
+        state = MATCH_COPY;
+      }
+        [[fallthrough]];
+
+      case MATCH_COPY: {
+        size_t n = matchLength;
+        const size_t space = outEnd - outNext;
+        if (n > space) n = space;
+        copyMatch(out, outNext - out, matchDistance, n, windowMask);
+        outNext += n;
+        matchLength -= n;
+        if (matchLength > 0) goto outputFull;
+        state = LITLEN;
+        break;
+      }
+
+      case STREAM_DONE:
+        status = DONE;
+        goto finish;
+
+      default:
+        goto fail;
+    }
+  }
+
+invalidCode:
+  // With the input exhausted the lookup may have run on missing bits, so only a full buffer proves corruption
+  if (bitcount >= 15 || inNext < inEnd) goto fail;
+
+needInput:
+  if (!hasMoreInput) goto fail;
+  status = NEEDS_MORE_INPUT;
+  goto finish;
+
+outputFull:
+  status = HAS_MORE_OUTPUT;
+  goto finish;
+
+fail:
+  state = STREAM_FAILED;
+  status = FAILED;
+
+finish:
+  bitBuffer = bitbuf;
+  bitCount = bitcount;
+  totalOut += outNext - outStart;
+  *inBytes = inNext - in;
+  *outBytes = outNext - outStart;
+  return status;
+}
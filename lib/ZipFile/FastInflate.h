@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Table-driven raw deflate decoder, an alternative to miniz tinfl selected with -DZIP_FAST_INFLATE=1.
+//
+// Decoding uses libdeflate-style lookup tables: a 10-bit root table (with subtables for longer codes) whose literal
+// entries pack two literals when both codes fit in the root bits, and a 32-bit bit buffer refilled four bytes at a
+// time. Like tinfl it is resumable at symbol boundaries, so it can be fed input in chunks and drained through a
+// circular 32KB window. All state is plain data, which lets inflate checkpoints snapshot it with memcpy.
+class FastInflate {
+ public:
+  enum Status : int8_t { FAILED = -1, DONE = 0, NEEDS_MORE_INPUT = 1, HAS_MORE_OUTPUT = 2 };
+
+  static constexpr size_t WINDOW_SIZE = 32768;
+  // windowMask to pass when the output buffer is a circular WINDOW_SIZE window
+  static constexpr size_t CIRCULAR_WINDOW = WINDOW_SIZE - 1;
+  // windowMask to pass when the output buffer holds the whole inflated stream
+  static constexpr size_t FLAT_BUFFER = SIZE_MAX;
+
+  void init();
+  // Inflates from in (*inBytes available, updated to the number consumed) into out[outPos, outPos + *outBytes)
+  // (updated to the number produced). Back references are resolved against out using windowMask.
+  Status inflate(const uint8_t* in, size_t* inBytes, uint8_t* out, size_t outPos, size_t* outBytes, size_t windowMask,
+                 bool hasMoreInput);
+
+ private:
+  static constexpr unsigned LITLEN_TABLE_BITS = 10;
+  static constexpr unsigned DIST_TABLE_BITS = 8;
+  static constexpr unsigned PRECODE_TABLE_BITS = 7;
+  // Worst case root + subtable sizes (zlib's "enough" for 288/32 symbols, 15 bit codes)
+  static constexpr size_t LITLEN_ENOUGH = 1334;
+  static constexpr size_t DIST_ENOUGH = 402;
+  static constexpr size_t PRECODE_ENOUGH = 1 << PRECODE_TABLE_BITS;
+
+  enum class TableKind : uint8_t { PRECODE, LITLEN, DIST };
+
+  enum State : uint8_t {
+    BLOCK_HEADER,
+    STORED_HEADER,
+    STORED_COPY,
+    DYNAMIC_COUNTS,
+    DYNAMIC_PRECODE,
+    DYNAMIC_LENS,
+    LITLEN,
+    DIST,
+    DIST_EXTRA,
+    MATCH_COPY,
+    STREAM_DONE,
+    STREAM_FAILED
+  };
+
+  uint32_t litlenTable[LITLEN_ENOUGH];
+  uint32_t distTable[DIST_ENOUGH];
+  uint32_t precodeTable[PRECODE_ENOUGH];
+  uint8_t lens[288 + 32];
+  uint8_t precodeLens[19];
+
+  uint32_t bitBuffer;
+  uint32_t bitCount;
+  uint32_t totalOut;
+  uint32_t storedRemaining;
+  uint16_t numLitlen;
+  uint16_t numDist;
+  uint16_t numPrecode;
+  uint16_t lensRead;
+  uint16_t matchLength;
+  uint16_t matchDistance;
+  uint8_t distExtra;
+  uint8_t state;
+  bool finalBlock;
+
+  static bool buildTable(uint32_t* table, size_t enough, unsigned rootBits, const uint8_t* codeLens, unsigned numSyms,
+                         TableKind kind);
+  bool buildFixedTables();
+  // Decodes literals and matches without per-symbol bounds checks while the input and output margins allow it.
+  // Returns false on a corrupt match; stops early (leaving the code unconsumed) at end of block or invalid codes.
+  bool decodeFast(const uint8_t*& inRef, const uint8_t* inEnd, uint8_t* out, const uint8_t* outStart, uint8_t*& outRef,
+                  const uint8_t* outEnd, size_t windowMask, uint32_t& bitbufRef, uint32_t& bitcountRef) const;
+};
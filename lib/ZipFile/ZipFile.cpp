@@ -1,36 +1,85 @@
 #include "ZipFile.h"
 
+#include <FileHandleCache.h>
 #include <HardwareSerial.h>
 #include <SDCardManager.h>
+#include <Serialization.h>
 #include <miniz.h>
 
 #include <algorithm>
 
+#if ZIP_FAST_INFLATE
+#include "FastInflate.h"
+#endif
+
+namespace {
+// Thin wrappers so the rest of this file is independent of the inflate engine. Statuses follow tinfl's convention:
+// negative on failure, 0 when the stream is done, positive when more input or output space is needed.
+#if ZIP_FAST_INFLATE
+using Inflator = FastInflate;
+static_assert(FastInflate::WINDOW_SIZE == TINFL_LZ_DICT_SIZE, "Inflate window size mismatch");
+
+void initInflator(Inflator* inflator) { inflator->init(); }
+
+int inflateToWindow(Inflator* inflator, const uint8_t* in, size_t* inBytes, uint8_t* window, const size_t windowPos,
+                    size_t* outBytes, const bool hasMoreInput) {
+  return inflator->inflate(in, inBytes, window, windowPos, outBytes, FastInflate::CIRCULAR_WINDOW, hasMoreInput);
+}
+
+int inflateToBuffer(Inflator* inflator, const uint8_t* in, size_t* inBytes, uint8_t* out, size_t* outBytes) {
+  return inflator->inflate(in, inBytes, out, 0, outBytes, FastInflate::FLAT_BUFFER, false);
+}
+#else
+using Inflator = tinfl_decompressor;
+
+void initInflator(Inflator* inflator) {
+  memset(inflator, 0, sizeof(Inflator));
+  tinfl_init(inflator);
+}
+
+int inflateToWindow(Inflator* inflator, const uint8_t* in, size_t* inBytes, uint8_t* window, const size_t windowPos,
+                    size_t* outBytes, const bool hasMoreInput) {
+  return tinfl_decompress(inflator, in, inBytes, window, window + windowPos, outBytes,
+                          hasMoreInput ? TINFL_FLAG_HAS_MORE_INPUT : 0);
+}
+
+int inflateToBuffer(Inflator* inflator, const uint8_t* in, size_t* inBytes, uint8_t* out, size_t* outBytes) {
+  return tinfl_decompress(inflator, in, inBytes, nullptr, out, outBytes, TINFL_FLAG_USING_NON_WRAPPING_OUTPUT_BUF);
+}
+#endif
+}  // namespace
+
 bool inflateOneShot(const uint8_t* inputBuf, const size_t deflatedSize, uint8_t* outputBuf, const size_t inflatedSize) {
   // Setup inflator
-  const auto inflator = static_cast<tinfl_decompressor*>(malloc(sizeof(tinfl_decompressor)));
+  const auto inflator = static_cast<Inflator*>(malloc(sizeof(Inflator)));
   if (!inflator) {
     Serial.printf("[%lu] [ZIP] Failed to allocate memory for inflator\n", millis());
     return false;
   }
-  memset(inflator, 0, sizeof(tinfl_decompressor));
-  tinfl_init(inflator);
+  initInflator(inflator);
 
   size_t inBytes = deflatedSize;
   size_t outBytes = inflatedSize;
-  const tinfl_status status = tinfl_decompress(inflator, inputBuf, &inBytes, nullptr, outputBuf, &outBytes,
-                                               TINFL_FLAG_USING_NON_WRAPPING_OUTPUT_BUF);
+  const int status = inflateToBuffer(inflator, inputBuf, &inBytes, outputBuf, &outBytes);
   free(inflator);
 
-  if (status != TINFL_STATUS_DONE) {
-    Serial.printf("[%lu] [ZIP] tinfl_decompress() failed with status %d\n", millis(), status);
+  if (status != 0) {
+    Serial.printf("[%lu] [ZIP] Inflate failed with status %d\n", millis(), status);
     return false;
   }
 
   return true;
 }
 
-bool ZipFile::loadAllFileStatSlims() {
+bool ZipFile::indexEntryLess(const IndexEntry& a, const IndexEntry& b) {
+  return a.hash < b.hash || (a.hash == b.hash && a.nameLen < b.nameLen);
+}
+
+bool ZipFile::buildIndex() {
+  if (indexPath.empty()) {
+    return false;
+  }
+
   const bool wasOpen = isOpen();
   if (!wasOpen && !open()) {
     return false;
@@ -43,64 +92,296 @@ bool ZipFile::loadAllFileStatSlims() {
     return false;
   }
 
-  file.seek(zipDetails.centralDirOffset);
+  // Building takes one sort buffer of INDEX_RUN_ENTRIES whatever the size of the central directory. Directories that
+  // don't fit are sorted a buffer at a time into runs in a scratch file, which are then merged into the index.
+  const auto entries = static_cast<IndexEntry*>(malloc(sizeof(IndexEntry) * INDEX_RUN_ENTRIES));
+  if (!entries) {
+    Serial.printf("[%lu] [ZIP] Skipping central directory index, no memory for its sort buffer\n", millis());
+    if (!wasOpen) {
+      close();
+    }
+    return false;
+  }
 
-  uint32_t sig;
-  char itemName[256];
-  fileStatSlimCache.clear();
-  fileStatSlimCache.reserve(zipDetails.totalEntries);
+  const std::string scratchPath = indexPath + ".tmp";
+  FsFile scratch;
+  uint16_t buffered = 0;
+  const auto spillRun = [&entries, &scratch, &scratchPath, &buffered] {
+    std::sort(entries, entries + buffered, indexEntryLess);
+    const size_t runSize = sizeof(IndexEntry) * buffered;
+    if ((!scratch && !SdMan.openFileForWrite("ZIP", scratchPath, scratch)) ||
+        scratch.write(reinterpret_cast<const uint8_t*>(entries), runSize) != runSize) {
+      return false;
+    }
+    buffered = 0;
+    return true;
+  };
+
+  uint16_t count = 0;
+  bool spillFailed = false;
+  {
+    BufferedFsReader reader(file);
+    reader.seek(zipDetails.centralDirOffset);
+
+    constexpr size_t centralDirHeaderSize = 46;
+    uint8_t header[centralDirHeaderSize];
+    char itemName[256];
+
+    while (count < zipDetails.totalEntries && reader.read(header, centralDirHeaderSize) == centralDirHeaderSize) {
+      uint32_t sig;
+      memcpy(&sig, &header[0], 4);
+      if (sig != 0x02014b50) break;  // End of list
+
+      IndexEntry& entry = entries[buffered];
+      uint16_t m, k;
+      memcpy(&entry.method, &header[10], 2);
+      memcpy(&entry.compressedSize, &header[20], 4);
+      memcpy(&entry.uncompressedSize, &header[24], 4);
+      memcpy(&entry.nameLen, &header[28], 2);
+      memcpy(&m, &header[30], 2);
+      memcpy(&k, &header[32], 2);
+      memcpy(&entry.localHeaderOffset, &header[42], 4);
+
+      if (entry.nameLen < 256) {
+        reader.read(itemName, entry.nameLen);
+        entry.hash = fnvHash64(itemName, entry.nameLen);
+        buffered++;
+        count++;
+      } else {
+        // Name too long to ever be looked up, skip it
+        reader.seekCur(entry.nameLen);
+      }
 
-  while (file.available()) {
-    file.read(&sig, 4);
-    if (sig != 0x02014b50) break;  // End of list
+      // Skip extra field + comment
+      reader.seekCur(m + k);
 
-    FileStatSlim fileStat = {};
+      if (buffered == INDEX_RUN_ENTRIES && !spillRun()) {
+        spillFailed = true;
+        break;
+      }
+    }
+  }
 
-    file.seekCur(6);
-    file.read(&fileStat.method, 2);
-    file.seekCur(8);
-    file.read(&fileStat.compressedSize, 4);
-    file.read(&fileStat.uncompressedSize, 4);
-    uint16_t nameLen, m, k;
-    file.read(&nameLen, 2);
-    file.read(&m, 2);
-    file.read(&k, 2);
-    file.seekCur(8);
-    file.read(&fileStat.localHeaderOffset, 4);
-    file.read(itemName, nameLen);
-    itemName[nameLen] = '\0';
+  const uint32_t zipFileSize = file.size();
+  if (!wasOpen) {
+    close();
+  }
 
-    fileStatSlimCache.emplace(itemName, fileStat);
+  const bool merge = !!scratch;
+  if (merge) {
+    spillFailed = spillFailed || (buffered > 0 && !spillRun());
+    scratch.close();
+  } else {
+    std::sort(entries, entries + count, indexEntryLess);
+  }
 
-    // Skip the rest of this entry (extra field + comment)
-    file.seekCur(m + k);
+  FsFile outFile;
+  if (spillFailed || !FILE_CACHE.openFileForWrite("ZIP", indexPath, outFile)) {
+    Serial.printf("[%lu] [ZIP] Skipping central directory index, could not write it\n", millis());
+    free(entries);
+    if (merge) {
+      SdMan.remove(scratchPath.c_str());
+    }
+    return false;
   }
 
-  // Set cursor to start of central directory for sequential access
-  lastCentralDirPos = zipDetails.centralDirOffset;
-  lastCentralDirPosValid = true;
+  // Version is written last so a partially written index is never picked up
+  serialization::writePod(outFile, static_cast<uint8_t>(0));
+  serialization::writePod(outFile, zipFileSize);
+  serialization::writePod(outFile, count);
+  bool written;
+  if (merge) {
+    written = mergeIndexRuns(scratchPath, count, entries, outFile);
+    SdMan.remove(scratchPath.c_str());
+  } else {
+    const size_t indexSize = sizeof(IndexEntry) * count;
+    written = outFile.write(reinterpret_cast<const uint8_t*>(entries), indexSize) == indexSize;
+  }
+  if (written) {
+    outFile.seek(0);
+    serialization::writePod(outFile, INDEX_VERSION);
+  }
+  outFile.close();
+  free(entries);
 
-  if (!wasOpen) {
-    close();
+  // Force the index to be re-validated on next lookup
+  indexFile.close();
+  indexState = IndexState::UNCHECKED;
+
+  if (!written) {
+    Serial.printf("[%lu] [ZIP] Skipping central directory index, could not write it\n", millis());
+    return false;
   }
+  Serial.printf("[%lu] [ZIP] Built central directory index with %u entries in %u runs\n", millis(), count,
+                merge ? (count + INDEX_RUN_ENTRIES - 1) / INDEX_RUN_ENTRIES : 1);
   return true;
 }
 
-bool ZipFile::loadFileStatSlim(const char* filename, FileStatSlim* fileStat) {
-  if (!fileStatSlimCache.empty()) {
-    const auto it = fileStatSlimCache.find(filename);
-    if (it != fileStatSlimCache.end()) {
-      *fileStat = it->second;
+bool ZipFile::mergeIndexRuns(const std::string& scratchPath, const uint16_t count, IndexEntry* buffer,
+                             FsFile& outFile) {
+  FsFile scratch;
+  if (!SdMan.openFileForRead("ZIP", scratchPath, scratch)) {
+    return false;
+  }
+
+  // Every run reads ahead into an equal share of the sort buffer, at least a few entries with the 65535 entry maximum
+  struct Run {
+    uint32_t next;
+    uint32_t end;
+    uint16_t cursor;
+    uint16_t filled;
+  };
+  const uint16_t runCount = (count + INDEX_RUN_ENTRIES - 1) / INDEX_RUN_ENTRIES;
+  const uint16_t share = INDEX_RUN_ENTRIES / runCount;
+  std::vector<Run> runs(runCount);
+  const auto refill = [&scratch, &runs, buffer, share](const uint16_t r) {
+    Run& run = runs[r];
+    run.cursor = 0;
+    run.filled = static_cast<uint16_t>(std::min<uint32_t>(share, run.end - run.next));
+    if (run.filled == 0) {
       return true;
     }
+    const size_t size = sizeof(IndexEntry) * run.filled;
+    if (!scratch.seek(sizeof(IndexEntry) * run.next) ||
+        scratch.read(reinterpret_cast<uint8_t*>(buffer + r * share), size) != static_cast<int>(size)) {
+      return false;
+    }
+    run.next += run.filled;
+    return true;
+  };
+
+  bool ok = true;
+  for (uint16_t r = 0; r < runCount && ok; r++) {
+    runs[r].next = static_cast<uint32_t>(r) * INDEX_RUN_ENTRIES;
+    runs[r].end = std::min<uint32_t>(runs[r].next + INDEX_RUN_ENTRIES, count);
+    ok = refill(r);
+  }
+
+  BufferedFsWriter writer(outFile);
+  for (uint16_t written = 0; ok && written < count; written++) {
+    // Few runs even for the largest directories, a linear pick of the smallest head is cheap next to the SD reads
+    int smallest = -1;
+    for (uint16_t r = 0; r < runCount; r++) {
+      if (runs[r].cursor < runs[r].filled &&
+          (smallest < 0 || indexEntryLess(buffer[r * share + runs[r].cursor],
+                                          buffer[smallest * share + runs[smallest].cursor]))) {
+        smallest = r;
+      }
+    }
+    if (smallest < 0) {
+      ok = false;
+      break;
+    }
+    Run& run = runs[smallest];
+    writer.write(&buffer[smallest * share + run.cursor], sizeof(IndexEntry));
+    if (++run.cursor == run.filled) {
+      ok = refill(smallest);
+    }
+  }
+  ok = writer.flush() && ok;
+  scratch.close();
+  return ok;
+}
+
+bool ZipFile::openIndex() {
+  if (indexState != IndexState::UNCHECKED) {
+    return indexState == IndexState::READY;
+  }
+
+  // Only check once per open zip, if the index is missing or stale we fall back to scanning the central directory
+  indexState = IndexState::UNAVAILABLE;
+  if (indexPath.empty() || !SdMan.exists(indexPath.c_str())) {
     return false;
   }
 
+  if (!FILE_CACHE.openFileForRead("ZIP", indexPath, indexFile)) {
+    return false;
+  }
+
+  uint8_t version;
+  uint32_t zipFileSize;
+  serialization::readPod(indexFile, version);
+  serialization::readPod(indexFile, zipFileSize);
+  serialization::readPod(indexFile, indexEntryCount);
+
+  if (version != INDEX_VERSION || zipFileSize != file.size() ||
+      indexFile.size() != INDEX_HEADER_SIZE + sizeof(IndexEntry) * indexEntryCount) {
+    Serial.printf("[%lu] [ZIP] Ignoring stale central directory index\n", millis());
+    indexFile.close();
+    return false;
+  }
+
+  indexState = IndexState::READY;
+  return true;
+}
+
+bool ZipFile::readIndexEntry(const uint16_t index, IndexEntry& entry) {
+  indexFile.seek(INDEX_HEADER_SIZE + sizeof(IndexEntry) * index);
+  return indexFile.read(reinterpret_cast<uint8_t*>(&entry), sizeof(IndexEntry)) == sizeof(IndexEntry);
+}
+
+bool ZipFile::loadFileStatSlimFromIndex(const char* filename, FileStatSlim* fileStat) {
+  const size_t nameLen = strlen(filename);
+  const uint64_t hash = fnvHash64(filename, nameLen);
+
+  // Binary search for the first entry not less than (hash, nameLen)
+  IndexEntry entry = {};
+  uint16_t lo = 0;
+  uint16_t hi = indexEntryCount;
+  while (lo < hi) {
+    const uint16_t mid = lo + (hi - lo) / 2;
+    if (!readIndexEntry(mid, entry)) {
+      return false;
+    }
+    if (entry.hash < hash || (entry.hash == hash && entry.nameLen < nameLen)) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+
+  // The hash only narrows it down, the name in the entry's local header settles it (and any hash collision)
+  for (; lo < indexEntryCount && readIndexEntry(lo, entry) && entry.hash == hash && entry.nameLen == nameLen; lo++) {
+    if (localHeaderNameMatches(entry.localHeaderOffset, filename, nameLen)) {
+      fileStat->method = entry.method;
+      fileStat->compressedSize = entry.compressedSize;
+      fileStat->uncompressedSize = entry.uncompressedSize;
+      fileStat->localHeaderOffset = entry.localHeaderOffset;
+      return true;
+    }
+  }
+  return false;
+}
+
+bool ZipFile::localHeaderNameMatches(const uint32_t localHeaderOffset, const char* filename, const size_t nameLen) {
+  constexpr size_t localHeaderSize = 30;
+  uint8_t header[localHeaderSize];
+  char name[256];
+  if (nameLen >= sizeof(name) || !file.seek(localHeaderOffset) ||
+      file.read(header, localHeaderSize) != static_cast<int>(localHeaderSize)) {
+    return false;
+  }
+  const uint32_t sig = header[0] | (header[1] << 8) | (header[2] << 16) | (static_cast<uint32_t>(header[3]) << 24);
+  const uint16_t headerNameLen = header[26] | (header[27] << 8);
+  return sig == 0x04034b50 && headerNameLen == nameLen &&
+         file.read(reinterpret_cast<uint8_t*>(name), nameLen) == static_cast<int>(nameLen) &&
+         memcmp(name, filename, nameLen) == 0;
+}
+
+bool ZipFile::loadFileStatSlim(const char* filename, FileStatSlim* fileStat) {
   const bool wasOpen = isOpen();
   if (!wasOpen && !open()) {
     return false;
   }
 
+  if (openIndex()) {
+    const bool found = loadFileStatSlimFromIndex(filename, fileStat);
+    if (!wasOpen) {
+      close();
+    }
+    return found;
+  }
+
   if (!loadZipDetails()) {
     if (!wasOpen) {
       close();
@@ -114,19 +395,20 @@ bool ZipFile::loadFileStatSlim(const char* filename, FileStatSlim* fileStat) {
   bool wrapped = false;
   bool found = false;
 
-  file.seek(startPos);
+  BufferedFsReader reader(file);
+  reader.seek(startPos);
 
   uint32_t sig;
   char itemName[256];
 
   while (true) {
-    uint32_t entryStart = file.position();
+    uint32_t entryStart = reader.position();
 
-    if (file.read(&sig, 4) != 4 || sig != 0x02014b50) {
+    if (reader.read(&sig, 4) != 4 || sig != 0x02014b50) {
       // End of central directory
       if (!wrapped && lastCentralDirPosValid && startPos != zipDetails.centralDirOffset) {
         // Wrap around to beginning
-        file.seek(zipDetails.centralDirOffset);
+        reader.seek(zipDetails.centralDirOffset);
         wrapped = true;
         continue;
       }
@@ -138,37 +420,37 @@ bool ZipFile::loadFileStatSlim(const char* filename, FileStatSlim* fileStat) {
       break;
     }
 
-    file.seekCur(6);
-    file.read(&fileStat->method, 2);
-    file.seekCur(8);
-    file.read(&fileStat->compressedSize, 4);
-    file.read(&fileStat->uncompressedSize, 4);
+    reader.seekCur(6);
+    reader.read(&fileStat->method, 2);
+    reader.seekCur(8);
+    reader.read(&fileStat->compressedSize, 4);
+    reader.read(&fileStat->uncompressedSize, 4);
     uint16_t nameLen, m, k;
-    file.read(&nameLen, 2);
-    file.read(&m, 2);
-    file.read(&k, 2);
-    file.seekCur(8);
-    file.read(&fileStat->localHeaderOffset, 4);
+    reader.read(&nameLen, 2);
+    reader.read(&m, 2);
+    reader.read(&k, 2);
+    reader.seekCur(8);
+    reader.read(&fileStat->localHeaderOffset, 4);
 
     if (nameLen < 256) {
-      file.read(itemName, nameLen);
+      reader.read(itemName, nameLen);
       itemName[nameLen] = '\0';
 
       if (strcmp(itemName, filename) == 0) {
         // Found it! Update cursor to next entry
-        file.seekCur(m + k);
-        lastCentralDirPos = file.position();
+        reader.seekCur(m + k);
+        lastCentralDirPos = reader.position();
         lastCentralDirPosValid = true;
         found = true;
         break;
       }
     } else {
       // Name too long, skip it
-      file.seekCur(nameLen);
+      reader.seekCur(nameLen);
     }
 
     // Skip extra field + comment
-    file.seekCur(m + k);
+    reader.seekCur(m + k);
   }
 
   if (!wasOpen) {
@@ -279,7 +561,7 @@ bool ZipFile::loadZipDetails() {
 }
 
 bool ZipFile::open() {
-  if (!SdMan.openFileForRead("ZIP", filePath, file)) {
+  if (!FILE_CACHE.openFileForRead("ZIP", filePath, file)) {
     return false;
   }
   return true;
@@ -289,6 +571,10 @@ bool ZipFile::close() {
   if (file) {
     file.close();
   }
+  if (indexFile) {
+    indexFile.close();
+  }
+  indexState = IndexState::UNCHECKED;
   lastCentralDirPos = 0;
   lastCentralDirPosValid = false;
   return true;
@@ -314,6 +600,38 @@ int ZipFile::fillUncompressedSizes(std::vector<SizeTarget>& targets, std::vector
     return 0;
   }
 
+  int matched = 0;
+
+  if (openIndex()) {
+    // Both the targets and the index are sorted by (hash, len), so a single merge pass over the index is enough
+    auto it = targets.begin();
+    IndexEntry entry = {};
+    BufferedFsReader reader(indexFile);
+    reader.seek(INDEX_HEADER_SIZE);
+    for (uint16_t i = 0; i < indexEntryCount && it != targets.end(); i++) {
+      if (reader.read(&entry, sizeof(IndexEntry)) != sizeof(IndexEntry)) {
+        break;
+      }
+
+      while (it != targets.end() && (it->hash < entry.hash || (it->hash == entry.hash && it->len < entry.nameLen))) {
+        ++it;
+      }
+
+      while (it != targets.end() && it->hash == entry.hash && it->len == entry.nameLen) {
+        if (it->index < sizes.size()) {
+          sizes[it->index] = entry.uncompressedSize;
+          matched++;
+        }
+        ++it;
+      }
+    }
+
+    if (!wasOpen) {
+      close();
+    }
+    return matched;
+  }
+
   if (!loadZipDetails()) {
     if (!wasOpen) {
       close();
@@ -321,33 +639,33 @@ int ZipFile::fillUncompressedSizes(std::vector<SizeTarget>& targets, std::vector
     return 0;
   }
 
-  file.seek(zipDetails.centralDirOffset);
+  BufferedFsReader reader(file);
+  reader.seek(zipDetails.centralDirOffset);
 
-  int matched = 0;
   uint32_t sig;
   char itemName[256];
 
-  while (file.available()) {
-    file.read(&sig, 4);
+  while (reader.available()) {
+    reader.read(&sig, 4);
     if (sig != 0x02014b50) break;
 
-    file.seekCur(6);
+    reader.seekCur(6);
     uint16_t method;
-    file.read(&method, 2);
-    file.seekCur(8);
+    reader.read(&method, 2);
+    reader.seekCur(8);
     uint32_t compressedSize, uncompressedSize;
-    file.read(&compressedSize, 4);
-    file.read(&uncompressedSize, 4);
+    reader.read(&compressedSize, 4);
+    reader.read(&uncompressedSize, 4);
     uint16_t nameLen, m, k;
-    file.read(&nameLen, 2);
-    file.read(&m, 2);
-    file.read(&k, 2);
-    file.seekCur(8);
+    reader.read(&nameLen, 2);
+    reader.read(&m, 2);
+    reader.read(&k, 2);
+    reader.seekCur(8);
     uint32_t localHeaderOffset;
-    file.read(&localHeaderOffset, 4);
+    reader.read(&localHeaderOffset, 4);
 
     if (nameLen < 256) {
-      file.read(itemName, nameLen);
+      reader.read(itemName, nameLen);
       itemName[nameLen] = '\0';
 
       uint64_t hash = fnvHash64(itemName, nameLen);
@@ -365,10 +683,10 @@ int ZipFile::fillUncompressedSizes(std::vector<SizeTarget>& targets, std::vector
         ++it;
       }
     } else {
-      file.seekCur(nameLen);
+      reader.seekCur(nameLen);
     }
 
-    file.seekCur(m + k);
+    reader.seekCur(m + k);
   }
 
   if (!wasOpen) {
@@ -475,6 +793,39 @@ uint8_t* ZipFile::readFileToMemory(const char* filename, size_t* size, const boo
 }
 
 bool ZipFile::readFileToStream(const char* filename, Print& out, const size_t chunkSize) {
+  EntryReader reader;
+  if (!openEntry(filename, reader, chunkSize)) {
+    return false;
+  }
+
+  const auto buffer = static_cast<uint8_t*>(malloc(chunkSize));
+  if (!buffer) {
+    Serial.printf("[%lu] [ZIP] Failed to allocate memory for buffer\n", millis());
+    return false;
+  }
+
+  while (reader.available() > 0) {
+    const int dataRead = reader.read(buffer, chunkSize);
+    if (dataRead <= 0) {
+      Serial.printf("[%lu] [ZIP] Could not read more bytes\n", millis());
+      free(buffer);
+      return false;
+    }
+
+    if (out.write(buffer, dataRead) != static_cast<size_t>(dataRead)) {
+      Serial.printf("[%lu] [ZIP] Failed to write all output bytes to stream\n", millis());
+      free(buffer);
+      return false;
+    }
+  }
+
+  free(buffer);
+  return true;
+}
+
+bool ZipFile::openEntry(const char* filename, EntryReader& reader, const size_t chunkSize) {
+  reader.close();
+
   const bool wasOpen = isOpen();
   if (!wasOpen && !open()) {
     return false;
@@ -482,181 +833,333 @@ bool ZipFile::readFileToStream(const char* filename, Print& out, const size_t ch
 
   FileStatSlim fileStat = {};
   if (!loadFileStatSlim(filename, &fileStat)) {
+    if (!wasOpen) {
+      close();
+    }
     return false;
   }
 
-  const long fileOffset = getDataOffset(fileStat);
-  if (fileOffset < 0) {
+  const long dataOffset = getDataOffset(fileStat);
+  if (!wasOpen) {
+    close();
+  }
+  if (dataOffset < 0) {
     return false;
   }
 
-  file.seek(fileOffset);
-  const auto deflatedDataSize = fileStat.compressedSize;
-  const auto inflatedDataSize = fileStat.uncompressedSize;
+  if (fileStat.method != MZ_NO_COMPRESSION && fileStat.method != MZ_DEFLATED) {
+    Serial.printf("[%lu] [ZIP] Unsupported compression method\n", millis());
+    return false;
+  }
 
-  if (fileStat.method == MZ_NO_COMPRESSION) {
-    // no deflation, just read content
-    const auto buffer = static_cast<uint8_t*>(malloc(chunkSize));
-    if (!buffer) {
-      Serial.printf("[%lu] [ZIP] Failed to allocate memory for buffer\n", millis());
-      if (!wasOpen) {
-        close();
+  return reader.begin(filePath, fileStat, dataOffset, chunkSize);
+}
+
+bool ZipFile::EntryReader::begin(const std::string& zipPath, const FileStatSlim& fileStat, const long entryDataOffset,
+                                 const size_t readChunkSize) {
+  if (!FILE_CACHE.openFileForRead("ZIP", zipPath, file)) {
+    return false;
+  }
+  file.seek(entryDataOffset);
+
+  method = fileStat.method;
+  dataOffset = entryDataOffset;
+  localHeaderOffset = fileStat.localHeaderOffset;
+  compressedSize = fileStat.compressedSize;
+  uncompressedSize = fileStat.uncompressedSize;
+  chunkSize = readChunkSize;
+  outputPosition = 0;
+
+  if (method == MZ_NO_COMPRESSION) {
+    return true;
+  }
+
+  inflator = static_cast<Inflator*>(malloc(sizeof(Inflator)));
+  inputBuffer = static_cast<uint8_t*>(malloc(chunkSize));
+  dictionary = static_cast<uint8_t*>(malloc(TINFL_LZ_DICT_SIZE));
+  if (!inflator || !inputBuffer || !dictionary) {
+    Serial.printf("[%lu] [ZIP] Failed to allocate memory for entry reader\n", millis());
+    close();
+    return false;
+  }
+
+  resetInflator();
+  return true;
+}
+
+void ZipFile::EntryReader::resetInflator() {
+  initInflator(inflator);
+  file.seek(dataOffset);
+  compressedRemaining = compressedSize;
+  outputPosition = 0;
+  inputFilled = 0;
+  inputCursor = 0;
+  dictionaryCursor = 0;
+  pendingStart = 0;
+  pendingBytes = 0;
+  inflateDone = false;
+}
+
+int ZipFile::EntryReader::read(void* buf, const size_t len) { return pull(static_cast<uint8_t*>(buf), len); }
+
+int ZipFile::EntryReader::pull(uint8_t* out, const size_t len) {
+  if (!file) {
+    return -1;
+  }
+
+  if (method == MZ_NO_COMPRESSION) {
+    const size_t toRead = std::min(len, static_cast<size_t>(uncompressedSize - outputPosition));
+    if (toRead == 0) {
+      return 0;
+    }
+    if (!out) {
+      file.seekCur(toRead);
+      outputPosition += toRead;
+      return static_cast<int>(toRead);
+    }
+    SdOpCounter::reads++;
+    const int dataRead = file.read(out, toRead);
+    if (dataRead <= 0) {
+      Serial.printf("[%lu] [ZIP] Could not read more bytes\n", millis());
+      return -1;
+    }
+    outputPosition += dataRead;
+    return dataRead;
+  }
+
+  size_t written = 0;
+  while (written < len) {
+    // Hand out anything already inflated before asking for more
+    if (pendingBytes > 0) {
+      const size_t toCopy = std::min(pendingBytes, len - written);
+      if (out) {
+        memcpy(out + written, dictionary + pendingStart, toCopy);
       }
-      return false;
+      written += toCopy;
+      pendingStart += toCopy;
+      pendingBytes -= toCopy;
+      continue;
+    }
+
+    if (inflateDone) {
+      break;
+    }
+
+    // Everything inflated so far has been handed out, so this is a clean point to snapshot the inflator
+    if (checkpointFile && outputPosition + written >= nextCheckpointAt) {
+      writeCheckpoint(outputPosition + written);
+      nextCheckpointAt = outputPosition + written + checkpointInterval;
     }
 
-    size_t remaining = inflatedDataSize;
-    while (remaining > 0) {
-      const size_t dataRead = file.read(buffer, remaining < chunkSize ? remaining : chunkSize);
-      if (dataRead == 0) {
+    // Load more compressed bytes when needed
+    if (inputCursor >= inputFilled && compressedRemaining > 0) {
+      SdOpCounter::reads++;
+      const int dataRead = file.read(inputBuffer, std::min(static_cast<size_t>(compressedRemaining), chunkSize));
+      if (dataRead <= 0) {
         Serial.printf("[%lu] [ZIP] Could not read more bytes\n", millis());
-        free(buffer);
-        if (!wasOpen) {
-          close();
-        }
-        return false;
+        return -1;
       }
+      inputFilled = dataRead;
+      inputCursor = 0;
+      compressedRemaining -= dataRead;
+    }
+
+    // Available bytes in inputBuffer to process
+    size_t inBytes = inputFilled - inputCursor;
+    // Space remaining until the end of the dictionary, the inflator wraps around on the next call
+    size_t outBytes = TINFL_LZ_DICT_SIZE - dictionaryCursor;
 
-      out.write(buffer, dataRead);
-      remaining -= dataRead;
+    const int status = inflateToWindow(inflator, inputBuffer + inputCursor, &inBytes, dictionary, dictionaryCursor,
+                                       &outBytes, compressedRemaining > 0);
+
+    inputCursor += inBytes;
+    pendingStart = dictionaryCursor;
+    pendingBytes = outBytes;
+    dictionaryCursor = (dictionaryCursor + outBytes) & (TINFL_LZ_DICT_SIZE - 1);
+
+    if (status < 0) {
+      Serial.printf("[%lu] [ZIP] Inflate failed with status %d\n", millis(), status);
+      return -1;
     }
 
-    if (!wasOpen) {
-      close();
+    if (status == 0) {
+      inflateDone = true;
+    } else if (outBytes == 0 && inputCursor >= inputFilled && compressedRemaining == 0) {
+      Serial.printf("[%lu] [ZIP] Unexpected EOF\n", millis());
+      return -1;
     }
-    free(buffer);
-    return true;
   }
 
-  if (fileStat.method == MZ_DEFLATED) {
-    // Setup inflator
-    const auto inflator = static_cast<tinfl_decompressor*>(malloc(sizeof(tinfl_decompressor)));
-    if (!inflator) {
-      Serial.printf("[%lu] [ZIP] Failed to allocate memory for inflator\n", millis());
-      if (!wasOpen) {
-        close();
-      }
-      return false;
-    }
-    memset(inflator, 0, sizeof(tinfl_decompressor));
-    tinfl_init(inflator);
+  outputPosition += written;
+  return static_cast<int>(written);
+}
 
-    // Setup file read buffer
-    const auto fileReadBuffer = static_cast<uint8_t*>(malloc(chunkSize));
-    if (!fileReadBuffer) {
-      Serial.printf("[%lu] [ZIP] Failed to allocate memory for zip file read buffer\n", millis());
-      free(inflator);
-      if (!wasOpen) {
-        close();
+namespace {
+// Snapshots are engine specific, so each engine writes its own sidecar version
+constexpr uint8_t CHECKPOINT_FILE_VERSION = ZIP_FAST_INFLATE ? 0x81 : 1;
+// version, state size, local header offset, compressed size, uncompressed size, interval, count
+constexpr uint32_t CHECKPOINT_HEADER_SIZE =
+    sizeof(uint8_t) + sizeof(uint16_t) + sizeof(uint32_t) * 4 + sizeof(uint16_t);
+// inflated offset, consumed compressed bytes, dictionary cursor, inflator state, dictionary
+constexpr uint32_t CHECKPOINT_RECORD_SIZE =
+    sizeof(uint32_t) + sizeof(uint32_t) + sizeof(uint16_t) + sizeof(Inflator) + TINFL_LZ_DICT_SIZE;
+}  // namespace
+
+bool ZipFile::EntryReader::enableCheckpoints(const std::string& path, const uint32_t interval) {
+  if (!file || method != MZ_DEFLATED || interval == 0) {
+    return false;
+  }
+
+  checkpointFile.close();
+  checkpointOffsets.clear();
+  checkpointInterval = interval;
+
+  // Reuse an existing sidecar if it was recorded for this exact entry
+  if (SdMan.exists(path.c_str()) && SdMan.openFileForRead("ZIP", path, checkpointFile)) {
+    uint8_t version;
+    uint16_t stateSize, count;
+    uint32_t fileLocalHeaderOffset, fileCompressedSize, fileUncompressedSize, fileInterval;
+    serialization::readPod(checkpointFile, version);
+    serialization::readPod(checkpointFile, stateSize);
+    serialization::readPod(checkpointFile, fileLocalHeaderOffset);
+    serialization::readPod(checkpointFile, fileCompressedSize);
+    serialization::readPod(checkpointFile, fileUncompressedSize);
+    serialization::readPod(checkpointFile, fileInterval);
+    serialization::readPod(checkpointFile, count);
+    const bool valid = version == CHECKPOINT_FILE_VERSION && stateSize == sizeof(Inflator) &&
+                       fileLocalHeaderOffset == localHeaderOffset && fileCompressedSize == compressedSize &&
+                       fileUncompressedSize == uncompressedSize && fileInterval == interval &&
+                       checkpointFile.size() >= CHECKPOINT_HEADER_SIZE + CHECKPOINT_RECORD_SIZE * count;
+    if (valid) {
+      checkpointOffsets.reserve(count);
+      for (uint16_t i = 0; i < count; i++) {
+        uint32_t inflatedOffset;
+        checkpointFile.seek(CHECKPOINT_HEADER_SIZE + CHECKPOINT_RECORD_SIZE * i);
+        serialization::readPod(checkpointFile, inflatedOffset);
+        checkpointOffsets.push_back(inflatedOffset);
       }
-      return false;
+      checkpointFile.close();
+      checkpointFile = SdMan.open(path.c_str(), O_RDWR);
+    } else {
+      checkpointFile.close();
     }
+  }
 
-    const auto outputBuffer = static_cast<uint8_t*>(malloc(TINFL_LZ_DICT_SIZE));
-    if (!outputBuffer) {
-      Serial.printf("[%lu] [ZIP] Failed to allocate memory for dictionary\n", millis());
-      free(inflator);
-      free(fileReadBuffer);
-      if (!wasOpen) {
-        close();
-      }
+  if (!checkpointFile) {
+    checkpointOffsets.clear();
+    if (!SdMan.openFileForWrite("ZIP", path, checkpointFile)) {
       return false;
     }
-    memset(outputBuffer, 0, TINFL_LZ_DICT_SIZE);
+    serialization::writePod(checkpointFile, CHECKPOINT_FILE_VERSION);
+    serialization::writePod(checkpointFile, static_cast<uint16_t>(sizeof(Inflator)));
+    serialization::writePod(checkpointFile, localHeaderOffset);
+    serialization::writePod(checkpointFile, compressedSize);
+    serialization::writePod(checkpointFile, uncompressedSize);
+    serialization::writePod(checkpointFile, interval);
+    serialization::writePod(checkpointFile, static_cast<uint16_t>(0));
+  }
 
-    size_t fileRemainingBytes = deflatedDataSize;
-    size_t processedOutputBytes = 0;
-    size_t fileReadBufferFilledBytes = 0;
-    size_t fileReadBufferCursor = 0;
-    size_t outputCursor = 0;  // Current offset in the circular dictionary
+  nextCheckpointAt = (checkpointOffsets.empty() ? 0 : checkpointOffsets.back()) + interval;
+  return true;
+}
 
-    while (true) {
-      // Load more compressed bytes when needed
-      if (fileReadBufferCursor >= fileReadBufferFilledBytes) {
-        if (fileRemainingBytes == 0) {
-          // Should not be hit, but a safe protection
-          break;  // EOF
-        }
+bool ZipFile::EntryReader::writeCheckpoint(const uint32_t inflatedOffset) {
+  // Compressed bytes consumed by the inflator, anything it has buffered in its bit buffer is part of its state
+  const uint32_t consumed = compressedSize - compressedRemaining - (inputFilled - inputCursor);
+  const auto count = static_cast<uint16_t>(checkpointOffsets.size());
+
+  checkpointFile.seek(CHECKPOINT_HEADER_SIZE + CHECKPOINT_RECORD_SIZE * count);
+  serialization::writePod(checkpointFile, inflatedOffset);
+  serialization::writePod(checkpointFile, consumed);
+  serialization::writePod(checkpointFile, static_cast<uint16_t>(dictionaryCursor));
+  checkpointFile.write(reinterpret_cast<const uint8_t*>(inflator), sizeof(Inflator));
+  if (checkpointFile.write(dictionary, TINFL_LZ_DICT_SIZE) != TINFL_LZ_DICT_SIZE) {
+    Serial.printf("[%lu] [ZIP] Failed to write inflate checkpoint, disabling checkpoints\n", millis());
+    checkpointFile.close();
+    return false;
+  }
 
-        fileReadBufferFilledBytes =
-            file.read(fileReadBuffer, fileRemainingBytes < chunkSize ? fileRemainingBytes : chunkSize);
-        fileRemainingBytes -= fileReadBufferFilledBytes;
-        fileReadBufferCursor = 0;
+  // Bump the count last so a torn record is never referenced
+  checkpointFile.seek(CHECKPOINT_HEADER_SIZE - sizeof(uint16_t));
+  serialization::writePod(checkpointFile, static_cast<uint16_t>(count + 1));
+  checkpointFile.flush();
+  checkpointOffsets.push_back(inflatedOffset);
+  return true;
+}
 
-        if (fileReadBufferFilledBytes == 0) {
-          // Bad read
-          break;  // EOF
-        }
-      }
+bool ZipFile::EntryReader::restoreCheckpoint(const size_t index) {
+  uint32_t inflatedOffset, consumed;
+  uint16_t cursor;
+  checkpointFile.seek(CHECKPOINT_HEADER_SIZE + CHECKPOINT_RECORD_SIZE * index);
+  serialization::readPod(checkpointFile, inflatedOffset);
+  serialization::readPod(checkpointFile, consumed);
+  serialization::readPod(checkpointFile, cursor);
+  if (checkpointFile.read(reinterpret_cast<uint8_t*>(inflator), sizeof(Inflator)) != sizeof(Inflator) ||
+      checkpointFile.read(dictionary, TINFL_LZ_DICT_SIZE) != TINFL_LZ_DICT_SIZE) {
+    Serial.printf("[%lu] [ZIP] Failed to read inflate checkpoint %u\n", millis(), static_cast<unsigned>(index));
+    resetInflator();
+    return false;
+  }
 
-      // Available bytes in fileReadBuffer to process
-      size_t inBytes = fileReadBufferFilledBytes - fileReadBufferCursor;
-      // Space remaining in outputBuffer
-      size_t outBytes = TINFL_LZ_DICT_SIZE - outputCursor;
-
-      const tinfl_status status = tinfl_decompress(inflator, fileReadBuffer + fileReadBufferCursor, &inBytes,
-                                                   outputBuffer, outputBuffer + outputCursor, &outBytes,
-                                                   fileRemainingBytes > 0 ? TINFL_FLAG_HAS_MORE_INPUT : 0);
-
-      // Update input position
-      fileReadBufferCursor += inBytes;
-
-      // Write output chunk
-      if (outBytes > 0) {
-        processedOutputBytes += outBytes;
-        if (out.write(outputBuffer + outputCursor, outBytes) != outBytes) {
-          Serial.printf("[%lu] [ZIP] Failed to write all output bytes to stream\n", millis());
-          if (!wasOpen) {
-            close();
-          }
-          free(outputBuffer);
-          free(fileReadBuffer);
-          free(inflator);
-          return false;
-        }
-        // Update output position in buffer (with wraparound)
-        outputCursor = (outputCursor + outBytes) & (TINFL_LZ_DICT_SIZE - 1);
-      }
+  file.seek(dataOffset + consumed);
+  compressedRemaining = compressedSize - consumed;
+  outputPosition = inflatedOffset;
+  inputFilled = 0;
+  inputCursor = 0;
+  dictionaryCursor = cursor;
+  pendingStart = 0;
+  pendingBytes = 0;
+  inflateDone = false;
+  return true;
+}
 
-      if (status < 0) {
-        Serial.printf("[%lu] [ZIP] tinfl_decompress() failed with status %d\n", millis(), status);
-        if (!wasOpen) {
-          close();
-        }
-        free(outputBuffer);
-        free(fileReadBuffer);
-        free(inflator);
-        return false;
-      }
+bool ZipFile::EntryReader::seek(const size_t offset) {
+  if (!file || offset > uncompressedSize) {
+    return false;
+  }
 
-      if (status == TINFL_STATUS_DONE) {
-        Serial.printf("[%lu] [ZIP] Decompressed %d bytes into %d bytes\n", millis(), deflatedDataSize,
-                      inflatedDataSize);
-        if (!wasOpen) {
-          close();
-        }
-        free(inflator);
-        free(fileReadBuffer);
-        free(outputBuffer);
-        return true;
+  if (method == MZ_NO_COMPRESSION) {
+    file.seek(dataOffset + offset);
+    outputPosition = offset;
+    return true;
+  }
+
+  // Nearest checkpoint at or before the target
+  const auto it = std::upper_bound(checkpointOffsets.begin(), checkpointOffsets.end(), static_cast<uint32_t>(offset));
+  const bool hasCheckpoint = checkpointFile && it != checkpointOffsets.begin();
+  const uint32_t checkpointOffset = hasCheckpoint ? *(it - 1) : 0;
+
+  if (offset < outputPosition || checkpointOffset > outputPosition) {
+    if (hasCheckpoint) {
+      if (!restoreCheckpoint(it - 1 - checkpointOffsets.begin())) {
+        return false;
       }
+    } else {
+      resetInflator();
     }
+  }
 
-    // If we get here, EOF reached without TINFL_STATUS_DONE
-    Serial.printf("[%lu] [ZIP] Unexpected EOF\n", millis());
-    if (!wasOpen) {
-      close();
+  while (outputPosition < offset) {
+    if (pull(nullptr, offset - outputPosition) <= 0) {
+      return false;
     }
-    free(outputBuffer);
-    free(fileReadBuffer);
-    free(inflator);
-    return false;
   }
+  return true;
+}
 
-  if (!wasOpen) {
-    close();
+void ZipFile::EntryReader::close() {
+  if (file) {
+    file.close();
   }
-
-  Serial.printf("[%lu] [ZIP] Unsupported compression method\n", millis());
-  return false;
+  if (checkpointFile) {
+    checkpointFile.close();
+  }
+  checkpointOffsets.clear();
+  free(inflator);
+  free(inputBuffer);
+  free(dictionary);
+  inflator = nullptr;
+  inputBuffer = nullptr;
+  dictionary = nullptr;
+  pendingBytes = 0;
 }
@@ -2,9 +2,19 @@
 #include <SdFat.h>
 
 #include <string>
-#include <unordered_map>
 #include <vector>
 
+// Build with -DZIP_FAST_INFLATE=1 to inflate with the table-driven FastInflate instead of miniz tinfl
+#ifndef ZIP_FAST_INFLATE
+#define ZIP_FAST_INFLATE 0
+#endif
+
+#if ZIP_FAST_INFLATE
+class FastInflate;
+#else
+struct tinfl_decompressor_tag;
+#endif
+
 class ZipFile {
  public:
   struct FileStatSlim {
@@ -27,6 +37,75 @@ class ZipFile {
     uint16_t index;  // Caller's index (e.g. spine index)
   };
 
+  // Pull-style reader over a single entry, inflating on demand straight into the caller's buffer.
+  // Lets consumers (XML parsers, the JPEG decoder) stream an entry without staging it in a temp file first.
+  // Holds its own handle on the zip file, so it stays valid after the ZipFile that opened it is gone.
+  class EntryReader {
+   public:
+    // Default spacing between inflate checkpoints (in inflated bytes)
+    static constexpr uint32_t CHECKPOINT_INTERVAL = 256 * 1024;
+
+   private:
+    FsFile file;
+    uint16_t method = 0;
+    uint32_t dataOffset = 0;
+    uint32_t localHeaderOffset = 0;
+    uint32_t compressedSize = 0;
+    uint32_t uncompressedSize = 0;
+    uint32_t compressedRemaining = 0;
+    uint32_t outputPosition = 0;
+    size_t chunkSize = 0;
+#if ZIP_FAST_INFLATE
+    FastInflate* inflator = nullptr;
+#else
+    tinfl_decompressor_tag* inflator = nullptr;
+#endif
+    uint8_t* inputBuffer = nullptr;
+    size_t inputFilled = 0;
+    size_t inputCursor = 0;
+    // Circular dictionary, inflated bytes in [pendingStart, pendingStart + pendingBytes) are not yet handed out
+    uint8_t* dictionary = nullptr;
+    size_t dictionaryCursor = 0;
+    size_t pendingStart = 0;
+    size_t pendingBytes = 0;
+    bool inflateDone = false;
+
+    // Inflate checkpoints (decompressor state + 32KB window) in a sidecar file, allowing seeks to resume from the
+    // nearest checkpoint rather than inflating from the start of the entry
+    FsFile checkpointFile;
+    std::vector<uint32_t> checkpointOffsets;
+    uint32_t checkpointInterval = 0;
+    uint32_t nextCheckpointAt = 0;
+
+    friend class ZipFile;
+    bool begin(const std::string& zipPath, const FileStatSlim& fileStat, long dataOffset, size_t chunkSize);
+    void resetInflator();
+    // Reads (or skips when out is nullptr) up to len inflated bytes
+    int pull(uint8_t* out, size_t len);
+    bool writeCheckpoint(uint32_t inflatedOffset);
+    bool restoreCheckpoint(size_t index);
+
+   public:
+    EntryReader() = default;
+    ~EntryReader() { close(); }
+    EntryReader(const EntryReader&) = delete;
+    EntryReader& operator=(const EntryReader&) = delete;
+
+    bool isOpen() const { return !!file; }
+    // Reads up to len inflated bytes, returns the number of bytes read (0 at the end of the entry) or -1 on error
+    int read(void* buf, size_t len);
+    // Repositions to an inflated offset. Deflated entries resume from the nearest checkpoint at or before offset
+    // when there is one, otherwise they inflate forward (from the start if seeking backwards)
+    bool seek(size_t offset);
+    // Records a checkpoint every interval inflated bytes into the sidecar file at path while reading, reusing any
+    // checkpoints already in it for this entry. Only worthwhile for large deflated entries.
+    bool enableCheckpoints(const std::string& path, uint32_t interval = CHECKPOINT_INTERVAL);
+    void close();
+    size_t size() const { return uncompressedSize; }
+    size_t position() const { return outputPosition; }
+    size_t available() const { return uncompressedSize - outputPosition; }
+  };
+
   // FNV-1a 64-bit hash computed from char buffer (no std::string allocation)
   static uint64_t fnvHash64(const char* s, size_t len) {
     uint64_t hash = 14695981039346656037ull;
@@ -37,11 +116,37 @@ class ZipFile {
     return hash;
   }
 
+  // Bump when the central directory index format changes
+  static constexpr uint8_t INDEX_VERSION = 1;
+
  private:
+  // On-SD central directory index. Records are sorted by (hash, nameLen) so a lookup is a binary search of
+  // O(log n) small reads instead of a scan of the whole central directory.
+  // version (u8) + zip file size (u32) + entry count (u16)
+  static constexpr uint32_t INDEX_HEADER_SIZE = sizeof(uint8_t) + sizeof(uint32_t) + sizeof(uint16_t);
+
+  struct IndexEntry {
+    uint64_t hash;  // FNV-1a 64-bit hash of the entry name
+    uint16_t nameLen;
+    uint16_t method;
+    uint32_t compressedSize;
+    uint32_t uncompressedSize;
+    uint32_t localHeaderOffset;
+  };
+
+  // Entries sorted in RAM at a time while building the index (12KB), larger central directories are merged from
+  // runs of this size on the card
+  static constexpr uint16_t INDEX_RUN_ENTRIES = 512;
+
+  enum class IndexState : uint8_t { UNCHECKED, READY, UNAVAILABLE };
+
   const std::string& filePath;
+  std::string indexPath;
   FsFile file;
+  FsFile indexFile;
+  IndexState indexState = IndexState::UNCHECKED;
+  uint16_t indexEntryCount = 0;
   ZipDetails zipDetails = {0, 0, false};
-  std::unordered_map<std::string, FileStatSlim> fileStatSlimCache;
 
   // Cursor for sequential central-dir scanning optimization
   uint32_t lastCentralDirPos = 0;
@@ -50,16 +155,26 @@ class ZipFile {
   bool loadFileStatSlim(const char* filename, FileStatSlim* fileStat);
   long getDataOffset(const FileStatSlim& fileStat);
   bool loadZipDetails();
+  bool openIndex();
+  bool readIndexEntry(uint16_t index, IndexEntry& entry);
+  bool loadFileStatSlimFromIndex(const char* filename, FileStatSlim* fileStat);
+  bool localHeaderNameMatches(uint32_t localHeaderOffset, const char* filename, size_t nameLen);
+  static bool indexEntryLess(const IndexEntry& a, const IndexEntry& b);
+  // Merges the sorted runs of count entries in scratchPath into outFile, reading through buffer
+  bool mergeIndexRuns(const std::string& scratchPath, uint16_t count, IndexEntry* buffer, FsFile& outFile);
 
  public:
-  explicit ZipFile(const std::string& filePath) : filePath(filePath) {}
+  // indexPath is optional, when set (and the index has been built) entry lookups go through the on-SD index
+  explicit ZipFile(const std::string& filePath, std::string indexPath = "")
+      : filePath(filePath), indexPath(std::move(indexPath)) {}
   ~ZipFile() = default;
   // Zip file can be opened and closed by hand in order to allow for quick calculation of inflated file size
   // It is NOT recommended to pre-open it for any kind of inflation due to memory constraints
   bool isOpen() const { return !!file; }
   bool open();
   bool close();
-  bool loadAllFileStatSlims();
+  // Scan the central directory once and write the sorted index to indexPath
+  bool buildIndex();
   bool getInflatedFileSize(const char* filename, size_t* size);
   // Batch lookup: scan ZIP central dir once and fill sizes for matching targets.
   // targets must be sorted by (hash, len). sizes[target.index] receives uncompressedSize.
@@ -69,4 +184,6 @@ class ZipFile {
   // These functions will open and close the zip as needed
   uint8_t* readFileToMemory(const char* filename, size_t* size = nullptr, bool trailingNullByte = false);
   bool readFileToStream(const char* filename, Print& out, size_t chunkSize);
+  // Opens an entry for pull-style reading, chunkSize is the size of the compressed read buffer
+  bool openEntry(const char* filename, EntryReader& reader, size_t chunkSize = 1024);
 };
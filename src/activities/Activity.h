@@ -5,6 +5,8 @@
 #include <string>
 #include <utility>
 
+#include "ActivityArena.h"
+
 class MappedInputManager;
 class GfxRenderer;
 
@@ -13,11 +15,15 @@ class Activity {
   std::string name;
   GfxRenderer& renderer;
   MappedInputManager& mappedInput;
+  // For state that lives as long as the activity, all of it is freed with the activity
+  ActivityArena arena;
 
  public:
   explicit Activity(std::string name, GfxRenderer& renderer, MappedInputManager& mappedInput)
       : name(std::move(name)), renderer(renderer), mappedInput(mappedInput) {}
   virtual ~Activity() = default;
+  const std::string& getName() const { return name; }
+  const ActivityArena& getArena() const { return arena; }
   virtual void onEnter() { Serial.printf("[%lu] [ACT] Entering activity: %s\n", millis(), name.c_str()); }
   virtual void onExit() { Serial.printf("[%lu] [ACT] Exiting activity: %s\n", millis(), name.c_str()); }
   virtual void loop() {}
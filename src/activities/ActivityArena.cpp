@@ -0,0 +1,79 @@
+#include "ActivityArena.h"
+
+#include <HardwareSerial.h>
+
+#include <cstdlib>
+#include <cstring>
+
+ActivityArena::Block* ActivityArena::addBlock(const size_t dataSize) {
+  auto* block = static_cast<Block*>(malloc(sizeof(Block) + dataSize));
+  if (!block) {
+    Serial.printf("[%lu] [ARN] Failed to allocate arena block (%zu bytes)\n", millis(), sizeof(Block) + dataSize);
+    return nullptr;
+  }
+  block->size = dataSize;
+  block->used = 0;
+  bytesReserved += sizeof(Block) + dataSize;
+  blockCount++;
+  return block;
+}
+
+void* ActivityArena::allocate(const size_t size, const size_t alignment) {
+  if (head) {
+    const size_t offset = (head->used + alignment - 1) & ~(alignment - 1);
+    if (offset + size <= head->size) {
+      head->used = offset + size;
+      bytesUsed += size;
+      return blockData(head) + offset;
+    }
+  }
+
+  // Block data starts max_align_t aligned, a fresh block needs no padding
+  if (size > BLOCK_SIZE / 4) {
+    // Kept behind the head, so what is left of the head block can still be used
+    Block* block = addBlock(size);
+    if (!block) {
+      return nullptr;
+    }
+    block->used = size;
+    if (head) {
+      block->next = head->next;
+      head->next = block;
+    } else {
+      block->next = nullptr;
+      head = block;
+    }
+    bytesUsed += size;
+    return blockData(block);
+  }
+
+  Block* block = addBlock(BLOCK_SIZE - sizeof(Block));
+  if (!block) {
+    return nullptr;
+  }
+  block->next = head;
+  block->used = size;
+  head = block;
+  bytesUsed += size;
+  return blockData(block);
+}
+
+const char* ActivityArena::copyString(const char* text, const size_t length) {
+  auto* copy = static_cast<char*>(allocate(length + 1, 1));
+  if (copy) {
+    memcpy(copy, text, length);
+    copy[length] = '\0';
+  }
+  return copy;
+}
+
+void ActivityArena::reset() {
+  while (head) {
+    Block* next = head->next;
+    free(head);
+    head = next;
+  }
+  bytesUsed = 0;
+  bytesReserved = 0;
+  blockCount = 0;
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Region allocator for an activity's transient state. Allocations are carved from 4KB blocks and never freed one by
+ * one: reset() (or destroying the arena with its activity) gives every block back at once. Many small objects that
+ * live as long as the activity then take a few equal sized heap blocks instead of interleaving with everything else,
+ * and leave no holes behind when the activity exits.
+ */
+class ActivityArena {
+ public:
+  static constexpr size_t BLOCK_SIZE = 4096;
+
+  ActivityArena() = default;
+  ~ActivityArena() { reset(); }
+  ActivityArena(const ActivityArena&) = delete;
+  ActivityArena& operator=(const ActivityArena&) = delete;
+
+  // alignment is a power of two up to alignof(std::max_align_t). nullptr if the heap is exhausted. Requests above a
+  // quarter block get a block of their own.
+  void* allocate(size_t size, size_t alignment = alignof(std::max_align_t));
+  // NUL terminated copy of text, nullptr if the heap is exhausted
+  const char* copyString(const char* text, size_t length);
+  void reset();
+
+  size_t getBytesUsed() const { return bytesUsed; }
+  size_t getBytesReserved() const { return bytesReserved; }
+  size_t getBlockCount() const { return blockCount; }
+
+ private:
+  // Keeps the data behind each header aligned for anything
+  struct alignas(std::max_align_t) Block {
+    Block* next;
+    size_t size;
+    size_t used;
+  };
+
+  // Most recent first, only the head is allocated from
+  Block* head = nullptr;
+  size_t bytesUsed = 0;
+  size_t bytesReserved = 0;
+  size_t blockCount = 0;
+
+  Block* addBlock(size_t dataSize);
+  static uint8_t* blockData(Block* block) { return reinterpret_cast<uint8_t*>(block + 1); }
+};
@@ -1,15 +1,22 @@
 #include "ActivityWithSubactivity.h"
 
+#include "util/HeapStats.h"
+
 void ActivityWithSubactivity::exitActivity() {
   if (subActivity) {
     subActivity->onExit();
+    const std::string subName = subActivity->getName();
+    HeapStats::log("Leaving", subName.c_str(), subActivity->getArena().getBytesReserved(),
+                   subActivity->getArena().getBlockCount());
     subActivity.reset();
+    HeapStats::log("Left", subName.c_str());
   }
 }
 
 void ActivityWithSubactivity::enterNewActivity(Activity* activity) {
   subActivity.reset(activity);
   subActivity->onEnter();
+  HeapStats::log("Entered", subActivity->getName().c_str());
 }
 
 void ActivityWithSubactivity::loop() {
@@ -1,6 +1,6 @@
 #include "OpdsBookBrowserActivity.h"
 
-#include <Epub.h>
+#include <Epub/BookFingerprintStore.h>
 #include <GfxRenderer.h>
 #include <HardwareSerial.h>
 #include <OpdsStream.h>
@@ -363,10 +363,9 @@ void OpdsBookBrowserActivity::downloadBook(const OpdsEntry& book) {
   if (result == HttpDownloader::OK) {
     Serial.printf("[%lu] [OPDS] Download complete: %s\n", millis(), filename.c_str());
 
-    // Invalidate any existing cache for this file to prevent stale metadata issues
-    Epub epub(filename, "/.crosspoint");
-    epub.clearCache();
-    Serial.printf("[%lu] [OPDS] Cleared cache for: %s\n", millis(), filename.c_str());
+    // The download may have replaced a different book at this path, its cache is keyed by content so only the
+    // remembered fingerprint is stale
+    BOOK_FINGERPRINTS.forget(filename);
 
     state = BrowserState::BROWSING;
     updateRequired = true;
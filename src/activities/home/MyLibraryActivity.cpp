@@ -4,6 +4,7 @@
 #include <SDCardManager.h>
 
 #include <algorithm>
+#include <cstring>
 
 #include "CrossPointSettings.h"
 #include "MappedInputManager.h"
@@ -23,12 +24,17 @@ constexpr int RIGHT_MARGIN = 40;  // Extra space for scroll indicator
 constexpr int SKIP_PAGE_MS = 700;
 constexpr unsigned long GO_HOME_MS = 1000;
 
-void sortFileList(std::vector<std::string>& strs) {
-  std::sort(begin(strs), end(strs), [](const std::string& str1, const std::string& str2) {
-    if (str1.back() == '/' && str2.back() != '/') return true;
-    if (str1.back() != '/' && str2.back() == '/') return false;
-    return lexicographical_compare(
-        begin(str1), end(str1), begin(str2), end(str2),
+bool isDirectoryName(const char* name) {
+  const size_t length = strlen(name);
+  return length > 0 && name[length - 1] == '/';
+}
+
+void sortFileList(std::vector<const char*>& names) {
+  std::sort(begin(names), end(names), [](const char* str1, const char* str2) {
+    if (isDirectoryName(str1) && !isDirectoryName(str2)) return true;
+    if (!isDirectoryName(str1) && isDirectoryName(str2)) return false;
+    return std::lexicographical_compare(
+        str1, str1 + strlen(str1), str2, str2 + strlen(str2),
         [](const char& char1, const char& char2) { return tolower(char1) < tolower(char2); });
   });
 }
@@ -116,11 +122,15 @@ void MyLibraryActivity::loadRecentBooks() {
 }
 
 void MyLibraryActivity::loadFiles() {
+  // The names of the previous directory go with the arena, the display task must not be drawing them meanwhile
+  xSemaphoreTake(renderingMutex, portMAX_DELAY);
   files.clear();
+  arena.reset();
 
   auto root = SdMan.open(basepath.c_str());
   if (!root || !root.isDirectory()) {
     if (root) root.close();
+    xSemaphoreGive(renderingMutex);
     return;
   }
 
@@ -140,13 +150,19 @@ void MyLibraryActivity::loadFiles() {
       if (StringUtils::checkFileExtension(filename, ".epub") || StringUtils::checkFileExtension(filename, ".xtch") ||
           StringUtils::checkFileExtension(filename, ".xtc") || StringUtils::checkFileExtension(filename, ".txt") ||
           StringUtils::checkFileExtension(filename, ".md")) {
-        files.emplace_back(filename);
+        if (const char* copy = arena.copyString(filename.c_str(), filename.size())) {
+          files.push_back(copy);
+        }
       }
     }
     file.close();
   }
   root.close();
   sortFileList(files);
+  Serial.printf("[%lu] [MYL] %u files, names take %u bytes in %u arena blocks\n", millis(),
+                static_cast<unsigned>(files.size()), static_cast<unsigned>(arena.getBytesUsed()),
+                static_cast<unsigned>(arena.getBlockCount()));
+  xSemaphoreGive(renderingMutex);
 }
 
 void MyLibraryActivity::rebuildItemList() {
@@ -174,7 +190,7 @@ void MyLibraryActivity::rebuildItemList() {
 
 size_t MyLibraryActivity::findEntry(const std::string& name) const {
   for (size_t i = 0; i < files.size(); i++) {
-    if (files[i] == name) return i;
+    if (strcmp(files[i], name.c_str()) == 0) return i;
   }
   return 0;
 }
@@ -257,7 +273,8 @@ void MyLibraryActivity::loop() {
         const auto& book = recentBooks[static_cast<size_t>(item.index)];
         onSelectBook(book.path, Tab::Recent);
       } else if (item.type == LibraryItemType::File) {
-        const auto& fileName = files[static_cast<size_t>(item.index)];
+        // Copied, loading the directory frees the arena the name lives in
+        const std::string fileName = files[static_cast<size_t>(item.index)];
         if (basepath.back() != '/') basepath += "/";
         if (!fileName.empty() && fileName.back() == '/') {
           basepath += fileName.substr(0, fileName.length() - 1);
@@ -408,9 +425,8 @@ void MyLibraryActivity::renderCombinedList() const {
           renderer.truncatedText(UI_10_FONT_ID, title.c_str(), pageWidth - LEFT_MARGIN - RIGHT_MARGIN);
       renderer.drawText(UI_10_FONT_ID, LEFT_MARGIN, y, truncatedTitle.c_str(), textColor);
     } else if (item.type == LibraryItemType::File) {
-      const auto& fileName = files[static_cast<size_t>(item.index)];
-      auto truncatedName =
-          renderer.truncatedText(UI_10_FONT_ID, fileName.c_str(), pageWidth - LEFT_MARGIN - RIGHT_MARGIN);
+      const char* fileName = files[static_cast<size_t>(item.index)];
+      auto truncatedName = renderer.truncatedText(UI_10_FONT_ID, fileName, pageWidth - LEFT_MARGIN - RIGHT_MARGIN);
       renderer.drawText(UI_10_FONT_ID, LEFT_MARGIN, y, truncatedName.c_str(), textColor);
     }
   }
@@ -34,7 +34,8 @@ class MyLibraryActivity final : public Activity {
 
   // Files tab state (from FileSelectionActivity)
   std::string basepath = "/";
-  std::vector<std::string> files;
+  // Names are NUL terminated copies in the activity arena, which each directory load starts afresh
+  std::vector<const char*> files;
 
   std::vector<LibraryItem> items;
 
@@ -1,13 +1,17 @@
 #include "EpubReaderActivity.h"
 
 #include <Epub/Page.h>
+#include <FileHandleCache.h>
 #include <FsHelpers.h>
 #include <GfxRenderer.h>
+#include <PackBits.h>
 #include <SDCardManager.h>
+#include <ZipFile.h>
 
 #include <algorithm>
 #include <cmath>
 
+#include "Battery.h"
 #include "CrossPointSettings.h"
 #include "CrossPointState.h"
 #include "EpubReaderChapterSelectionActivity.h"
@@ -22,6 +26,26 @@ constexpr unsigned long skipChapterMs = 700;
 constexpr unsigned long goHomeMs = 1000;
 constexpr int statusBarMargin = 19;
 constexpr int progressBarMarginTop = 1;
+// The background indexer waits this long after a render, so it doesn't get in the way of quick page turns
+constexpr unsigned long indexIdleMs = 2000;
+constexpr uint16_t indexMinBatteryPercent = 20;
+constexpr unsigned long indexBatteryCheckMs = 60000;
+// Dense text pages pack to 30-40KB in portrait, where each buffer row crosses every line. Pages that don't pack below
+// this (images, dithered pages) aren't worth holding on to
+constexpr size_t maxPrerenderedFrameSize = 40 * 1024;
+// Left in the largest free heap block after the pre-render buffers, for everything else the reader allocates
+constexpr size_t prerenderHeapReserve = 16 * 1024;
+constexpr uint16_t pageCountUnknown = UINT16_MAX;
+constexpr uint16_t pageCountFailed = UINT16_MAX - 1;
+
+// Identifies everything that affects pagination, book page numbers are only exact for the layout they were counted in
+uint64_t makeLayoutKey(const uint16_t viewportWidth, const uint16_t viewportHeight) {
+  char key[64];
+  const int len = snprintf(key, sizeof(key), "%d/%g/%u/%u/%u/%u/%u", SETTINGS.getReaderFontId(),
+                           SETTINGS.getReaderLineCompression(), SETTINGS.extraParagraphSpacing,
+                           SETTINGS.paragraphAlignment, SETTINGS.hyphenationEnabled, viewportWidth, viewportHeight);
+  return ZipFile::fnvHash64(key, std::min(static_cast<size_t>(len), sizeof(key) - 1));
+}
 
 int getEffectiveRefreshFrequency(const bool darkMode, const int refreshFrequency) {
   if (!darkMode) {
@@ -37,6 +61,12 @@ void EpubReaderActivity::taskTrampoline(void* param) {
   self->displayTaskLoop();
 }
 
+void EpubReaderActivity::sectionBuildTaskTrampoline(void* param) {
+  auto* self = static_cast<EpubReaderActivity*>(param);
+  self->buildSection();
+  vTaskDelete(nullptr);
+}
+
 void EpubReaderActivity::onEnter() {
   ActivityWithSubactivity::onEnter();
 
@@ -44,6 +74,8 @@ void EpubReaderActivity::onEnter() {
     return;
   }
 
+  tocTitleCache.reset(new TocWindowCache(*epub, renderer, SMALL_FONT_ID, renderer.getScreenWidth()));
+
   // Configure screen orientation based on settings
   switch (SETTINGS.orientation) {
     case CrossPointSettings::ORIENTATION::PORTRAIT:
@@ -68,17 +100,23 @@ void EpubReaderActivity::onEnter() {
 
   FsFile f;
   if (SdMan.openFileForRead("ERS", epub->getCachePath() + "/progress.bin", f)) {
-    uint8_t data[6];
-    int dataSize = f.read(data, 6);
-    if (dataSize == 4 || dataSize == 6) {
+    uint8_t data[12];
+    int dataSize = f.read(data, 12);
+    if (dataSize == 4 || dataSize == 6 || dataSize == 12) {
       currentSpineIndex = data[0] + (data[1] << 8);
       nextPageNumber = data[2] + (data[3] << 8);
       cachedSpineIndex = currentSpineIndex;
       Serial.printf("[%lu] [ERS] Loaded cache: %d, %d\n", millis(), currentSpineIndex, nextPageNumber);
     }
-    if (dataSize == 6) {
+    if (dataSize == 6 || dataSize == 12) {
       cachedChapterTotalPageCount = data[4] + (data[5] << 8);
     }
+    if (dataSize == 12) {
+      pendingSourcePosition.offset =
+          data[6] + (data[7] << 8) + (data[8] << 16) + (static_cast<uint32_t>(data[9]) << 24);
+      pendingSourcePosition.wordIndex = data[10] + (data[11] << 8);
+      hasPendingSourcePosition = true;
+    }
     f.close();
   }
   // We may want a better condition to detect if we are opening for the first time.
@@ -116,18 +154,35 @@ void EpubReaderActivity::onExit() {
   renderer.setTextInverted(false);
 
   // Wait until not rendering to delete task to avoid killing mid-instruction to EPD
+  indexingCancelled = true;
   xSemaphoreTake(renderingMutex, portMAX_DELAY);
+  stopBackgroundIndexing();
   if (displayTaskHandle) {
     vTaskDelete(displayTaskHandle);
     displayTaskHandle = nullptr;
   }
+  stopSectionBuild();
   vSemaphoreDelete(renderingMutex);
   renderingMutex = nullptr;
   section.reset();
+  tocTitleCache.reset();
   epub.reset();
+
+  // Drop the handles held open for this book
+  FILE_CACHE.logStats();
+  FILE_CACHE.clear();
 }
 
 void EpubReaderActivity::loop() {
+  if (sectionBuildFailed) {
+    xSemaphoreTake(renderingMutex, portMAX_DELAY);
+    if (sectionBuildFailed && !sectionBuildTaskHandle) {
+      sectionBuildFailed = false;
+      section.reset();
+    }
+    xSemaphoreGive(renderingMutex);
+  }
+
   // Pass input responsibility to sub activity if exists
   if (subActivity) {
     subActivity->loop();
@@ -140,29 +195,56 @@ void EpubReaderActivity::loop() {
     xSemaphoreTake(renderingMutex, portMAX_DELAY);
     const int currentPage = section ? section->currentPage : 0;
     const int totalPages = section ? section->pageCount : 0;
+    SourcePosition sourcePosition = {0, 0};
+    if (section) {
+      section->getSourcePosition(currentPage, &sourcePosition);
+    }
+    // The selection screen replaces the "Indexing..." box, draw it again when coming back
+    waitingForSectionBuild = false;
+    pageTurnStartMs = 0;
     exitActivity();
     enterNewActivity(new EpubReaderChapterSelectionActivity(
         this->renderer, this->mappedInput, epub, epub->getPath(), currentSpineIndex, currentPage, totalPages,
+        sourcePosition.offset,
         [this] {
           exitActivity();
           updateRequired = true;
         },
-        [this](const int newSpineIndex) {
+        [this](const int newSpineIndex, const std::string& anchor) {
+          xSemaphoreTake(renderingMutex, portMAX_DELAY);
           if (currentSpineIndex != newSpineIndex) {
             currentSpineIndex = newSpineIndex;
             nextPageNumber = 0;
+            stopSectionBuild();
             section.reset();
           }
+          if (!anchor.empty()) {
+            if (section && !sectionBuildTaskHandle) {
+              const int anchorPage = section->getPageForAnchor(anchor);
+              section->currentPage = anchorPage >= 0 ? anchorPage : 0;
+            } else {
+              // Resolved when the section is opened, or once its build has finished
+              pendingAnchor = anchor;
+              if (section) {
+                nextPageNumber = 0;
+                sectionPositionPending = true;
+              }
+            }
+          }
+          xSemaphoreGive(renderingMutex);
           exitActivity();
           updateRequired = true;
         },
         [this](const int newSpineIndex, const int newPage) {
           // Handle sync position
+          xSemaphoreTake(renderingMutex, portMAX_DELAY);
           if (currentSpineIndex != newSpineIndex || (section && section->currentPage != newPage)) {
             currentSpineIndex = newSpineIndex;
             nextPageNumber = newPage;
+            stopSectionBuild();
             section.reset();
           }
+          xSemaphoreGive(renderingMutex);
           exitActivity();
           updateRequired = true;
         }));
@@ -203,58 +285,247 @@ void EpubReaderActivity::loop() {
   if (!prevTriggered && !nextTriggered) {
     return;
   }
+  pageTurnStartMs = millis();
+
+  const bool skipChapter = SETTINGS.longPressChapterSkip && mappedInput.getHeldTime() > skipChapterMs;
 
-  // any botton press when at end of the book goes back to the last page
+  // The display and build tasks use the section too, it is only looked at or replaced with the mutex held
+  xSemaphoreTake(renderingMutex, portMAX_DELAY);
   if (currentSpineIndex > 0 && currentSpineIndex >= epub->getSpineItemsCount()) {
+    // any botton press when at end of the book goes back to the last page
     currentSpineIndex = epub->getSpineItemsCount() - 1;
     nextPageNumber = UINT16_MAX;
-    updateRequired = true;
-    return;
-  }
-
-  const bool skipChapter = SETTINGS.longPressChapterSkip && mappedInput.getHeldTime() > skipChapterMs;
-
-  if (skipChapter) {
-    // We don't want to delete the section mid-render, so grab the semaphore
-    xSemaphoreTake(renderingMutex, portMAX_DELAY);
+  } else if (skipChapter) {
     nextPageNumber = 0;
     currentSpineIndex = nextTriggered ? currentSpineIndex + 1 : currentSpineIndex - 1;
+    stopSectionBuild();
     section.reset();
-    xSemaphoreGive(renderingMutex);
-    updateRequired = true;
-    return;
-  }
-
-  // No current section, attempt to rerender the book
-  if (!section) {
-    updateRequired = true;
-    return;
-  }
-
-  if (prevTriggered) {
+  } else if (!section) {
+    // No current section, attempt to rerender the book
+  } else if (prevTriggered) {
     if (section->currentPage > 0) {
       section->currentPage--;
     } else {
-      // We don't want to delete the section mid-render, so grab the semaphore
-      xSemaphoreTake(renderingMutex, portMAX_DELAY);
       nextPageNumber = UINT16_MAX;
       currentSpineIndex--;
+      stopSectionBuild();
       section.reset();
-      xSemaphoreGive(renderingMutex);
     }
-    updateRequired = true;
+  } else if (section->currentPage < section->pageCount - 1) {
+    section->currentPage++;
+  } else if (sectionBuildTaskHandle) {
+    // Still building, the next page is shown as soon as it exists
+    section->currentPage = std::min(section->currentPage + 1, static_cast<int>(section->pageCount));
   } else {
-    if (section->currentPage < section->pageCount - 1) {
-      section->currentPage++;
-    } else {
-      // We don't want to delete the section mid-render, so grab the semaphore
-      xSemaphoreTake(renderingMutex, portMAX_DELAY);
-      nextPageNumber = 0;
-      currentSpineIndex++;
-      section.reset();
+    nextPageNumber = 0;
+    currentSpineIndex++;
+    section.reset();
+  }
+  xSemaphoreGive(renderingMutex);
+  updateRequired = true;
+}
+
+void EpubReaderActivity::buildSection() {
+  xSemaphoreTake(renderingMutex, portMAX_DELAY);
+
+  // Sub activities read the SD card (TOC titles, KOReader sync) without renderingMutex and SdFat can't be shared,
+  // the build waits at a page boundary until they are closed
+  const auto waitForSubActivity = [this] {
+    while (subActivity && !sectionBuildCancelled) {
       xSemaphoreGive(renderingMutex);
+      vTaskDelay(10 / portTICK_PERIOD_MS);
+      xSemaphoreTake(renderingMutex, portMAX_DELAY);
+    }
+  };
+
+  // Progress only goes on screen while the box is all there is to see
+  const auto progressCallback = [this](const int progress) {
+    if (waitingForSectionBuild && !subActivity) {
+      renderIndexingBox(progress);
+    }
+  };
+  const auto pageBuilt = [this, &waitForSubActivity] {
+    if (waitingForSectionBuild && !subActivity) {
+      updateRequired = true;
     }
-    updateRequired = true;
+    // The section is consistent up to the page just built, let rendering and input handling at it
+    xSemaphoreGive(renderingMutex);
+    vTaskDelay(1);
+    xSemaphoreTake(renderingMutex, portMAX_DELAY);
+    waitForSubActivity();
+    return !sectionBuildCancelled;
+  };
+
+  waitForSubActivity();
+  const auto start = millis();
+  const bool built =
+      !sectionBuildCancelled &&
+      section->createSectionFile(SETTINGS.getReaderFontId(), SETTINGS.getReaderLineCompression(),
+                                 SETTINGS.extraParagraphSpacing, SETTINGS.paragraphAlignment, layoutViewportWidth,
+                                 layoutViewportHeight, SETTINGS.hyphenationEnabled, nullptr, progressCallback,
+                                 pageBuilt);
+  if (built) {
+    Serial.printf("[%lu] [ERS] Built %d pages in the background in %lums\n", millis(), section->pageCount,
+                  millis() - start);
+    noteSectionPageCount(currentSpineIndex, section->pageCount);
+    // Positions that needed the whole chapter can be applied now
+    if (waitingForSectionBuild && !subActivity) {
+      updateRequired = true;
+    }
+  } else if (!sectionBuildCancelled) {
+    Serial.printf("[%lu] [ERS] Failed to persist page data to SD\n", millis());
+    waitingForSectionBuild = false;
+    // Input handling may still be using the section, it is dropped from loop()
+    sectionBuildFailed = true;
+  }
+
+  sectionBuildTaskHandle = nullptr;
+  xSemaphoreGive(renderingMutex);
+}
+
+void EpubReaderActivity::stopSectionBuild() {
+  if (!sectionBuildTaskHandle) {
+    return;
+  }
+  sectionBuildCancelled = true;
+  // The build only looks at the flag between pages, which it can't reach while the mutex is held here
+  while (sectionBuildTaskHandle) {
+    xSemaphoreGive(renderingMutex);
+    vTaskDelay(10 / portTICK_PERIOD_MS);
+    xSemaphoreTake(renderingMutex, portMAX_DELAY);
+  }
+  waitingForSectionBuild = false;
+}
+
+void EpubReaderActivity::renderIndexingBox(const int progress) {
+  constexpr int barWidth = 200;
+  constexpr int barHeight = 10;
+  constexpr int boxMargin = 20;
+  constexpr int boxY = 50;
+  const bool withBar = progress >= 0;
+  const bool fg = !SETTINGS.readerDarkMode;
+  const bool bg = SETTINGS.readerDarkMode;
+  const int textWidth = renderer.getTextWidth(UI_12_FONT_ID, "Indexing...");
+  const int boxWidth = (withBar ? std::max(barWidth, textWidth) : textWidth) + boxMargin * 2;
+  const int boxHeight = renderer.getLineHeight(UI_12_FONT_ID) + boxMargin * 2 + (withBar ? barHeight + boxMargin : 0);
+  const int boxX = (renderer.getScreenWidth() - boxWidth) / 2;
+
+  renderer.setTextInverted(false);
+  renderer.fillRect(boxX, boxY, boxWidth, boxHeight, bg);
+  renderer.drawText(UI_12_FONT_ID, boxX + boxMargin, boxY + boxMargin, "Indexing...", fg);
+  renderer.drawRect(boxX + 5, boxY + 5, boxWidth - 10, boxHeight - 10, fg);
+  if (!withBar) {
+    renderer.displayBuffer();
+    pagesUntilFullRefresh = 0;
+    return;
+  }
+
+  const int barX = boxX + (boxWidth - barWidth) / 2;
+  const int barY = boxY + renderer.getLineHeight(UI_12_FONT_ID) + boxMargin * 2;
+  renderer.drawRect(barX, barY, barWidth, barHeight, fg);
+  renderer.fillRect(barX + 1, barY + 1, (barWidth - 2) * progress / 100, barHeight - 2, fg);
+  renderer.displayBuffer(HalDisplay::FAST_REFRESH);
+}
+
+void EpubReaderActivity::noteSectionPageCount(const int spineIndex, const uint16_t pageCount) {
+  if (spineIndex < 0 || spineIndex >= static_cast<int>(indexedPageCounts.size()) ||
+      indexedPageCounts[spineIndex] == pageCount) {
+    return;
+  }
+  indexedPageCounts[spineIndex] = pageCount;
+  if (std::any_of(indexedPageCounts.begin(), indexedPageCounts.end(),
+                  [](const uint16_t count) { return count >= pageCountFailed; })) {
+    return;
+  }
+
+  // Every chapter is laid out under this layout, the page numbers are exact now
+  auto& bookPages = epub->getBookPageMap();
+  if (!bookPages.isAvailable() || bookPages.getLayoutKey() != indexedLayoutKey ||
+      bookPages.getSpineCount() != static_cast<int>(indexedPageCounts.size())) {
+    bookPages.save(indexedLayoutKey, indexedPageCounts);
+    // The status bar of the pre-rendered page still shows the estimated book pages
+    clearPrerenderedPage();
+  }
+}
+
+bool EpubReaderActivity::shouldPauseIndexing() {
+  // The battery is only sampled every so often, reading it is not free and it changes slowly
+  if (lastBatteryCheckMs == 0 || millis() - lastBatteryCheckMs >= indexBatteryCheckMs) {
+    lastBatteryCheckMs = millis();
+    const bool low = battery.readPercentage() < indexMinBatteryPercent;
+    if (low != batteryLowForIndexing) {
+      Serial.printf("[%lu] [ERS] Background indexing %s\n", millis(), low ? "paused, battery low" : "resumed");
+    }
+    batteryLowForIndexing = low;
+  }
+  // Renders (page turns), sub activities and the current chapter's own build all come first
+  return indexingCancelled || batteryLowForIndexing || updateRequired || subActivity || sectionBuildTaskHandle;
+}
+
+void EpubReaderActivity::indexNextSection() {
+  const int spineCount = static_cast<int>(indexedPageCounts.size());
+  if (!epub || !section || currentSpineIndex < 0 || currentSpineIndex >= spineCount) {
+    return;
+  }
+
+  // Next and previous chapters first, then spreading out from the current one
+  int target = -1;
+  for (int distance = 1; distance < spineCount && target < 0; distance++) {
+    for (const int candidate : {currentSpineIndex + distance, currentSpineIndex - distance}) {
+      if (candidate >= 0 && candidate < spineCount && indexedPageCounts[candidate] == pageCountUnknown) {
+        target = candidate;
+        break;
+      }
+    }
+  }
+  if (target < 0) {
+    // Only the current chapter can be left, its count comes in when it is rendered
+    bookIndexComplete = indexedPageCounts[currentSpineIndex] != pageCountUnknown;
+    return;
+  }
+
+  Section candidate(epub, target, renderer);
+  if (candidate.loadSectionFile(SETTINGS.getReaderFontId(), SETTINGS.getReaderLineCompression(),
+                                SETTINGS.extraParagraphSpacing, SETTINGS.paragraphAlignment, layoutViewportWidth,
+                                layoutViewportHeight, SETTINGS.hyphenationEnabled)) {
+    noteSectionPageCount(target, candidate.pageCount);
+    return;
+  }
+
+  Serial.printf("[%lu] [ERS] Indexing spine item %d in the background\n", millis(), target);
+  const auto start = millis();
+  bool paused = false;
+  indexingSection = true;
+  const bool built = candidate.createSectionFile(
+      SETTINGS.getReaderFontId(), SETTINGS.getReaderLineCompression(), SETTINGS.extraParagraphSpacing,
+      SETTINGS.paragraphAlignment, layoutViewportWidth, layoutViewportHeight, SETTINGS.hyphenationEnabled, nullptr,
+      nullptr, [this, &paused] {
+        // Input handling gets the mutex between pages, then anything that wants the display stops the build. It
+        // resumes from its checkpoint once the reader is idle again.
+        xSemaphoreGive(renderingMutex);
+        vTaskDelay(1);
+        xSemaphoreTake(renderingMutex, portMAX_DELAY);
+        paused = shouldPauseIndexing();
+        return !paused;
+      });
+  indexingSection = false;
+
+  if (built) {
+    Serial.printf("[%lu] [ERS] Indexed spine item %d: %d pages in %lums\n", millis(), target, candidate.pageCount,
+                  millis() - start);
+    noteSectionPageCount(target, candidate.pageCount);
+  } else if (!paused) {
+    Serial.printf("[%lu] [ERS] Failed to index spine item %d\n", millis(), target);
+    indexedPageCounts[target] = pageCountFailed;
+  }
+}
+
+void EpubReaderActivity::stopBackgroundIndexing() {
+  indexingCancelled = true;
+  while (indexingSection) {
+    xSemaphoreGive(renderingMutex);
+    vTaskDelay(10 / portTICK_PERIOD_MS);
+    xSemaphoreTake(renderingMutex, portMAX_DELAY);
   }
 }
 
@@ -264,12 +535,54 @@ void EpubReaderActivity::displayTaskLoop() {
       updateRequired = false;
       xSemaphoreTake(renderingMutex, portMAX_DELAY);
       renderScreen();
+      lastRenderMs = millis();
+      prefetchPending = true;
+      prerenderPending = true;
+      xSemaphoreGive(renderingMutex);
+    } else if (prefetchPending) {
+      // One page at a time, a page turn in between is rendered first
+      xSemaphoreTake(renderingMutex, portMAX_DELAY);
+      prefetchPending =
+          section && !sectionBuildFailed && !sectionPositionPending && !updateRequired && section->prefetchPage();
+      xSemaphoreGive(renderingMutex);
+    } else if (prerenderPending) {
+      xSemaphoreTake(renderingMutex, portMAX_DELAY);
+      prerenderPending = false;
+      // The frame buffer is borrowed for this, sub activities draw to it from their own task
+      if (section && !sectionBuildFailed && !sectionPositionPending && !sectionBuildTaskHandle && !updateRequired &&
+          !subActivity) {
+        prerenderNextPage();
+      }
+      xSemaphoreGive(renderingMutex);
+    } else if (!bookIndexComplete && section && millis() - lastRenderMs >= indexIdleMs && !shouldPauseIndexing()) {
+      xSemaphoreTake(renderingMutex, portMAX_DELAY);
+      indexNextSection();
       xSemaphoreGive(renderingMutex);
     }
     vTaskDelay(10 / portTICK_PERIOD_MS);
   }
 }
 
+void EpubReaderActivity::getContentMargins(int* orientedMarginTop, int* orientedMarginRight, int* orientedMarginBottom,
+                                           int* orientedMarginLeft) const {
+  // Apply screen viewable areas and additional padding
+  renderer.getOrientedViewableTRBL(orientedMarginTop, orientedMarginRight, orientedMarginBottom, orientedMarginLeft);
+  *orientedMarginTop += SETTINGS.screenMargin;
+  *orientedMarginLeft += SETTINGS.screenMargin;
+  *orientedMarginRight += SETTINGS.screenMargin;
+  *orientedMarginBottom += SETTINGS.screenMargin;
+
+  // Add status bar margin
+  if (SETTINGS.statusBar != CrossPointSettings::STATUS_BAR_MODE::NONE) {
+    // Add additional margin for status bar if progress bar is shown
+    const bool showProgressBar = SETTINGS.statusBar == CrossPointSettings::STATUS_BAR_MODE::FULL_WITH_PROGRESS_BAR ||
+                                 SETTINGS.statusBar == CrossPointSettings::STATUS_BAR_MODE::ONLY_PROGRESS_BAR;
+    *orientedMarginBottom +=
+        statusBarMargin - SETTINGS.screenMargin +
+        (showProgressBar ? (ScreenComponents::BOOK_PROGRESS_BAR_HEIGHT + progressBarMarginTop) : 0);
+  }
+}
+
 // TODO: Failure handling
 void EpubReaderActivity::renderScreen() {
   if (!epub) {
@@ -295,116 +608,64 @@ void EpubReaderActivity::renderScreen() {
     return;
   }
 
-  // Apply screen viewable areas and additional padding
   int orientedMarginTop, orientedMarginRight, orientedMarginBottom, orientedMarginLeft;
-  renderer.getOrientedViewableTRBL(&orientedMarginTop, &orientedMarginRight, &orientedMarginBottom,
-                                   &orientedMarginLeft);
-  orientedMarginTop += SETTINGS.screenMargin;
-  orientedMarginLeft += SETTINGS.screenMargin;
-  orientedMarginRight += SETTINGS.screenMargin;
-  orientedMarginBottom += SETTINGS.screenMargin;
-
-  // Add status bar margin
-  if (SETTINGS.statusBar != CrossPointSettings::STATUS_BAR_MODE::NONE) {
-    // Add additional margin for status bar if progress bar is shown
-    const bool showProgressBar = SETTINGS.statusBar == CrossPointSettings::STATUS_BAR_MODE::FULL_WITH_PROGRESS_BAR ||
-                                 SETTINGS.statusBar == CrossPointSettings::STATUS_BAR_MODE::ONLY_PROGRESS_BAR;
-    orientedMarginBottom += statusBarMargin - SETTINGS.screenMargin +
-                            (showProgressBar ? (ScreenComponents::BOOK_PROGRESS_BAR_HEIGHT + progressBarMarginTop) : 0);
+  getContentMargins(&orientedMarginTop, &orientedMarginRight, &orientedMarginBottom, &orientedMarginLeft);
+
+  layoutViewportWidth = renderer.getScreenWidth() - orientedMarginLeft - orientedMarginRight;
+  layoutViewportHeight = renderer.getScreenHeight() - orientedMarginTop - orientedMarginBottom;
+  // A different layout (e.g. after an orientation change) has to be indexed again
+  const uint64_t layoutKey = makeLayoutKey(layoutViewportWidth, layoutViewportHeight);
+  if (layoutKey != indexedLayoutKey || indexedPageCounts.size() != static_cast<size_t>(epub->getSpineItemsCount())) {
+    indexedLayoutKey = layoutKey;
+    indexedPageCounts.assign(epub->getSpineItemsCount(), pageCountUnknown);
+    bookIndexComplete = false;
   }
 
+  if (sectionBuildFailed) {
+    // Half written, loop() drops it before anything else is done with it
+    return;
+  }
   if (!section) {
     const auto filepath = epub->getSpineItem(currentSpineIndex).href;
     Serial.printf("[%lu] [ERS] Loading file: %s, index: %d\n", millis(), filepath.c_str(), currentSpineIndex);
     section = std::unique_ptr<Section>(new Section(epub, currentSpineIndex, renderer));
-
-    const uint16_t viewportWidth = renderer.getScreenWidth() - orientedMarginLeft - orientedMarginRight;
-    const uint16_t viewportHeight = renderer.getScreenHeight() - orientedMarginTop - orientedMarginBottom;
+    sectionBuildFailed = false;
+    // Layout, orientation or chapter changed, a frame drawn for the previous section is of no use
+    clearPrerenderedPage();
 
     if (!section->loadSectionFile(SETTINGS.getReaderFontId(), SETTINGS.getReaderLineCompression(),
-                                  SETTINGS.extraParagraphSpacing, SETTINGS.paragraphAlignment, viewportWidth,
-                                  viewportHeight, SETTINGS.hyphenationEnabled)) {
-      Serial.printf("[%lu] [ERS] Cache not found, building...\n", millis());
-
-      // Progress bar dimensions
-      constexpr int barWidth = 200;
-      constexpr int barHeight = 10;
-      constexpr int boxMargin = 20;
-      const bool fg = !SETTINGS.readerDarkMode;
-      const bool bg = SETTINGS.readerDarkMode;
-      const int textWidth = renderer.getTextWidth(UI_12_FONT_ID, "Indexing...");
-      const int boxWidthWithBar = (barWidth > textWidth ? barWidth : textWidth) + boxMargin * 2;
-      const int boxWidthNoBar = textWidth + boxMargin * 2;
-      const int boxHeightWithBar = renderer.getLineHeight(UI_12_FONT_ID) + barHeight + boxMargin * 3;
-      const int boxHeightNoBar = renderer.getLineHeight(UI_12_FONT_ID) + boxMargin * 2;
-      const int boxXWithBar = (renderer.getScreenWidth() - boxWidthWithBar) / 2;
-      const int boxXNoBar = (renderer.getScreenWidth() - boxWidthNoBar) / 2;
-      constexpr int boxY = 50;
-      const int barX = boxXWithBar + (boxWidthWithBar - barWidth) / 2;
-      const int barY = boxY + renderer.getLineHeight(UI_12_FONT_ID) + boxMargin * 2;
-
-      // Always show "Indexing..." text first
-      {
-        renderer.setTextInverted(false);
-        renderer.fillRect(boxXNoBar, boxY, boxWidthNoBar, boxHeightNoBar, bg);
-        renderer.drawText(UI_12_FONT_ID, boxXNoBar + boxMargin, boxY + boxMargin, "Indexing...", fg);
-        renderer.drawRect(boxXNoBar + 5, boxY + 5, boxWidthNoBar - 10, boxHeightNoBar - 10, fg);
-        renderer.displayBuffer();
-        pagesUntilFullRefresh = 0;
-      }
-
-      // Setup callback - only called for chapters >= 50KB, redraws with progress bar
-      auto progressSetup = [this, boxXWithBar, boxWidthWithBar, boxHeightWithBar, barX, barY] {
-        const bool fg = !SETTINGS.readerDarkMode;
-        const bool bg = SETTINGS.readerDarkMode;
-        renderer.setTextInverted(false);
-        renderer.fillRect(boxXWithBar, boxY, boxWidthWithBar, boxHeightWithBar, bg);
-        renderer.drawText(UI_12_FONT_ID, boxXWithBar + boxMargin, boxY + boxMargin, "Indexing...", fg);
-        renderer.drawRect(boxXWithBar + 5, boxY + 5, boxWidthWithBar - 10, boxHeightWithBar - 10, fg);
-        renderer.drawRect(barX, barY, barWidth, barHeight, fg);
-        renderer.displayBuffer();
-      };
-
-      // Progress callback to update progress bar
-      auto progressCallback = [this, barX, barY, barWidth, barHeight](int progress) {
-        const bool fg = !SETTINGS.readerDarkMode;
-        const int fillWidth = (barWidth - 2) * progress / 100;
-        renderer.fillRect(barX + 1, barY + 1, fillWidth, barHeight - 2, fg);
-        renderer.displayBuffer(HalDisplay::FAST_REFRESH);
-      };
-
-      if (!section->createSectionFile(SETTINGS.getReaderFontId(), SETTINGS.getReaderLineCompression(),
-                                      SETTINGS.extraParagraphSpacing, SETTINGS.paragraphAlignment, viewportWidth,
-                                      viewportHeight, SETTINGS.hyphenationEnabled, progressSetup, progressCallback)) {
-        Serial.printf("[%lu] [ERS] Failed to persist page data to SD\n", millis());
+                                  SETTINGS.extraParagraphSpacing, SETTINGS.paragraphAlignment, layoutViewportWidth,
+                                  layoutViewportHeight, SETTINGS.hyphenationEnabled)) {
+      Serial.printf("[%lu] [ERS] Cache not found, building in the background...\n", millis());
+      sectionBuildCancelled = false;
+      // Layout and SD writes run on the build task's stack, it needs as much as the display task
+      if (xTaskCreate(&EpubReaderActivity::sectionBuildTaskTrampoline, "EpubSectionBuildTask", 8192, this, 1,
+                      &sectionBuildTaskHandle) != pdPASS) {
+        Serial.printf("[%lu] [ERS] Failed to start section build\n", millis());
+        sectionBuildTaskHandle = nullptr;
         section.reset();
         return;
       }
     } else {
       Serial.printf("[%lu] [ERS] Cache found, skipping build...\n", millis());
     }
+    sectionPositionPending = true;
+  }
 
-    if (pendingSpineFraction >= 0.0f && section->pageCount > 0) {
-      const int estimatedPage = static_cast<int>(std::round(pendingSpineFraction * (section->pageCount - 1)));
-      section->currentPage = std::min(std::max(estimatedPage, 0), section->pageCount - 1);
-      pendingSpineFraction = -1.0f;
-      nextPageNumber = section->currentPage;
-    } else if (nextPageNumber == UINT16_MAX) {
-      section->currentPage = section->pageCount - 1;
-    } else {
-      section->currentPage = nextPageNumber;
-    }
-
-    // handles changes in reader settings and reset to approximate position based on cached progress
-    if (cachedChapterTotalPageCount > 0) {
-      // only goes to relative position if spine index matches cached value
-      if (currentSpineIndex == cachedSpineIndex && section->pageCount != cachedChapterTotalPageCount) {
-        float progress = static_cast<float>(section->currentPage) / static_cast<float>(cachedChapterTotalPageCount);
-        int newPage = static_cast<int>(progress * section->pageCount);
-        section->currentPage = newPage;
-      }
-      cachedChapterTotalPageCount = 0;  // resets to 0 to prevent reading cached progress again
+  if (sectionPositionPending && applyPendingPosition()) {
+    sectionPositionPending = false;
+  }
+  // Page not built yet, every page the build adds asks for another render until it is
+  if (sectionPositionPending || (sectionBuildTaskHandle && section->currentPage >= section->pageCount)) {
+    if (!waitingForSectionBuild) {
+      waitingForSectionBuild = true;
+      renderIndexingBox(-1);
     }
+    return;
+  }
+  waitingForSectionBuild = false;
+  if (!sectionBuildTaskHandle) {
+    noteSectionPageCount(currentSpineIndex, section->pageCount);
   }
 
   // Popup temporarily disables text inversion for readability.
@@ -414,7 +675,7 @@ void EpubReaderActivity::renderScreen() {
   if (section->pageCount == 0) {
     Serial.printf("[%lu] [ERS] No pages to render\n", millis());
     renderer.drawCenteredText(UI_12_FONT_ID, 300, "Empty chapter", true, EpdFontFamily::BOLD);
-    renderStatusBar(orientedMarginRight, orientedMarginBottom, orientedMarginLeft);
+    renderStatusBar(section->currentPage, orientedMarginRight, orientedMarginBottom, orientedMarginLeft);
     renderer.displayBuffer();
     return;
   }
@@ -422,43 +683,116 @@ void EpubReaderActivity::renderScreen() {
   if (section->currentPage < 0 || section->currentPage >= section->pageCount) {
     Serial.printf("[%lu] [ERS] Page out of bounds: %d (max %d)\n", millis(), section->currentPage, section->pageCount);
     renderer.drawCenteredText(UI_12_FONT_ID, 300, "Out of bounds", true, EpdFontFamily::BOLD);
-    renderStatusBar(orientedMarginRight, orientedMarginBottom, orientedMarginLeft);
+    renderStatusBar(section->currentPage, orientedMarginRight, orientedMarginBottom, orientedMarginLeft);
     renderer.displayBuffer();
     return;
   }
 
   {
-    auto p = section->loadPageFromSectionFile();
+    const Page* p = section->getPage(section->currentPage);
     if (!p) {
       Serial.printf("[%lu] [ERS] Failed to load page from SD - clearing section cache\n", millis());
+      stopSectionBuild();
       section->clearCache();
       section.reset();
       return renderScreen();
     }
     const auto start = millis();
-    renderContents(std::move(p), orientedMarginTop, orientedMarginRight, orientedMarginBottom, orientedMarginLeft);
+    renderContents(*p, orientedMarginTop, orientedMarginRight, orientedMarginBottom, orientedMarginLeft);
     Serial.printf("[%lu] [ERS] Rendered page in %dms\n", millis(), millis() - start);
   }
 
+  SourcePosition sourcePosition;
+  const bool hasSourcePosition = section->getSourcePosition(section->currentPage, &sourcePosition);
   FsFile f;
   if (SdMan.openFileForWrite("ERS", epub->getCachePath() + "/progress.bin", f)) {
-    uint8_t data[6];
+    uint8_t data[12];
     data[0] = currentSpineIndex & 0xFF;
     data[1] = (currentSpineIndex >> 8) & 0xFF;
     data[2] = section->currentPage & 0xFF;
     data[3] = (section->currentPage >> 8) & 0xFF;
     data[4] = section->pageCount & 0xFF;
     data[5] = (section->pageCount >> 8) & 0xFF;
-    f.write(data, 6);
+    if (hasSourcePosition) {
+      data[6] = sourcePosition.offset & 0xFF;
+      data[7] = (sourcePosition.offset >> 8) & 0xFF;
+      data[8] = (sourcePosition.offset >> 16) & 0xFF;
+      data[9] = (sourcePosition.offset >> 24) & 0xFF;
+      data[10] = sourcePosition.wordIndex & 0xFF;
+      data[11] = (sourcePosition.wordIndex >> 8) & 0xFF;
+    }
+    f.write(data, hasSourcePosition ? 12 : 6);
     f.close();
   }
 }
 
-void EpubReaderActivity::renderContents(std::unique_ptr<Page> page, const int orientedMarginTop,
-                                        const int orientedMarginRight, const int orientedMarginBottom,
-                                        const int orientedMarginLeft) {
-  page->render(renderer, SETTINGS.getReaderFontId(), orientedMarginLeft, orientedMarginTop);
-  renderStatusBar(orientedMarginRight, orientedMarginBottom, orientedMarginLeft);
+// Moves a newly opened section to where reading continues. Returns false while that depends on pages the background
+// build has not produced yet.
+bool EpubReaderActivity::applyPendingPosition() {
+  if (sectionBuildTaskHandle) {
+    // A spine fraction, the last page, an anchor or a page count saved without a source position need every page
+    if (!section->isBuilding() || pendingSpineFraction >= 0.0f || nextPageNumber == UINT16_MAX ||
+        !pendingAnchor.empty() ||
+        (!hasPendingSourcePosition && cachedChapterTotalPageCount > 0 && currentSpineIndex == cachedSpineIndex)) {
+      return false;
+    }
+    if (hasPendingSourcePosition && currentSpineIndex == cachedSpineIndex &&
+        section->getPageForSourcePosition(pendingSourcePosition) < 0) {
+      return false;
+    }
+  }
+
+  if (pendingSpineFraction >= 0.0f && section->pageCount > 0) {
+    const int estimatedPage = static_cast<int>(std::round(pendingSpineFraction * (section->pageCount - 1)));
+    section->currentPage = std::min(std::max(estimatedPage, 0), section->pageCount - 1);
+    pendingSpineFraction = -1.0f;
+    nextPageNumber = section->currentPage;
+  } else if (nextPageNumber == UINT16_MAX) {
+    section->currentPage = section->pageCount - 1;
+  } else {
+    section->currentPage = nextPageNumber;
+  }
+
+  // Saved source position maps back to the same first line whatever the layout, so prefer it over the page
+  if (hasPendingSourcePosition) {
+    if (currentSpineIndex == cachedSpineIndex) {
+      const int sourcePage = section->getPageForSourcePosition(pendingSourcePosition);
+      if (sourcePage >= 0) {
+        section->currentPage = sourcePage;
+      }
+    }
+    hasPendingSourcePosition = false;
+    cachedChapterTotalPageCount = 0;
+  }
+
+  // handles changes in reader settings and reset to approximate position based on cached progress
+  if (cachedChapterTotalPageCount > 0) {
+    // only goes to relative position if spine index matches cached value
+    if (currentSpineIndex == cachedSpineIndex && section->pageCount != cachedChapterTotalPageCount) {
+      float progress = static_cast<float>(section->currentPage) / static_cast<float>(cachedChapterTotalPageCount);
+      int newPage = static_cast<int>(progress * section->pageCount);
+      section->currentPage = newPage;
+    }
+    cachedChapterTotalPageCount = 0;  // resets to 0 to prevent reading cached progress again
+  }
+
+  if (!pendingAnchor.empty()) {
+    const int anchorPage = section->getPageForAnchor(pendingAnchor);
+    if (anchorPage >= 0) {
+      section->currentPage = anchorPage;
+    }
+    pendingAnchor.clear();
+  }
+  return true;
+}
+
+void EpubReaderActivity::renderContents(const Page& page, const int orientedMarginTop, const int orientedMarginRight,
+                                        const int orientedMarginBottom, const int orientedMarginLeft) {
+  const bool prerendered = unpackPrerenderedPage();
+  if (!prerendered) {
+    page.render(renderer, SETTINGS.getReaderFontId(), orientedMarginLeft, orientedMarginTop);
+    renderStatusBar(section->currentPage, orientedMarginRight, orientedMarginBottom, orientedMarginLeft);
+  }
 
   // Refresh policy:
   // - Light mode: unchanged (FAST most pages, periodic HALF refresh).
@@ -470,9 +804,11 @@ void EpubReaderActivity::renderContents(std::unique_ptr<Page> page, const int or
 
   if (pagesUntilFullRefresh <= 1) {
     renderer.displayBuffer(HalDisplay::HALF_REFRESH);
+    logPageTurnLatency(prerendered);
     pagesUntilFullRefresh = effectiveRefreshFrequency;
   } else {
     renderer.displayBuffer(HalDisplay::FAST_REFRESH);
+    logPageTurnLatency(prerendered);
     pagesUntilFullRefresh--;
 
     if (darkMode) {
@@ -493,13 +829,13 @@ void EpubReaderActivity::renderContents(std::unique_ptr<Page> page, const int or
   if (SETTINGS.textAntiAliasing) {
     renderer.clearScreen(0x00);
     renderer.setRenderMode(GfxRenderer::GRAYSCALE_LSB);
-    page->render(renderer, SETTINGS.getReaderFontId(), orientedMarginLeft, orientedMarginTop);
+    page.render(renderer, SETTINGS.getReaderFontId(), orientedMarginLeft, orientedMarginTop);
     renderer.copyGrayscaleLsbBuffers();
 
     // Render and copy to MSB buffer
     renderer.clearScreen(0x00);
     renderer.setRenderMode(GfxRenderer::GRAYSCALE_MSB);
-    page->render(renderer, SETTINGS.getReaderFontId(), orientedMarginLeft, orientedMarginTop);
+    page.render(renderer, SETTINGS.getReaderFontId(), orientedMarginLeft, orientedMarginTop);
     renderer.copyGrayscaleMsbBuffers();
 
     // display grayscale part
@@ -511,7 +847,87 @@ void EpubReaderActivity::renderContents(std::unique_ptr<Page> page, const int or
   renderer.restoreBwBuffer();
 }
 
-void EpubReaderActivity::renderStatusBar(const int orientedMarginRight, const int orientedMarginBottom,
+void EpubReaderActivity::prerenderNextPage() {
+  const int nextPage = section->currentPage + 1;
+  if (nextPage >= section->pageCount || (prerenderedSpineIndex == currentSpineIndex && prerenderedPage == nextPage)) {
+    return;
+  }
+  const Page* page = section->getPage(nextPage);
+  uint8_t* frameBuffer = renderer.getFrameBuffer();
+  if (!page || !frameBuffer) {
+    return;
+  }
+  const auto start = millis();
+  clearPrerenderedPage();
+
+  // The frame on screen is packed away while the next page is drawn in its place, then put back. A failed allocation
+  // aborts, so with an image on screen or a fragmented heap the next page is simply drawn on the turn.
+  const size_t bufferSize = GfxRenderer::getBufferSize();
+  const size_t shownSize = PackBits::encode(frameBuffer, bufferSize, nullptr);
+  const size_t largestBlock = ESP.getMaxAllocHeap();
+  if (shownSize > maxPrerenderedFrameSize ||
+      largestBlock < shownSize + maxPrerenderedFrameSize + prerenderHeapReserve) {
+    Serial.printf("[%lu] [ERS] Not pre-rendering page %d: %u bytes packed on screen, largest free block %u\n",
+                  millis(), nextPage, static_cast<unsigned>(shownSize), static_cast<unsigned>(largestBlock));
+    return;
+  }
+  std::vector<uint8_t> shownFrame(shownSize);
+  PackBits::encode(frameBuffer, bufferSize, shownFrame.data());
+
+  int orientedMarginTop, orientedMarginRight, orientedMarginBottom, orientedMarginLeft;
+  getContentMargins(&orientedMarginTop, &orientedMarginRight, &orientedMarginBottom, &orientedMarginLeft);
+  renderer.clearScreen(SETTINGS.readerDarkMode ? 0x00 : 0xFF);
+  page->render(renderer, SETTINGS.getReaderFontId(), orientedMarginLeft, orientedMarginTop);
+  const uint16_t batteryPercent = battery.readPercentage();
+  renderStatusBar(nextPage, orientedMarginRight, orientedMarginBottom, orientedMarginLeft);
+
+  const size_t packedSize = PackBits::encode(frameBuffer, bufferSize, nullptr);
+  const bool keep = packedSize <= maxPrerenderedFrameSize && ESP.getMaxAllocHeap() >= packedSize + prerenderHeapReserve;
+  if (keep) {
+    prerenderedFrame.resize(packedSize);
+    PackBits::encode(frameBuffer, bufferSize, prerenderedFrame.data());
+    prerenderedSpineIndex = currentSpineIndex;
+    prerenderedPage = nextPage;
+    prerenderedBatteryPercent = batteryPercent;
+  }
+  PackBits::decode(shownFrame.data(), shownFrame.size(), frameBuffer, bufferSize);
+  Serial.printf("[%lu] [ERS] Pre-rendered page %d in %lums: %u bytes packed%s\n", millis(), nextPage,
+                millis() - start, static_cast<unsigned>(packedSize), keep ? "" : ", not kept");
+}
+
+bool EpubReaderActivity::unpackPrerenderedPage() {
+  if (prerenderedSpineIndex != currentSpineIndex || prerenderedPage != section->currentPage) {
+    return false;
+  }
+  // The status bar was drawn with the battery level of back then, a changed one has the page drawn afresh
+  if (battery.readPercentage() != prerenderedBatteryPercent) {
+    clearPrerenderedPage();
+    return false;
+  }
+  uint8_t* frameBuffer = renderer.getFrameBuffer();
+  const bool unpacked = frameBuffer && PackBits::decode(prerenderedFrame.data(), prerenderedFrame.size(),
+                                                        frameBuffer, GfxRenderer::getBufferSize());
+  // On screen now, the next page gets its own frame once the reader is idle again
+  clearPrerenderedPage();
+  return unpacked;
+}
+
+void EpubReaderActivity::clearPrerenderedPage() {
+  std::vector<uint8_t>().swap(prerenderedFrame);
+  prerenderedSpineIndex = -1;
+  prerenderedPage = -1;
+}
+
+void EpubReaderActivity::logPageTurnLatency(const bool prerendered) {
+  if (pageTurnStartMs == 0) {
+    return;
+  }
+  Serial.printf("[%lu] [ERS] Page turn on screen %lums after the button (%s)\n", millis(), millis() - pageTurnStartMs,
+                prerendered ? "pre-rendered" : "rendered");
+  pageTurnStartMs = 0;
+}
+
+void EpubReaderActivity::renderStatusBar(const int page, const int orientedMarginRight, const int orientedMarginBottom,
                                          const int orientedMarginLeft) const {
   // determine visible status bar elements
   const bool showProgressPercentage = SETTINGS.statusBar == CrossPointSettings::STATUS_BAR_MODE::FULL;
@@ -534,16 +950,25 @@ void EpubReaderActivity::renderStatusBar(const int orientedMarginRight, const in
   int progressTextWidth = 0;
 
   // Calculate progress in book (use mid-page for smoother position preservation)
-  const float sectionChapterProg = (static_cast<float>(section->currentPage) + 0.5f) / section->pageCount;
-  const float bookProgress = epub->calculateProgress(currentSpineIndex, sectionChapterProg) * 100;
+  const float sectionChapterProg = (static_cast<float>(page) + 0.5f) / section->pageCount;
+  const float bookProgress = epub->calculateProgress(currentSpineIndex, sectionChapterProg, indexedLayoutKey) * 100;
 
   if (showProgressText || showProgressPercentage) {
-    char progressStr[32];
-    if (showProgressPercentage) {
-      snprintf(progressStr, sizeof(progressStr), "%d/%d  %.0f%%", section->currentPage + 1, section->pageCount,
+    char progressStr[48];
+    // The page count keeps growing while the chapter is still being built
+    const char* pageCountSuffix = sectionBuildTaskHandle ? "+" : "";
+    auto& bookPages = epub->getBookPageMap();
+    const bool exactBookPages = bookPages.isAvailable() && bookPages.getLayoutKey() == indexedLayoutKey &&
+                                bookPages.getSpineCount() == epub->getSpineItemsCount();
+    if (showProgressPercentage && exactBookPages) {
+      snprintf(progressStr, sizeof(progressStr), "%d/%d  %lu/%lu  %.0f%%", page + 1, section->pageCount,
+               static_cast<unsigned long>(bookPages.getFirstPage(currentSpineIndex) + page + 1),
+               static_cast<unsigned long>(bookPages.getBookPageCount()), bookProgress);
+    } else if (showProgressPercentage) {
+      snprintf(progressStr, sizeof(progressStr), "%d/%d%s  %.0f%%", page + 1, section->pageCount, pageCountSuffix,
                bookProgress);
     } else {
-      snprintf(progressStr, sizeof(progressStr), "%d/%d", section->currentPage + 1, section->pageCount);
+      snprintf(progressStr, sizeof(progressStr), "%d/%d%s", page + 1, section->pageCount, pageCountSuffix);
     }
 
     progressTextWidth = renderer.getTextWidth(SMALL_FONT_ID, progressStr);
@@ -577,11 +1002,13 @@ void EpubReaderActivity::renderStatusBar(const int orientedMarginRight, const in
 
     std::string title;
     int titleWidth;
-    if (tocIndex == -1) {
+    TocWindowCache::Item tocItem;
+    // Titles are cached pre-truncated to the full status bar width, the loop below only trims them further
+    tocTitleCache->setMaxWidth(rendererableScreenWidth);
+    if (tocIndex == -1 || !tocTitleCache->get(tocIndex, &tocItem)) {
       title = "Unnamed";
       titleWidth = renderer.getTextWidth(SMALL_FONT_ID, "Unnamed");
     } else {
-      const auto tocItem = epub->getTocItem(tocIndex);
       title = tocItem.title;
       titleWidth = renderer.getTextWidth(SMALL_FONT_ID, title.c_str());
       if (titleWidth > availableTitleSpace) {
@@ -606,7 +1033,7 @@ float EpubReaderActivity::getCurrentProgress() const {
     return 0.0f;
   }
   const float sectionProgress = (static_cast<float>(section->currentPage) + 0.5f) / section->pageCount;
-  return epub->calculateProgress(currentSpineIndex, sectionProgress);
+  return epub->calculateProgress(currentSpineIndex, sectionProgress, indexedLayoutKey);
 }
 
 void EpubReaderActivity::resolveProgressToSpine(const float progress, int& outSpineIndex,
@@ -624,17 +1051,26 @@ void EpubReaderActivity::resolveProgressToSpine(const float progress, int& outSp
   }
 
   const float clampedProgress = std::min(std::max(progress, 0.0f), 1.0f);
-  const size_t targetBytes = static_cast<size_t>(bookSize * clampedProgress);
 
-  int spineIndex = 0;
-  for (int i = 0; i < epub->getSpineItemsCount(); i++) {
-    const size_t cumulativeSize = epub->getCumulativeSpineItemSize(i);
-    if (cumulativeSize >= targetBytes) {
-      spineIndex = i;
-      break;
-    }
+  // Inverse of Epub::calculateProgress, which counts pages once the book page map is available for this layout
+  auto& bookPages = epub->getBookPageMap();
+  const int spineCount = epub->getSpineItemsCount();
+  if (bookPages.isAvailable() && bookPages.getLayoutKey() == indexedLayoutKey &&
+      bookPages.getSpineCount() == spineCount && bookPages.getBookPageCount() > 0) {
+    const float targetPage = clampedProgress * static_cast<float>(bookPages.getBookPageCount());
+    const int spineIndex = bookPages.findSpineForPage(static_cast<uint32_t>(targetPage));
+    const uint32_t spinePages = bookPages.getSpinePageCount(spineIndex);
+    outSpineIndex = spineIndex;
+    outSpineFraction =
+        spinePages > 0 ? (targetPage - static_cast<float>(bookPages.getFirstPage(spineIndex))) / spinePages : 0.0f;
+    outSpineFraction = std::min(std::max(outSpineFraction, 0.0f), 1.0f);
+    return;
   }
 
+  const size_t targetBytes = static_cast<size_t>(bookSize * clampedProgress);
+
+  const int spineIndex = epub->getSpineIndexForBookOffset(targetBytes);
+
   const size_t prevCumulative = (spineIndex > 0) ? epub->getCumulativeSpineItemSize(spineIndex - 1) : 0;
   const size_t spineSize = epub->getCumulativeSpineItemSize(spineIndex) - prevCumulative;
   const size_t spineOffset = (targetBytes > prevCumulative) ? targetBytes - prevCumulative : 0;
@@ -648,13 +1084,16 @@ void EpubReaderActivity::cycleOrientationPreservePosition() {
     return;
   }
 
+  xSemaphoreTake(renderingMutex, portMAX_DELAY);
   const float progress = getCurrentProgress();
 
   int targetSpineIndex = 0;
   float spineFraction = 0.0f;
   resolveProgressToSpine(progress, targetSpineIndex, spineFraction);
 
-  xSemaphoreTake(renderingMutex, portMAX_DELAY);
+  // The page's source position survives the new layout exactly, the byte fraction is only an estimate
+  SourcePosition sourcePosition;
+  const bool hasSourcePosition = section && section->getSourcePosition(section->currentPage, &sourcePosition);
   if (SETTINGS.orientation == CrossPointSettings::ORIENTATION::PORTRAIT) {
     SETTINGS.orientation = CrossPointSettings::ORIENTATION::LANDSCAPE_CCW;
     renderer.setOrientation(GfxRenderer::Orientation::LandscapeCounterClockwise);
@@ -668,9 +1107,16 @@ void EpubReaderActivity::cycleOrientationPreservePosition() {
           : CrossPointSettings::SIDE_BUTTON_LAYOUT::PREV_NEXT;
   SETTINGS.saveToFile();
 
-  currentSpineIndex = targetSpineIndex;
-  pendingSpineFraction = spineFraction;
+  if (hasSourcePosition) {
+    cachedSpineIndex = currentSpineIndex;
+    pendingSourcePosition = sourcePosition;
+    hasPendingSourcePosition = true;
+  } else {
+    currentSpineIndex = targetSpineIndex;
+    pendingSpineFraction = spineFraction;
+  }
   nextPageNumber = 0;
+  stopSectionBuild();
   section.reset();
   xSemaphoreGive(renderingMutex);
 
@@ -1,6 +1,7 @@
 #pragma once
 #include <Epub.h>
 #include <Epub/Section.h>
+#include <Epub/TocWindowCache.h>
 #include <freertos/FreeRTOS.h>
 #include <freertos/semphr.h>
 #include <freertos/task.h>
@@ -10,24 +11,85 @@
 class EpubReaderActivity final : public ActivityWithSubactivity {
   std::shared_ptr<Epub> epub;
   std::unique_ptr<Section> section = nullptr;
+  // Chapter titles for the status bar, so drawing it does not go back to book.bin for every page turn
+  std::unique_ptr<TocWindowCache> tocTitleCache;
   TaskHandle_t displayTaskHandle = nullptr;
   SemaphoreHandle_t renderingMutex = nullptr;
+  // Builds a section that is not cached yet while its first pages are read. It holds renderingMutex except between
+  // pages, so the display task and input handling only ever see the section paused at a page boundary.
+  TaskHandle_t sectionBuildTaskHandle = nullptr;
+  bool sectionBuildCancelled = false;
+  // The build could not write the section, loop() drops it and the next render starts over
+  bool sectionBuildFailed = false;
+  // Viewport of the current layout, as of the last render
+  uint16_t layoutViewportWidth = 0;
+  uint16_t layoutViewportHeight = 0;
+  // The "Indexing..." box is up because the page to show has not been built yet
+  bool waitingForSectionBuild = false;
+  // The pending* positions below still have to be applied to a newly opened section
+  bool sectionPositionPending = false;
+  // Background indexer: while the reader is idle the display task lays out the chapters that aren't cached yet,
+  // adjacent ones first, and publishes exact book page numbers once every chapter's page count is known
+  std::vector<uint16_t> indexedPageCounts;
+  uint64_t indexedLayoutKey = 0;
+  bool bookIndexComplete = false;
+  bool indexingSection = false;
+  bool indexingCancelled = false;
+  bool batteryLowForIndexing = false;
+  unsigned long lastBatteryCheckMs = 0;
+  unsigned long lastRenderMs = 0;
   int currentSpineIndex = 0;
   int nextPageNumber = 0;
   int pagesUntilFullRefresh = 0;
   float pendingSpineFraction = -1.0f;
+  // Element id to open the next loaded section at (TOC entries pointing into the middle of a chapter)
+  std::string pendingAnchor;
   int cachedSpineIndex = 0;
   int cachedChapterTotalPageCount = 0;
+  // Source position to reopen cachedSpineIndex at, mapped back to a page once the section is (re)built
+  SourcePosition pendingSourcePosition = {0, 0};
+  bool hasPendingSourcePosition = false;
   bool updateRequired = false;
+  // Set after each render, the display task then decodes the pages next to the current one while idle
+  bool prefetchPending = false;
+  // Next page drawn and PackBits packed while the reader is idle, a forward turn then only unpacks it into the frame
+  // buffer before the refresh
+  std::vector<uint8_t> prerenderedFrame;
+  int prerenderedSpineIndex = -1;
+  int prerenderedPage = -1;
+  uint16_t prerenderedBatteryPercent = 0;
+  bool prerenderPending = false;
+  // When the page turn button was handled, for the button to display latency log
+  unsigned long pageTurnStartMs = 0;
   const std::function<void()> onGoBack;
   const std::function<void()> onGoHome;
 
   static void taskTrampoline(void* param);
   [[noreturn]] void displayTaskLoop();
+  static void sectionBuildTaskTrampoline(void* param);
+  void buildSection();
+  // Cancels a background build and waits for it to stop, must be called with renderingMutex held
+  void stopSectionBuild();
+  bool applyPendingPosition();
+  void renderIndexingBox(int progress);
+  void noteSectionPageCount(int spineIndex, uint16_t pageCount);
+  bool shouldPauseIndexing();
+  // Loads or builds one chapter for the index, called from the display task with renderingMutex held
+  void indexNextSection();
+  // Waits for an index build running in the display task to stop, must be called with renderingMutex held
+  void stopBackgroundIndexing();
+  void getContentMargins(int* orientedMarginTop, int* orientedMarginRight, int* orientedMarginBottom,
+                         int* orientedMarginLeft) const;
   void renderScreen();
-  void renderContents(std::unique_ptr<Page> page, int orientedMarginTop, int orientedMarginRight,
-                      int orientedMarginBottom, int orientedMarginLeft);
-  void renderStatusBar(int orientedMarginRight, int orientedMarginBottom, int orientedMarginLeft) const;
+  void renderContents(const Page& page, int orientedMarginTop, int orientedMarginRight, int orientedMarginBottom,
+                      int orientedMarginLeft);
+  // Draws the page after the current one and packs it, called from the display task while idle
+  void prerenderNextPage();
+  // Puts the pre-rendered frame in the frame buffer if it is the current page
+  bool unpackPrerenderedPage();
+  void clearPrerenderedPage();
+  void logPageTurnLatency(bool prerendered);
+  void renderStatusBar(int page, int orientedMarginRight, int orientedMarginBottom, int orientedMarginLeft) const;
   void cycleOrientationPreservePosition();
   float getCurrentProgress() const;
   void resolveProgressToSpine(float progress, int& outSpineIndex, float& outSpineFraction) const;
@@ -2,6 +2,8 @@
 
 #include <GfxRenderer.h>
 
+#include <algorithm>
+
 #include "CrossPointSettings.h"
 #include "KOReaderCredentialStore.h"
 #include "KOReaderSyncActivity.h"
@@ -11,6 +13,9 @@
 namespace {
 // Time threshold for treating a long press as a page-up/page-down
 constexpr int SKIP_PAGE_MS = 700;
+// Chapter rows start at this x and are indented further per TOC level
+constexpr int ROW_INDENT = 20;
+constexpr int LEVEL_INDENT = 15;
 }  // namespace
 
 bool EpubReaderChapterSelectionActivity::hasSyncOption() const { return KOREADER_STORE.hasCredentials(); }
@@ -64,6 +69,8 @@ void EpubReaderChapterSelectionActivity::onEnter() {
   }
 
   renderingMutex = xSemaphoreCreateMutex();
+  tocCache.reset(new TocWindowCache(*epub, renderer, UI_10_FONT_ID, renderer.getScreenWidth() - 40 - ROW_INDENT,
+                                    LEVEL_INDENT));
 
   // Account for sync option offset when finding current TOC index
   const int syncOffset = hasSyncOption() ? 1 : 0;
@@ -94,13 +101,14 @@ void EpubReaderChapterSelectionActivity::onExit() {
   }
   vSemaphoreDelete(renderingMutex);
   renderingMutex = nullptr;
+  tocCache.reset();
 }
 
 void EpubReaderChapterSelectionActivity::launchSyncActivity() {
   xSemaphoreTake(renderingMutex, portMAX_DELAY);
   exitActivity();
   enterNewActivity(new KOReaderSyncActivity(
-      renderer, mappedInput, epub, epubPath, currentSpineIndex, currentPage, totalPagesInSpine,
+      renderer, mappedInput, epub, epubPath, currentSpineIndex, currentPage, totalPagesInSpine, currentSourceOffset,
       [this]() {
         // On cancel
         exitActivity();
@@ -142,7 +150,7 @@ void EpubReaderChapterSelectionActivity::loop() {
     if (newSpineIndex == -1) {
       onGoBack();
     } else {
-      onSelectSpineIndex(newSpineIndex);
+      onSelectSpineIndex(newSpineIndex, epub->getTocItem(tocIndex).anchor);
     }
   } else if (mappedInput.wasReleased(MappedInputManager::Button::Back)) {
     onGoBack();
@@ -191,6 +199,10 @@ void EpubReaderChapterSelectionActivity::renderScreen() {
   const auto pageStartIndex = selectorIndex / pageItems * pageItems;
   renderer.fillRect(0, 60 + (selectorIndex % pageItems) * 30 - 2, pageWidth - 1, 30, !darkMode);
 
+  // Pull in the whole page of chapter rows with one read
+  const int pageStartTocIndex = std::max(tocIndexFromItemIndex(pageStartIndex), 0);
+  tocCache->ensure(pageStartTocIndex, tocIndexFromItemIndex(pageStartIndex + pageItems) - pageStartTocIndex);
+
   for (int i = 0; i < pageItems; i++) {
     int itemIndex = pageStartIndex + i;
     if (itemIndex >= totalItems) break;
@@ -205,13 +217,14 @@ void EpubReaderChapterSelectionActivity::renderScreen() {
       renderer.drawText(UI_10_FONT_ID, 20, displayY, ">> Sync Progress", textColor);
     } else {
       const int tocIndex = tocIndexFromItemIndex(itemIndex);
-      auto item = epub->getTocItem(tocIndex);
-
-      const int indentSize = 20 + (item.level - 1) * 15;
-      const std::string chapterName =
-          renderer.truncatedText(UI_10_FONT_ID, item.title.c_str(), pageWidth - 40 - indentSize);
-
-      renderer.drawText(UI_10_FONT_ID, indentSize, displayY, chapterName.c_str(), textColor);
+      TocWindowCache::Item item;
+      if (!tocCache->get(tocIndex, &item)) {
+        continue;
+      }
+
+      // Titles come out of the cache already truncated to fit their indent
+      const int indentSize = ROW_INDENT + (item.level - 1) * LEVEL_INDENT;
+      renderer.drawText(UI_10_FONT_ID, indentSize, displayY, item.title, textColor);
     }
   }
 
@@ -1,5 +1,6 @@
 #pragma once
 #include <Epub.h>
+#include <Epub/TocWindowCache.h>
 #include <freertos/FreeRTOS.h>
 #include <freertos/semphr.h>
 #include <freertos/task.h>
@@ -16,10 +17,15 @@ class EpubReaderChapterSelectionActivity final : public ActivityWithSubactivity
   int currentSpineIndex = 0;
   int currentPage = 0;
   int totalPagesInSpine = 0;
+  // XHTML source offset of the current page, lets sync report the exact paragraph
+  uint32_t currentSourceOffset = 0;
   int selectorIndex = 0;
   bool updateRequired = false;
+  // Rows of the visible page, read in one go when the page changes
+  std::unique_ptr<TocWindowCache> tocCache;
   const std::function<void()> onGoBack;
-  const std::function<void(int newSpineIndex)> onSelectSpineIndex;
+  // anchor is the TOC entry's fragment id within the spine item, empty if it points at its start
+  const std::function<void(int newSpineIndex, const std::string& anchor)> onSelectSpineIndex;
   const std::function<void(int newSpineIndex, int newPage)> onSyncPosition;
 
   // Number of items that fit on a page, derived from logical screen height.
@@ -47,8 +53,10 @@ class EpubReaderChapterSelectionActivity final : public ActivityWithSubactivity
   explicit EpubReaderChapterSelectionActivity(GfxRenderer& renderer, MappedInputManager& mappedInput,
                                               const std::shared_ptr<Epub>& epub, const std::string& epubPath,
                                               const int currentSpineIndex, const int currentPage,
-                                              const int totalPagesInSpine, const std::function<void()>& onGoBack,
-                                              const std::function<void(int newSpineIndex)>& onSelectSpineIndex,
+                                              const int totalPagesInSpine, const uint32_t currentSourceOffset,
+                                              const std::function<void()>& onGoBack,
+                                              const std::function<void(int newSpineIndex, const std::string& anchor)>&
+                                                  onSelectSpineIndex,
                                               const std::function<void(int newSpineIndex, int newPage)>& onSyncPosition)
       : ActivityWithSubactivity("EpubReaderChapterSelection", renderer, mappedInput),
         epub(epub),
@@ -56,6 +64,7 @@ class EpubReaderChapterSelectionActivity final : public ActivityWithSubactivity
         currentSpineIndex(currentSpineIndex),
         currentPage(currentPage),
         totalPagesInSpine(totalPagesInSpine),
+        currentSourceOffset(currentSourceOffset),
         onGoBack(onGoBack),
         onSelectSpineIndex(onSelectSpineIndex),
         onSyncPosition(onSyncPosition) {}
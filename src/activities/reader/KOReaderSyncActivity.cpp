@@ -124,7 +124,7 @@ void KOReaderSyncActivity::performSync() {
   remotePosition = ProgressMapper::toCrossPoint(epub, koPos, totalPagesInSpine);
 
   // Calculate local progress in KOReader format (for display)
-  CrossPointPosition localPos = {currentSpineIndex, currentPage, totalPagesInSpine};
+  CrossPointPosition localPos = {currentSpineIndex, currentPage, totalPagesInSpine, currentSourceOffset};
   localProgress = ProgressMapper::toKOReader(epub, localPos);
 
   xSemaphoreTake(renderingMutex, portMAX_DELAY);
@@ -143,7 +143,7 @@ void KOReaderSyncActivity::performUpload() {
   vTaskDelay(10 / portTICK_PERIOD_MS);
 
   // Convert current position to KOReader format
-  CrossPointPosition localPos = {currentSpineIndex, currentPage, totalPagesInSpine};
+  CrossPointPosition localPos = {currentSpineIndex, currentPage, totalPagesInSpine, currentSourceOffset};
   KOReaderPosition koPos = ProgressMapper::toKOReader(epub, localPos);
 
   KOReaderProgress progress;
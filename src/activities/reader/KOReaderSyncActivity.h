@@ -28,14 +28,15 @@ class KOReaderSyncActivity final : public ActivityWithSubactivity {
 
   explicit KOReaderSyncActivity(GfxRenderer& renderer, MappedInputManager& mappedInput,
                                 const std::shared_ptr<Epub>& epub, const std::string& epubPath, int currentSpineIndex,
-                                int currentPage, int totalPagesInSpine, OnCancelCallback onCancel,
-                                OnSyncCompleteCallback onSyncComplete)
+                                int currentPage, int totalPagesInSpine, uint32_t currentSourceOffset,
+                                OnCancelCallback onCancel, OnSyncCompleteCallback onSyncComplete)
       : ActivityWithSubactivity("KOReaderSync", renderer, mappedInput),
         epub(epub),
         epubPath(epubPath),
         currentSpineIndex(currentSpineIndex),
         currentPage(currentPage),
         totalPagesInSpine(totalPagesInSpine),
+        currentSourceOffset(currentSourceOffset),
         remoteProgress{},
         remotePosition{},
         localProgress{},
@@ -65,6 +66,7 @@ class KOReaderSyncActivity final : public ActivityWithSubactivity {
   int currentSpineIndex;
   int currentPage;
   int totalPagesInSpine;
+  uint32_t currentSourceOffset;
 
   TaskHandle_t displayTaskHandle = nullptr;
   SemaphoreHandle_t renderingMutex = nullptr;
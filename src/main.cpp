@@ -27,6 +27,8 @@
 #include "activities/util/FullScreenMessageActivity.h"
 #include "fontIds.h"
 #include "images/CrossLarge.h"
+#include "util/HeapStats.h"
+#include "util/SdBenchmark.h"
 
 namespace {
 bool ignorePowerHoldUntilRelease = false;
@@ -159,14 +161,20 @@ EpdFontFamily ui12FontFamily(&ui12RegularFont, &ui12BoldFont);
 void exitActivity() {
   if (currentActivity) {
     currentActivity->onExit();
+    // Heap as the activity leaves it and once it is gone, the difference is what it still held
+    const std::string name = currentActivity->getName();
+    const auto& arena = currentActivity->getArena();
+    HeapStats::log("Leaving", name.c_str(), arena.getBytesReserved(), arena.getBlockCount());
     delete currentActivity;
     currentActivity = nullptr;
+    HeapStats::log("Left", name.c_str());
   }
 }
 
 void enterNewActivity(Activity* activity) {
   currentActivity = activity;
   currentActivity->onEnter();
+  HeapStats::log("Entered", currentActivity->getName().c_str());
 }
 
 void waitForPowerRelease() {
@@ -333,6 +341,10 @@ void setup() {
   // First serial output
   Serial.printf("[%lu] [   ] Starting CrossPoint version " CROSSPOINT_VERSION "\n", millis());
 
+#if CROSSPOINT_SD_BENCHMARK
+  runSdBenchmark();
+#endif
+
   // Load remaining fonts
   setupDisplayAndFonts();
 
@@ -379,8 +391,12 @@ void loop() {
   }
 
   if (Serial && millis() - lastMemPrint >= 10000) {
-    Serial.printf("[%lu] [MEM] Free: %d bytes, Total: %d bytes, Min Free: %d bytes\n", millis(), ESP.getFreeHeap(),
-                  ESP.getHeapSize(), ESP.getMinFreeHeap());
+    const auto heap = HeapStats::take();
+    Serial.printf("[%lu] [MEM] Free: %d bytes, Total: %d bytes, Min Free: %d bytes, Largest block: %u bytes (%.1f%% "
+                  "fragmented) in %s\n",
+                  millis(), ESP.getFreeHeap(), ESP.getHeapSize(), ESP.getMinFreeHeap(),
+                  static_cast<unsigned>(heap.largestBlock), heap.fragmentation,
+                  currentActivity ? currentActivity->getName().c_str() : "no activity");
     lastMemPrint = millis();
   }
 
@@ -1,7 +1,8 @@
 #include "CrossPointWebServer.h"
 
 #include <ArduinoJson.h>
-#include <Epub.h>
+#include <Epub/BookFingerprintStore.h>
+#include <FileHandleCache.h>
 #include <FsHelpers.h>
 #include <SDCardManager.h>
 #include <WiFi.h>
@@ -36,12 +37,12 @@ String wsLastCompleteName;
 size_t wsLastCompleteSize = 0;
 unsigned long wsLastCompleteAt = 0;
 
-// Helper function to clear epub cache after upload
-void clearEpubCacheIfNeeded(const String& filePath) {
-  // Only clear cache for .epub files
+// Helper function to drop what is remembered about an epub after it was overwritten or deleted. Its cache is keyed by
+// content, so an overwritten book gets a fresh cache (and a re-uploaded one finds its old cache) without clearing it.
+void forgetEpubIfNeeded(const String& filePath) {
   if (StringUtils::checkFileExtension(filePath, ".epub")) {
-    Epub(filePath.c_str(), "/.crosspoint").clearCache();
-    Serial.printf("[%lu] [WEB] Cleared epub cache for: %s\n", millis(), filePath.c_str());
+    BOOK_FINGERPRINTS.forget(filePath.c_str());
+    Serial.printf("[%lu] [WEB] Forgot epub fingerprint for: %s\n", millis(), filePath.c_str());
   }
 }
 }  // namespace
@@ -556,7 +557,7 @@ void CrossPointWebServer::handleUpload() const {
     if (SdMan.exists(filePath.c_str())) {
       Serial.printf("[%lu] [WEB] [UPLOAD] Overwriting existing file: %s\n", millis(), filePath.c_str());
       esp_task_wdt_reset();
-      SdMan.remove(filePath.c_str());
+      FILE_CACHE.remove(filePath.c_str());
     }
 
     // Open file for writing - this can be slow due to FAT cluster allocation
@@ -624,11 +625,11 @@ void CrossPointWebServer::handleUpload() const {
         Serial.printf("[%lu] [WEB] [UPLOAD] Diagnostics: %d writes, total write time: %lu ms (%.1f%%)\n", millis(),
                       writeCount, totalWriteTime, writePercent);
 
-        // Clear epub cache to prevent stale metadata issues when overwriting files
+        // Forget the fingerprint of any file this upload overwrote
         String filePath = uploadPath;
         if (!filePath.endsWith("/")) filePath += "/";
         filePath += uploadFileName;
-        clearEpubCacheIfNeeded(filePath);
+        forgetEpubIfNeeded(filePath);
       }
     }
   } else if (upload.status == UPLOAD_FILE_ABORTED) {
@@ -639,7 +640,7 @@ void CrossPointWebServer::handleUpload() const {
       String filePath = uploadPath;
       if (!filePath.endsWith("/")) filePath += "/";
       filePath += uploadFileName;
-      SdMan.remove(filePath.c_str());
+      FILE_CACHE.remove(filePath.c_str());
     }
     uploadError = "Upload aborted";
     Serial.printf("[%lu] [WEB] Upload aborted\n", millis());
@@ -775,7 +776,10 @@ void CrossPointWebServer::handleDelete() const {
     success = SdMan.rmdir(itemPath.c_str());
   } else {
     // For files, use remove
-    success = SdMan.remove(itemPath.c_str());
+    success = FILE_CACHE.remove(itemPath.c_str());
+    if (success) {
+      forgetEpubIfNeeded(itemPath);
+    }
   }
 
   if (success) {
@@ -811,7 +815,7 @@ void CrossPointWebServer::onWebSocketEvent(uint8_t num, WStype_t type, uint8_t*
         String filePath = wsUploadPath;
         if (!filePath.endsWith("/")) filePath += "/";
         filePath += wsUploadFileName;
-        SdMan.remove(filePath.c_str());
+        FILE_CACHE.remove(filePath.c_str());
         Serial.printf("[%lu] [WS] Deleted incomplete upload: %s\n", millis(), filePath.c_str());
       }
       wsUploadInProgress = false;
@@ -856,7 +860,7 @@ void CrossPointWebServer::onWebSocketEvent(uint8_t num, WStype_t type, uint8_t*
           // Check if file exists and remove it
           esp_task_wdt_reset();
           if (SdMan.exists(filePath.c_str())) {
-            SdMan.remove(filePath.c_str());
+            FILE_CACHE.remove(filePath.c_str());
           }
 
           // Open file for writing
@@ -920,11 +924,11 @@ void CrossPointWebServer::onWebSocketEvent(uint8_t num, WStype_t type, uint8_t*
         Serial.printf("[%lu] [WS] Upload complete: %s (%d bytes in %lu ms, %.1f KB/s)\n", millis(),
                       wsUploadFileName.c_str(), wsUploadSize, elapsed, kbps);
 
-        // Clear epub cache to prevent stale metadata issues when overwriting files
+        // Forget the fingerprint of any file this upload overwrote
         String filePath = wsUploadPath;
         if (!filePath.endsWith("/")) filePath += "/";
         filePath += wsUploadFileName;
-        clearEpubCacheIfNeeded(filePath);
+        forgetEpubIfNeeded(filePath);
 
         wsServer->sendTXT(num, "DONE");
         lastProgressSent = 0;
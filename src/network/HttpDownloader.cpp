@@ -1,5 +1,6 @@
 #include "HttpDownloader.h"
 
+#include <FileHandleCache.h>
 #include <HTTPClient.h>
 #include <HardwareSerial.h>
 #include <StreamString.h>
@@ -101,12 +102,12 @@ HttpDownloader::DownloadError HttpDownloader::downloadToFile(const std::string&
 
   // Remove existing file if present
   if (SdMan.exists(destPath.c_str())) {
-    SdMan.remove(destPath.c_str());
+    FILE_CACHE.remove(destPath.c_str());
   }
 
   // Open file for writing
   FsFile file;
-  if (!SdMan.openFileForWrite("HTTP", destPath.c_str(), file)) {
+  if (!FILE_CACHE.openFileForWrite("HTTP", destPath, file)) {
     Serial.printf("[%lu] [HTTP] Failed to open file for writing\n", millis());
     http.end();
     return FILE_ERROR;
@@ -117,7 +118,7 @@ HttpDownloader::DownloadError HttpDownloader::downloadToFile(const std::string&
   if (!stream) {
     Serial.printf("[%lu] [HTTP] Failed to get stream\n", millis());
     file.close();
-    SdMan.remove(destPath.c_str());
+    FILE_CACHE.remove(destPath.c_str());
     http.end();
     return HTTP_ERROR;
   }
@@ -145,7 +146,7 @@ HttpDownloader::DownloadError HttpDownloader::downloadToFile(const std::string&
     if (written != bytesRead) {
       Serial.printf("[%lu] [HTTP] Write failed: wrote %zu of %zu bytes\n", millis(), written, bytesRead);
       file.close();
-      SdMan.remove(destPath.c_str());
+      FILE_CACHE.remove(destPath.c_str());
       http.end();
       return FILE_ERROR;
     }
@@ -165,7 +166,7 @@ HttpDownloader::DownloadError HttpDownloader::downloadToFile(const std::string&
   // Verify download size if known
   if (contentLength > 0 && downloaded != contentLength) {
     Serial.printf("[%lu] [HTTP] Size mismatch: got %zu, expected %zu\n", millis(), downloaded, contentLength);
-    SdMan.remove(destPath.c_str());
+    FILE_CACHE.remove(destPath.c_str());
     return HTTP_ERROR;
   }
 
@@ -0,0 +1,24 @@
+#include "HeapStats.h"
+
+#include <Arduino.h>
+
+HeapStats::Snapshot HeapStats::take() {
+  const size_t freeBytes = ESP.getFreeHeap();
+  const size_t largestBlock = ESP.getMaxAllocHeap();
+  const float fragmentation =
+      freeBytes > 0 ? 100.0f * (1.0f - static_cast<float>(largestBlock) / static_cast<float>(freeBytes)) : 0.0f;
+  return {freeBytes, largestBlock, fragmentation};
+}
+
+void HeapStats::log(const char* event, const char* activityName, const size_t arenaReserved, const size_t arenaBlocks) {
+  const Snapshot heap = take();
+  if (arenaBlocks > 0) {
+    Serial.printf("[%lu] [MEM] %s %s: free %u, largest block %u, fragmentation %.1f%%, arena %u bytes in %u blocks\n",
+                  millis(), event, activityName, static_cast<unsigned>(heap.freeBytes),
+                  static_cast<unsigned>(heap.largestBlock), heap.fragmentation, static_cast<unsigned>(arenaReserved),
+                  static_cast<unsigned>(arenaBlocks));
+    return;
+  }
+  Serial.printf("[%lu] [MEM] %s %s: free %u, largest block %u, fragmentation %.1f%%\n", millis(), event, activityName,
+                static_cast<unsigned>(heap.freeBytes), static_cast<unsigned>(heap.largestBlock), heap.fragmentation);
+}
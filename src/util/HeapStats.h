@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstddef>
+
+namespace HeapStats {
+
+/**
+ * Free heap and the largest block a single malloc can still get. Fragmentation is the share of free heap outside that
+ * block: 0% when all of it is one hole, towards 100% when it is scattered in pieces too small for the frame sized
+ * buffers (storeBwBuffer's 8KB chunks, readFileToMemory) that fail first as a session goes on.
+ */
+struct Snapshot {
+  size_t freeBytes;
+  size_t largestBlock;
+  float fragmentation;
+};
+
+Snapshot take();
+// One [MEM] line for an activity transition, with what the activity's arena held if it is given
+void log(const char* event, const char* activityName, size_t arenaReserved = 0, size_t arenaBlocks = 0);
+
+}  // namespace HeapStats
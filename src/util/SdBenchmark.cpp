@@ -0,0 +1,188 @@
+#include "SdBenchmark.h"
+
+#if CROSSPOINT_SD_BENCHMARK
+
+#include <Arduino.h>
+#include <BufferedFsReader.h>
+#include <BufferedFsWriter.h>
+#include <SDCardManager.h>
+
+#include <cstdlib>
+
+namespace {
+constexpr char BENCH_DIR[] = "/.crosspoint/sdbench";
+constexpr char FRAGMENTED_FILE[] = "/.crosspoint/sdbench/fragmented.bin";
+constexpr char INTERLEAVED_FILE[] = "/.crosspoint/sdbench/interleaved.bin";
+constexpr char CONTIGUOUS_FILE[] = "/.crosspoint/sdbench/contiguous.bin";
+constexpr uint32_t FILE_SIZE = 1024 * 1024;
+// Size of the small writes used to grow the fragmented file, similar to serializing words one field at a time
+constexpr size_t SMALL_WRITE_SIZE = 64;
+// Bytes written to the interleaved file between writes to the fragmented one, so their clusters alternate
+constexpr size_t INTERLEAVE_CHUNK = 16 * 1024;
+constexpr size_t BLOCK_SIZE = BufferedFsReader::DEFAULT_BLOCK_SIZE;
+constexpr int RANDOM_READS = 128;
+
+uint8_t pattern(const uint32_t offset) { return static_cast<uint8_t>(offset * 31 + 7); }
+
+void logResult(const char* name, const unsigned long micros, const uint32_t bytes) {
+  const unsigned long ms = micros / 1000;
+  const unsigned long kbPerSec = micros > 0 ? static_cast<unsigned long>(static_cast<uint64_t>(bytes) * 1000000 /
+                                                                         1024 / micros)
+                                            : 0;
+  Serial.printf("[%lu] [SDB] %-28s %6lu ms %6lu KB/s\n", millis(), name, ms, kbPerSec);
+}
+
+// Today's pattern: grow the file with small unbuffered writes while another file grows alongside it
+unsigned long writeFragmented() {
+  FsFile file;
+  FsFile other;
+  if (!SdMan.openFileForWrite("SDB", FRAGMENTED_FILE, file) ||
+      !SdMan.openFileForWrite("SDB", INTERLEAVED_FILE, other)) {
+    return 0;
+  }
+
+  uint8_t chunk[SMALL_WRITE_SIZE];
+  unsigned long elapsed = 0;
+  for (uint32_t offset = 0; offset < FILE_SIZE; offset += SMALL_WRITE_SIZE) {
+    for (size_t i = 0; i < SMALL_WRITE_SIZE; i++) {
+      chunk[i] = pattern(offset + i);
+    }
+    const unsigned long start = micros();
+    file.write(chunk, SMALL_WRITE_SIZE);
+    elapsed += micros() - start;
+
+    if ((offset + SMALL_WRITE_SIZE) % INTERLEAVE_CHUNK == 0) {
+      file.flush();
+      for (size_t i = 0; i < INTERLEAVE_CHUNK; i += SMALL_WRITE_SIZE) {
+        other.write(chunk, SMALL_WRITE_SIZE);
+      }
+      other.flush();
+    }
+  }
+
+  const unsigned long start = micros();
+  file.close();
+  elapsed += micros() - start;
+  other.close();
+  return elapsed;
+}
+
+unsigned long writeContiguous() {
+  FsFile file;
+  if (!SdMan.openFileForWrite("SDB", CONTIGUOUS_FILE, file)) {
+    return 0;
+  }
+
+  uint8_t chunk[SMALL_WRITE_SIZE];
+  const unsigned long start = micros();
+  {
+    BufferedFsWriter writer(file);
+    if (!writer.preAllocate(FILE_SIZE)) {
+      Serial.printf("[%lu] [SDB] Pre-allocation failed, contiguous results are not meaningful\n", millis());
+    }
+    for (uint32_t offset = 0; offset < FILE_SIZE; offset += SMALL_WRITE_SIZE) {
+      for (size_t i = 0; i < SMALL_WRITE_SIZE; i++) {
+        chunk[i] = pattern(offset + i);
+      }
+      writer.write(chunk, SMALL_WRITE_SIZE);
+    }
+    writer.finish();
+  }
+  file.close();
+  return micros() - start;
+}
+
+// Sequential read of the whole file in blocks, verifying the contents
+unsigned long readSequential(const char* path, bool& valid) {
+  FsFile file;
+  valid = false;
+  if (!SdMan.openFileForRead("SDB", path, file)) {
+    return 0;
+  }
+
+  auto* block = static_cast<uint8_t*>(malloc(BLOCK_SIZE));
+  if (!block) {
+    file.close();
+    return 0;
+  }
+
+  valid = true;
+  unsigned long elapsed = 0;
+  for (uint32_t offset = 0; offset < FILE_SIZE; offset += BLOCK_SIZE) {
+    const unsigned long start = micros();
+    const int dataRead = file.read(block, BLOCK_SIZE);
+    elapsed += micros() - start;
+    if (dataRead != static_cast<int>(BLOCK_SIZE)) {
+      valid = false;
+      break;
+    }
+    for (size_t i = 0; i < BLOCK_SIZE; i += 509) {
+      valid = valid && block[i] == pattern(offset + i);
+    }
+  }
+
+  free(block);
+  file.close();
+  return elapsed;
+}
+
+// Page load pattern: seek somewhere and pull a few hundred small fields through the block reader
+unsigned long readRandomPages(const char* path) {
+  FsFile file;
+  if (!SdMan.openFileForRead("SDB", path, file)) {
+    return 0;
+  }
+
+  srand(1234);
+  uint32_t sink = 0;
+  const unsigned long start = micros();
+  {
+    BufferedFsReader reader(file);
+    for (int i = 0; i < RANDOM_READS; i++) {
+      reader.seek(static_cast<uint32_t>(rand()) % (FILE_SIZE - 2 * BLOCK_SIZE));
+      for (int field = 0; field < 400; field++) {
+        uint16_t value;
+        reader.read(&value, sizeof(value));
+        sink += value;
+      }
+    }
+  }
+  const unsigned long elapsed = micros() - start;
+  file.close();
+  Serial.printf("[%lu] [SDB] (checksum %lu)\n", millis(), static_cast<unsigned long>(sink));
+  return elapsed;
+}
+}  // namespace
+
+void runSdBenchmark() {
+  Serial.printf("[%lu] [SDB] Starting SD benchmark, %lu KB files\n", millis(),
+                static_cast<unsigned long>(FILE_SIZE / 1024));
+  SdMan.removeDir(BENCH_DIR);
+  SdMan.mkdir(BENCH_DIR);
+
+  logResult("write fragmented (64B)", writeFragmented(), FILE_SIZE);
+  logResult("write contiguous (4KB)", writeContiguous(), FILE_SIZE);
+
+  bool fragmentedValid = false;
+  bool contiguousValid = false;
+  logResult("read fragmented seq", readSequential(FRAGMENTED_FILE, fragmentedValid), FILE_SIZE);
+  logResult("read contiguous seq", readSequential(CONTIGUOUS_FILE, contiguousValid), FILE_SIZE);
+  logResult("read fragmented pages", readRandomPages(FRAGMENTED_FILE), RANDOM_READS * 800);
+  logResult("read contiguous pages", readRandomPages(CONTIGUOUS_FILE), RANDOM_READS * 800);
+
+  FsFile file;
+  if (SdMan.openFileForRead("SDB", CONTIGUOUS_FILE, file)) {
+    Serial.printf("[%lu] [SDB] Contiguous file is contiguous: %s, size %lu\n", millis(),
+                  file.isContiguous() ? "yes" : "no", static_cast<unsigned long>(file.size()));
+    file.close();
+  }
+  if (!fragmentedValid || !contiguousValid) {
+    Serial.printf("[%lu] [SDB] Verification failed (fragmented %d, contiguous %d)\n", millis(), fragmentedValid,
+                  contiguousValid);
+  }
+
+  SdMan.removeDir(BENCH_DIR);
+  Serial.printf("[%lu] [SDB] SD benchmark done\n", millis());
+}
+
+#endif
@@ -0,0 +1,6 @@
+#pragma once
+
+// On-device comparison of fragmented, incrementally grown cache files against contiguous pre-allocated ones written
+// and read in sector aligned blocks. Results go to the serial log. Only built with -DCROSSPOINT_SD_BENCHMARK=1
+// (pio run -e sd_benchmark).
+void runSdBenchmark();
@@ -0,0 +1,235 @@
+// Compares miniz tinfl against FastInflate on the chapters of real EPUB files, decoding the same way
+// ZipFile::EntryReader does on device: 1KB input chunks into a circular 32KB window.
+#include <miniz.h>
+
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "lib/ZipFile/FastInflate.h"
+
+namespace {
+constexpr size_t INPUT_CHUNK_SIZE = 1024;
+constexpr size_t WINDOW_SIZE = 32768;
+
+struct Chapter {
+  std::string name;
+  std::vector<uint8_t> deflated;
+  uint32_t inflatedSize;
+};
+
+uint16_t readU16(const uint8_t* p) { return p[0] | (p[1] << 8); }
+uint32_t readU32(const uint8_t* p) { return p[0] | (p[1] << 8) | (p[2] << 16) | (static_cast<uint32_t>(p[3]) << 24); }
+
+bool endsWith(const std::string& value, const std::string& suffix) {
+  return value.size() >= suffix.size() && value.compare(value.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+// Collects the deflated XHTML entries of an EPUB
+bool loadChapters(const std::string& path, std::vector<Chapter>& chapters) {
+  std::ifstream file(path, std::ios::binary);
+  if (!file) {
+    std::cerr << "Cannot open " << path << "\n";
+    return false;
+  }
+  const std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+  // End of central directory record, searching backwards past any comment
+  size_t eocd = data.size() >= 22 ? data.size() - 22 : 0;
+  while (eocd > 0 && readU32(&data[eocd]) != 0x06054b50) {
+    eocd--;
+  }
+  if (data.size() < 22 || readU32(&data[eocd]) != 0x06054b50) {
+    std::cerr << path << " is not a zip file\n";
+    return false;
+  }
+
+  const uint16_t totalEntries = readU16(&data[eocd + 10]);
+  size_t pos = readU32(&data[eocd + 16]);
+  for (uint16_t i = 0; i < totalEntries && pos + 46 <= data.size(); i++) {
+    const uint8_t* header = &data[pos];
+    if (readU32(header) != 0x02014b50) {
+      break;
+    }
+    const uint16_t method = readU16(header + 10);
+    const uint32_t compressedSize = readU32(header + 20);
+    const uint32_t uncompressedSize = readU32(header + 24);
+    const uint16_t nameLen = readU16(header + 28);
+    const uint16_t extraLen = readU16(header + 30);
+    const uint16_t commentLen = readU16(header + 32);
+    const uint32_t localHeaderOffset = readU32(header + 42);
+    const std::string name(reinterpret_cast<const char*>(header + 46), nameLen);
+    pos += 46 + nameLen + extraLen + commentLen;
+
+    if (method != MZ_DEFLATED || !(endsWith(name, ".xhtml") || endsWith(name, ".html") || endsWith(name, ".htm"))) {
+      continue;
+    }
+    const uint8_t* local = &data[localHeaderOffset];
+    const size_t dataOffset = localHeaderOffset + 30 + readU16(local + 26) + readU16(local + 28);
+    if (dataOffset + compressedSize > data.size()) {
+      continue;
+    }
+    chapters.push_back({name,
+                        std::vector<uint8_t>(data.begin() + dataOffset, data.begin() + dataOffset + compressedSize),
+                        uncompressedSize});
+  }
+  return true;
+}
+
+// Both decoders hand their output to a sink; the verification pass keeps it so the engines can be compared, timed
+// passes only count it
+struct Sink {
+  std::vector<uint8_t>* keep = nullptr;
+  size_t bytes = 0;
+
+  void consume(const uint8_t* data, const size_t len) {
+    if (keep) {
+      keep->insert(keep->end(), data, data + len);
+    }
+    bytes += len;
+  }
+};
+
+bool inflateTinfl(const Chapter& chapter, Sink& sink, std::vector<uint8_t>& window) {
+  auto inflator = std::make_unique<tinfl_decompressor>();
+  tinfl_init(inflator.get());
+  size_t inputPos = 0;
+  size_t cursor = 0;
+  for (;;) {
+    const size_t chunk = std::min(INPUT_CHUNK_SIZE, chapter.deflated.size() - inputPos);
+    size_t inBytes = chunk;
+    size_t outBytes = WINDOW_SIZE - cursor;
+    const bool hasMoreInput = inputPos + chunk < chapter.deflated.size();
+    const tinfl_status status =
+        tinfl_decompress(inflator.get(), chapter.deflated.data() + inputPos, &inBytes, window.data(),
+                         window.data() + cursor, &outBytes, hasMoreInput ? TINFL_FLAG_HAS_MORE_INPUT : 0);
+    inputPos += inBytes;
+    sink.consume(window.data() + cursor, outBytes);
+    cursor = (cursor + outBytes) & (WINDOW_SIZE - 1);
+    if (status == TINFL_STATUS_DONE) {
+      return true;
+    }
+    if (status < 0 || (inBytes == 0 && outBytes == 0)) {
+      return false;
+    }
+  }
+}
+
+bool inflateFast(const Chapter& chapter, Sink& sink, std::vector<uint8_t>& window) {
+  auto inflator = std::make_unique<FastInflate>();
+  inflator->init();
+  size_t inputPos = 0;
+  size_t cursor = 0;
+  for (;;) {
+    const size_t chunk = std::min(INPUT_CHUNK_SIZE, chapter.deflated.size() - inputPos);
+    size_t inBytes = chunk;
+    size_t outBytes = WINDOW_SIZE - cursor;
+    const bool hasMoreInput = inputPos + chunk < chapter.deflated.size();
+    const FastInflate::Status status =
+        inflator->inflate(chapter.deflated.data() + inputPos, &inBytes, window.data(), cursor, &outBytes,
+                          FastInflate::CIRCULAR_WINDOW, hasMoreInput);
+    inputPos += inBytes;
+    sink.consume(window.data() + cursor, outBytes);
+    cursor = (cursor + outBytes) & (WINDOW_SIZE - 1);
+    if (status == FastInflate::DONE) {
+      return true;
+    }
+    if (status == FastInflate::FAILED || (inBytes == 0 && outBytes == 0)) {
+      return false;
+    }
+  }
+}
+
+template <typename InflateFn>
+bool verify(const std::vector<Chapter>& chapters, InflateFn inflateFn, std::vector<std::vector<uint8_t>>& outputs) {
+  std::vector<uint8_t> window(WINDOW_SIZE);
+  outputs.assign(chapters.size(), {});
+  for (size_t i = 0; i < chapters.size(); i++) {
+    Sink sink;
+    sink.keep = &outputs[i];
+    if (!inflateFn(chapters[i], sink, window) || sink.bytes != chapters[i].inflatedSize) {
+      std::cerr << "Failed to inflate " << chapters[i].name << "\n";
+      return false;
+    }
+  }
+  return true;
+}
+
+template <typename InflateFn>
+double benchmark(const std::vector<Chapter>& chapters, const int iterations, InflateFn inflateFn) {
+  std::vector<uint8_t> window(WINDOW_SIZE);
+  const auto start = std::chrono::steady_clock::now();
+  for (int iteration = 0; iteration < iterations; iteration++) {
+    for (const auto& chapter : chapters) {
+      Sink sink;
+      inflateFn(chapter, sink, window);
+    }
+  }
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+}  // namespace
+
+int main(int argc, char** argv) {
+  int iterations = 10;
+  std::vector<std::string> paths;
+  for (int i = 1; i < argc; i++) {
+    const std::string arg = argv[i];
+    if (arg == "--iterations" && i + 1 < argc) {
+      iterations = std::max(1, std::stoi(argv[++i]));
+    } else {
+      paths.push_back(arg);
+    }
+  }
+  if (paths.empty()) {
+    std::cerr << "Usage: " << argv[0] << " [--iterations N] book.epub [book.epub ...]\n";
+    return 1;
+  }
+
+  std::vector<Chapter> chapters;
+  for (const auto& path : paths) {
+    if (!loadChapters(path, chapters)) {
+      return 1;
+    }
+  }
+  size_t inflatedTotal = 0;
+  size_t deflatedTotal = 0;
+  for (const auto& chapter : chapters) {
+    inflatedTotal += chapter.inflatedSize;
+    deflatedTotal += chapter.deflated.size();
+  }
+  std::cout << chapters.size() << " chapters, " << deflatedTotal << " bytes deflated, " << inflatedTotal
+            << " bytes inflated, " << iterations << " iterations\n";
+
+  std::vector<std::vector<uint8_t>> tinflOutputs;
+  std::vector<std::vector<uint8_t>> fastOutputs;
+  if (!verify(chapters, inflateTinfl, tinflOutputs) || !verify(chapters, inflateFast, fastOutputs)) {
+    return 1;
+  }
+  for (size_t i = 0; i < chapters.size(); i++) {
+    if (tinflOutputs[i] != fastOutputs[i]) {
+      std::cerr << "Output mismatch for " << chapters[i].name << "\n";
+      return 1;
+    }
+  }
+
+  const double tinflSeconds = benchmark(chapters, iterations, inflateTinfl);
+  const double fastSeconds = benchmark(chapters, iterations, inflateFast);
+
+  // Peak RAM is what a reader holds while an entry is open: decoder state, window and input chunk
+  const double megabytes = static_cast<double>(inflatedTotal) * iterations / (1024.0 * 1024.0);
+  const auto report = [&](const char* engine, const double seconds, const size_t stateSize) {
+    std::cout << std::left << std::setw(12) << engine << std::right << std::fixed << std::setprecision(1)
+              << std::setw(8) << megabytes / seconds << " MB/s  peak RAM " << stateSize + WINDOW_SIZE + INPUT_CHUNK_SIZE
+              << " bytes (state " << stateSize << ")\n";
+  };
+  report("tinfl", tinflSeconds, sizeof(tinfl_decompressor));
+  report("FastInflate", fastSeconds, sizeof(FastInflate));
+  std::cout << "Speedup: " << std::setprecision(2) << tinflSeconds / fastSeconds << "x\n";
+  return 0;
+}
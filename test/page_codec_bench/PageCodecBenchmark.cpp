@@ -0,0 +1,414 @@
+// Lays out the chapters of real EPUB files into pages and compares the field by field page format (section version 13)
+// with the PageCodec records of version 14: bytes on the SD card, reads per page and time to load every page.
+//
+// Layout is an approximation of the device (fixed advance per byte, greedy line breaking, <b>/<i> styles), which is
+// enough to get realistic words per line, lines per page and style changes.
+#include <miniz.h>
+
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <list>
+#include <string>
+#include <vector>
+
+#include "lib/Epub/Epub/PageCodec.h"
+
+namespace {
+constexpr int VIEWPORT_WIDTH = 464;
+constexpr int LINES_PER_PAGE = 28;
+constexpr int LINE_HEIGHT = 26;
+constexpr int CHAR_ADVANCE = 9;
+constexpr int SPACE_ADVANCE = 6;
+
+struct Word {
+  std::string text;
+  uint16_t x;
+  uint8_t style;
+};
+
+struct Line {
+  int16_t y;
+  uint8_t blockStyle;
+  std::vector<Word> words;
+};
+
+using Page = std::vector<Line>;
+
+uint16_t readU16(const uint8_t* p) { return p[0] | (p[1] << 8); }
+uint32_t readU32(const uint8_t* p) { return p[0] | (p[1] << 8) | (p[2] << 16) | (static_cast<uint32_t>(p[3]) << 24); }
+
+bool endsWith(const std::string& value, const std::string& suffix) {
+  return value.size() >= suffix.size() && value.compare(value.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+// Inflates the XHTML entries of an EPUB
+bool loadChapters(const std::string& path, std::vector<std::string>& chapters) {
+  std::ifstream file(path, std::ios::binary);
+  if (!file) {
+    std::cerr << "Cannot open " << path << "\n";
+    return false;
+  }
+  const std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+  size_t eocd = data.size() >= 22 ? data.size() - 22 : 0;
+  while (eocd > 0 && readU32(&data[eocd]) != 0x06054b50) {
+    eocd--;
+  }
+  if (data.size() < 22 || readU32(&data[eocd]) != 0x06054b50) {
+    std::cerr << path << " is not a zip file\n";
+    return false;
+  }
+
+  const uint16_t totalEntries = readU16(&data[eocd + 10]);
+  size_t pos = readU32(&data[eocd + 16]);
+  for (uint16_t i = 0; i < totalEntries && pos + 46 <= data.size(); i++) {
+    const uint8_t* header = &data[pos];
+    if (readU32(header) != 0x02014b50) {
+      break;
+    }
+    const uint16_t method = readU16(header + 10);
+    const uint32_t compressedSize = readU32(header + 20);
+    const uint16_t nameLen = readU16(header + 28);
+    const uint16_t extraLen = readU16(header + 30);
+    const uint16_t commentLen = readU16(header + 32);
+    const uint32_t localHeaderOffset = readU32(header + 42);
+    const std::string name(reinterpret_cast<const char*>(header + 46), nameLen);
+    pos += 46 + nameLen + extraLen + commentLen;
+
+    if (!(endsWith(name, ".xhtml") || endsWith(name, ".html") || endsWith(name, ".htm"))) {
+      continue;
+    }
+    const uint8_t* local = &data[localHeaderOffset];
+    const size_t dataOffset = localHeaderOffset + 30 + readU16(local + 26) + readU16(local + 28);
+    if (dataOffset + compressedSize > data.size()) {
+      continue;
+    }
+    if (method == 0) {
+      chapters.emplace_back(reinterpret_cast<const char*>(&data[dataOffset]), compressedSize);
+    } else if (method == MZ_DEFLATED) {
+      size_t inflatedSize = 0;
+      void* inflated = tinfl_decompress_mem_to_heap(&data[dataOffset], compressedSize, &inflatedSize, 0);
+      if (inflated) {
+        chapters.emplace_back(static_cast<const char*>(inflated), inflatedSize);
+        mz_free(inflated);
+      }
+    }
+  }
+  return true;
+}
+
+// Splits a chapter into paragraphs of styled words, ignoring everything but <p>/<h*>/<div>/<li> breaks and <b>/<i>
+void layoutChapter(const std::string& html, std::vector<Page>& pages) {
+  Page page;
+  Line line{0, 0, {}};
+  int lineWidth = 0;
+  int bold = 0;
+  int italic = 0;
+  bool inBody = false;
+  std::string word;
+
+  const auto flushLine = [&] {
+    if (line.words.empty()) {
+      return;
+    }
+    line.y = static_cast<int16_t>(page.size() * LINE_HEIGHT);
+    page.push_back(std::move(line));
+    line = Line{0, 0, {}};
+    lineWidth = 0;
+    if (page.size() == LINES_PER_PAGE) {
+      pages.push_back(std::move(page));
+      page.clear();
+    }
+  };
+  const auto flushWord = [&] {
+    if (word.empty()) {
+      return;
+    }
+    const int width = static_cast<int>(word.size()) * CHAR_ADVANCE;
+    if (lineWidth > 0 && lineWidth + SPACE_ADVANCE + width > VIEWPORT_WIDTH) {
+      flushLine();
+    }
+    if (lineWidth > 0) {
+      lineWidth += SPACE_ADVANCE;
+    }
+    const uint8_t style = (bold > 0 ? 1 : 0) | (italic > 0 ? 2 : 0);
+    line.words.push_back({word, static_cast<uint16_t>(lineWidth), style});
+    lineWidth += width;
+    word.clear();
+  };
+
+  for (size_t i = 0; i < html.size(); i++) {
+    const char c = html[i];
+    if (c == '<') {
+      const size_t close = html.find('>', i);
+      if (close == std::string::npos) {
+        break;
+      }
+      std::string tag = html.substr(i + 1, close - i - 1);
+      i = close;
+      const bool closing = !tag.empty() && tag[0] == '/';
+      const size_t nameStart = closing ? 1 : 0;
+      const std::string name = tag.substr(nameStart, tag.find_first_of(" />", nameStart) - nameStart);
+      if (name == "body") {
+        inBody = !closing;
+      } else if (name == "b" || name == "strong") {
+        bold += closing ? -1 : 1;
+      } else if (name == "i" || name == "em") {
+        italic += closing ? -1 : 1;
+      } else if (name == "p" || name == "div" || name == "li" || name == "br" || (name.size() == 2 && name[0] == 'h')) {
+        flushWord();
+        flushLine();
+      }
+      continue;
+    }
+    if (!inBody) {
+      continue;
+    }
+    if (c == ' ' || c == '\n' || c == '\r' || c == '\t') {
+      flushWord();
+    } else {
+      word.push_back(c);
+    }
+  }
+  flushWord();
+  flushLine();
+  if (!page.empty()) {
+    pages.push_back(std::move(page));
+  }
+}
+
+// Section version 13: per element a tag and position, per line a word count, a u32 length + bytes per word, then a
+// u16 x and a u8 style per word and the block style
+template <typename T>
+void put(std::vector<uint8_t>& out, const T& value) {
+  const auto* bytes = reinterpret_cast<const uint8_t*>(&value);
+  out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+
+void encodeLegacy(const Page& page, std::vector<uint8_t>& out) {
+  put(out, static_cast<uint16_t>(page.size()));
+  for (const auto& line : page) {
+    put(out, static_cast<uint8_t>(PageCodec::LINE));
+    put(out, static_cast<int16_t>(0));
+    put(out, line.y);
+    put(out, static_cast<uint16_t>(line.words.size()));
+    for (const auto& word : line.words) {
+      put(out, static_cast<uint32_t>(word.text.size()));
+      out.insert(out.end(), word.text.begin(), word.text.end());
+    }
+    for (const auto& word : line.words) put(out, word.x);
+    for (const auto& word : line.words) put(out, word.style);
+    put(out, line.blockStyle);
+  }
+}
+
+void encodeCompact(const Page& page, PageCodec::Encoder& encoder, std::vector<uint8_t>& out) {
+  for (const auto& line : page) {
+    encoder.beginLine(0, line.y, line.blockStyle);
+    for (const auto& word : line.words) {
+      encoder.addWord(word.text.data(), word.text.size(), word.x, word.style);
+    }
+    encoder.endLine();
+  }
+  const auto& record = encoder.finish();
+  put(out, static_cast<uint32_t>(record.size()));
+  out.insert(out.end(), record.begin(), record.end());
+  encoder.reset();
+}
+
+// Stands in for BufferedFsReader, counting the read calls a page load makes
+struct Reader {
+  const uint8_t* pos;
+  size_t reads = 0;
+
+  void read(void* out, const size_t len) {
+    memcpy(out, pos, len);
+    pos += len;
+    reads++;
+  }
+  template <typename T>
+  T pod() {
+    T value;
+    read(&value, sizeof(T));
+    return value;
+  }
+};
+
+// Both loaders build the std::list based TextBlock contents the reader renders from
+struct LoadedLine {
+  std::list<std::string> words;
+  std::list<uint16_t> wordXpos;
+  std::list<uint8_t> wordStyles;
+};
+
+size_t loadLegacy(Reader& reader, std::vector<LoadedLine>& lines) {
+  lines.clear();
+  const auto count = reader.pod<uint16_t>();
+  size_t words = 0;
+  for (uint16_t i = 0; i < count; i++) {
+    reader.pod<uint8_t>();
+    reader.pod<int16_t>();
+    reader.pod<int16_t>();
+    const auto wordCount = reader.pod<uint16_t>();
+    LoadedLine line;
+    line.words.resize(wordCount);
+    line.wordXpos.resize(wordCount);
+    line.wordStyles.resize(wordCount);
+    for (auto& w : line.words) {
+      const auto len = reader.pod<uint32_t>();
+      w.resize(len);
+      reader.read(&w[0], len);
+    }
+    for (auto& x : line.wordXpos) x = reader.pod<uint16_t>();
+    for (auto& s : line.wordStyles) s = reader.pod<uint8_t>();
+    reader.pod<uint8_t>();
+    words += wordCount;
+    lines.push_back(std::move(line));
+  }
+  return words;
+}
+
+size_t loadCompact(Reader& reader, std::vector<LoadedLine>& lines, std::vector<uint8_t>& record) {
+  lines.clear();
+  record.resize(reader.pod<uint32_t>());
+  reader.read(record.data(), record.size());
+  PageCodec::Decoder decoder(record.data(), record.size());
+  PageCodec::Element element;
+  PageCodec::Word word;
+  size_t words = 0;
+  while (decoder.nextElement(element)) {
+    LoadedLine line;
+    for (uint16_t i = 0; i < element.wordCount && decoder.nextWord(word); i++) {
+      line.words.emplace_back(word.text, word.length);
+      line.wordXpos.push_back(word.x);
+      line.wordStyles.push_back(word.style);
+    }
+    words += element.wordCount;
+    lines.push_back(std::move(line));
+  }
+  return decoder.ok() ? words : 0;
+}
+
+bool sameLines(const std::vector<LoadedLine>& a, const std::vector<LoadedLine>& b) {
+  if (a.size() != b.size()) {
+    return false;
+  }
+  for (size_t i = 0; i < a.size(); i++) {
+    if (a[i].words != b[i].words || a[i].wordXpos != b[i].wordXpos || a[i].wordStyles != b[i].wordStyles) {
+      return false;
+    }
+  }
+  return true;
+}
+}  // namespace
+
+int main(int argc, char** argv) {
+  int iterations = 10;
+  std::vector<std::string> paths;
+  for (int i = 1; i < argc; i++) {
+    const std::string arg = argv[i];
+    if (arg == "--iterations" && i + 1 < argc) {
+      iterations = std::max(1, std::stoi(argv[++i]));
+    } else {
+      paths.push_back(arg);
+    }
+  }
+  if (paths.empty()) {
+    std::cerr << "Usage: " << argv[0] << " [--iterations N] book.epub [book.epub ...]\n";
+    return 1;
+  }
+
+  std::vector<Page> pages;
+  size_t textBytes = 0;
+  size_t wordCount = 0;
+  for (const auto& path : paths) {
+    std::vector<std::string> chapters;
+    if (!loadChapters(path, chapters)) {
+      return 1;
+    }
+    for (const auto& chapter : chapters) {
+      layoutChapter(chapter, pages);
+    }
+  }
+  for (const auto& page : pages) {
+    for (const auto& line : page) {
+      for (const auto& word : line.words) {
+        textBytes += word.text.size();
+        wordCount++;
+      }
+    }
+  }
+  if (pages.empty()) {
+    std::cerr << "No pages laid out\n";
+    return 1;
+  }
+
+  std::vector<uint8_t> legacy;
+  std::vector<uint8_t> compact;
+  std::vector<size_t> legacyOffsets;
+  std::vector<size_t> compactOffsets;
+  PageCodec::Encoder encoder;
+  for (const auto& page : pages) {
+    legacyOffsets.push_back(legacy.size());
+    compactOffsets.push_back(compact.size());
+    encodeLegacy(page, legacy);
+    encodeCompact(page, encoder, compact);
+  }
+
+  // Both formats must load the same words before their timings mean anything
+  size_t legacyReads = 0;
+  size_t compactReads = 0;
+  std::vector<LoadedLine> legacyLines;
+  std::vector<LoadedLine> compactLines;
+  std::vector<uint8_t> record;
+  for (size_t i = 0; i < pages.size(); i++) {
+    Reader legacyReader{legacy.data() + legacyOffsets[i]};
+    Reader compactReader{compact.data() + compactOffsets[i]};
+    loadLegacy(legacyReader, legacyLines);
+    loadCompact(compactReader, compactLines, record);
+    if (!sameLines(legacyLines, compactLines)) {
+      std::cerr << "Page " << i << " decodes differently\n";
+      return 1;
+    }
+    legacyReads += legacyReader.reads;
+    compactReads += compactReader.reads;
+  }
+
+  const auto time = [&](const auto& load) {
+    const auto start = std::chrono::steady_clock::now();
+    for (int iteration = 0; iteration < iterations; iteration++) {
+      for (size_t i = 0; i < pages.size(); i++) {
+        load(i);
+      }
+    }
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  };
+  const double legacySeconds = time([&](const size_t i) {
+    Reader reader{legacy.data() + legacyOffsets[i]};
+    loadLegacy(reader, legacyLines);
+  });
+  const double compactSeconds = time([&](const size_t i) {
+    Reader reader{compact.data() + compactOffsets[i]};
+    loadCompact(reader, compactLines, record);
+  });
+
+  std::cout << pages.size() << " pages, " << wordCount << " words, " << textBytes << " bytes of text, " << iterations
+            << " iterations\n";
+  const auto report = [&](const char* format, const size_t bytes, const size_t reads, const double seconds) {
+    std::cout << std::left << std::setw(14) << format << std::right << std::setw(10) << bytes << " bytes ("
+              << std::fixed << std::setprecision(2) << static_cast<double>(bytes) / textBytes << "x text)  "
+              << std::setw(7) << std::setprecision(1) << static_cast<double>(reads) / pages.size()
+              << " reads/page  " << std::setw(7) << std::setprecision(2)
+              << seconds * 1e6 / (static_cast<double>(pages.size()) * iterations) << " us/page\n";
+  };
+  report("v13 fields", legacy.size(), legacyReads, legacySeconds);
+  report("v14 PageCodec", compact.size(), compactReads, compactSeconds);
+  std::cout << "Size reduction: " << std::setprecision(1)
+            << 100.0 * (1.0 - static_cast<double>(compact.size()) / legacy.size()) << "%, load speedup "
+            << std::setprecision(2) << legacySeconds / compactSeconds << "x\n";
+  return 0;
+}
@@ -0,0 +1,25 @@
+#pragma once
+// Host stand-in for the renderer ParsedText measures words with: a fixed advance per code point that varies with the
+// character and style, enough to give realistic line breaks without font data.
+#include <EpdFontFamily.h>
+
+#include <cstdint>
+
+class GfxRenderer {
+ public:
+  int getTextWidth(int fontId, const char* text, EpdFontFamily::Style style = EpdFontFamily::REGULAR) const {
+    (void)fontId;
+    int width = 0;
+    for (const auto* p = reinterpret_cast<const uint8_t*>(text); *p; p++) {
+      // Continuation bytes of a UTF-8 sequence don't advance
+      if ((*p & 0xC0) != 0x80) {
+        width += 7 + (*p % 5) + ((style & EpdFontFamily::BOLD) ? 1 : 0);
+      }
+    }
+    return width;
+  }
+  int getSpaceWidth(int fontId) const {
+    (void)fontId;
+    return 6;
+  }
+};
@@ -0,0 +1,18 @@
+#pragma once
+// Host stand-in for the Arduino serial logger
+#include <chrono>
+#include <cstdio>
+
+inline unsigned long millis() {
+  static const auto start = std::chrono::steady_clock::now();
+  return static_cast<unsigned long>(
+      std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count());
+}
+
+struct HostSerial {
+  template <typename... Args>
+  void printf(const char* format, Args... args) {
+    std::fprintf(stderr, format, args...);
+  }
+};
+inline HostSerial Serial;
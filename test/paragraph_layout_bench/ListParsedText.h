@@ -0,0 +1,63 @@
+// ParsedText as it was before moving to contiguous arrays (std::list per word), kept as the benchmark baseline.
+#pragma once
+
+#include <EpdFontFamily.h>
+
+#include <functional>
+#include <list>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "lib/Epub/Epub/blocks/TextBlock.h"
+
+class GfxRenderer;
+
+// A laid out line as the list based ParsedText produced it (formerly a list based TextBlock)
+struct ListLine {
+  std::list<std::string> words;
+  std::list<uint16_t> wordXpos;
+  std::list<EpdFontFamily::Style> wordStyles;
+};
+
+class ListParsedText {
+  std::list<std::string> words;
+  std::list<EpdFontFamily::Style> wordStyles;
+  // Set for the remainder of a word split by hyphenation, so word indices keep counting source words
+  std::list<bool> wordContinuations;
+  // Source words handed out in lines so far, and the index of the source word the last extracted line starts in
+  uint16_t extractedSourceWords = 0;
+  uint16_t lineStartWordIndex = 0;
+  TextBlock::Style style;
+  bool extraParagraphSpacing;
+  bool hyphenationEnabled;
+
+  void applyParagraphIndent();
+  std::vector<size_t> computeLineBreaks(const GfxRenderer& renderer, int fontId, int pageWidth, int spaceWidth,
+                                        std::vector<uint16_t>& wordWidths);
+  std::vector<size_t> computeHyphenatedLineBreaks(const GfxRenderer& renderer, int fontId, int pageWidth,
+                                                  int spaceWidth, std::vector<uint16_t>& wordWidths);
+  bool hyphenateWordAtIndex(size_t wordIndex, int availableWidth, const GfxRenderer& renderer, int fontId,
+                            std::vector<uint16_t>& wordWidths, bool allowFallbackBreaks);
+  void extractLine(size_t breakIndex, int pageWidth, int spaceWidth, const std::vector<uint16_t>& wordWidths,
+                   const std::vector<size_t>& lineBreakIndices,
+                   const std::function<void(std::shared_ptr<ListLine>)>& processLine);
+  std::vector<uint16_t> calculateWordWidths(const GfxRenderer& renderer, int fontId);
+
+ public:
+  explicit ListParsedText(const TextBlock::Style style, const bool extraParagraphSpacing,
+                      const bool hyphenationEnabled = false)
+      : style(style), extraParagraphSpacing(extraParagraphSpacing), hyphenationEnabled(hyphenationEnabled) {}
+  ~ListParsedText() = default;
+
+  void addWord(std::string word, EpdFontFamily::Style fontStyle);
+  void setStyle(const TextBlock::Style style) { this->style = style; }
+  TextBlock::Style getStyle() const { return style; }
+  size_t size() const { return words.size(); }
+  bool isEmpty() const { return words.empty(); }
+  // Index (within this block, counting words as added) of the word the line last passed to processLine starts in
+  uint16_t getLineStartWordIndex() const { return lineStartWordIndex; }
+  void layoutAndExtractLines(const GfxRenderer& renderer, int fontId, uint16_t viewportWidth,
+                             const std::function<void(std::shared_ptr<ListLine>)>& processLine,
+                             bool includeLastLine = true);
+};
\ No newline at end of file
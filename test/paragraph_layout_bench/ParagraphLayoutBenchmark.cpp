@@ -0,0 +1,339 @@
+// Lays out the paragraphs of real EPUB files with ParsedText and with the std::list based version it replaced
+// (ListParsedText), feeding words the way ChapterHtmlSlimParser does, and reports words per second and the peak heap
+// each needs while a paragraph is laid out. Both must produce the same lines.
+#include <miniz.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "GfxRenderer.h"
+#include "ListParsedText.h"
+#include "lib/Epub/Epub/ParsedText.h"
+#include "lib/Epub/Epub/hyphenation/Hyphenator.h"
+
+namespace {
+constexpr uint16_t VIEWPORT_WIDTH = 464;
+// ChapterHtmlSlimParser lays out everything but the last line once a block holds this many words
+constexpr size_t SPLIT_WORD_COUNT = 750;
+
+// Heap accounting through the global allocator, each block carries its size in front of it
+size_t liveBytes = 0;
+size_t peakBytes = 0;
+constexpr size_t HEADER_SIZE = alignof(std::max_align_t);
+
+struct Word {
+  std::string text;
+  EpdFontFamily::Style style;
+};
+using Paragraph = std::vector<Word>;
+
+uint16_t readU16(const uint8_t* p) { return p[0] | (p[1] << 8); }
+uint32_t readU32(const uint8_t* p) { return p[0] | (p[1] << 8) | (p[2] << 16) | (static_cast<uint32_t>(p[3]) << 24); }
+
+bool endsWith(const std::string& value, const std::string& suffix) {
+  return value.size() >= suffix.size() && value.compare(value.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+// Inflates the XHTML entries of an EPUB
+bool loadChapters(const std::string& path, std::vector<std::string>& chapters) {
+  std::ifstream file(path, std::ios::binary);
+  if (!file) {
+    std::cerr << "Cannot open " << path << "\n";
+    return false;
+  }
+  const std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+  size_t eocd = data.size() >= 22 ? data.size() - 22 : 0;
+  while (eocd > 0 && readU32(&data[eocd]) != 0x06054b50) {
+    eocd--;
+  }
+  if (data.size() < 22 || readU32(&data[eocd]) != 0x06054b50) {
+    std::cerr << path << " is not a zip file\n";
+    return false;
+  }
+
+  const uint16_t totalEntries = readU16(&data[eocd + 10]);
+  size_t pos = readU32(&data[eocd + 16]);
+  for (uint16_t i = 0; i < totalEntries && pos + 46 <= data.size(); i++) {
+    const uint8_t* header = &data[pos];
+    if (readU32(header) != 0x02014b50) {
+      break;
+    }
+    const uint16_t method = readU16(header + 10);
+    const uint32_t compressedSize = readU32(header + 20);
+    const uint16_t nameLen = readU16(header + 28);
+    const uint16_t extraLen = readU16(header + 30);
+    const uint16_t commentLen = readU16(header + 32);
+    const uint32_t localHeaderOffset = readU32(header + 42);
+    const std::string name(reinterpret_cast<const char*>(header + 46), nameLen);
+    pos += 46 + nameLen + extraLen + commentLen;
+
+    if (!(endsWith(name, ".xhtml") || endsWith(name, ".html") || endsWith(name, ".htm"))) {
+      continue;
+    }
+    const uint8_t* local = &data[localHeaderOffset];
+    const size_t dataOffset = localHeaderOffset + 30 + readU16(local + 26) + readU16(local + 28);
+    if (dataOffset + compressedSize > data.size()) {
+      continue;
+    }
+    if (method == 0) {
+      chapters.emplace_back(reinterpret_cast<const char*>(&data[dataOffset]), compressedSize);
+    } else if (method == MZ_DEFLATED) {
+      size_t inflatedSize = 0;
+      void* inflated = tinfl_decompress_mem_to_heap(&data[dataOffset], compressedSize, &inflatedSize, 0);
+      if (inflated) {
+        chapters.emplace_back(static_cast<const char*>(inflated), inflatedSize);
+        mz_free(inflated);
+      }
+    }
+  }
+  return true;
+}
+
+// Splits a chapter into paragraphs of styled words at <p>/<h*>/<div>/<li> boundaries, following <b>/<i> nesting
+void splitParagraphs(const std::string& html, std::vector<Paragraph>& paragraphs) {
+  Paragraph paragraph;
+  std::string word;
+  int bold = 0;
+  int italic = 0;
+  bool inBody = false;
+
+  const auto flushWord = [&] {
+    if (!word.empty()) {
+      const int style = (bold > 0 ? EpdFontFamily::BOLD : 0) | (italic > 0 ? EpdFontFamily::ITALIC : 0);
+      paragraph.push_back({word, static_cast<EpdFontFamily::Style>(style)});
+      word.clear();
+    }
+  };
+  const auto flushParagraph = [&] {
+    flushWord();
+    if (!paragraph.empty()) {
+      paragraphs.push_back(std::move(paragraph));
+      paragraph.clear();
+    }
+  };
+
+  for (size_t i = 0; i < html.size(); i++) {
+    const char c = html[i];
+    if (c == '<') {
+      const size_t close = html.find('>', i);
+      if (close == std::string::npos) {
+        break;
+      }
+      const std::string tag = html.substr(i + 1, close - i - 1);
+      i = close;
+      const bool closing = !tag.empty() && tag[0] == '/';
+      const size_t nameStart = closing ? 1 : 0;
+      const std::string name = tag.substr(nameStart, tag.find_first_of(" />", nameStart) - nameStart);
+      if (name == "body") {
+        inBody = !closing;
+      } else if (name == "b" || name == "strong") {
+        flushWord();
+        bold += closing ? -1 : 1;
+      } else if (name == "i" || name == "em") {
+        flushWord();
+        italic += closing ? -1 : 1;
+      } else if (name == "p" || name == "div" || name == "li" || name == "br" || (name.size() == 2 && name[0] == 'h')) {
+        flushParagraph();
+      }
+      continue;
+    }
+    if (!inBody) {
+      continue;
+    }
+    if (c == ' ' || c == '\n' || c == '\r' || c == '\t') {
+      flushWord();
+    } else {
+      word.push_back(c);
+    }
+  }
+  flushParagraph();
+}
+
+// What both implementations are reduced to for comparison: the words of each line with their x and style
+struct Line {
+  std::vector<std::string> words;
+  std::vector<uint16_t> xpos;
+  std::vector<uint8_t> styles;
+  bool operator==(const Line& other) const {
+    return words == other.words && xpos == other.xpos && styles == other.styles;
+  }
+};
+
+// Runs one paragraph through a ParsedText-like type the way the parser does
+template <typename Text, typename LineFn>
+void layoutParagraph(const Paragraph& paragraph, const bool hyphenation, const LineFn& onLine) {
+  GfxRenderer renderer;
+  Text text(TextBlock::JUSTIFIED, false, hyphenation);
+  for (const auto& word : paragraph) {
+    text.addWord(word.text, word.style);
+    if (text.size() > SPLIT_WORD_COUNT) {
+      text.layoutAndExtractLines(renderer, 0, VIEWPORT_WIDTH, onLine, false);
+    }
+  }
+  text.layoutAndExtractLines(renderer, 0, VIEWPORT_WIDTH, onLine);
+}
+
+void collectListLine(const std::shared_ptr<ListLine>& line, std::vector<Line>& out) {
+  Line collected;
+  collected.words.assign(line->words.begin(), line->words.end());
+  collected.xpos.assign(line->wordXpos.begin(), line->wordXpos.end());
+  collected.styles.assign(line->wordStyles.begin(), line->wordStyles.end());
+  out.push_back(std::move(collected));
+}
+
+// TextBlock only hands its words to a page encoder, so read them back from the record it produces
+void collectTextBlock(const std::shared_ptr<TextBlock>& line, std::vector<Line>& out) {
+  PageCodec::Encoder encoder;
+  line->encode(encoder, 0, 0);
+  const auto& record = encoder.finish();
+  PageCodec::Decoder decoder(record.data(), record.size());
+  PageCodec::Element element;
+  PageCodec::Word word;
+  Line collected;
+  while (decoder.nextElement(element)) {
+    for (uint16_t i = 0; i < element.wordCount && decoder.nextWord(word); i++) {
+      collected.words.emplace_back(word.text, word.length);
+      collected.xpos.push_back(word.x);
+      collected.styles.push_back(word.style);
+    }
+  }
+  out.push_back(std::move(collected));
+}
+
+struct Result {
+  double seconds = 0;
+  size_t peakHeap = 0;
+};
+
+template <typename Text, typename LineFn>
+Result run(const std::vector<Paragraph>& paragraphs, const bool hyphenation, const int iterations,
+           const LineFn& onLine) {
+  Result result;
+  const auto start = std::chrono::steady_clock::now();
+  for (int iteration = 0; iteration < iterations; iteration++) {
+    for (const auto& paragraph : paragraphs) {
+      const size_t baseline = liveBytes;
+      peakBytes = liveBytes;
+      layoutParagraph<Text>(paragraph, hyphenation, onLine);
+      result.peakHeap = std::max(result.peakHeap, peakBytes - baseline);
+    }
+  }
+  result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  return result;
+}
+}  // namespace
+
+void* operator new(const size_t size) {
+  auto* block = static_cast<uint8_t*>(std::malloc(size + HEADER_SIZE));
+  if (!block) {
+    throw std::bad_alloc();
+  }
+  memcpy(block, &size, sizeof(size));
+  liveBytes += size;
+  peakBytes = std::max(peakBytes, liveBytes);
+  return block + HEADER_SIZE;
+}
+
+void operator delete(void* ptr) noexcept {
+  if (!ptr) {
+    return;
+  }
+  auto* block = static_cast<uint8_t*>(ptr) - HEADER_SIZE;
+  size_t size;
+  memcpy(&size, block, sizeof(size));
+  liveBytes -= size;
+  std::free(block);
+}
+
+void operator delete(void* ptr, size_t) noexcept { operator delete(ptr); }
+
+int main(int argc, char** argv) {
+  int iterations = 5;
+  std::vector<std::string> paths;
+  for (int i = 1; i < argc; i++) {
+    const std::string arg = argv[i];
+    if (arg == "--iterations" && i + 1 < argc) {
+      iterations = std::max(1, std::stoi(argv[++i]));
+    } else {
+      paths.push_back(arg);
+    }
+  }
+  if (paths.empty()) {
+    std::cerr << "Usage: " << argv[0] << " [--iterations N] book.epub [book.epub ...]\n";
+    return 1;
+  }
+
+  std::vector<Paragraph> paragraphs;
+  for (const auto& path : paths) {
+    std::vector<std::string> chapters;
+    if (!loadChapters(path, chapters)) {
+      return 1;
+    }
+    for (const auto& chapter : chapters) {
+      splitParagraphs(chapter, paragraphs);
+    }
+  }
+  size_t wordCount = 0;
+  size_t longestParagraph = 0;
+  for (const auto& paragraph : paragraphs) {
+    wordCount += paragraph.size();
+    longestParagraph = std::max(longestParagraph, paragraph.size());
+  }
+  if (paragraphs.empty()) {
+    std::cerr << "No paragraphs found\n";
+    return 1;
+  }
+  Hyphenator::setPreferredLanguage("en");
+  std::cout << paragraphs.size() << " paragraphs, " << wordCount << " words (longest paragraph " << longestParagraph
+            << "), " << iterations << " iterations\n";
+
+  // Real paragraphs never reach the parser's split point, so the comparison also runs the whole book as one block
+  Paragraph wholeBook;
+  for (const auto& paragraph : paragraphs) {
+    wholeBook.insert(wholeBook.end(), paragraph.begin(), paragraph.end());
+  }
+  std::vector<Paragraph> checked = paragraphs;
+  checked.push_back(std::move(wholeBook));
+
+  for (const bool hyphenation : {false, true}) {
+    // Same lines from both before anything is timed
+    std::vector<Line> listLines;
+    std::vector<Line> arrayLines;
+    for (const auto& paragraph : checked) {
+      layoutParagraph<ListParsedText>(paragraph, hyphenation,
+                                      [&](std::shared_ptr<ListLine> line) { collectListLine(line, listLines); });
+      layoutParagraph<ParsedText>(paragraph, hyphenation,
+                                  [&](std::shared_ptr<TextBlock> line) { collectTextBlock(line, arrayLines); });
+    }
+    if (listLines.size() != arrayLines.size() || !std::equal(listLines.begin(), listLines.end(), arrayLines.begin())) {
+      std::cerr << "Layouts differ" << (hyphenation ? " with hyphenation" : "") << "\n";
+      return 1;
+    }
+
+    // Lines are dropped straight away, like the parser does once it has encoded them into the page
+    const auto listResult = run<ListParsedText>(paragraphs, hyphenation, iterations, [](std::shared_ptr<ListLine>) {});
+    const auto arrayResult = run<ParsedText>(paragraphs, hyphenation, iterations, [](std::shared_ptr<TextBlock>) {});
+
+    std::cout << "\nHyphenation " << (hyphenation ? "on" : "off") << ", " << listLines.size() << " lines\n";
+    const auto report = [&](const char* layout, const Result& result) {
+      std::cout << std::left << std::setw(18) << layout << std::right << std::fixed << std::setprecision(0)
+                << std::setw(12) << static_cast<double>(wordCount) * iterations / result.seconds
+                << " words/s  peak heap " << std::setw(7) << result.peakHeap << " bytes\n";
+    };
+    report("std::list", listResult);
+    report("flat arrays", arrayResult);
+    std::cout << "Speedup: " << std::setprecision(2) << listResult.seconds / arrayResult.seconds << "x, peak heap "
+              << std::setprecision(1) << 100.0 * arrayResult.peakHeap / listResult.peakHeap << "% of std::list\n";
+  }
+  return 0;
+}
@@ -0,0 +1,34 @@
+#pragma once
+// Host stand-in for the display driver: a plain frame buffer in RAM, refreshes do nothing. Includes what Arduino.h
+// would for the renderer sources
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#include "HardwareSerial.h"
+
+class HalDisplay {
+ public:
+  enum RefreshMode { FULL_REFRESH, HALF_REFRESH, FAST_REFRESH };
+
+  static constexpr uint16_t DISPLAY_WIDTH = 800;
+  static constexpr uint16_t DISPLAY_HEIGHT = 480;
+  static constexpr uint16_t DISPLAY_WIDTH_BYTES = DISPLAY_WIDTH / 8;
+  static constexpr uint32_t BUFFER_SIZE = DISPLAY_WIDTH_BYTES * DISPLAY_HEIGHT;
+
+  void clearScreen(const uint8_t color = 0xFF) const { std::memset(frameBuffer, color, BUFFER_SIZE); }
+  void drawImage(const uint8_t* imageData, uint16_t x, uint16_t y, uint16_t w, uint16_t h,
+                 bool fromProgmem = false) const {
+    (void)imageData, (void)x, (void)y, (void)w, (void)h, (void)fromProgmem;
+  }
+  void displayBuffer(RefreshMode mode = FAST_REFRESH) { (void)mode; }
+  void displayWindow(uint16_t x, uint16_t y, uint16_t w, uint16_t h) { (void)x, (void)y, (void)w, (void)h; }
+  uint8_t* getFrameBuffer() const { return frameBuffer; }
+  void copyGrayscaleLsbBuffers(const uint8_t* lsbBuffer) { (void)lsbBuffer; }
+  void copyGrayscaleMsbBuffers(const uint8_t* msbBuffer) { (void)msbBuffer; }
+  void cleanupGrayscaleBuffers(const uint8_t* bwBuffer) { (void)bwBuffer; }
+  void displayGrayBuffer() {}
+
+ private:
+  static inline uint8_t frameBuffer[BUFFER_SIZE];
+};
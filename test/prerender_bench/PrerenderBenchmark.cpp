@@ -0,0 +1,374 @@
+// Draws the pages of real EPUB files with the device renderer and fonts into a host frame buffer and compares the two
+// ways the reader gets a page on screen: rendering it on the page turn, and unpacking the PackBits frame pre-rendered
+// while the reader was idle. Also reports what pre-rendering costs in the idle time and how well the frames pack.
+//
+// Only the CPU part of a page turn is measured, the display refresh that follows is the same for both. Layout is greedy
+// line breaking with the real glyph advances, left aligned, portrait with the default margins and status bar. Words
+// wider than a line are left out.
+#include <GfxRenderer.h>
+#include <PackBits.h>
+#include <builtinFonts/all.h>
+#include <miniz.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace {
+constexpr int READER_FONT_ID = 1;
+constexpr int SMALL_FONT_ID = 2;
+// Viewable area plus the default 5px screen margin, the bottom also holds the status bar
+constexpr int MARGIN_TOP = GfxRenderer::VIEWABLE_MARGIN_TOP + 5;
+constexpr int MARGIN_RIGHT = GfxRenderer::VIEWABLE_MARGIN_RIGHT + 5;
+constexpr int MARGIN_LEFT = GfxRenderer::VIEWABLE_MARGIN_LEFT + 5;
+constexpr int MARGIN_BOTTOM = GfxRenderer::VIEWABLE_MARGIN_BOTTOM + 19;
+// Frames that pack above this are not kept by the reader
+constexpr size_t MAX_PRERENDERED_FRAME_SIZE = 40 * 1024;
+
+EpdFont bookerly14RegularFont(&bookerly_14_regular);
+EpdFont bookerly14BoldFont(&bookerly_14_bold);
+EpdFont bookerly14ItalicFont(&bookerly_14_italic);
+EpdFont bookerly14BoldItalicFont(&bookerly_14_bolditalic);
+EpdFontFamily bookerly14FontFamily(&bookerly14RegularFont, &bookerly14BoldFont, &bookerly14ItalicFont,
+                                   &bookerly14BoldItalicFont);
+EpdFont smallFont(&notosans_8_regular);
+EpdFontFamily smallFontFamily(&smallFont);
+
+struct Word {
+  std::string text;
+  EpdFontFamily::Style style;
+};
+using Paragraph = std::vector<Word>;
+
+struct PlacedWord {
+  std::string text;
+  int16_t x;
+  int16_t y;
+  EpdFontFamily::Style style;
+};
+using Page = std::vector<PlacedWord>;
+
+uint16_t readU16(const uint8_t* p) { return p[0] | (p[1] << 8); }
+uint32_t readU32(const uint8_t* p) { return p[0] | (p[1] << 8) | (p[2] << 16) | (static_cast<uint32_t>(p[3]) << 24); }
+
+bool endsWith(const std::string& value, const std::string& suffix) {
+  return value.size() >= suffix.size() && value.compare(value.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+// Inflates the XHTML entries of an EPUB
+bool loadChapters(const std::string& path, std::vector<std::string>& chapters) {
+  std::ifstream file(path, std::ios::binary);
+  if (!file) {
+    std::cerr << "Cannot open " << path << "\n";
+    return false;
+  }
+  const std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+  size_t eocd = data.size() >= 22 ? data.size() - 22 : 0;
+  while (eocd > 0 && readU32(&data[eocd]) != 0x06054b50) {
+    eocd--;
+  }
+  if (data.size() < 22 || readU32(&data[eocd]) != 0x06054b50) {
+    std::cerr << path << " is not a zip file\n";
+    return false;
+  }
+
+  const uint16_t totalEntries = readU16(&data[eocd + 10]);
+  size_t pos = readU32(&data[eocd + 16]);
+  for (uint16_t i = 0; i < totalEntries && pos + 46 <= data.size(); i++) {
+    const uint8_t* header = &data[pos];
+    if (readU32(header) != 0x02014b50) {
+      break;
+    }
+    const uint16_t method = readU16(header + 10);
+    const uint32_t compressedSize = readU32(header + 20);
+    const uint16_t nameLen = readU16(header + 28);
+    const uint16_t extraLen = readU16(header + 30);
+    const uint16_t commentLen = readU16(header + 32);
+    const uint32_t localHeaderOffset = readU32(header + 42);
+    const std::string name(reinterpret_cast<const char*>(header + 46), nameLen);
+    pos += 46 + nameLen + extraLen + commentLen;
+
+    if (!(endsWith(name, ".xhtml") || endsWith(name, ".html") || endsWith(name, ".htm"))) {
+      continue;
+    }
+    const uint8_t* local = &data[localHeaderOffset];
+    const size_t dataOffset = localHeaderOffset + 30 + readU16(local + 26) + readU16(local + 28);
+    if (dataOffset + compressedSize > data.size()) {
+      continue;
+    }
+    if (method == 0) {
+      chapters.emplace_back(reinterpret_cast<const char*>(&data[dataOffset]), compressedSize);
+    } else if (method == MZ_DEFLATED) {
+      size_t inflatedSize = 0;
+      void* inflated = tinfl_decompress_mem_to_heap(&data[dataOffset], compressedSize, &inflatedSize, 0);
+      if (inflated) {
+        chapters.emplace_back(static_cast<const char*>(inflated), inflatedSize);
+        mz_free(inflated);
+      }
+    }
+  }
+  return true;
+}
+
+// Splits a chapter into paragraphs of styled words at <p>/<h*>/<div>/<li> boundaries, following <b>/<i> nesting
+void splitParagraphs(const std::string& html, std::vector<Paragraph>& paragraphs) {
+  Paragraph paragraph;
+  std::string word;
+  int bold = 0;
+  int italic = 0;
+  bool inBody = false;
+
+  const auto flushWord = [&] {
+    if (!word.empty()) {
+      const int style = (bold > 0 ? EpdFontFamily::BOLD : 0) | (italic > 0 ? EpdFontFamily::ITALIC : 0);
+      paragraph.push_back({word, static_cast<EpdFontFamily::Style>(style)});
+      word.clear();
+    }
+  };
+  const auto flushParagraph = [&] {
+    flushWord();
+    if (!paragraph.empty()) {
+      paragraphs.push_back(std::move(paragraph));
+      paragraph.clear();
+    }
+  };
+
+  for (size_t i = 0; i < html.size(); i++) {
+    const char c = html[i];
+    if (c == '<') {
+      const size_t close = html.find('>', i);
+      if (close == std::string::npos) {
+        break;
+      }
+      const std::string tag = html.substr(i + 1, close - i - 1);
+      i = close;
+      const bool closing = !tag.empty() && tag[0] == '/';
+      const size_t nameStart = closing ? 1 : 0;
+      const std::string name = tag.substr(nameStart, tag.find_first_of(" />", nameStart) - nameStart);
+      if (name == "body") {
+        inBody = !closing;
+      } else if (name == "b" || name == "strong") {
+        flushWord();
+        bold += closing ? -1 : 1;
+      } else if (name == "i" || name == "em") {
+        flushWord();
+        italic += closing ? -1 : 1;
+      } else if (name == "p" || name == "div" || name == "li" || name == "br" || (name.size() == 2 && name[0] == 'h')) {
+        flushParagraph();
+      }
+      continue;
+    }
+    if (!inBody) {
+      continue;
+    }
+    if (c == ' ' || c == '\n' || c == '\r' || c == '\t') {
+      flushWord();
+    } else {
+      word.push_back(c);
+    }
+  }
+  flushParagraph();
+}
+
+// Breaks the paragraphs into lines and the lines into pages, each page ends where the next line would not fit
+std::vector<Page> paginate(const GfxRenderer& renderer, const std::vector<Paragraph>& paragraphs) {
+  const int viewportWidth = renderer.getScreenWidth() - MARGIN_LEFT - MARGIN_RIGHT;
+  const int viewportBottom = renderer.getScreenHeight() - MARGIN_BOTTOM;
+  const int lineHeight = renderer.getLineHeight(READER_FONT_ID);
+  const int spaceWidth = renderer.getSpaceWidth(READER_FONT_ID);
+
+  std::vector<Page> pages(1);
+  int y = MARGIN_TOP;
+  const auto newLine = [&] {
+    y += lineHeight;
+    if (y + lineHeight > viewportBottom) {
+      pages.emplace_back();
+      y = MARGIN_TOP;
+    }
+  };
+  for (const auto& paragraph : paragraphs) {
+    int x = 0;
+    for (const auto& word : paragraph) {
+      const int width = renderer.getTextWidth(READER_FONT_ID, word.text.c_str(), word.style);
+      // Long URLs and the like get split by the reader, they would only draw past the edge here
+      if (width > viewportWidth) {
+        continue;
+      }
+      if (x > 0 && x + width > viewportWidth) {
+        newLine();
+        x = 0;
+      }
+      pages.back().push_back({word.text, static_cast<int16_t>(MARGIN_LEFT + x), static_cast<int16_t>(y), word.style});
+      x += width + spaceWidth;
+    }
+    newLine();
+  }
+  if (pages.back().empty()) {
+    pages.pop_back();
+  }
+  return pages;
+}
+
+// What the reader draws for a page: the words, then page numbers, chapter title and battery in the status bar
+void renderPage(const GfxRenderer& renderer, const Page& page, const int pageIndex, const int pageCount) {
+  renderer.clearScreen(0xFF);
+  for (const auto& word : page) {
+    renderer.drawText(READER_FONT_ID, word.x, word.y, word.text.c_str(), true, word.style);
+  }
+
+  const int textY = renderer.getScreenHeight() - MARGIN_BOTTOM - 4;
+  char progress[32];
+  snprintf(progress, sizeof(progress), "%d/%d  %.0f%%", pageIndex + 1, pageCount, 100.0f * pageIndex / pageCount);
+  const int progressWidth = renderer.getTextWidth(SMALL_FONT_ID, progress);
+  renderer.drawText(SMALL_FONT_ID, renderer.getScreenWidth() - MARGIN_RIGHT - progressWidth, textY, progress);
+  const char* title = "Chapter Seven: The Long Way Home";
+  renderer.drawText(SMALL_FONT_ID, (renderer.getScreenWidth() - renderer.getTextWidth(SMALL_FONT_ID, title)) / 2,
+                    textY, title);
+  renderer.drawText(SMALL_FONT_ID, MARGIN_LEFT + 21, textY, "87%");
+  renderer.drawRect(MARGIN_LEFT + 1, textY + 6, 15, 12);
+  renderer.fillRect(MARGIN_LEFT + 3, textY + 8, 10, 8);
+}
+
+double microsSince(const std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+}
+
+struct Stats {
+  std::vector<double> samples;
+  double mean() const {
+    double sum = 0;
+    for (const double sample : samples) {
+      sum += sample;
+    }
+    return samples.empty() ? 0 : sum / samples.size();
+  }
+  double percentile(const double p) {
+    if (samples.empty()) {
+      return 0;
+    }
+    std::sort(samples.begin(), samples.end());
+    return samples[std::min(samples.size() - 1, static_cast<size_t>(p * samples.size()))];
+  }
+};
+}  // namespace
+
+int main(int argc, char** argv) {
+  int iterations = 3;
+  std::vector<std::string> paths;
+  for (int i = 1; i < argc; i++) {
+    const std::string arg = argv[i];
+    if (arg == "--iterations" && i + 1 < argc) {
+      iterations = std::max(1, std::stoi(argv[++i]));
+    } else {
+      paths.push_back(arg);
+    }
+  }
+  if (paths.empty()) {
+    std::cerr << "Usage: " << argv[0] << " [--iterations N] book.epub [book.epub ...]\n";
+    return 1;
+  }
+
+  std::vector<Paragraph> paragraphs;
+  for (const auto& path : paths) {
+    std::vector<std::string> chapters;
+    if (!loadChapters(path, chapters)) {
+      return 1;
+    }
+    for (const auto& chapter : chapters) {
+      splitParagraphs(chapter, paragraphs);
+    }
+  }
+
+  HalDisplay display;
+  GfxRenderer renderer(display);
+  renderer.insertFont(READER_FONT_ID, bookerly14FontFamily);
+  renderer.insertFont(SMALL_FONT_ID, smallFontFamily);
+  renderer.setOrientation(GfxRenderer::Portrait);
+
+  const auto pages = paginate(renderer, paragraphs);
+  if (pages.size() < 2) {
+    std::cerr << "Not enough text for a page turn\n";
+    return 1;
+  }
+  const int pageCount = static_cast<int>(pages.size());
+  std::cout << pageCount << " pages, " << iterations << " iterations\n";
+
+  uint8_t* frameBuffer = renderer.getFrameBuffer();
+  const size_t bufferSize = GfxRenderer::getBufferSize();
+  Stats rendered;
+  Stats unpacked;
+  Stats prerendered;
+  size_t packedTotal = 0;
+  size_t packedMax = 0;
+  int kept = 0;
+  std::vector<uint8_t> shownFrame;
+  std::vector<uint8_t> nextFrame;
+  std::vector<uint8_t> check(bufferSize);
+
+  for (int iteration = 0; iteration < iterations; iteration++) {
+    renderPage(renderer, pages[0], 0, pageCount);
+    for (int next = 1; next < pageCount; next++) {
+      // Idle time after the previous turn, as prerenderNextPage does it: pack the frame on screen, draw the next page,
+      // pack it and put the shown frame back
+      auto start = std::chrono::steady_clock::now();
+      shownFrame.resize(PackBits::encode(frameBuffer, bufferSize, nullptr));
+      PackBits::encode(frameBuffer, bufferSize, shownFrame.data());
+      renderPage(renderer, pages[next], next, pageCount);
+      nextFrame.resize(PackBits::encode(frameBuffer, bufferSize, nullptr));
+      PackBits::encode(frameBuffer, bufferSize, nextFrame.data());
+      PackBits::decode(shownFrame.data(), shownFrame.size(), frameBuffer, bufferSize);
+      prerendered.samples.push_back(microsSince(start));
+
+      // Page turn with the frame pre-rendered
+      start = std::chrono::steady_clock::now();
+      if (!PackBits::decode(nextFrame.data(), nextFrame.size(), frameBuffer, bufferSize)) {
+        std::cerr << "Page " << next << " did not unpack\n";
+        return 1;
+      }
+      unpacked.samples.push_back(microsSince(start));
+      memcpy(check.data(), frameBuffer, bufferSize);
+
+      // Page turn that renders, it has to come out the same
+      start = std::chrono::steady_clock::now();
+      renderPage(renderer, pages[next], next, pageCount);
+      rendered.samples.push_back(microsSince(start));
+      if (memcmp(check.data(), frameBuffer, bufferSize) != 0) {
+        std::cerr << "Page " << next << " differs between the two paths\n";
+        return 1;
+      }
+
+      if (iteration == 0) {
+        packedTotal += nextFrame.size();
+        packedMax = std::max(packedMax, nextFrame.size());
+        kept += nextFrame.size() <= MAX_PRERENDERED_FRAME_SIZE ? 1 : 0;
+      }
+    }
+  }
+
+  const int turns = pageCount - 1;
+  std::cout << std::fixed << std::setprecision(0);
+  std::cout << "Packed frame: " << packedTotal / turns << " bytes average, " << packedMax << " max of " << bufferSize
+            << ", " << kept << "/" << turns << " kept (<= " << MAX_PRERENDERED_FRAME_SIZE << ")\n";
+  const auto report = [](const char* path, Stats& stats) {
+    const double mean = stats.mean();
+    std::cout << std::left << std::setw(26) << path << std::right << std::setw(8) << mean << " us mean "
+              << std::setw(8) << stats.percentile(0.95) << " us p95\n";
+  };
+  const double renderedMean = rendered.mean();
+  const double unpackedMean = unpacked.mean();
+  report("Turn, rendered", rendered);
+  report("Turn, pre-rendered", unpacked);
+  report("Pre-render while idle", prerendered);
+  std::cout << "Pre-rendered turns spend " << std::setprecision(1) << 100.0 * unpackedMean / renderedMean
+            << "% of the CPU time of rendered turns (" << std::setprecision(1) << renderedMean / unpackedMean
+            << "x less)\n";
+  return 0;
+}
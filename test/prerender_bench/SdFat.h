@@ -0,0 +1,17 @@
+#pragma once
+// Host stand-in for the SD card file the bitmap reader is declared against, the benchmark draws no bitmaps
+#include <cstddef>
+#include <cstdint>
+
+class FsFile {
+ public:
+  explicit operator bool() const { return false; }
+  uint32_t position() const { return 0; }
+  uint32_t size() const { return 0; }
+  bool seek(uint32_t position) { return position == 0; }
+  int read(void* buf, size_t len) {
+    (void)buf, (void)len;
+    return -1;
+  }
+  void close() {}
+};
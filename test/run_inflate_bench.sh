@@ -0,0 +1,36 @@
+#!/usr/bin/env bash
+set -euo pipefail
+
+ROOT_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")/.." && pwd)"
+BUILD_DIR="$ROOT_DIR/build/inflate_bench"
+BINARY="$BUILD_DIR/InflateBenchmark"
+
+mkdir -p "$BUILD_DIR"
+
+CFLAGS=(
+  -O2
+  -DMINIZ_NO_ZLIB_COMPATIBLE_NAMES=1
+  -I"$ROOT_DIR/lib/miniz"
+)
+
+CXXFLAGS=(
+  -std=c++20
+  -O2
+  -Wall
+  -Wextra
+  -pedantic
+  -DMINIZ_NO_ZLIB_COMPATIBLE_NAMES=1
+  -I"$ROOT_DIR"
+  -I"$ROOT_DIR/lib"
+  -I"$ROOT_DIR/lib/miniz"
+)
+
+cc "${CFLAGS[@]}" -c "$ROOT_DIR/lib/miniz/miniz.c" -o "$BUILD_DIR/miniz.o"
+
+c++ "${CXXFLAGS[@]}" \
+  "$ROOT_DIR/test/inflate_bench/InflateBenchmark.cpp" \
+  "$ROOT_DIR/lib/ZipFile/FastInflate.cpp" \
+  "$BUILD_DIR/miniz.o" \
+  -o "$BINARY"
+
+"$BINARY" "$@"
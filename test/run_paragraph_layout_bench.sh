@@ -0,0 +1,48 @@
+#!/usr/bin/env bash
+set -euo pipefail
+
+ROOT_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")/.." && pwd)"
+BUILD_DIR="$ROOT_DIR/build/paragraph_layout_bench"
+BINARY="$BUILD_DIR/ParagraphLayoutBenchmark"
+
+mkdir -p "$BUILD_DIR"
+
+CFLAGS=(
+  -O2
+  -DMINIZ_NO_ZLIB_COMPATIBLE_NAMES=1
+  -I"$ROOT_DIR/lib/miniz"
+)
+
+# The bench directory comes first so its GfxRenderer and HardwareSerial stand-ins replace the device ones
+CXXFLAGS=(
+  -std=c++20
+  -O2
+  -Wall
+  -Wextra
+  -pedantic
+  -DMINIZ_NO_ZLIB_COMPATIBLE_NAMES=1
+  -I"$ROOT_DIR/test/paragraph_layout_bench"
+  -I"$ROOT_DIR"
+  -I"$ROOT_DIR/lib"
+  -I"$ROOT_DIR/lib/EpdFont"
+  -I"$ROOT_DIR/lib/Utf8"
+  -I"$ROOT_DIR/lib/miniz"
+)
+
+cc "${CFLAGS[@]}" -c "$ROOT_DIR/lib/miniz/miniz.c" -o "$BUILD_DIR/miniz.o"
+
+c++ "${CXXFLAGS[@]}" \
+  "$ROOT_DIR/test/paragraph_layout_bench/ParagraphLayoutBenchmark.cpp" \
+  "$ROOT_DIR/test/paragraph_layout_bench/ListParsedText.cpp" \
+  "$ROOT_DIR/lib/Epub/Epub/ParsedText.cpp" \
+  "$ROOT_DIR/lib/Epub/Epub/PageCodec.cpp" \
+  "$ROOT_DIR/lib/Epub/Epub/blocks/TextBlock.cpp" \
+  "$ROOT_DIR/lib/Epub/Epub/hyphenation/Hyphenator.cpp" \
+  "$ROOT_DIR/lib/Epub/Epub/hyphenation/LanguageRegistry.cpp" \
+  "$ROOT_DIR/lib/Epub/Epub/hyphenation/LiangHyphenation.cpp" \
+  "$ROOT_DIR/lib/Epub/Epub/hyphenation/HyphenationCommon.cpp" \
+  "$ROOT_DIR/lib/Utf8/Utf8.cpp" \
+  "$BUILD_DIR/miniz.o" \
+  -o "$BINARY"
+
+"$BINARY" "$@"
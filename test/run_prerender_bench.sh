@@ -0,0 +1,47 @@
+#!/usr/bin/env bash
+set -euo pipefail
+
+ROOT_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")/.." && pwd)"
+BUILD_DIR="$ROOT_DIR/build/prerender_bench"
+BINARY="$BUILD_DIR/PrerenderBenchmark"
+
+mkdir -p "$BUILD_DIR"
+
+CFLAGS=(
+  -O2
+  -DMINIZ_NO_ZLIB_COMPATIBLE_NAMES=1
+  -I"$ROOT_DIR/lib/miniz"
+)
+
+# The bench directory comes first so its HalDisplay, SdFat and HardwareSerial stand-ins replace the device ones
+CXXFLAGS=(
+  -std=c++20
+  -O2
+  -Wall
+  -Wextra
+  -pedantic
+  -DMINIZ_NO_ZLIB_COMPATIBLE_NAMES=1
+  -I"$ROOT_DIR/test/prerender_bench"
+  -I"$ROOT_DIR/lib/EpdFont"
+  -I"$ROOT_DIR/lib/GfxRenderer"
+  -I"$ROOT_DIR/lib/Serialization"
+  -I"$ROOT_DIR/lib/Utf8"
+  -I"$ROOT_DIR/lib/miniz"
+)
+
+cc "${CFLAGS[@]}" -c "$ROOT_DIR/lib/miniz/miniz.c" -o "$BUILD_DIR/miniz.o"
+
+c++ "${CXXFLAGS[@]}" \
+  "$ROOT_DIR/test/prerender_bench/PrerenderBenchmark.cpp" \
+  "$ROOT_DIR/lib/GfxRenderer/GfxRenderer.cpp" \
+  "$ROOT_DIR/lib/GfxRenderer/PackBits.cpp" \
+  "$ROOT_DIR/lib/GfxRenderer/Bitmap.cpp" \
+  "$ROOT_DIR/lib/GfxRenderer/BitmapHelpers.cpp" \
+  "$ROOT_DIR/lib/Serialization/BufferedFsReader.cpp" \
+  "$ROOT_DIR/lib/EpdFont/EpdFont.cpp" \
+  "$ROOT_DIR/lib/EpdFont/EpdFontFamily.cpp" \
+  "$ROOT_DIR/lib/Utf8/Utf8.cpp" \
+  "$BUILD_DIR/miniz.o" \
+  -o "$BINARY"
+
+"$BINARY" "$@"